@@ -4,6 +4,8 @@
 
 #include "app.h"
 #include "core/config.h"
+#include "core/utility/frame_allocator.h"
+#include "core/utility/slab_allocator.h"
 #include <SDL.h>
 #include <imgui.h>
 #include <imgui_impl_sdl2.h>
@@ -31,10 +33,14 @@ void App::init()
     auto [w, h] = renderer->getWindowSize();
     auto camera = Camera(45.0f, float(w), float(h), 0.1f, 1000.0f);
 
-    world = std::make_unique<GameWorld>();
+    world = std::make_unique<GameWorld>(threadPool);
+    chunkMesher = std::make_unique<voxel::ChunkMesher>(threadPool);
+    remeshScheduler = std::make_unique<voxel::RemeshScheduler>(world->getTerrain(), *chunkMesher);
+    remeshScheduler->setLighting(&world->getLight());
     Transform t = glm::vec3();
     t.rotation = glm::rotate(t.rotation, glm::vec3(0.0f, glm::radians(180.0f), 0.0f));
     camera.position = glm::vec3(0.0f, 5.0f, 3.0f);
+    previousCameraPosition = camera.position;
     const auto& ecs = world->getECSWorld();
     ecs.singleton<Camera>().set(camera);
     for (uint32_t i = 0; i < 5; i++) {
@@ -49,10 +55,14 @@ void App::init()
 
     auto e = ecs.entity().set(Transform()).set(assetManager.get<Model>("Cube"));
     e = e.add<StaticObject>();
-    ecs.system<const AssetRef<Model>, const Transform>()
-        .kind(flecs::PostUpdate)
-        .each([&](const AssetRef<Model>& m, const Transform& transform) {
-            renderer->addDrawable(m, transform);
+    drawSystem = ecs.system<const AssetRef<Model>, const Transform, const PreviousTransform*>()
+        .kind(0)
+        .each([&](const AssetRef<Model>& m, const Transform& transform, const PreviousTransform* previous) {
+            // Drawn between the last two ticks, so motion is smooth at any frame rate
+            if (previous == nullptr || !previous->captured)
+                renderer->addDrawable(m, transform);
+            else
+                renderer->addDrawable(m, interpolate(previous->transform, transform, float(getTickAlpha())));
         });
 
     ecs.system<Transform>().without<StaticObject>().each([](const flecs::iter& it, size_t, Transform& tr) {
@@ -66,6 +76,8 @@ void App::init()
 
 App::~App()
 {
+    remeshScheduler.reset();
+    chunkMesher.reset();
     world.reset();
     assetManager.clear();
     renderer.reset();
@@ -79,6 +91,18 @@ App::~App()
     }
 }
 
+void App::tick(const double tickTime)
+{
+    Camera* camera = world->getECSWorld().singleton<Camera>().get_mut<Camera>();
+    previousCameraPosition = camera->position;
+    const Uint8* keys = SDL_GetKeyboardState(nullptr);
+    const float vertical = float(keys[SDL_SCANCODE_SPACE]) - float(keys[SDL_SCANCODE_LCTRL]);
+    camera->position.z += 3.0f * vertical * float(tickTime);
+    if (!world->getECSWorld().progress(static_cast<float>(tickTime)))
+        stop();
+    world->update(tickTime);
+}
+
 void App::mainLoop(const double deltaTime)
 {
     renderer->beginImGuiFrame();
@@ -90,19 +114,6 @@ void App::mainLoop(const double deltaTime)
                 spdlog::info("Window closed");
                 stop();
                 break;
-            case SDL_KEYDOWN:
-                switch (event.key.keysym.sym) {
-                    case SDLK_SPACE:
-                        world->getECSWorld().singleton<Camera>().get_mut<Camera>()->position.z
-                            += 3.0f * float(deltaTime);
-                        break;
-                    case SDLK_LCTRL:
-                        world->getECSWorld().singleton<Camera>().get_mut<Camera>()->position.z
-                            -= 3.0f * float(deltaTime);
-                        break;
-                    default: break;
-                }
-                break;
         }
     }
     ImGui::Begin("Frame Info");
@@ -112,11 +123,95 @@ void App::mainLoop(const double deltaTime)
     ImGui::Checkbox("Vsync", &vsync);
     if (last != vsync)
         renderer->setVsync(vsync);
-    if (!world->getECSWorld().progress(static_cast<float>(deltaTime)))
-        stop();
+    ImGui::Text(
+        "Ticks: %u this frame at %.0fHz, %llu dropped",
+        getFrameTicks(),
+        getTickRate(),
+        static_cast<unsigned long long>(getDroppedTicks())
+    );
+    drawSystem.run(static_cast<float>(deltaTime));
     ImGui::Text("Model count: %d", renderer->getDrawCount());
+    // Streaming and meshing run once per frame, the ticks only step the simulation
+    const glm::vec3 observer = world->getECSWorld().singleton<Camera>().get<Camera>()->position;
+    voxel::Terrain& terrain = world->getTerrain();
+    terrain.update(std::span(&observer, 1));
+    world->syncTerrain();
+    updateChunkMeshes(terrain);
+    ImGui::Text(
+        "Chunks: %zu (%.1fMB), pending %zu, queued %zu",
+        terrain.getChunks().size(),
+        double(terrain.getChunks().memoryUsage()) / (1024.0 * 1024.0),
+        terrain.getStreamer().pendingLoads(),
+        terrain.getStreamer().queuedWork()
+    );
+    ImGui::Text(
+        "Chunk meshes: %zu (%zu visible), meshing %zu, queued %zu",
+        renderer->getChunkMeshCount(),
+        renderer->getVisibleChunkCount(),
+        remeshScheduler->inFlight(),
+        remeshScheduler->queued()
+    );
+    ImGui::Text(
+        "Fluids: %zu active voxels in %zu chunks",
+        world->getFluids().activeCount(),
+        world->getFluids().activeChunkCount()
+    );
+    // Added up over the ticks of the frame
+    voxel::RandomTicker& randomTicker = world->getRandomTicker();
+    const auto& randomTicks = randomTicker.getStats();
+    ImGui::Text(
+        "Random ticks: %zu runs, %zu voxels from %zu sections (%zu skipped) in %.2fms",
+        randomTicks.tickRuns,
+        randomTicks.ticks,
+        randomTicks.sampledSections,
+        randomTicks.skippedSections,
+        randomTicks.milliseconds
+    );
+    randomTicker.resetStats();
+    const voxel::Pathfinder& pathfinder = world->getPathfinder();
+    ImGui::Text(
+        "Paths: %zu chunk graphs with %zu nodes, %zu builds and %zu requests pending",
+        pathfinder.graphCount(),
+        pathfinder.nodeCount(),
+        pathfinder.pendingBuilds(),
+        pathfinder.pendingRequests()
+    );
+    const auto frameMemory = frameAllocator::getStats();
+    ImGui::Text(
+        "Frame memory: %.1fKB (peak %.1fKB)",
+        double(frameMemory.lastFrameBytes) / 1024.0,
+        double(frameMemory.peakFrameBytes) / 1024.0
+    );
+    ImGui::Text(
+        "Frame memory blocks: %zu (%.1fMB), overflows: %llu",
+        frameMemory.blockCount,
+        double(frameMemory.capacity) / (1024.0 * 1024.0),
+        static_cast<unsigned long long>(frameMemory.overflowCount)
+    );
+    const auto chunkMemory = slabAllocator::getStats();
+    ImGui::Text(
+        "Chunk blocks: %zu live (%.1fMB), %zu pooled (%.1fMB), RSS %.1fMB",
+        chunkMemory.liveBlocks,
+        double(chunkMemory.liveBytes) / (1024.0 * 1024.0),
+        chunkMemory.pooledBlocks,
+        double(chunkMemory.pooledBytes) / (1024.0 * 1024.0),
+        double(chunkMemory.residentBytes) / (1024.0 * 1024.0)
+    );
     ImGui::End();
-    renderer->render(*world->getECSWorld().singleton<Camera>().get<Camera>());
+    // Drawn between the last two ticks like the models
+    Camera camera = *world->getECSWorld().singleton<Camera>().get<Camera>();
+    camera.position = glm::mix(previousCameraPosition, camera.position, float(getTickAlpha()));
+    renderer->render(camera);
+}
+
+void App::updateChunkMeshes(voxel::Terrain& terrain)
+{
+    for (const glm::i32vec3 position : terrain.getStreamer().getUnloaded())
+        renderer->freeChunkMesh(position);
+    remeshScheduler->update();
+    meshedChunks.clear();
+    if (remeshScheduler->poll(meshedChunks) > 0)
+        renderer->uploadChunkMeshes(meshedChunks);
 }
 
 cxxopts::OptionAdder App::getExtraCliOptions(cxxopts::OptionAdder&& options)
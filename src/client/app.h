@@ -5,6 +5,9 @@
 #pragma once
 #include <client/rendering/base_renderer.h>
 #include <core/engine.h>
+#include <core/voxel/mesher.h>
+#include <core/voxel/remesh_scheduler.h>
+#include <core/voxel/terrain.h>
 #include <memory>
 
 namespace dragonfire {
@@ -17,11 +20,21 @@ public:
     ~App() override;
 
 protected:
+    void tick(double tickTime) override;
     void mainLoop(double deltaTime) override;
     cxxopts::OptionAdder getExtraCliOptions(cxxopts::OptionAdder&& options) override;
 
 private:
     std::unique_ptr<BaseRenderer> renderer;
+    std::unique_ptr<voxel::ChunkMesher> chunkMesher;
+    std::unique_ptr<voxel::RemeshScheduler> remeshScheduler;
+    std::vector<voxel::MeshedChunk> meshedChunks;
+    /// Draws every model, run once per frame rather than with the simulation
+    flecs::system drawSystem;
+    /// Position of the camera at the start of the last tick, it is drawn between this and where it is now
+    glm::vec3 previousCameraPosition{};
+
+    void updateChunkMeshes(voxel::Terrain& terrain);
 };
 
 }// namespace dragonfire
\ No newline at end of file
@@ -10,11 +10,13 @@
 
 extern "C" int main(const int argc, char** argv)
 {
+    int exitCode = 0;
     dragonfire::crashOnException([&] {
         dragonfire::App app(argc, argv);
         app.init();
         app.run();
+        exitCode = app.getExitCode();
     });
     spdlog::shutdown();
-    return 0;
+    return exitCode;
 }
@@ -113,6 +113,14 @@ void BaseRenderer::render(const Camera& camera)
 {
     ImGui::Render();
     beginFrame(camera);
+    occlusion.cull(camera.position);
+    visibleChunks = 0;
+    for (const auto& [position, model] : chunkModels) {
+        if (!occlusion.isVisible(position))
+            continue;
+        addDrawable(&model, Transform(glm::vec3(position * std::int32_t(voxel::Chunk::CHUNK_DIM))));
+        visibleChunks++;
+    }
     drawModels(camera, drawables);
     endFrame();
 }
@@ -4,6 +4,9 @@
 
 #pragma once
 #include "camera.h"
+#include "core/voxel/chunk_map.h"
+#include "core/voxel/mesher.h"
+#include "core/voxel/visibility.h"
 #include "core/world/transform.h"
 #include "model.h"
 #include <SDL_video.h>
@@ -25,6 +28,13 @@ public:
 
     void addDrawable(const Drawable* drawable, const Transform& transform);
     void addDrawables(const Drawable* drawable, std::span<Transform> transforms);
+    /***
+     * @brief Uploads finished chunk meshes as a single batch, replacing any mesh the chunks already had.
+     * Chunks are drawn every frame once their upload has finished, empty meshes remove the chunk's mesh.
+     */
+    virtual void uploadChunkMeshes(std::span<const voxel::MeshedChunk> meshes) = 0;
+    /// Stops drawing the chunk and frees its mesh once the GPU is no longer using it
+    virtual void freeChunkMesh(glm::i32vec3 position) = 0;
     void render(const Camera& camera);
     virtual void setVsync(bool vsync);
 
@@ -35,10 +45,19 @@ public:
     static BaseRenderer* createRenderer(bool enableValidation);
 
     [[nodiscard]] uint32_t getDrawCount() const noexcept { return drawables.size(); }
+
+    [[nodiscard]] std::size_t getChunkMeshCount() const noexcept { return chunkModels.size(); }
+
+    /// Number of chunk meshes drawn by the last frame, after culling chunks hidden behind terrain
+    [[nodiscard]] std::size_t getVisibleChunkCount() const noexcept { return visibleChunks; }
     [[nodiscard]] std::pair<int, int> getWindowSize() const noexcept;
 
 protected:
     std::shared_ptr<spdlog::logger> logger;
+    /// Models of the chunks with a finished mesh, drawn at each chunk's position
+    ankerl::unordered_dense::map<glm::i32vec3, Model, voxel::ChunkPositionHash> chunkModels;
+    /// Visibility of every meshed chunk, including empty ones, used to skip chunks hidden behind terrain
+    voxel::OcclusionCuller occlusion;
     virtual void beginFrame(const Camera& camera) = 0;
     virtual void drawModels(const Camera& camera, const Drawable::Drawables& models) = 0;
     virtual void endFrame();
@@ -47,6 +66,7 @@ private:
     SDL_Window* window = nullptr;
     void (*imguiRenderNewFrameCallback)() = nullptr;
     uint64_t frameCount = 0;
+    std::size_t visibleChunks = 0;
     Drawable::Drawables drawables;
 };
 
@@ -0,0 +1,40 @@
+#include "chunk_mesh.h"
+#include <cassert>
+#include <cmath>
+
+namespace dragonfire {
+
+glm::vec4 chunkMeshBounds() noexcept
+{
+    constexpr float half = float(voxel::Chunk::CHUNK_DIM) / 2.0f;
+    return {half, half, half, half * std::sqrt(3.0f)};
+}
+
+void writeChunkVertices(
+    const voxel::ChunkMesh& mesh,
+    const std::span<Vertex> vertices,
+    const std::span<uint32_t> indices
+)
+{
+    assert(vertices.size() >= chunkVertexCount(mesh) && indices.size() >= chunkIndexCount(mesh));
+    Vertex* vertex = vertices.data();
+    uint32_t* index = indices.data();
+    uint32_t base = 0;
+    for (const voxel::MeshQuad& quad : mesh.quads) {
+        const voxel::QuadAxes axes = voxel::quadAxes(quad.face);
+        const glm::vec3 normal(voxel::FACE_DIRECTIONS[quad.face]);
+        const glm::i32vec3 origin(quad.position);
+        constexpr float maxLevel = voxel::ChunkLight::MAX_LEVEL;
+        const glm::vec2 light(float(quad.light >> 4) / maxLevel, float(quad.light & 0xF) / maxLevel);
+        // UVs count voxels across the quad so textures repeat once per voxel
+        for (const glm::i32vec3 corner : voxel::quadCorners(quad)) {
+            const glm::vec2 uv(corner[axes.u] - origin[axes.u], corner[axes.v] - origin[axes.v]);
+            *vertex++ = Vertex{glm::vec3(corner), normal, uv, light};
+        }
+        for (const uint32_t i : {0u, 1u, 2u, 0u, 2u, 3u})
+            *index++ = base + i;
+        base += 4;
+    }
+}
+
+}// namespace dragonfire
@@ -0,0 +1,33 @@
+#pragma once
+#include "core/voxel/mesher.h"
+#include "vertex.h"
+#include <glm/vec4.hpp>
+#include <span>
+
+namespace dragonfire {
+
+/// Bounding sphere of any chunk mesh, relative to the chunk's minimum corner
+glm::vec4 chunkMeshBounds() noexcept;
+
+inline std::size_t chunkVertexCount(const voxel::ChunkMesh& mesh) noexcept
+{
+    return mesh.quads.size() * 4;
+}
+
+inline std::size_t chunkIndexCount(const voxel::ChunkMesh& mesh) noexcept
+{
+    return mesh.quads.size() * 6;
+}
+
+/***
+ * @brief Writes the triangles of a chunk mesh, positions are relative to the chunk's minimum corner
+ * @param vertices must have room for chunkVertexCount(mesh) vertices
+ * @param indices must have room for chunkIndexCount(mesh) indices, indices start from the first vertex
+ */
+void writeChunkVertices(
+    const voxel::ChunkMesh& mesh,
+    std::span<Vertex> vertices,
+    std::span<uint32_t> indices
+);
+
+}// namespace dragonfire
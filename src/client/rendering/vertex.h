@@ -12,6 +12,8 @@ struct Vertex {
     glm::vec3 position;
     glm::vec3 normal;
     glm::vec2 uv;
+    /// Sky and block light from 0 to 1, models are drawn in full sky light
+    glm::vec2 light{1.0f, 0.0f};
 };
 
 }// namespace dragonfire
\ No newline at end of file
@@ -108,7 +108,7 @@ std::pair<Mesh*, vk::Fence> MeshRegistry::uploadMesh(
         throw std::runtime_error("VMA virtual allocation failed");
     }
     vmaGetVirtualAllocationInfo(vertexBlock, mesh->vertexAlloc, &mesh->vertexInfo);
-    vmaGetVirtualAllocationInfo(vertexBlock, mesh->vertexAlloc, &mesh->indexInfo);
+    vmaGetVirtualAllocationInfo(indexBlock, mesh->indexAlloc, &mesh->indexInfo);
 
     device.resetCommandPool(pool);
     vk::CommandBufferBeginInfo beginInfo{};
@@ -179,6 +179,85 @@ std::pair<Mesh*, vk::Fence> MeshRegistry::uploadMesh(
     return uploadMesh(id, stagingBuffer, vertices.size(), indices.size());
 }
 
+std::pair<std::vector<Mesh*>, vk::Fence> MeshRegistry::uploadMeshes(
+    const Buffer& stagingBuffer,
+    const std::span<const MeshUpload> uploads
+)
+{
+    std::vector<Mesh*> out;
+    out.reserve(uploads.size());
+    std::vector<vk::BufferCopy> vertexCopies, indexCopies;
+    vertexCopies.reserve(uploads.size());
+    indexCopies.reserve(uploads.size());
+    std::vector<const std::string*> added;
+
+    std::unique_lock lock(mutex);
+    for (const MeshUpload& upload : uploads) {
+        const auto [iter, inserted] = meshes.try_emplace(upload.id);
+        Mesh* mesh = &iter->second;
+        out.push_back(mesh);
+        if (!inserted)
+            continue;
+        mesh->vertexCount = upload.vertexCount;
+        mesh->indexCount = upload.indexCount;
+
+        VmaVirtualAllocationCreateInfo vertexAllocInfo{}, indexAllocInfo{};
+        vertexAllocInfo.size = upload.vertexCount * sizeof(Vertex);
+        vertexAllocInfo.alignment = 16;
+        indexAllocInfo.size = upload.indexCount * sizeof(uint32_t);
+        indexAllocInfo.alignment = 16;
+        VkResult result = vmaVirtualAllocate(vertexBlock, &vertexAllocInfo, &mesh->vertexAlloc, nullptr);
+        if (result == VK_SUCCESS) {
+            result = vmaVirtualAllocate(indexBlock, &indexAllocInfo, &mesh->indexAlloc, nullptr);
+            if (result != VK_SUCCESS)
+                vmaVirtualFree(vertexBlock, mesh->vertexAlloc);
+        }
+        if (result != VK_SUCCESS) {
+            // Release the meshes allocated by this batch so a failed batch does not leak buffer space
+            meshes.erase(iter);
+            for (const std::string* id : added) {
+                const auto found = meshes.find(*id);
+                vmaVirtualFree(vertexBlock, found->second.vertexAlloc);
+                vmaVirtualFree(indexBlock, found->second.indexAlloc);
+                meshes.erase(found);
+            }
+            throw std::runtime_error("VMA virtual allocation failed");
+        }
+        vmaGetVirtualAllocationInfo(vertexBlock, mesh->vertexAlloc, &mesh->vertexInfo);
+        vmaGetVirtualAllocationInfo(indexBlock, mesh->indexAlloc, &mesh->indexInfo);
+        added.push_back(&upload.id);
+
+        vertexCopies.emplace_back(upload.vertexOffset, mesh->vertexInfo.offset, vertexAllocInfo.size);
+        if (upload.indexCount > 0)
+            indexCopies.emplace_back(upload.indexOffset, mesh->indexInfo.offset, indexAllocInfo.size);
+    }
+    if (vertexCopies.empty())
+        return {out, nullptr};
+
+    device.resetCommandPool(pool);
+    vk::CommandBufferBeginInfo beginInfo{};
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    cmd.begin(beginInfo);
+    cmd.copyBuffer(stagingBuffer, vertexBuffer, vertexCopies);
+    if (!indexCopies.empty())
+        cmd.copyBuffer(stagingBuffer, indexBuffer, indexCopies);
+    cmd.end();
+
+    vk::SubmitInfo submitInfo{};
+    submitInfo.pCommandBuffers = &cmd;
+    submitInfo.commandBufferCount = 1;
+    vk::Fence fence = device.createFence(vk::FenceCreateInfo());
+    try {
+        queue.submit(submitInfo, fence);
+    }
+    catch (...) {
+        device.destroy(fence);
+        throw;
+    }
+
+    return {out, fence};
+}
+
 void MeshRegistry::freeMesh(const Mesh* mesh)
 {
     if (mesh) {
@@ -188,6 +267,17 @@ void MeshRegistry::freeMesh(const Mesh* mesh)
     }
 }
 
+void MeshRegistry::freeMesh(const std::string_view id)
+{
+    std::unique_lock lock(mutex);
+    const auto iter = meshes.find(id);
+    if (iter == meshes.end())
+        return;
+    vmaVirtualFree(vertexBlock, iter->second.vertexAlloc);
+    vmaVirtualFree(indexBlock, iter->second.indexAlloc);
+    meshes.erase(iter);
+}
+
 Mesh* MeshRegistry::getMesh(const std::string_view id)
 {
     std::shared_lock lock(mutex);
@@ -8,6 +8,8 @@
 #include <client/rendering/vertex.h>
 #include <core/utility/string_hash.h>
 #include <shared_mutex>
+#include <span>
+#include <vector>
 
 namespace dragonfire::vulkan {
 
@@ -19,6 +21,13 @@ struct Mesh {
 
 class MeshRegistry {
 public:
+    struct MeshUpload {
+        std::string id;
+        size_t vertexCount, indexCount;
+        /// Byte offsets of the mesh's vertices and indices in the staging buffer
+        size_t vertexOffset, indexOffset;
+    };
+
     MeshRegistry(const Context& ctx, GpuAllocator& allocator);
     ~MeshRegistry();
     std::pair<Mesh*, vk::Fence> uploadMesh(
@@ -34,7 +43,17 @@ public:
         std::span<Vertex> vertices,
         std::span<uint32_t> indices
     );
+    /***
+     * @brief Copies many meshes out of one staging buffer with a single submission
+     * @return the meshes in the same order as uploads, and a fence signalled once every copy has finished
+     */
+    std::pair<std::vector<Mesh*>, vk::Fence> uploadMeshes(
+        const Buffer& stagingBuffer,
+        std::span<const MeshUpload> uploads
+    );
     void freeMesh(const Mesh* mesh);
+    /// Frees the mesh and removes it from the registry, so the id can be uploaded again
+    void freeMesh(std::string_view id);
     Mesh* getMesh(std::string_view id);
     void bindBuffers(vk::CommandBuffer cmd);
 
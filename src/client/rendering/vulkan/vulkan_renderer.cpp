@@ -3,6 +3,7 @@
 //
 
 #include "vulkan_renderer.h"
+#include "client/rendering/chunk_mesh.h"
 #include "core/config.h"
 #include "core/crash.h"
 #include "core/utility/utility.h"
@@ -60,6 +61,8 @@ vulkan::VulkanRenderer::VulkanRenderer(bool enableValidation)
     const bool vsync = Config::get().getBool("vsync").value_or(true);
     swapchain = Swapchain(getWindow(), context, vsync);
     meshRegistry = std::make_unique<MeshRegistry>(context, allocator);
+    chunkStagingBuffer
+        = std::make_unique<StagingBuffer>(allocator, 1 << 20, true, "chunk mesh staging buffer");
     descriptorLayoutManager = DescriptorLayoutManager(context.device);
     pipelineFactory = std::make_unique<PipelineFactory>(
         context,
@@ -157,7 +160,11 @@ void vulkan::VulkanRenderer::beginFrame(const Camera& camera)
 {
     waitForLastFrame();
     writeGlobalUBO(camera);
-    const Frame& frame = getCurrentFrame();
+    Frame& frame = getCurrentFrame();
+    for (const std::string& id : frame.retiredMeshes)
+        meshRegistry->freeMesh(id);
+    frame.retiredMeshes.clear();
+    finishChunkUploads(false);
     context.device.resetCommandPool(frame.pool);
     vk::CommandBufferBeginInfo beginInfo{};
     beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
@@ -237,6 +244,9 @@ vulkan::VulkanRenderer::~VulkanRenderer()
     presentThread.join();
     context.device.waitIdle();
     ImGui_ImplVulkan_Shutdown();
+    context.device.destroy(chunkUploadFence);
+    chunkModels.clear();
+    chunkStagingBuffer.reset();
     for (Frame& frame : frames) {
         context.device.destroy(frame.pool);
         context.device.destroy(frame.presentSemaphore);
@@ -280,6 +290,105 @@ std::unique_ptr<Model::Loader> vulkan::VulkanRenderer::getModelLoader()
     );
 }
 
+void vulkan::VulkanRenderer::uploadChunkMeshes(const std::span<const voxel::MeshedChunk> meshes)
+{
+    // Only one batch is in flight at a time, so the staging buffer and upload list can be reused
+    finishChunkUploads(true);
+    std::size_t vertexBytes = 0, indexBytes = 0;
+    for (const voxel::MeshedChunk& meshed : meshes) {
+        vertexBytes += chunkVertexCount(meshed.mesh) * sizeof(Vertex);
+        indexBytes += chunkIndexCount(meshed.mesh) * sizeof(uint32_t);
+    }
+    char* staging = static_cast<char*>(chunkStagingBuffer->getStagingPtr(vertexBytes + indexBytes));
+
+    std::vector<MeshRegistry::MeshUpload> uploads;
+    uploads.reserve(meshes.size());
+    std::size_t vertexOffset = 0, indexOffset = vertexBytes;
+    for (const voxel::MeshedChunk& meshed : meshes) {
+        if (meshed.mesh.empty()) {
+            freeChunkMesh(meshed.position);
+            // Empty chunks have nothing to draw but can still be seen through
+            occlusion.setVisibility(meshed.position, meshed.visibility);
+            continue;
+        }
+        occlusion.setVisibility(meshed.position, meshed.visibility);
+        const std::size_t vertexCount = chunkVertexCount(meshed.mesh);
+        const std::size_t indexCount = chunkIndexCount(meshed.mesh);
+        writeChunkVertices(
+            meshed.mesh,
+            std::span(reinterpret_cast<Vertex*>(staging + vertexOffset), vertexCount),
+            std::span(reinterpret_cast<uint32_t*>(staging + indexOffset), indexCount)
+        );
+        const glm::i32vec3 pos = meshed.position;
+        std::string id = fmt::format("chunk_{}_{}_{}_{}", pos.x, pos.y, pos.z, chunkMeshVersion++);
+        uploads.push_back({id, vertexCount, indexCount, vertexOffset, indexOffset});
+        chunkUploads.push_back({pos, std::move(id)});
+        vertexOffset += vertexCount * sizeof(Vertex);
+        indexOffset += indexCount * sizeof(uint32_t);
+    }
+    if (uploads.empty())
+        return;
+    chunkStagingBuffer->flushStagingBuffer();
+
+    auto [uploaded, fence] = meshRegistry->uploadMeshes(chunkStagingBuffer->getStagingBuffer(), uploads);
+    for (std::size_t i = 0; i < uploaded.size(); i++)
+        chunkUploads[i].mesh = uploaded[i];
+    chunkUploadFence = fence;
+}
+
+void vulkan::VulkanRenderer::freeChunkMesh(const glm::i32vec3 position)
+{
+    for (ChunkUpload& upload : chunkUploads) {
+        if (upload.position == position)
+            upload.cancelled = true;
+    }
+    chunkModels.erase(position);
+    occlusion.remove(position);
+    const auto found = chunkMeshIds.find(position);
+    if (found != chunkMeshIds.end()) {
+        retireMesh(std::move(found->second));
+        chunkMeshIds.erase(found);
+    }
+}
+
+void vulkan::VulkanRenderer::finishChunkUploads(const bool wait)
+{
+    if (!chunkUploadFence)
+        return;
+    if (wait) {
+        if (context.device.waitForFences(chunkUploadFence, true, UINT64_MAX) != vk::Result::eSuccess)
+            logger->error("Fence wait failed, attempting to continue, but things may break");
+    }
+    else if (context.device.getFenceStatus(chunkUploadFence) != vk::Result::eSuccess)
+        return;
+    context.device.destroy(chunkUploadFence);
+    chunkUploadFence = nullptr;
+
+    for (ChunkUpload& upload : chunkUploads) {
+        if (upload.cancelled) {
+            retireMesh(std::move(upload.meshId));
+            continue;
+        }
+        std::string& current = chunkMeshIds[upload.position];
+        if (!current.empty())
+            retireMesh(std::move(current));
+        current = std::move(upload.meshId);
+
+        Model model;
+        const auto mesh = reinterpret_cast<dragonfire::Mesh>(upload.mesh);
+        model.addPrimitive({mesh, Material::DEFAULT, chunkMeshBounds()});
+        chunkModels[upload.position] = std::move(model);
+    }
+    chunkUploads.clear();
+}
+
+void vulkan::VulkanRenderer::retireMesh(std::string&& id)
+{
+    // Frames are recorded between presenting the previous frame and waiting on the next frame's fence, so
+    // the previous frame may still be drawing the mesh. Free it after that frame's fence has been waited on.
+    frames[(getFrameCount() + 1) % FRAMES_IN_FLIGHT].retiredMeshes.push_back(std::move(id));
+}
+
 void vulkan::VulkanRenderer::computePrePass(const uint32_t drawCount, const bool cull)
 {
     const Frame& frame = getCurrentFrame();
@@ -431,6 +540,7 @@ void vulkan::VulkanRenderer::waitForLastFrame()
     const Frame& frame = getCurrentFrame();
     if (context.device.waitForFences(frame.fence, true, UINT64_MAX) != vk::Result::eSuccess)
         logger->error("Fence wait failed, attempting to continue, but things may break");
+    frameArena.beginFrame(getFrameCount());
 
     int retries = 0;
     do {
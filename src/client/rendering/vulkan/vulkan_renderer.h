@@ -8,9 +8,11 @@
 #include "descriptor_set.h"
 #include "mesh.h"
 #include "pipeline.h"
+#include "staging_buffer.h"
 #include "swapchain.h"
 #include "texture.h"
 #include <client/rendering/base_renderer.h>
+#include <core/utility/frame_arena.h>
 #include <condition_variable>
 #include <thread>
 
@@ -21,11 +23,16 @@ public:
     explicit VulkanRenderer(bool enableValidation);
     ~VulkanRenderer() override;
     std::unique_ptr<Model::Loader> getModelLoader() override;
+    void uploadChunkMeshes(std::span<const voxel::MeshedChunk> meshes) override;
+    void freeChunkMesh(glm::i32vec3 position) override;
 
     static constexpr int FRAMES_IN_FLIGHT = 2;
     const uint32_t maxDrawCount;
     void setVsync(bool vsync) override;
 
+    /// Scratch memory that stays valid until the GPU has finished with the frame it was allocated in
+    [[nodiscard]] FrameArena& getFrameArena() noexcept { return frameArena; }
+
 protected:
     void beginFrame(const Camera& camera) override;
     void drawModels(const Camera& camera, const Drawable::Drawables& models) override;
@@ -64,6 +71,15 @@ private:
         Buffer drawData, culledMatrices, commandBuffer, countBuffer, textureIndexBuffer;
         vk::Fence fence;
         uint32_t textureBinding = 0;
+        /// Meshes to free once this frame's fence has been waited on
+        std::vector<std::string> retiredMeshes;
+    };
+
+    struct ChunkUpload {
+        glm::i32vec3 position;
+        std::string meshId;
+        Mesh* mesh = nullptr;
+        bool cancelled = false;
     };
 
     Context context;
@@ -80,6 +96,14 @@ private:
     Pipeline cullPipeline;
     std::unique_ptr<TextureRegistry> textureRegistry;
     vk::DescriptorPool descriptorPool;
+    FrameArena frameArena{FRAMES_IN_FLIGHT};
+    std::unique_ptr<StagingBuffer> chunkStagingBuffer;
+    /// Chunk meshes being copied by the transfer queue, they are not drawn until chunkUploadFence signals
+    std::vector<ChunkUpload> chunkUploads;
+    vk::Fence chunkUploadFence;
+    /// Id of the mesh currently drawn for each chunk
+    ankerl::unordered_dense::map<glm::i32vec3, std::string, voxel::ChunkPositionHash> chunkMeshIds;
+    uint64_t chunkMeshVersion = 0;
 
     struct {
         std::mutex mutex;
@@ -109,6 +133,9 @@ private:
     void mainPass();
     void beginRendering();
     void waitForLastFrame();
+    /// Starts drawing the chunks from the last upload if it has finished, or waits for it to finish
+    void finishChunkUploads(bool wait);
+    void retireMesh(std::string&& id);
     void writeGlobalUBO(const Camera& camera) const;
     void present(const std::stop_token& token);
     void transitionImageLayout(
@@ -7,11 +7,15 @@
 using magic_enum::iostream_operators::operator<<;
 using magic_enum::iostream_operators::operator>>;
 
+#include "config.h"
 #include "crash.h"
 #include "engine.h"
 #include "file.h"
+#include "utility/alloc_tracker.h"
 #include "utility/frame_allocator.h"
 #include <SDL2/SDL.h>
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <iostream>
 #include <physfs.h>
@@ -109,18 +113,92 @@ Engine::~Engine()
 void Engine::run()
 {
     crashOnException([this] {
-        Uint64 time = SDL_GetTicks64();
+        const uint64_t maxFrames = cli["frames"].as<uint64_t>();
+        const int64_t allocBudget = cli["alloc-budget"].as<int64_t>();
+        const uint64_t warmupFrames = cli["alloc-warmup"].as<uint64_t>();
+        uint64_t frame = 0, worstFrame = 0, framesOverBudget = 0;
+        using Clock = std::chrono::steady_clock;
+        const auto& cfg = Config::get();
+        tickRate = std::clamp(cfg.getFloat("engine.tickRate").value_or(60.0), 1.0, 1000.0);
+        const int64_t maxTicksPerFrame = cfg.getInt("engine.maxTicksPerFrame").value_or(5);
+        const auto maxTicks = uint32_t(std::clamp<int64_t>(maxTicksPerFrame, 1, 100));
+        const auto tickDuration = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / tickRate)
+        );
+        Clock::duration accumulator{};
+        Clock::time_point time = Clock::now();
         running = true;
         while (running) {
             frameAllocator::nextFrame();
-            const Uint64 now = SDL_GetTicks64();
-            const double deltaTime = static_cast<double>(now - time) / 1000.0;
+            if (allocBudget >= 0 && frame == warmupFrames)
+                allocTracker::start();
+            const Clock::time_point now = Clock::now();
+            const double deltaTime = std::chrono::duration<double>(now - time).count();
+            accumulator += now - time;
             time = now;
+            frameTicks = 0;
+            while (running && accumulator >= tickDuration && frameTicks < maxTicks) {
+                tick(1.0 / tickRate);
+                accumulator -= tickDuration;
+                frameTicks++;
+            }
+            // When ticks take longer than the time they simulate, falling behind would make every frame run
+            // more of them, so the simulation slows down instead
+            if (accumulator >= tickDuration) {
+                droppedTicks += uint64_t(accumulator / tickDuration);
+                accumulator %= tickDuration;
+            }
+            tickAlpha = double(accumulator.count()) / double(tickDuration.count());
             mainLoop(deltaTime);
+            if (allocBudget >= 0 && frame >= warmupFrames) {
+                const uint64_t count = allocTracker::markFrame();
+                worstFrame = std::max(worstFrame, count);
+                if (count > uint64_t(allocBudget))
+                    framesOverBudget++;
+            }
+            if (++frame == maxFrames)
+                stop();
+        }
+        if (allocBudget >= 0) {
+            const uint64_t measured = frame - std::min(frame, warmupFrames);
+            checkAllocationBudget(allocBudget, measured, worstFrame, framesOverBudget);
         }
     });
 }
 
+void Engine::checkAllocationBudget(
+    const int64_t budget,
+    const uint64_t frames,
+    const uint64_t worstFrame,
+    const uint64_t framesOverBudget
+)
+{
+    allocTracker::stop();
+    if (!allocTracker::supported()) {
+        spdlog::error("Allocation budget set, but this build was not configured with ALLOC_TRACKING");
+        exitCode = 1;
+        return;
+    }
+    const auto totals = allocTracker::totals();
+    spdlog::info(
+        "Steady state heap allocations over {} frames: {} total, {:.2f} per frame, worst frame {}",
+        frames,
+        totals.count,
+        frames > 0 ? double(totals.count) / double(frames) : 0.0,
+        worstFrame
+    );
+    allocTracker::logReport();
+    if (framesOverBudget > 0) {
+        spdlog::error(
+            "{} of {} frames exceeded the allocation budget of {} allocations per frame",
+            framesOverBudget,
+            frames,
+            budget
+        );
+        exitCode = 1;
+    }
+}
+
 void Engine::parseCommandLine()
 {
     cxxopts::Options options(APP_NAME, "A voxel game engine");
@@ -130,7 +208,14 @@ void Engine::parseCommandLine()
         "Log level [trace, debug, info, warn, err, critical, off]",
         cxxopts::value<spdlog::level::level_enum>()->default_value("info")
     )("m,mount", "Mount a directory to a virtual mount point, specify args in the form of [dir]=[mount point]",
-        cxxopts::value<std::vector<std::string>>());
+        cxxopts::value<std::vector<std::string>>()
+    )("frames", "Exit after running this many frames, 0 runs until the game is closed",
+        cxxopts::value<uint64_t>()->default_value("0")
+    )("alloc-budget", "Fail if any frame after the warmup makes more heap allocations than this, "
+        "requires a build with ALLOC_TRACKING, -1 disables the check",
+        cxxopts::value<int64_t>()->default_value("-1")
+    )("alloc-warmup", "Number of frames to run before checking the allocation budget",
+        cxxopts::value<uint64_t>()->default_value("120"));
 
     cli = options.parse(argc, argv);
 
@@ -6,6 +6,7 @@
 #include "world/game_world.h"
 #include <cxxopts.hpp>
 #include "asset.h"
+#include "utility/thread_pool.h"
 #include <sol/sol.hpp>
 
 namespace dragonfire {
@@ -23,6 +24,9 @@ public:
 
     void stop() { running = false; }
 
+    /// Process exit code, non-zero if a check such as the allocation budget failed
+    [[nodiscard]] int getExitCode() const noexcept { return exitCode; }
+
     const bool remote;
 
     template<typename T>
@@ -37,19 +41,46 @@ public:
 protected:
     int argc;
     char** argv;
+    /***
+     * @brief Advances the simulation by one tick of fixed length
+     *
+     * Called at the rate set by engine.tickRate no matter the frame rate, so it may run several times in a
+     * frame or not at all.
+     */
+    virtual void tick(double tickTime) = 0;
+    /// Called once per frame after the ticks due, to handle input and render
     virtual void mainLoop(double deltaTime) = 0;
+
+    /// How far the time since the last tick is into the next one, from 0 to 1, for rendering between ticks
+    [[nodiscard]] double getTickAlpha() const noexcept { return tickAlpha; }
+
+    [[nodiscard]] double getTickRate() const noexcept { return tickRate; }
+
+    /// Number of ticks run in the last frame
+    [[nodiscard]] uint32_t getFrameTicks() const noexcept { return frameTicks; }
+
+    /// Number of ticks skipped because the simulation could not keep up
+    [[nodiscard]] uint64_t getDroppedTicks() const noexcept { return droppedTicks; }
     AssetManager assetManager;
 
     virtual cxxopts::OptionAdder getExtraCliOptions(cxxopts::OptionAdder&& options) { return options; }
 
     cxxopts::ParseResult cli;
+    /// Workers for background jobs such as terrain generation, declared before the world so it outlives it
+    ThreadPool threadPool;
     std::unique_ptr<GameWorld> world;
 
 private:
     static Engine* INSTANCE;
     bool running = false;
+    int exitCode = 0;
+    double tickRate = 60.0;
+    double tickAlpha = 0.0;
+    uint32_t frameTicks = 0;
+    uint64_t droppedTicks = 0;
 
     void parseCommandLine();
+    void checkAllocationBudget(int64_t budget, uint64_t frames, uint64_t worstFrame, uint64_t framesOverBudget);
 };
 
 }// namespace dragonfire
\ No newline at end of file
@@ -6,6 +6,18 @@
 #include <cassert>
 #include <physfs.h>
 #include <spdlog/spdlog.h>
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace dragonfire {
 File::File(const char* path, const Mode mode)
@@ -114,6 +126,108 @@ void File::mount(const std::string& dir, const std::string& mountPoint, const bo
     mount(dir.c_str(), mountPoint.c_str(), append);
 }
 
+void File::mkdir(const char* path)
+{
+    if (PHYSFS_mkdir(path) == 0)
+        throw PhysFsError(path);
+}
+
+std::filesystem::path File::nativeWritePath(const std::string_view path)
+{
+    const char* writeDir = PHYSFS_getWriteDir();
+    if (writeDir == nullptr)
+        throw PhysFsError(PHYSFS_ERR_NO_WRITE_DIR);
+    return std::filesystem::path(writeDir) / std::filesystem::path(path).relative_path();
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+    const HANDLE file = CreateFileW(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::system_error(int(GetLastError()), std::system_category(), path.string());
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        const DWORD error = GetLastError();
+        CloseHandle(file);
+        throw std::system_error(int(error), std::system_category(), path.string());
+    }
+    if (fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return;
+    }
+    // The view keeps the mapping and the file open, so both handles can be closed straight away
+    const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+        throw std::system_error(int(GetLastError()), std::system_category(), path.string());
+    ptr = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    const DWORD error = GetLastError();
+    CloseHandle(mapping);
+    if (ptr == nullptr)
+        throw std::system_error(int(error), std::system_category(), path.string());
+    size = size_t(fileSize.QuadPart);
+}
+
+void MappedFile::unmap() noexcept
+{
+    if (ptr)
+        UnmapViewOfFile(ptr);
+    ptr = nullptr;
+    size = 0;
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), path.string());
+    struct stat info{};
+    if (fstat(fd, &info) != 0) {
+        const int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), path.string());
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        return;
+    }
+    // The mapping keeps its own reference to the file, so the descriptor can be closed straight away
+    void* mapped = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    const int error = errno;
+    close(fd);
+    if (mapped == MAP_FAILED)
+        throw std::system_error(error, std::generic_category(), path.string());
+    ptr = static_cast<const uint8_t*>(mapped);
+    size = size_t(info.st_size);
+}
+
+void MappedFile::unmap() noexcept
+{
+    if (ptr)
+        munmap(const_cast<uint8_t*>(ptr), size);
+    ptr = nullptr;
+    size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() noexcept
+{
+    unmap();
+}
+
 PhysFsError::PhysFsError() : PhysFsError(PHYSFS_getLastErrorCode()) {}
 
 PhysFsError::PhysFsError(int errorCode)
@@ -4,8 +4,10 @@
 
 #pragma once
 #include <cstdint>
+#include <filesystem>
 #include <span>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
 struct PHYSFS_File;
@@ -60,6 +62,14 @@ public:
     static void init(const char* argv0);
     static void mount(const char* dir, const char* mountPoint, bool append = false);
     static void mount(const std::string& dir, const std::string& mountPoint, bool append = false);
+    /// Creates a directory, and any missing parents, in the write directory
+    static void mkdir(const char* path);
+    /***
+     * @brief Gets the native path of a file in the write directory, for access that can not go through
+     * PhysFs such as memory mapping or writing to the middle of a file
+     * @param path path relative to the write directory
+     */
+    static std::filesystem::path nativeWritePath(std::string_view path);
     File(const File& other) = delete;
 
     File(File&& other) noexcept : fp(other.fp) {}
@@ -75,6 +85,44 @@ public:
     }
 };
 
+/// Read only memory map of a native file, the file can be appended to while mapped but the map only
+/// covers the length the file had when it was mapped
+class MappedFile {
+    const uint8_t* ptr = nullptr;
+    size_t size = 0;
+
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile() noexcept;
+
+    [[nodiscard]] std::span<const uint8_t> data() const noexcept { return {ptr, size}; }
+
+    [[nodiscard]] size_t length() const noexcept { return size; }
+
+    MappedFile(const MappedFile& other) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : ptr(std::exchange(other.ptr, nullptr)), size(std::exchange(other.size, 0))
+    {
+    }
+
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this == &other)
+            return *this;
+        unmap();
+        ptr = std::exchange(other.ptr, nullptr);
+        size = std::exchange(other.size, 0);
+        return *this;
+    }
+
+private:
+    void unmap() noexcept;
+};
+
 struct PhysFsError final : std::runtime_error {
     PhysFsError();
     explicit PhysFsError(int errorCode);
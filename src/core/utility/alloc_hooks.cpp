@@ -0,0 +1,200 @@
+//
+// Replacements for the global allocation functions that report every heap allocation to allocTracker.
+// Only linked into core-tests and into the game when configured with ALLOC_TRACKING, see alloc_tracker.h
+//
+
+#include "alloc_tracker.h"
+#include <bit>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define DRAGONFIRE_MALLOC_HOOKS 1
+#else
+#define DRAGONFIRE_MALLOC_HOOKS 0
+#endif
+
+using dragonfire::allocTracker::detail::record;
+
+static const bool HOOKS_INSTALLED = [] {
+    dragonfire::allocTracker::detail::installHooks();
+    return true;
+}();
+
+#if DRAGONFIRE_MALLOC_HOOKS
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+
+// Hooks C allocations too, flecs, LuaJIT and most other C libraries allocate through these
+void* malloc(const std::size_t size)
+{
+    record(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(const std::size_t count, const std::size_t size)
+{
+    record(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, const std::size_t size)
+{
+    record(size);
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(const std::size_t alignment, const std::size_t size)
+{
+    record(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(const std::size_t alignment, const std::size_t size)
+{
+    record(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** out, const std::size_t alignment, const std::size_t size)
+{
+    if (alignment < sizeof(void*) || !std::has_single_bit(alignment))
+        return EINVAL;
+    record(size);
+    void* ptr = __libc_memalign(alignment, size);
+    if (ptr == nullptr && size != 0)
+        return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+}
+
+static void* allocate(const std::size_t size) noexcept
+{
+    record(size);
+    return __libc_malloc(size == 0 ? 1 : size);
+}
+
+static void* allocateAligned(const std::size_t size, const std::size_t alignment) noexcept
+{
+    record(size);
+    return __libc_memalign(alignment, size == 0 ? 1 : size);
+}
+#else
+static void* allocate(const std::size_t size) noexcept
+{
+    record(size);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+static void* allocateAligned(const std::size_t size, const std::size_t alignment) noexcept
+{
+    record(size);
+    #ifdef _WIN32
+    return _aligned_malloc(size == 0 ? 1 : size, alignment);
+    #else
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    #endif
+}
+#endif
+
+static void freeAligned(void* ptr) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void* operator new(const std::size_t size)
+{
+    if (void* ptr = allocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](const std::size_t size)
+{
+    if (void* ptr = allocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(const std::size_t size, const std::align_val_t alignment)
+{
+    if (void* ptr = allocateAligned(size, static_cast<std::size_t>(alignment)))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](const std::size_t size, const std::align_val_t alignment)
+{
+    if (void* ptr = allocateAligned(size, static_cast<std::size_t>(alignment)))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    freeAligned(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    freeAligned(ptr);
+}
@@ -0,0 +1,268 @@
+#include "alloc_tracker.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <spdlog/spdlog.h>
+#include <string_view>
+
+#if __has_include(<execinfo.h>) && __has_include(<dlfcn.h>) && __has_include(<cxxabi.h>)
+#define DRAGONFIRE_STACK_TRACES 1
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#else
+#define DRAGONFIRE_STACK_TRACES 0
+#endif
+
+namespace dragonfire {
+
+static constexpr std::size_t STACK_DEPTH = 12;
+static constexpr std::size_t SITE_TABLE_SIZE = 4096;
+
+struct SiteSlot {
+    std::atomic_uint64_t hash = 0, count = 0, bytes = 0;
+    std::atomic_int depth = 0;
+    void* frames[STACK_DEPTH]{};
+};
+
+static std::atomic_bool HOOKS_INSTALLED, ENABLED, CAPTURE_STACKS;
+static std::atomic_uint64_t TOTAL_COUNT, TOTAL_BYTES, FRAME_COUNT, DROPPED_SITES;
+static SiteSlot SITES[SITE_TABLE_SIZE];
+// Set while inside the hook or while building a report, so allocations made by the tracker itself,
+// including the ones made by backtrace() on first use, are not counted
+static thread_local bool IN_TRACKER = false;
+
+namespace {
+struct TrackerGuard {
+    bool previous = IN_TRACKER;
+
+    TrackerGuard() noexcept { IN_TRACKER = true; }
+
+    ~TrackerGuard() noexcept { IN_TRACKER = previous; }
+};
+}// namespace
+
+[[gnu::noinline]] static void recordSite(const std::size_t size) noexcept
+{
+#if DRAGONFIRE_STACK_TRACES
+    void* frames[STACK_DEPTH + 2];
+    const int depth = std::max(backtrace(frames, STACK_DEPTH + 2) - 2, 0);
+    void** stack = frames + 2;// skip recordSite and record
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (int i = 0; i < depth; i++) {
+        hash ^= reinterpret_cast<std::uintptr_t>(stack[i]);
+        hash *= 0x100000001b3;
+    }
+    hash = std::max<std::uint64_t>(hash, 1);
+    for (std::size_t probe = 0; probe < SITE_TABLE_SIZE; probe++) {
+        SiteSlot& slot = SITES[(hash + probe) % SITE_TABLE_SIZE];
+        std::uint64_t expected = slot.hash.load(std::memory_order_acquire);
+        if (expected == 0 && slot.hash.compare_exchange_strong(expected, hash, std::memory_order_acq_rel)) {
+            std::copy_n(stack, depth, slot.frames);
+            slot.depth.store(depth, std::memory_order_release);
+            expected = hash;
+        }
+        if (expected == hash) {
+            slot.count.fetch_add(1, std::memory_order_relaxed);
+            slot.bytes.fetch_add(size, std::memory_order_relaxed);
+            return;
+        }
+    }
+    DROPPED_SITES.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+void allocTracker::detail::installHooks() noexcept
+{
+    HOOKS_INSTALLED = true;
+}
+
+void allocTracker::detail::record(const std::size_t size) noexcept
+{
+    if (!ENABLED.load(std::memory_order_relaxed) || IN_TRACKER)
+        return;
+    TrackerGuard guard;
+    TOTAL_COUNT.fetch_add(1, std::memory_order_relaxed);
+    TOTAL_BYTES.fetch_add(size, std::memory_order_relaxed);
+    FRAME_COUNT.fetch_add(1, std::memory_order_relaxed);
+    if (CAPTURE_STACKS.load(std::memory_order_relaxed))
+        recordSite(size);
+}
+
+bool allocTracker::supported() noexcept
+{
+    return HOOKS_INSTALLED;
+}
+
+void allocTracker::start(const bool captureStacks) noexcept
+{
+    if (!supported()) {
+        spdlog::warn("Allocation tracking requested, but the allocation hooks are not linked in");
+        return;
+    }
+    CAPTURE_STACKS = captureStacks && DRAGONFIRE_STACK_TRACES;
+    FRAME_COUNT = 0;
+    ENABLED = true;
+}
+
+void allocTracker::stop() noexcept
+{
+    ENABLED = false;
+}
+
+void allocTracker::reset() noexcept
+{
+    TOTAL_COUNT = TOTAL_BYTES = FRAME_COUNT = DROPPED_SITES = 0;
+    for (SiteSlot& slot : SITES) {
+        slot.depth = 0;
+        slot.count = slot.bytes = 0;
+        slot.hash = 0;
+    }
+}
+
+std::uint64_t allocTracker::markFrame() noexcept
+{
+    return FRAME_COUNT.exchange(0, std::memory_order_relaxed);
+}
+
+allocTracker::Totals allocTracker::totals() noexcept
+{
+    return {TOTAL_COUNT.load(std::memory_order_relaxed), TOTAL_BYTES.load(std::memory_order_relaxed)};
+}
+
+#if DRAGONFIRE_STACK_TRACES
+/// Returns the demangled name of the function containing the address, or an empty string if it has no
+/// exported symbol, such as static functions or executables not linked with -rdynamic
+static std::string symbolName(void* address)
+{
+    Dl_info info{};
+    if (dladdr(address, &info) == 0 || info.dli_sname == nullptr)
+        return {};
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+    free(demangled);
+    return name;
+}
+#endif
+
+/// Frames belonging to the allocator or containers, the call site is the first frame that matches none
+static constexpr std::array IGNORED_FRAMES = {
+    "dragonfire::allocTracker",
+    "operator new",
+    "malloc",
+    "calloc",
+    "realloc",
+    "std::",
+    "__gnu_cxx::",
+    "ankerl::",
+};
+
+static constexpr std::array<std::pair<std::string_view, std::string_view>, 11> SUBSYSTEMS = {{
+    {"dragonfire::vulkan", "vulkan"},
+    {"dragonfire::voxel", "voxel"},
+    {"dragonfire::Model", "rendering"},
+    {"dragonfire::BaseRenderer", "rendering"},
+    {"flecs", "flecs"},
+    {"ecs_", "flecs"},
+    {"spdlog", "logging"},
+    {"ImGui", "imgui"},
+    {"sol::", "lua"},
+    {"JPH::", "physics"},
+    {"dragonfire::", "engine"},
+}};
+
+static void classify(const SiteSlot& slot, allocTracker::CallSite& site)
+{
+    site.subsystem = "other";
+#if DRAGONFIRE_STACK_TRACES
+    const int depth = slot.depth.load(std::memory_order_acquire);
+    for (int i = 0; i < depth; i++) {
+        std::string name = symbolName(slot.frames[i]);
+        if (name.empty()) {
+            if (site.location.empty())
+                site.location = fmt::format("{}", slot.frames[i]);
+            continue;
+        }
+        const bool ignored = std::ranges::any_of(IGNORED_FRAMES, [&](const char* pattern) {
+            return name.find(pattern) != std::string::npos;
+        });
+        if (ignored)
+            continue;
+        for (const auto& [pattern, subsystem] : SUBSYSTEMS) {
+            if (name.find(pattern) != std::string::npos) {
+                site.subsystem = subsystem;
+                break;
+            }
+        }
+        site.location = std::move(name);
+        return;
+    }
+#endif
+    if (site.location.empty())
+        site.location = "unknown";
+}
+
+std::vector<allocTracker::CallSite> allocTracker::callSites(const std::size_t maxCount)
+{
+    TrackerGuard guard;
+    std::vector<CallSite> sites;
+    for (const SiteSlot& slot : SITES) {
+        const std::uint64_t count = slot.count.load(std::memory_order_relaxed);
+        if (count == 0)
+            continue;
+        CallSite& site = sites.emplace_back();
+        site.stackHash = slot.hash.load(std::memory_order_relaxed);
+        site.count = count;
+        site.bytes = slot.bytes.load(std::memory_order_relaxed);
+    }
+    std::ranges::sort(sites, std::greater{}, &CallSite::count);
+    if (sites.size() > maxCount)
+        sites.resize(maxCount);
+    for (CallSite& site : sites) {
+        const auto& slot = *std::ranges::find_if(SITES, [&](const SiteSlot& s) {
+            return s.hash.load(std::memory_order_relaxed) == site.stackHash;
+        });
+        classify(slot, site);
+    }
+    return sites;
+}
+
+std::vector<allocTracker::SubsystemTotals> allocTracker::subsystems()
+{
+    TrackerGuard guard;
+    std::vector<SubsystemTotals> out;
+    for (const CallSite& site : callSites(SITE_TABLE_SIZE)) {
+        auto found = std::ranges::find(out, site.subsystem, &SubsystemTotals::subsystem);
+        if (found == out.end())
+            found = out.insert(out.end(), SubsystemTotals{site.subsystem});
+        found->count += site.count;
+        found->bytes += site.bytes;
+    }
+    std::ranges::sort(out, std::greater{}, &SubsystemTotals::count);
+    return out;
+}
+
+void allocTracker::logReport(const std::size_t maxSites)
+{
+    TrackerGuard guard;
+    const Totals total = totals();
+    spdlog::info("Heap allocations: {} ({} bytes)", total.count, total.bytes);
+    if (const auto dropped = DROPPED_SITES.load(); dropped > 0)
+        spdlog::warn("Allocation call site table full, {} allocations were not attributed", dropped);
+    for (const auto& [subsystem, count, bytes] : subsystems())
+        spdlog::info("  {:<10} {:>10} allocations {:>12} bytes", subsystem, count, bytes);
+    for (const CallSite& site : callSites(maxSites)) {
+        spdlog::info(
+            "  [{:016x}] {:>8} allocations {:>10} bytes [{}] {}",
+            site.stackHash,
+            site.count,
+            site.bytes,
+            site.subsystem,
+            site.location
+        );
+    }
+}
+
+}// namespace dragonfire
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dragonfire {
+
+/// Counts heap allocations made through global operator new and, on glibc, malloc, calloc, realloc,
+/// memalign, aligned_alloc and posix_memalign. The obsolete valloc and pvalloc are not counted.
+/// The hooks live in utility/alloc_hooks.cpp which is only linked into core-tests, and into the game
+/// when configured with -DALLOC_TRACKING=ON, in other builds supported() returns false and every other
+/// function is a no-op.
+namespace allocTracker {
+    /// Returns true if the allocation hooks are linked into this executable
+    bool supported() noexcept;
+    /***
+     * @brief Starts counting heap allocations made by any thread
+     * @param captureStacks also record a hash of the call stack of every allocation so the
+     * allocating call sites can be reported, this is a lot slower than just counting
+     */
+    void start(bool captureStacks = true) noexcept;
+    void stop() noexcept;
+    /// Clears all counters and recorded call sites
+    void reset() noexcept;
+    /// Returns the number of allocations since the last call to markFrame, or since start
+    std::uint64_t markFrame() noexcept;
+
+    struct Totals {
+        std::uint64_t count = 0, bytes = 0;
+    };
+
+    Totals totals() noexcept;
+
+    struct CallSite {
+        std::uint64_t stackHash = 0, count = 0, bytes = 0;
+        /// Engine subsystem the call site was attributed to, e.g. "vulkan", "voxel" or "flecs"
+        std::string subsystem;
+        /// Demangled name of the first function on the stack that is not allocator or standard library code
+        std::string location;
+    };
+
+    /// Returns the recorded call sites, sorted by allocation count with the most frequent first
+    std::vector<CallSite> callSites(std::size_t maxCount = 32);
+
+    struct SubsystemTotals {
+        std::string subsystem;
+        std::uint64_t count = 0, bytes = 0;
+    };
+
+    /// Returns the recorded allocations summed per subsystem, sorted by allocation count
+    std::vector<SubsystemTotals> subsystems();
+    /// Logs the per-subsystem totals and the top call sites
+    void logReport(std::size_t maxSites = 16);
+
+    namespace detail {
+        void installHooks() noexcept;
+        void record(std::size_t size) noexcept;
+    }// namespace detail
+}// namespace allocTracker
+
+}// namespace dragonfire
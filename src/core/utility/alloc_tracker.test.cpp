@@ -0,0 +1,75 @@
+#include "alloc_tracker.h"
+#include "frame_allocator.h"
+#include "temp_containers.h"
+#include <catch.hpp>
+#include <cstdlib>
+#include <memory>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace dragonfire;
+
+TEST_CASE("Allocation tracker")
+{
+    REQUIRE(allocTracker::supported());
+    allocTracker::reset();
+    frameAllocator::nextFrame();
+    // make sure this thread's frame arena exists before counting
+    frameAllocator::freeLast(frameAllocator::alloc(1), 1);
+
+    SECTION("Counts heap allocations")
+    {
+        allocTracker::start();
+        allocTracker::markFrame();
+        auto ptr = std::make_unique<std::uint64_t>(5);
+        auto array = std::make_unique<std::uint32_t[]>(64);
+        const auto count = allocTracker::markFrame();
+        allocTracker::stop();
+        CHECK(count == 2);
+        CHECK(allocTracker::totals().bytes >= sizeof(std::uint64_t) + 64 * sizeof(std::uint32_t));
+        const auto sites = allocTracker::callSites();
+        REQUIRE(!sites.empty());
+        std::uint64_t total = 0;
+        for (const auto& site : sites)
+            total += site.count;
+        CHECK(total == 2);
+        CHECK(!allocTracker::subsystems().empty());
+    }
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+    SECTION("Counts aligned C allocations")
+    {
+        // Kept where the compiler can't see them, so the allocations aren't optimized out
+        static void* volatile sink[3];
+        allocTracker::start(false);
+        allocTracker::markFrame();
+        sink[0] = aligned_alloc(64, 256);
+        void* ptr = nullptr;
+        const int result = posix_memalign(&ptr, 64, 256);
+        sink[1] = ptr;
+        sink[2] = memalign(64, 256);
+        const auto count = allocTracker::markFrame();
+        allocTracker::stop();
+        CHECK(result == 0);
+        CHECK(count == 3);
+        for (void* block : sink)
+            free(block);
+    }
+#endif
+
+    SECTION("Temporary containers stay off the heap")
+    {
+        allocTracker::start(false);
+        allocTracker::markFrame();
+        for (int frame = 0; frame < 10; frame++) {
+            frameAllocator::nextFrame();
+            TempVec<std::uint32_t> data;
+            for (std::uint32_t i = 0; i < 1000; i++)
+                data.push_back(i);
+            TempString str = "a string long enough to not fit in the small string buffer";
+            CHECK(allocTracker::markFrame() == 0);
+        }
+        allocTracker::stop();
+    }
+}
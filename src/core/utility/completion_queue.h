@@ -0,0 +1,46 @@
+#pragma once
+#include <mutex>
+#include <vector>
+
+namespace dragonfire {
+
+/// Queue for handing results from worker threads back to the thread that consumes them.
+/// Producers push individual results, the consumer takes everything available at once.
+template<typename T>
+class CompletionQueue {
+public:
+    void push(T&& value)
+    {
+        std::unique_lock lock(mutex);
+        items.push_back(std::move(value));
+    }
+
+    /***
+     * @brief Moves every completed item to the end of out
+     * @return the number of items added to out
+     */
+    std::size_t drain(std::vector<T>& out)
+    {
+        std::unique_lock lock(mutex);
+        if (out.empty()) {
+            out.swap(items);
+            return out.size();
+        }
+        const std::size_t count = items.size();
+        out.insert(out.end(), std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+        items.clear();
+        return count;
+    }
+
+    [[nodiscard]] std::size_t size()
+    {
+        std::unique_lock lock(mutex);
+        return items.size();
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<T> items;
+};
+
+}// namespace dragonfire
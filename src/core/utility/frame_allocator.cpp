@@ -3,60 +3,161 @@
 //
 
 #include "frame_allocator.h"
+#include "linear_arena.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <mutex>
-#include <sanitizer/asan_interface.h>
 #include <spdlog/spdlog.h>
+#include <vector>
 
 namespace dragonfire {
-static constexpr std::size_t MAX_SIZE = 1 << 21;// 2mb
+static constexpr std::size_t INITIAL_SIZE = 1 << 21;// 2mb
 static constexpr std::size_t BUFFER_COUNT = 2;
 
-static struct MemoryBuffer {
-    char memory[MAX_SIZE]{};
-    std::size_t offset = 0;
-} BUFFERS[BUFFER_COUNT], *CURRENT_BUFFER = &BUFFERS[0];
+/// Bump arena owned by a single thread at a time, so the allocation path needs no locking.
+/// Arenas are never freed while the program runs, when a thread exits its arena is handed to the next
+/// thread that needs one, allocations made by the exited thread stay valid for the rest of the frame.
+struct ThreadArena {
+    LinearArena buffers[BUFFER_COUNT] = {LinearArena(INITIAL_SIZE), LinearArena(INITIAL_SIZE)};
+    LinearArena* current = &buffers[0];
+    std::uint64_t epoch = 0;
+    // Written by the owning thread, read by nextFrame and getStats
+    std::atomic_uint64_t statsEpoch = 0, overflows = 0;
+    std::atomic_size_t frameBytes = 0, blockCount = BUFFER_COUNT, capacity = BUFFER_COUNT * INITIAL_SIZE;
 
-static std::uint64_t SWAP_COUNT;
+    void advance(const std::uint64_t frame) noexcept
+    {
+        epoch = frame;
+        current = &buffers[frame % BUFFER_COUNT];
+        current->reset();
+        updateStats();
+    }
+
+    void updateStats() noexcept
+    {
+        std::uint64_t overflowTotal = 0;
+        std::size_t blockTotal = 0, capacityTotal = 0;
+        for (const LinearArena& buffer : buffers) {
+            overflowTotal += buffer.overflowCount();
+            blockTotal += buffer.blockCount();
+            capacityTotal += buffer.capacity();
+        }
+        overflows.store(overflowTotal, std::memory_order_relaxed);
+        blockCount.store(blockTotal, std::memory_order_relaxed);
+        capacity.store(capacityTotal, std::memory_order_relaxed);
+    }
+};
+
+static std::atomic_uint64_t EPOCH;
+
+static struct ArenaRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadArena>> arenas;
+    std::vector<ThreadArena*> freeArenas;
+    std::size_t lastFrameBytes = 0, peakFrameBytes = 0;
+
+    ThreadArena* acquire()
+    {
+        std::unique_lock lock(mutex);
+        if (!freeArenas.empty()) {
+            ThreadArena* arena = freeArenas.back();
+            freeArenas.pop_back();
+            return arena;
+        }
+        SPDLOG_TRACE("Creating per-frame arena {}", arenas.size());
+        return arenas.emplace_back(std::make_unique<ThreadArena>()).get();
+    }
+
+    void release(ThreadArena* arena)
+    {
+        std::unique_lock lock(mutex);
+        freeArenas.push_back(arena);
+    }
+} REGISTRY;
+
+static thread_local struct ArenaHandle {
+    ThreadArena* arena = nullptr;
+
+    ~ArenaHandle()
+    {
+        if (arena)
+            REGISTRY.release(arena);
+    }
+} LOCAL_ARENA;
 
-static std::mutex MUTEX;
+static ThreadArena& localArena()
+{
+    if (LOCAL_ARENA.arena == nullptr)
+        LOCAL_ARENA.arena = REGISTRY.acquire();
+    ThreadArena& arena = *LOCAL_ARENA.arena;
+    const std::uint64_t epoch = EPOCH.load(std::memory_order_acquire);
+    if (arena.epoch != epoch)
+        arena.advance(epoch);
+    return arena;
+}
 
-void* frameAllocator::alloc(const std::size_t size) noexcept
+void* frameAllocator::alloc(const std::size_t size, const std::size_t alignment) noexcept
 {
     if (size == 0)
         return nullptr;
-    std::unique_lock lock(MUTEX);
-    if (CURRENT_BUFFER->offset + size < MAX_SIZE) {
-        void* ptr = &CURRENT_BUFFER->memory[CURRENT_BUFFER->offset];
-        CURRENT_BUFFER->offset += size;
-        ASAN_UNPOISON_MEMORY_REGION(ptr, size);
-        SPDLOG_TRACE("Allocated per-frame memory block of size {}", size);
-        return ptr;
-    }
-    spdlog::warn("Per-Frame memory pool {} exhausted", SWAP_COUNT % BUFFER_COUNT);
-    return nullptr;
+    ThreadArena& arena = localArena();
+    const std::uint64_t overflows = arena.current->overflowCount();
+    void* ptr = arena.current->alloc(size, alignment);
+    if (ptr == nullptr) {
+        spdlog::error("Failed to allocate per-frame memory block of size {}", size);
+        return nullptr;
+    }
+    if (arena.current->overflowCount() != overflows) {
+        SPDLOG_DEBUG("Per-frame arena overflowed, chained a new memory block");
+        arena.updateStats();
+    }
+    arena.frameBytes.store(arena.current->used(), std::memory_order_relaxed);
+    arena.statsEpoch.store(arena.epoch, std::memory_order_relaxed);
+    SPDLOG_TRACE("Allocated per-frame memory block of size {}", size);
+    return ptr;
 }
 
 void frameAllocator::nextFrame() noexcept
 {
-    std::unique_lock lock(MUTEX);
-    CURRENT_BUFFER = &BUFFERS[++SWAP_COUNT % BUFFER_COUNT];
-    CURRENT_BUFFER->offset = 0;
-    ASAN_POISON_MEMORY_REGION(CURRENT_BUFFER->memory, MAX_SIZE);
+    const std::uint64_t finished = EPOCH.load(std::memory_order_relaxed);
+    {
+        std::unique_lock lock(REGISTRY.mutex);
+        std::size_t bytes = 0;
+        for (const auto& arena : REGISTRY.arenas) {
+            if (arena->statsEpoch.load(std::memory_order_relaxed) == finished)
+                bytes += arena->frameBytes.load(std::memory_order_relaxed);
+        }
+        REGISTRY.lastFrameBytes = bytes;
+        REGISTRY.peakFrameBytes = std::max(REGISTRY.peakFrameBytes, bytes);
+    }
+    EPOCH.fetch_add(1, std::memory_order_acq_rel);
 }
 
 bool frameAllocator::freeLast(const void* ptr, const std::size_t size) noexcept
 {
-    std::unique_lock lock(MUTEX);
-    if (CURRENT_BUFFER->offset < size)
-        return false;
-    const void* ptr2 = &CURRENT_BUFFER->memory[CURRENT_BUFFER->offset - size];
-    if (ptr == ptr2) {
-        CURRENT_BUFFER->offset -= size;
-        ASAN_POISON_MEMORY_REGION(ptr2, size);
+    ThreadArena& arena = localArena();
+    if (arena.current->freeLast(ptr, size)) {
+        arena.frameBytes.store(arena.current->used(), std::memory_order_relaxed);
         SPDLOG_TRACE("Freed per-frame memory block of size {}", size);
         return true;
     }
     return false;
 }
 
-}// namespace dragonfire
\ No newline at end of file
+frameAllocator::Stats frameAllocator::getStats() noexcept
+{
+    std::unique_lock lock(REGISTRY.mutex);
+    Stats stats{};
+    stats.lastFrameBytes = REGISTRY.lastFrameBytes;
+    stats.peakFrameBytes = REGISTRY.peakFrameBytes;
+    stats.arenaCount = REGISTRY.arenas.size();
+    for (const auto& arena : REGISTRY.arenas) {
+        stats.overflowCount += arena->overflows.load(std::memory_order_relaxed);
+        stats.blockCount += arena->blockCount.load(std::memory_order_relaxed);
+        stats.capacity += arena->capacity.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+}// namespace dragonfire
@@ -3,26 +3,31 @@
 //
 
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <new>
 
 namespace dragonfire {
 
 namespace frameAllocator {
     /***
-     * @brief Allocates temporary per-frame memory
+     * @brief Allocates temporary per-frame memory.
+     * Each thread bump allocates from its own arena, so this never takes a lock. If the arena is full
+     * another memory block is chained on, and the arena is grown to fit when it is next reset
      * @param size size of the allocation
-     * @return ptr to the allocation
+     * @param alignment required alignment of the allocation, must be a power of two
+     * @return ptr to the allocation, or nullptr if the system is out of memory
      */
-    void* alloc(std::size_t size) noexcept;
+    void* alloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) noexcept;
     /***
-     * @brief Clears the per-frame allocator, all of the previous allocations are invalidated by
-     * this call
+     * @brief Advances the global frame epoch, every thread's arena is reset the next time that thread
+     * allocates. Allocations from the previous frame remain valid until the following call
      */
     void nextFrame() noexcept;
     /***
      * @brief Attempt to free a memory block allocated from the per-frame pool.
-     * This is only possible if the memory block is the last allocation.
+     * This is only possible if the memory block is the last allocation made by the calling thread.
      * If it is not, this is a no-op.
      * @param ptr pointer to the memory block to free
      * @param size size of the memory block
@@ -30,11 +35,29 @@ namespace frameAllocator {
      */
     bool freeLast(const void* ptr, std::size_t size) noexcept;
 
+    struct Stats {
+        /// Bytes allocated across all threads during the last completed frame
+        std::size_t lastFrameBytes;
+        /// Highest per-frame usage seen so far
+        std::size_t peakFrameBytes;
+        /// Number of times an arena ran out of space and had to chain on a new block
+        std::uint64_t overflowCount;
+        /// Memory blocks currently owned by all arenas, and their total size in bytes
+        std::size_t blockCount, capacity;
+        /// Number of per-thread arenas that have been created
+        std::size_t arenaCount;
+    };
+
+    /***
+     * @brief Get usage statistics for the per-frame allocator, per-frame values are updated by nextFrame
+     */
+    Stats getStats() noexcept;
+
     template<typename T, typename... Args>
     static T* frameNew(Args... args)
     {
         // ReSharper disable once CppDFAMemoryLeak
-        void* ptr = static_cast<T*>(frameAllocator::alloc(sizeof(T)));
+        void* ptr = static_cast<T*>(frameAllocator::alloc(sizeof(T), alignof(T)));
         T* obj = new (ptr) T(std::forward<Args>(args)...);
         return obj;
     }
@@ -60,7 +83,7 @@ public:
     T* allocate(const size_type n) const
     {
         size_type size = n * sizeof(T);
-        void* ptr = frameAllocator::alloc(size);
+        void* ptr = frameAllocator::alloc(size, alignof(T));
         if (ptr)
             return static_cast<T*>(ptr);
         throw std::bad_alloc();
@@ -1,9 +1,17 @@
 //
 // Created by josh on 10/17/23.
 //
+#include <algorithm>
+#include <atomic>
+#include <barrier>
 #include <catch.hpp>
 #include <core/utility/temp_containers.h>
 #include <core/utility/frame_allocator.h>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 using namespace dragonfire;
 
@@ -31,6 +39,20 @@ TEST_CASE("Frame Allocator Test")
     {
         REQUIRE(frameAllocator::alloc(UINT64_MAX) == nullptr);
     }
+
+    SECTION("Grow")
+    {
+        const auto before = frameAllocator::getStats();
+        auto ptr = static_cast<char*>(frameAllocator::alloc(1 << 22));
+        REQUIRE(ptr != nullptr);
+        memset(ptr, 0, 1 << 22);
+        const auto after = frameAllocator::getStats();
+        CHECK(after.overflowCount > before.overflowCount);
+        CHECK(after.blockCount > before.blockCount);
+        frameAllocator::nextFrame();
+        CHECK(frameAllocator::getStats().lastFrameBytes >= 1 << 22);
+        CHECK(frameAllocator::getStats().peakFrameBytes >= 1 << 22);
+    }
 }
 
 TEST_CASE("Temporary Containers Test")
@@ -43,4 +65,132 @@ TEST_CASE("Temporary Containers Test")
             data.push_back(i);
         return !data.empty();
     });
-}
\ No newline at end of file
+}
+
+TEST_CASE("Frame Allocator Multi-threaded")
+{
+    frameAllocator::nextFrame();
+    constexpr std::size_t THREAD_COUNT = 8, ALLOC_COUNT = 1000;
+    std::vector<std::vector<std::uint32_t*>> results(THREAD_COUNT);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < THREAD_COUNT; t++) {
+        threads.emplace_back([&, t] {
+            for (std::size_t i = 0; i < ALLOC_COUNT; i++) {
+                auto ptr = static_cast<std::uint32_t*>(frameAllocator::alloc(sizeof(std::uint32_t) * 4));
+                if (ptr)
+                    std::fill_n(ptr, 4, std::uint32_t(t));
+                results[t].push_back(ptr);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (std::size_t t = 0; t < THREAD_COUNT; t++) {
+        for (const std::uint32_t* ptr : results[t]) {
+            REQUIRE(ptr != nullptr);
+            CHECK(std::all_of(ptr, ptr + 4, [t](const std::uint32_t v) { return v == t; }));
+        }
+    }
+}
+
+namespace {
+/// Copy of the original single buffer allocator guarded by one global mutex, kept as a benchmark baseline
+class LockedFrameAllocator {
+    static constexpr std::size_t MAX_SIZE = 1 << 21;
+    std::unique_ptr<char[]> memory = std::make_unique<char[]>(MAX_SIZE);
+    std::size_t offset = 0;
+    std::mutex mutex;
+
+public:
+    void* alloc(const std::size_t size)
+    {
+        std::unique_lock lock(mutex);
+        if (offset + size < MAX_SIZE) {
+            void* ptr = &memory[offset];
+            offset += size;
+            return ptr;
+        }
+        return nullptr;
+    }
+
+    void nextFrame()
+    {
+        std::unique_lock lock(mutex);
+        offset = 0;
+    }
+};
+
+/// Threads started once and released together for each round, so a benchmark doesn't time starting threads
+class Workers {
+    std::function<void()> job;
+    bool stopping = false;
+    std::barrier<> start, done;
+    std::vector<std::thread> threads;
+
+public:
+    explicit Workers(const std::size_t threadCount)
+        : start(std::ptrdiff_t(threadCount) + 1), done(std::ptrdiff_t(threadCount) + 1)
+    {
+        threads.reserve(threadCount);
+        for (std::size_t i = 0; i < threadCount; i++) {
+            threads.emplace_back([this] {
+                for (start.arrive_and_wait(); !stopping; start.arrive_and_wait()) {
+                    job();
+                    done.arrive_and_wait();
+                }
+            });
+        }
+    }
+
+    ~Workers()
+    {
+        stopping = true;
+        start.arrive_and_wait();
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    /// Runs func once on every worker and returns when all of them are done
+    void run(std::function<void()> func)
+    {
+        job = std::move(func);
+        start.arrive_and_wait();
+        done.arrive_and_wait();
+    }
+};
+}// namespace
+
+TEST_CASE("Frame Allocator Contention", "[.][benchmark]")
+{
+    constexpr std::size_t ALLOC_COUNT = 2000, ALLOC_SIZE = 64;
+    const std::size_t threadCount = std::max(std::thread::hardware_concurrency(), 2u);
+    LockedFrameAllocator locked;
+    Workers workers(threadCount);
+
+    BENCHMARK("Mutex allocator")
+    {
+        locked.nextFrame();
+        std::atomic_size_t failed = 0;
+        workers.run([&] {
+            std::size_t count = 0;
+            for (std::size_t i = 0; i < ALLOC_COUNT; i++)
+                count += locked.alloc(ALLOC_SIZE) == nullptr;
+            failed += count;
+        });
+        return failed.load();
+    };
+
+    BENCHMARK("Thread-local arenas")
+    {
+        frameAllocator::nextFrame();
+        std::atomic_size_t failed = 0;
+        workers.run([&] {
+            std::size_t count = 0;
+            for (std::size_t i = 0; i < ALLOC_COUNT; i++)
+                count += frameAllocator::alloc(ALLOC_SIZE) == nullptr;
+            failed += count;
+        });
+        return failed.load();
+    };
+}
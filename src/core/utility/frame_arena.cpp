@@ -0,0 +1,20 @@
+#include "frame_arena.h"
+#include <cassert>
+
+namespace dragonfire {
+
+FrameArena::FrameArena(const std::uint32_t framesInFlight, const std::size_t initialSize)
+{
+    assert(framesInFlight > 0);
+    slots.reserve(framesInFlight);
+    for (std::uint32_t i = 0; i < framesInFlight; i++)
+        slots.emplace_back(initialSize);
+}
+
+void FrameArena::beginFrame(const std::uint64_t frameIndex) noexcept
+{
+    current = frameIndex % slots.size();
+    slots[current].reset();
+}
+
+}// namespace dragonfire
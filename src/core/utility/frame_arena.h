@@ -0,0 +1,96 @@
+#pragma once
+#include "linear_arena.h"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dragonfire {
+
+/// Arena for CPU side data that has to outlive a single frame, such as data read by the GPU or the
+/// present thread while a frame is in flight. Each frame slot has its own arena, memory allocated during
+/// a frame is only recycled when beginFrame is called for the same slot again, which should only be
+/// done after that frame's fence has signalled.
+/// Not thread safe, an arena should be used by one thread at a time.
+class FrameArena {
+public:
+    explicit FrameArena(std::uint32_t framesInFlight, std::size_t initialSize = 1 << 20);
+
+    /***
+     * @brief Starts a new frame, recycling the memory allocated the last time this frame slot was used
+     * @param frameIndex monotonically increasing frame number, the slot used is frameIndex % frameCount()
+     */
+    void beginFrame(std::uint64_t frameIndex) noexcept;
+
+    /***
+     * @brief Allocates memory that is valid until the current frame slot is recycled
+     * @return ptr to the allocation, or nullptr if the system is out of memory
+     */
+    void* alloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) noexcept
+    {
+        return slots[current].alloc(size, alignment);
+    }
+
+    /// Allocates uninitialized storage for count objects of T, respecting the alignment of T
+    template<typename T>
+        requires std::is_trivially_destructible_v<T>
+    T* allocate(const std::size_t count = 1)
+    {
+        void* ptr = alloc(sizeof(T) * count, alignof(T));
+        if (ptr == nullptr)
+            throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+
+    template<typename T>
+        requires std::is_trivially_destructible_v<T>
+    std::span<T> allocateSpan(const std::size_t count)
+    {
+        return std::span<T>(allocate<T>(count), count);
+    }
+
+    /// Constructs a T in the arena, destructors are never run so T must be trivially destructible
+    template<typename T, typename... Args>
+        requires std::is_trivially_destructible_v<T>
+    T* create(Args&&... args)
+    {
+        return new (allocate<T>()) T(std::forward<Args>(args)...);
+    }
+
+    using Marker = LinearArena::Marker;
+
+    [[nodiscard]] Marker mark() const noexcept { return slots[current].mark(); }
+
+    /// Frees every allocation made in the current frame since the marker was taken
+    void rewind(const Marker& marker) noexcept { slots[current].rewind(marker); }
+
+    /// Rewinds the arena to where it was when the scope was created once the scope is destroyed
+    class Scope {
+        FrameArena& arena;
+        Marker marker;
+
+    public:
+        explicit Scope(FrameArena& arena) noexcept : arena(arena), marker(arena.mark()) {}
+
+        ~Scope() noexcept { arena.rewind(marker); }
+
+        Scope(const Scope& other) = delete;
+        Scope& operator=(const Scope& other) = delete;
+    };
+
+    [[nodiscard]] Scope scope() noexcept { return Scope(*this); }
+
+    [[nodiscard]] std::uint32_t frameCount() const noexcept { return std::uint32_t(slots.size()); }
+
+    /// The arena backing the current frame slot, exposed for usage statistics
+    [[nodiscard]] const LinearArena& currentArena() const noexcept { return slots[current]; }
+
+private:
+    std::vector<LinearArena> slots;
+    std::size_t current = 0;
+};
+
+}// namespace dragonfire
@@ -0,0 +1,58 @@
+#include "frame_arena.h"
+#include <catch.hpp>
+#include <glm/glm.hpp>
+
+using namespace dragonfire;
+
+namespace {
+struct alignas(16) AlignedData {
+    glm::mat4 transform{};
+    std::uint32_t values[4]{};
+};
+}// namespace
+
+TEST_CASE("Frame Arena lifetime")
+{
+    FrameArena arena(2, 4096);
+    arena.beginFrame(0);
+    auto first = arena.allocate<std::uint32_t>(16);
+    std::fill_n(first, 16, 0xABCDu);
+
+    arena.beginFrame(1);
+    auto second = arena.allocate<std::uint32_t>(16);
+    std::fill_n(second, 16, 0x1234u);
+    // memory from frame 0 is still in flight and must not be reused
+    CHECK(std::all_of(first, first + 16, [](const std::uint32_t v) { return v == 0xABCDu; }));
+    CHECK(second != first);
+
+    arena.beginFrame(2);
+    CHECK(arena.allocate<std::uint32_t>(16) == first);
+    CHECK(std::all_of(second, second + 16, [](const std::uint32_t v) { return v == 0x1234u; }));
+}
+
+TEST_CASE("Frame Arena alignment")
+{
+    FrameArena arena(2, 4096);
+    arena.beginFrame(0);
+    CHECK(arena.allocate<char>(3) != nullptr);
+    const auto data = arena.allocateSpan<AlignedData>(8);
+    CHECK(reinterpret_cast<std::uintptr_t>(data.data()) % alignof(AlignedData) == 0);
+    const auto obj = arena.create<AlignedData>();
+    CHECK(reinterpret_cast<std::uintptr_t>(obj) % alignof(AlignedData) == 0);
+    CHECK(obj->values[0] == 0);
+}
+
+TEST_CASE("Frame Arena scope")
+{
+    FrameArena arena(2, 256);
+    arena.beginFrame(0);
+    const auto used = arena.currentArena().used();
+    {
+        auto scope = arena.scope();
+        for (int i = 0; i < 64; i++)
+            CHECK(arena.allocate<std::uint64_t>(8) != nullptr);
+        CHECK(arena.currentArena().used() > used);
+    }
+    CHECK(arena.currentArena().used() == used);
+    CHECK(arena.currentArena().blockCount() > 1);
+}
@@ -0,0 +1,166 @@
+#include "linear_arena.h"
+#include <algorithm>
+#include <bit>
+#include <new>
+#include <sanitizer/asan_interface.h>
+#include <spdlog/spdlog.h>
+#include <utility>
+
+namespace dragonfire {
+
+static constexpr std::size_t MAX_BLOCK_SIZE = std::size_t(1) << 40;
+
+LinearArena::LinearArena(const std::size_t initialSize)
+{
+    blocks.reserve(4);
+    chainBlock(initialSize);
+}
+
+LinearArena::~LinearArena() noexcept
+{
+    freeBlocks();
+}
+
+void* LinearArena::alloc(const std::size_t size, const std::size_t alignment) noexcept
+{
+    if (size == 0 || size > MAX_BLOCK_SIZE)
+        return nullptr;
+    while (true) {
+        if (current < blocks.size()) {
+            Block& block = blocks[current];
+            const auto base = reinterpret_cast<std::uintptr_t>(block.memory);
+            const std::uintptr_t aligned = base + block.offset + alignment - 1 & ~(alignment - 1);
+            const std::size_t end = aligned - base + size;
+            if (end <= block.size) {
+                usedBytes += end - block.offset;
+                block.offset = end;
+                void* ptr = reinterpret_cast<void*>(aligned);
+                ASAN_UNPOISON_MEMORY_REGION(ptr, size);
+                return ptr;
+            }
+            if (current + 1 < blocks.size()) {
+                blocks[++current].offset = 0;
+                continue;
+            }
+            overflows++;
+        }
+        if (!chainBlock(size + alignment))
+            return nullptr;
+        current = blocks.size() - 1;
+    }
+}
+
+bool LinearArena::freeLast(const void* ptr, const std::size_t size) noexcept
+{
+    if (current >= blocks.size())
+        return false;
+    Block& block = blocks[current];
+    if (block.offset < size || ptr != block.memory + block.offset - size)
+        return false;
+    block.offset -= size;
+    usedBytes -= size;
+    ASAN_POISON_MEMORY_REGION(ptr, size);
+    return true;
+}
+
+void LinearArena::reset() noexcept
+{
+    highWater = std::max(highWater, usedBytes);
+    usedBytes = 0;
+    if (blocks.size() > 1) {
+        const std::size_t size = std::max(std::bit_ceil(highWater), blocks.front().size);
+        SPDLOG_DEBUG("Coalescing {} arena blocks into a single block of size {}", blocks.size(), size);
+        freeBlocks();
+        chainBlock(size);
+    }
+    for (Block& block : blocks) {
+        block.offset = 0;
+        ASAN_POISON_MEMORY_REGION(block.memory, block.size);
+    }
+    current = 0;
+}
+
+LinearArena::Marker LinearArena::mark() const noexcept
+{
+    if (current >= blocks.size())
+        return {};
+    return {current, blocks[current].offset, usedBytes};
+}
+
+void LinearArena::rewind(const Marker& marker) noexcept
+{
+    if (marker.block >= blocks.size() || marker.block > current)
+        return;
+    highWater = std::max(highWater, usedBytes);
+    for (std::size_t i = marker.block; i <= current; i++) {
+        Block& block = blocks[i];
+        const std::size_t start = i == marker.block ? marker.offset : 0;
+        ASAN_POISON_MEMORY_REGION(block.memory + start, block.size - start);
+        block.offset = start;
+    }
+    current = marker.block;
+    usedBytes = marker.used;
+}
+
+std::size_t LinearArena::capacity() const noexcept
+{
+    std::size_t size = 0;
+    for (const Block& block : blocks)
+        size += block.size;
+    return size;
+}
+
+bool LinearArena::chainBlock(std::size_t minSize) noexcept
+{
+    if (!blocks.empty())
+        minSize = std::max(minSize, blocks.back().size * 2);
+    minSize = std::min(std::bit_ceil(minSize), MAX_BLOCK_SIZE);
+    char* memory = new (std::nothrow) char[minSize];
+    if (memory == nullptr) {
+        spdlog::error("Failed to allocate arena block of size {}", minSize);
+        return false;
+    }
+    try {
+        blocks.push_back(Block{memory, minSize, 0});
+    }
+    catch (const std::bad_alloc&) {
+        delete[] memory;
+        return false;
+    }
+    ASAN_POISON_MEMORY_REGION(memory, minSize);
+    return true;
+}
+
+void LinearArena::freeBlocks() noexcept
+{
+    for (const Block& block : blocks) {
+        ASAN_UNPOISON_MEMORY_REGION(block.memory, block.size);
+        delete[] block.memory;
+    }
+    blocks.clear();
+}
+
+LinearArena::LinearArena(LinearArena&& other) noexcept
+    : blocks(std::move(other.blocks)), current(other.current), usedBytes(other.usedBytes),
+      highWater(other.highWater), overflows(other.overflows)
+{
+    other.blocks.clear();
+    other.current = other.usedBytes = 0;
+}
+
+LinearArena& LinearArena::operator=(LinearArena&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+    freeBlocks();
+    blocks = std::move(other.blocks);
+    current = other.current;
+    usedBytes = other.usedBytes;
+    highWater = other.highWater;
+    overflows = other.overflows;
+    other.blocks.clear();
+    other.current = other.usedBytes = 0;
+    return *this;
+}
+
+}// namespace dragonfire
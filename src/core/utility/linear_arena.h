@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dragonfire {
+
+/// Bump allocator backed by a chain of memory blocks.
+/// When the current block runs out a new block is chained on instead of failing, reset() then
+/// coalesces the chain into a single block sized to the highest usage seen so far.
+/// Not thread safe, each arena is meant to be owned by a single thread at a time.
+class LinearArena {
+public:
+    explicit LinearArena(std::size_t initialSize);
+    ~LinearArena() noexcept;
+
+    /***
+     * @brief Allocates a block of memory from the arena
+     * @param size size of the allocation
+     * @param alignment required alignment, must be a power of two
+     * @return ptr to the allocation, or nullptr if size is 0 or the system is out of memory
+     */
+    void* alloc(std::size_t size, std::size_t alignment = 1) noexcept;
+    /***
+     * @brief Frees the memory block if it is the last allocation made from the arena, otherwise this is a
+     * no-op
+     * @return true if the block was freed
+     */
+    bool freeLast(const void* ptr, std::size_t size) noexcept;
+    /***
+     * @brief Invalidates all allocations, if the arena overflowed since the last reset the block chain is
+     * replaced with a single block large enough to hold the high-water mark
+     */
+    void reset() noexcept;
+
+    /// Position in the arena that can later be rewound to with rewind()
+    struct Marker {
+        std::size_t block = 0, offset = 0, used = 0;
+    };
+
+    [[nodiscard]] Marker mark() const noexcept;
+    /***
+     * @brief Frees every allocation made after the marker was taken, blocks chained on since then are
+     * kept and reused by later allocations
+     */
+    void rewind(const Marker& marker) noexcept;
+
+    /// Bytes allocated since the last reset, including alignment padding
+    [[nodiscard]] std::size_t used() const noexcept { return usedBytes; }
+
+    /// Highest value of used() observed at any reset or rewind
+    [[nodiscard]] std::size_t highWaterMark() const noexcept { return highWater; }
+
+    [[nodiscard]] std::size_t capacity() const noexcept;
+
+    [[nodiscard]] std::size_t blockCount() const noexcept { return blocks.size(); }
+
+    /// Number of times a block had to be chained on because the arena was full
+    [[nodiscard]] std::uint64_t overflowCount() const noexcept { return overflows; }
+
+    LinearArena(const LinearArena& other) = delete;
+    LinearArena(LinearArena&& other) noexcept;
+    LinearArena& operator=(const LinearArena& other) = delete;
+    LinearArena& operator=(LinearArena&& other) noexcept;
+
+private:
+    struct Block {
+        char* memory = nullptr;
+        std::size_t size = 0;
+        std::size_t offset = 0;
+    };
+
+    std::vector<Block> blocks;
+    std::size_t current = 0;
+    std::size_t usedBytes = 0, highWater = 0;
+    std::uint64_t overflows = 0;
+
+    bool chainBlock(std::size_t minSize) noexcept;
+    void freeBlocks() noexcept;
+};
+
+}// namespace dragonfire
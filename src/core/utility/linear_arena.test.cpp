@@ -0,0 +1,53 @@
+#include "linear_arena.h"
+#include <catch.hpp>
+#include <cstring>
+
+using namespace dragonfire;
+
+TEST_CASE("Linear Arena")
+{
+    LinearArena arena(1024);
+
+    SECTION("Alignment")
+    {
+        CHECK(arena.alloc(1) != nullptr);
+        void* ptr = arena.alloc(64, 64);
+        REQUIRE(ptr != nullptr);
+        CHECK(reinterpret_cast<std::uintptr_t>(ptr) % 64 == 0);
+    }
+
+    SECTION("Overflow chains blocks")
+    {
+        for (int i = 0; i < 8; i++) {
+            auto ptr = static_cast<char*>(arena.alloc(512));
+            REQUIRE(ptr != nullptr);
+            memset(ptr, i, 512);
+        }
+        CHECK(arena.blockCount() > 1);
+        CHECK(arena.overflowCount() > 0);
+        CHECK(arena.used() == 8 * 512);
+
+        arena.reset();
+        CHECK(arena.blockCount() == 1);
+        CHECK(arena.highWaterMark() == 8 * 512);
+        CHECK(arena.capacity() >= arena.highWaterMark());
+        const auto overflows = arena.overflowCount();
+        CHECK(arena.alloc(8 * 512) != nullptr);
+        CHECK(arena.overflowCount() == overflows);
+    }
+
+    SECTION("Free last")
+    {
+        void* first = arena.alloc(16);
+        void* second = arena.alloc(16);
+        CHECK(!arena.freeLast(first, 16));
+        CHECK(arena.freeLast(second, 16));
+        CHECK(arena.used() == 16);
+    }
+
+    SECTION("Over alloc")
+    {
+        CHECK(arena.alloc(UINT64_MAX) == nullptr);
+        CHECK(arena.alloc(0) == nullptr);
+    }
+}
@@ -0,0 +1,198 @@
+#include "slab_allocator.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <vector>
+#ifdef __linux__
+    #include <fstream>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace dragonfire {
+static constexpr std::size_t CLASS_COUNT = std::countr_zero(slabAllocator::MAX_BLOCK_SIZE)
+                                           - std::countr_zero(slabAllocator::MIN_BLOCK_SIZE) + 1;
+/// Bytes of free blocks each thread keeps per size class before returning half of them to the shared pool
+static constexpr std::size_t CACHE_BYTES = 256 << 10;
+static constexpr std::size_t BLOCK_ALIGNMENT = 64;
+
+/// Size class of an allocation, or CLASS_COUNT if it is not served from slabs
+static std::size_t sizeClass(const std::size_t size) noexcept
+{
+    if (size < slabAllocator::MIN_BLOCK_SIZE || size > slabAllocator::MAX_BLOCK_SIZE)
+        return CLASS_COUNT;
+    return std::bit_width(size - 1) - std::countr_zero(slabAllocator::MIN_BLOCK_SIZE);
+}
+
+static constexpr std::size_t blockSize(const std::size_t sizeClass) noexcept
+{
+    return slabAllocator::MIN_BLOCK_SIZE << sizeClass;
+}
+
+static constexpr std::size_t cacheCapacity(const std::size_t sizeClass) noexcept
+{
+    return CACHE_BYTES / blockSize(sizeClass);
+}
+
+/// Free blocks shared by every thread, new slabs are carved into blocks of one size class when it runs out
+struct SlabPool {
+    struct SizeClass {
+        std::mutex mutex;
+        std::vector<void*> free;
+        std::atomic_size_t blocks = 0, live = 0;
+    };
+
+    std::array<SizeClass, CLASS_COUNT> classes;
+    std::atomic_size_t slabCount = 0;
+    std::atomic_bool hugePages = false;
+
+    /// Moves up to count free blocks to out, creating a slab if there are none
+    std::size_t take(const std::size_t sizeClass, void** out, const std::size_t count)
+    {
+        SizeClass& entry = classes[sizeClass];
+        std::unique_lock lock(entry.mutex);
+        if (entry.free.empty())
+            addSlab(sizeClass);
+        const std::size_t taken = std::min(count, entry.free.size());
+        std::copy(entry.free.end() - std::ptrdiff_t(taken), entry.free.end(), out);
+        entry.free.resize(entry.free.size() - taken);
+        return taken;
+    }
+
+    void give(const std::size_t sizeClass, void* const* blocks, const std::size_t count)
+    {
+        SizeClass& entry = classes[sizeClass];
+        std::unique_lock lock(entry.mutex);
+        entry.free.insert(entry.free.end(), blocks, blocks + count);
+    }
+
+private:
+    /// Called with the size class locked
+    void addSlab(const std::size_t sizeClass)
+    {
+        // Aligned to their size so the system can back them with huge pages
+        constexpr auto alignment = std::align_val_t(slabAllocator::SLAB_SIZE);
+        auto* slab = static_cast<char*>(::operator new(slabAllocator::SLAB_SIZE, alignment));
+#ifdef __linux__
+        if (hugePages.load(std::memory_order_relaxed))
+            madvise(slab, slabAllocator::SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+        const std::size_t size = blockSize(sizeClass), count = slabAllocator::SLAB_SIZE / size;
+        SizeClass& entry = classes[sizeClass];
+        // Reversed so blocks are handed out from the start of the slab
+        for (std::size_t i = count; i > 0; i--)
+            entry.free.push_back(slab + (i - 1) * size);
+        entry.blocks.fetch_add(count, std::memory_order_relaxed);
+        slabCount.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+/// Never destroyed, chunks in static storage may be freed after it would have been
+static SlabPool& pool()
+{
+    static auto* const instance = new SlabPool();
+    return *instance;
+}
+
+/// Set once the thread's cache is destroyed, blocks freed by later thread_local destructors go to the pool
+static thread_local bool CACHE_DESTROYED = false;
+
+/// Free blocks owned by a single thread, so most allocations and frees take no lock
+static thread_local struct BlockCache {
+    std::array<std::vector<void*>, CLASS_COUNT> blocks;
+
+    ~BlockCache()
+    {
+        for (std::size_t i = 0; i < CLASS_COUNT; i++)
+            pool().give(i, blocks[i].data(), blocks[i].size());
+        CACHE_DESTROYED = true;
+    }
+} CACHE;
+
+void* slabAllocator::alloc(const std::size_t size)
+{
+    const std::size_t sizeClass = dragonfire::sizeClass(size);
+    if (sizeClass == CLASS_COUNT)
+        return ::operator new(size, std::align_val_t(BLOCK_ALIGNMENT));
+    pool().classes[sizeClass].live.fetch_add(1, std::memory_order_relaxed);
+    if (CACHE_DESTROYED) {
+        void* block;
+        pool().take(sizeClass, &block, 1);
+        return block;
+    }
+    std::vector<void*>& cached = CACHE.blocks[sizeClass];
+    if (cached.empty()) {
+        // Refill half the cache at once, so the pool is locked once for many allocations
+        cached.resize(std::max(cacheCapacity(sizeClass) / 2, std::size_t(1)));
+        cached.resize(pool().take(sizeClass, cached.data(), cached.size()));
+    }
+    void* block = cached.back();
+    cached.pop_back();
+    return block;
+}
+
+void slabAllocator::free(void* ptr, const std::size_t size) noexcept
+{
+    if (ptr == nullptr)
+        return;
+    const std::size_t sizeClass = dragonfire::sizeClass(size);
+    if (sizeClass == CLASS_COUNT) {
+        ::operator delete(ptr, std::align_val_t(BLOCK_ALIGNMENT));
+        return;
+    }
+    pool().classes[sizeClass].live.fetch_sub(1, std::memory_order_relaxed);
+    if (CACHE_DESTROYED) {
+        pool().give(sizeClass, &ptr, 1);
+        return;
+    }
+    std::vector<void*>& cached = CACHE.blocks[sizeClass];
+    if (cached.size() >= cacheCapacity(sizeClass)) {
+        const std::size_t half = cached.size() / 2;
+        pool().give(sizeClass, cached.data() + half, cached.size() - half);
+        cached.resize(half);
+    }
+    cached.push_back(ptr);
+}
+
+void slabAllocator::setHugePages(const bool enabled) noexcept
+{
+    pool().hugePages.store(enabled, std::memory_order_relaxed);
+}
+
+void slabAllocator::trim() noexcept
+{
+#ifdef __linux__
+    for (std::size_t i = 0; i < CLASS_COUNT; i++) {
+        SlabPool::SizeClass& entry = pool().classes[i];
+        std::unique_lock lock(entry.mutex);
+        for (void* block : entry.free)
+            madvise(block, blockSize(i), MADV_DONTNEED);
+    }
+#endif
+}
+
+slabAllocator::Stats slabAllocator::getStats() noexcept
+{
+    Stats stats{};
+    for (std::size_t i = 0; i < CLASS_COUNT; i++) {
+        const SlabPool::SizeClass& entry = pool().classes[i];
+        const std::size_t blocks = entry.blocks.load(std::memory_order_relaxed);
+        const std::size_t live = std::min(entry.live.load(std::memory_order_relaxed), blocks);
+        stats.liveBlocks += live;
+        stats.liveBytes += live * blockSize(i);
+        stats.pooledBlocks += blocks - live;
+        stats.pooledBytes += (blocks - live) * blockSize(i);
+    }
+    stats.slabCount = pool().slabCount.load(std::memory_order_relaxed);
+    stats.slabBytes = stats.slabCount * SLAB_SIZE;
+#ifdef __linux__
+    std::size_t pages = 0, resident = 0;
+    if (std::ifstream("/proc/self/statm") >> pages >> resident)
+        stats.residentBytes = resident * std::size_t(sysconf(_SC_PAGESIZE));
+#endif
+    return stats;
+}
+
+}// namespace dragonfire
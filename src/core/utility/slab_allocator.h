@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace dragonfire {
+
+/// Pools the large, fixed size blocks chunks are made of, such as packed voxel payloads and light arrays.
+/// Blocks are carved out of 2MB slabs that are never returned to the system heap, so loading and unloading
+/// chunks doesn't fragment the heap or contend on its locks. The pool only grows, trim gives the memory of
+/// its free blocks back without giving up their address space.
+namespace slabAllocator {
+    /// Block sizes served from slabs, every power of two in between is a size class
+    static constexpr std::size_t MIN_BLOCK_SIZE = 4096, MAX_BLOCK_SIZE = 65536;
+    static constexpr std::size_t SLAB_SIZE = 2 << 20;
+
+    /***
+     * @brief Allocates a block, taking it from the calling thread's cache of free blocks if it has one
+     *
+     * Sizes from MIN_BLOCK_SIZE to MAX_BLOCK_SIZE are rounded up to a power of two and served from slabs,
+     * other sizes are passed on to operator new. Blocks are aligned to at least 64 bytes.
+     * @throws std::bad_alloc if the system is out of memory
+     */
+    void* alloc(std::size_t size);
+    /***
+     * @brief Returns a block to the calling thread's cache, or to the shared pool once the cache is full
+     * @param size the size the block was allocated with
+     */
+    void free(void* ptr, std::size_t size) noexcept;
+    /// Backs slabs created after this call with transparent huge pages, on systems that support madvise
+    void setHugePages(bool enabled) noexcept;
+    /***
+     * @brief Returns the memory of blocks in the shared pool to the system, keeping their address space for
+     * reuse
+     *
+     * Blocks still in the thread caches are kept. Takes a system call per free block, so it is meant to be
+     * called after large unloads rather than every frame.
+     */
+    void trim() noexcept;
+
+    struct Stats {
+        /// Blocks allocated and not yet freed, and their total size in bytes
+        std::size_t liveBlocks, liveBytes;
+        /// Free blocks kept for reuse by the shared pool and the thread caches, and their size in bytes
+        std::size_t pooledBlocks, pooledBytes;
+        /// Number of slabs created and their total size in bytes
+        std::size_t slabCount, slabBytes;
+        /// Resident set size of the process, 0 where it can't be read
+        std::size_t residentBytes;
+    };
+
+    Stats getStats() noexcept;
+}// namespace slabAllocator
+
+template<typename T>
+class SlabAllocator {
+
+public:
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "readability-identifier-naming"
+    using value_type = T;                     // NOLINT(*-identifier-naming)
+    typedef value_type* pointer;              // NOLINT(*-identifier-naming)
+    typedef const value_type* const_pointer;  // NOLINT(*-identifier-naming)
+    typedef value_type& reference;            // NOLINT(*-identifier-naming)
+    typedef const value_type& const_reference;// NOLINT(*-identifier-naming)
+    typedef std::size_t size_type;            // NOLINT(*-identifier-naming)
+    typedef std::ptrdiff_t difference_type;   // NOLINT(*-identifier-naming)
+#pragma clang diagnostic pop
+
+    SlabAllocator() noexcept = default;
+
+    T* allocate(const size_type n) const { return static_cast<T*>(slabAllocator::alloc(n * sizeof(T))); }
+
+    void deallocate(T* ptr, const size_type n) const noexcept { slabAllocator::free(ptr, n * sizeof(T)); }
+
+    template<class U>
+    SlabAllocator(const SlabAllocator<U>&) noexcept
+    {
+    }
+
+    template<class U>
+    bool operator==(const SlabAllocator<U>&) const noexcept
+    {
+        return true;
+    }
+
+    template<class U>
+    bool operator!=(const SlabAllocator<U>&) const noexcept
+    {
+        return false;
+    }
+};
+
+/// Vector of chunk sized data, such as a voxel payload, with its storage pooled by slabAllocator
+template<typename T>
+using SlabVector = std::vector<T, SlabAllocator<T>>;
+
+}// namespace dragonfire
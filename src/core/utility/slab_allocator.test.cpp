@@ -0,0 +1,168 @@
+#include "slab_allocator.h"
+#include "thread_pool.h"
+#include <catch.hpp>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+using namespace dragonfire;
+
+TEST_CASE("Slab Allocator")
+{
+    SECTION("Blocks are reused by size class")
+    {
+        void* block = slabAllocator::alloc(5000);
+        REQUIRE(block != nullptr);
+        CHECK(reinterpret_cast<std::uintptr_t>(block) % 64 == 0);
+        std::memset(block, 1, 8192);
+        slabAllocator::free(block, 5000);
+        void* reused = slabAllocator::alloc(8192);
+        CHECK(reused == block);
+        slabAllocator::free(reused, 8192);
+    }
+
+    SECTION("Live and pooled blocks are counted")
+    {
+        const auto before = slabAllocator::getStats();
+        std::vector<void*> blocks;
+        for (int i = 0; i < 100; i++)
+            blocks.push_back(slabAllocator::alloc(slabAllocator::MAX_BLOCK_SIZE));
+        const auto during = slabAllocator::getStats();
+        CHECK(during.liveBlocks == before.liveBlocks + 100);
+        CHECK(during.liveBytes == before.liveBytes + 100 * slabAllocator::MAX_BLOCK_SIZE);
+        CHECK(during.liveBytes + during.pooledBytes == during.slabBytes);
+        for (void* block : blocks)
+            slabAllocator::free(block, slabAllocator::MAX_BLOCK_SIZE);
+        const auto after = slabAllocator::getStats();
+        CHECK(after.liveBlocks == before.liveBlocks);
+        CHECK(after.pooledBlocks == during.pooledBlocks + 100);
+
+        SECTION("Freed blocks are reused instead of creating slabs")
+        {
+            for (int i = 0; i < 1000; i++) {
+                for (void*& block : blocks)
+                    block = slabAllocator::alloc(slabAllocator::MAX_BLOCK_SIZE);
+                for (void* block : blocks)
+                    slabAllocator::free(block, slabAllocator::MAX_BLOCK_SIZE);
+            }
+            CHECK(slabAllocator::getStats().slabCount == after.slabCount);
+        }
+    }
+
+    SECTION("Trimmed blocks can still be reused")
+    {
+        std::vector<void*> blocks(200);
+        for (void*& block : blocks) {
+            block = slabAllocator::alloc(slabAllocator::MAX_BLOCK_SIZE);
+            std::memset(block, 1, slabAllocator::MAX_BLOCK_SIZE);
+        }
+        for (void* block : blocks)
+            slabAllocator::free(block, slabAllocator::MAX_BLOCK_SIZE);
+        const auto before = slabAllocator::getStats();
+        slabAllocator::trim();
+        for (void*& block : blocks) {
+            block = slabAllocator::alloc(slabAllocator::MAX_BLOCK_SIZE);
+            std::memset(block, 2, slabAllocator::MAX_BLOCK_SIZE);
+        }
+        CHECK(slabAllocator::getStats().slabCount == before.slabCount);
+        for (void* block : blocks)
+            slabAllocator::free(block, slabAllocator::MAX_BLOCK_SIZE);
+    }
+
+    SECTION("Blocks cached by an exited thread return to the pool")
+    {
+        std::vector<void*> blocks(200);
+        for (void*& block : blocks)
+            block = slabAllocator::alloc(slabAllocator::MIN_BLOCK_SIZE);
+        std::thread([&] {
+            for (void* block : blocks)
+                slabAllocator::free(block, slabAllocator::MIN_BLOCK_SIZE);
+        }).join();
+        const std::size_t slabs = slabAllocator::getStats().slabCount;
+        for (void*& block : blocks)
+            block = slabAllocator::alloc(slabAllocator::MIN_BLOCK_SIZE);
+        CHECK(slabAllocator::getStats().slabCount == slabs);
+        for (void* block : blocks)
+            slabAllocator::free(block, slabAllocator::MIN_BLOCK_SIZE);
+    }
+
+    SECTION("Sizes outside the slab classes use the heap")
+    {
+        const auto before = slabAllocator::getStats();
+        void* small = slabAllocator::alloc(100);
+        void* large = slabAllocator::alloc(slabAllocator::MAX_BLOCK_SIZE + 1);
+        CHECK(reinterpret_cast<std::uintptr_t>(small) % 64 == 0);
+        CHECK(slabAllocator::getStats().liveBlocks == before.liveBlocks);
+        slabAllocator::free(small, 100);
+        slabAllocator::free(large, slabAllocator::MAX_BLOCK_SIZE + 1);
+    }
+
+    SECTION("Slab vectors")
+    {
+        SlabVector<std::uint64_t> words(1024, 7);
+        SlabVector<std::uint64_t> copy = words;
+        words.clear();
+        words.shrink_to_fit();
+        CHECK(copy.size() == 1024);
+        CHECK(copy[1023] == 7);
+    }
+}
+
+/// Loads and unloads chunk sized payloads on every thread, as streaming does while the player moves
+template<template<typename> typename Allocator>
+static double churn(ThreadPool& pool, const int frames, const std::size_t liveChunks)
+{
+    using Payload = std::vector<std::uint64_t, Allocator<std::uint64_t>>;
+    using Light = std::vector<std::uint8_t, Allocator<std::uint8_t>>;
+    struct Slot {
+        Payload payload;
+        Light light;
+    };
+    const std::size_t threads = pool.threadCount();
+    std::vector<std::vector<Slot>> slots(threads, std::vector<Slot>(liveChunks / threads));
+    const auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        for (std::size_t thread = 0; thread < threads; thread++) {
+            pool.submit([&, thread, frame] {
+                std::mt19937 rng(std::uint32_t(frame * threads + thread));
+                // Replace an eighth of the chunks, with payloads from 1 to 16 bits per voxel
+                for (std::size_t i = 0; i < slots[thread].size() / 8; i++) {
+                    Slot& slot = slots[thread][rng() % slots[thread].size()];
+                    slot.payload = Payload(std::size_t(512) << rng() % 5);
+                    slot.light = Light(rng() % 2 ? 32768 : 0);
+                }
+            });
+        }
+        pool.waitIdle();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST_CASE("Slab Allocator Streaming Churn Benchmark", "[.][benchmark]")
+{
+    ThreadPool pool;
+    constexpr int frames = 200;
+    constexpr std::size_t liveChunks = 4096;
+    const double heap = churn<std::allocator>(pool, frames, liveChunks);
+    const double slab = churn<SlabAllocator>(pool, frames, liveChunks);
+    const auto stats = slabAllocator::getStats();
+    spdlog::info(
+        "{} frames of churn over {} chunks on {} threads: heap {:.1f}ms, slabs {:.1f}ms",
+        frames,
+        liveChunks,
+        pool.threadCount(),
+        heap,
+        slab
+    );
+    spdlog::info(
+        "{} live blocks ({:.1f}MB), {} pooled ({:.1f}MB), {} slabs, RSS {:.1f}MB",
+        stats.liveBlocks,
+        double(stats.liveBytes) / (1024.0 * 1024.0),
+        stats.pooledBlocks,
+        double(stats.pooledBytes) / (1024.0 * 1024.0),
+        stats.slabCount,
+        double(stats.residentBytes) / (1024.0 * 1024.0)
+    );
+}
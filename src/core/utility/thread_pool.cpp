@@ -0,0 +1,66 @@
+#include "thread_pool.h"
+#include "core/crash.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace dragonfire {
+
+ThreadPool::ThreadPool(const std::uint32_t threadCount)
+{
+    threads.reserve(threadCount);
+    for (std::uint32_t i = 0; i < std::max(threadCount, 1u); i++)
+        threads.emplace_back(std::bind_front(&ThreadPool::worker, this));
+    SPDLOG_DEBUG("Started thread pool with {} workers", threads.size());
+}
+
+ThreadPool::~ThreadPool()
+{
+    waitIdle();
+    for (std::jthread& thread : threads)
+        thread.request_stop();
+    taskAvailable.notify_all();
+    threads.clear();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::unique_lock lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::waitIdle()
+{
+    std::unique_lock lock(mutex);
+    idle.wait(lock, [this] { return tasks.empty() && running == 0; });
+}
+
+std::size_t ThreadPool::pending()
+{
+    std::unique_lock lock(mutex);
+    return tasks.size() + running;
+}
+
+std::uint32_t ThreadPool::defaultThreadCount() noexcept
+{
+    return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+}
+
+void ThreadPool::worker(const std::stop_token& token)
+{
+    std::unique_lock lock(mutex);
+    while (taskAvailable.wait(lock, token, [this] { return !tasks.empty(); })) {
+        std::function<void()> task = std::move(tasks.front());
+        tasks.pop_front();
+        running++;
+        lock.unlock();
+        crashOnException(task);
+        lock.lock();
+        if (--running == 0 && tasks.empty())
+            idle.notify_all();
+    }
+}
+
+}// namespace dragonfire
@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dragonfire {
+
+/// Fixed size pool of worker threads running tasks in submission order.
+/// Tasks that throw crash the program, the same as an exception escaping the main loop.
+class ThreadPool {
+public:
+    /// Creates a pool with the given number of workers, by default one less than the hardware thread count
+    explicit ThreadPool(std::uint32_t threadCount = defaultThreadCount());
+    /// Waits for queued tasks to finish and joins the workers
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+    /// Blocks until the queue is empty and no worker is running a task
+    void waitIdle();
+
+    [[nodiscard]] std::uint32_t threadCount() const noexcept { return std::uint32_t(threads.size()); }
+
+    /// Number of tasks queued or running
+    [[nodiscard]] std::size_t pending();
+
+    static std::uint32_t defaultThreadCount() noexcept;
+
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+private:
+    std::mutex mutex;
+    std::condition_variable_any taskAvailable;
+    std::condition_variable idle;
+    std::deque<std::function<void()>> tasks;
+    std::size_t running = 0;
+    std::vector<std::jthread> threads;
+
+    void worker(const std::stop_token& token);
+};
+
+/***
+ * @brief Counts the tasks an object has submitted to a pool, so it can wait for them before it is destroyed
+ *
+ * The count is shared with the tasks, so the last task can still notify after the waiting thread has returned
+ * and freed the object that owns the group.
+ */
+class TaskGroup {
+public:
+    template<typename Func>
+    void submit(ThreadPool& pool, Func&& task)
+    {
+        count->fetch_add(1, std::memory_order_relaxed);
+        pool.submit([count = count, task = std::forward<Func>(task)]() mutable {
+            task();
+            if (count->fetch_sub(1, std::memory_order_acq_rel) == 1)
+                count->notify_all();
+        });
+    }
+
+    /// Blocks until every submitted task has returned, must not be called from a worker of the pool
+    void wait() const
+    {
+        for (std::size_t value = count->load(std::memory_order_acquire); value != 0; value = count->load())
+            count->wait(value);
+    }
+
+    /// Number of tasks queued or running
+    [[nodiscard]] std::size_t pending() const noexcept { return count->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic_size_t> count = std::make_shared<std::atomic_size_t>(0);
+};
+
+/***
+ * @brief Runs func(i) for each i in [0, count) on the pool and waits for all of them
+ *
+ * Must not be called from a worker of the pool.
+ */
+template<typename Func>
+void parallelFor(ThreadPool& pool, const std::size_t count, Func&& func)
+{
+    TaskGroup group;
+    for (std::size_t i = 0; i < count; i++)
+        group.submit(pool, [&func, i] { func(i); });
+    group.wait();
+}
+
+}// namespace dragonfire
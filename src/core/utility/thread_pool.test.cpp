@@ -0,0 +1,55 @@
+#include "thread_pool.h"
+#include "completion_queue.h"
+#include <algorithm>
+#include <atomic>
+#include <catch.hpp>
+#include <memory>
+
+using namespace dragonfire;
+
+TEST_CASE("Thread Pool")
+{
+    ThreadPool pool(4);
+    REQUIRE(pool.threadCount() == 4);
+
+    SECTION("Runs every task")
+    {
+        std::atomic_int counter = 0;
+        for (int i = 0; i < 1000; i++)
+            pool.submit([&] { counter++; });
+        pool.waitIdle();
+        CHECK(counter == 1000);
+        CHECK(pool.pending() == 0);
+    }
+
+    SECTION("Completion queue")
+    {
+        CompletionQueue<int> queue;
+        for (int i = 0; i < 100; i++)
+            pool.submit([&queue, i] { queue.push(int(i)); });
+        pool.waitIdle();
+
+        std::vector<int> results{-1};
+        CHECK(queue.drain(results) == 100);
+        CHECK(queue.size() == 0);
+        std::ranges::sort(results);
+        CHECK(results.size() == 101);
+        CHECK(results.front() == -1);
+        CHECK(results.back() == 99);
+    }
+
+    SECTION("Task groups can be destroyed as soon as their tasks return")
+    {
+        std::atomic_int counter = 0;
+        for (int round = 0; round < 100; round++) {
+            // Freed right after waiting, while the last task may still be notifying
+            auto group = std::make_unique<TaskGroup>();
+            for (int i = 0; i < 8; i++)
+                group->submit(pool, [&] { counter++; });
+            group->wait();
+            CHECK(group->pending() == 0);
+        }
+        pool.waitIdle();
+        CHECK(counter == 800);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <memory>
+
+namespace dragonfire {
+
+/***
+ * @brief Scratch memory owned by the calling thread, created the first time the thread asks for it
+ *
+ * For buffers too large to put on a worker's stack, such as a chunk of unpacked voxels. There is one instance
+ * of each type per thread, so the reference must not be held across a call that uses the same type.
+ */
+template<typename T>
+T& threadScratch()
+{
+    static thread_local std::unique_ptr<T> scratch;
+    if (!scratch)
+        scratch = std::make_unique<T>();
+    return *scratch;
+}
+
+}// namespace dragonfire
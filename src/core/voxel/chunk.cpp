@@ -3,6 +3,427 @@
 //
 
 #include "chunk.h"
+#include "core/utility/formatted_error.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <utility>
 
 namespace dragonfire::voxel {
+
+static_assert(sizeof(Voxel) == sizeof(std::uint16_t), "Voxels are stored as raw 16 bit values");
+
+/// Returns the smallest supported index width able to address count palette entries
+static std::uint32_t bitsFor(const std::size_t count) noexcept
+{
+    if (count <= 1)
+        return 0;
+    if (count <= 2)
+        return 1;
+    if (count <= 4)
+        return 2;
+    if (count <= 16)
+        return 4;
+    if (count <= 256)
+        return 8;
+    return 16;
+}
+
+static std::uint32_t rawValue(const Voxel voxel) noexcept
+{
+    return std::bit_cast<std::uint16_t>(voxel);
+}
+
+/// Bit i set if the column has a non air voxel in brick i along z
+static std::uint64_t columnBricks(const std::uint32_t column) noexcept
+{
+    std::uint64_t out = 0;
+    for (std::size_t z = 0; z < Chunk::BRICK_COUNT; z++)
+        out |= std::uint64_t((column >> z * Chunk::BRICK_DIM & 0xF) != 0) << z;
+    return out;
+}
+
+/// Rebuilds the column and brick masks, calling occupied with the index of each voxel in order
+template<typename Func>
+void Chunk::buildOccupancy(Func&& occupied)
+{
+    columns.resize(CHUNK_DIM * CHUNK_DIM);
+    bricks = {};
+    for (std::size_t column = 0; column < columns.size(); column++) {
+        std::uint32_t mask = 0;
+        for (std::size_t z = 0; z < CHUNK_DIM; z++)
+            mask |= std::uint32_t(occupied(column * CHUNK_DIM + z)) << z;
+        columns[column] = mask;
+        const std::size_t x = column / CHUNK_DIM, y = column % CHUNK_DIM;
+        bricks[x / BRICK_DIM] |= columnBricks(mask) << y / BRICK_DIM * BRICK_COUNT;
+    }
+}
+
+Chunk Chunk::pack(const std::span<const Voxel, CHUNK_SIZE> voxels)
+{
+    Chunk chunk(voxels[0]);
+    std::vector<Voxel> palette{voxels[0]};
+    std::vector<std::uint16_t> counts{0};
+    std::uint32_t last = 0;
+    // Terrain is mostly long runs of the same voxel, so check the last match before searching
+    const auto find = [&](const Voxel voxel) -> std::uint32_t {
+        if (palette[last] == voxel)
+            return last;
+        const auto found = std::ranges::find(palette, voxel);
+        if (found == palette.end())
+            return UINT32_MAX;
+        return last = std::uint32_t(found - palette.begin());
+    };
+
+    bool direct = false;
+    for (const Voxel voxel : voxels) {
+        std::uint32_t index = find(voxel);
+        if (index == UINT32_MAX) {
+            if (palette.size() == std::size_t(1) << MAX_PALETTE_BITS) {
+                direct = true;
+                break;
+            }
+            index = last = std::uint32_t(palette.size());
+            palette.push_back(voxel);
+            counts.push_back(0);
+        }
+        counts[index]++;
+    }
+
+    if (palette.size() == 1 && !direct)
+        return chunk;
+    chunk.buildOccupancy([&](const std::size_t i) { return voxels[i].id != 0; });
+    if (direct) {
+        chunk.repack(DIRECT_BITS, {});
+        for (std::size_t i = 0; i < CHUNK_SIZE; i++)
+            chunk.writeIndex(i, rawValue(voxels[i]));
+        return chunk;
+    }
+
+    chunk.repack(bitsFor(palette.size()), {});
+    last = 0;
+    for (std::size_t i = 0; i < CHUNK_SIZE; i++)
+        chunk.writeIndex(i, find(voxels[i]));
+    chunk.livePaletteEntries = std::uint32_t(palette.size());
+    chunk.palette = std::move(palette);
+    chunk.refCounts = std::move(counts);
+    return chunk;
+}
+
+void Chunk::set(const std::size_t index, const Voxel voxel)
+{
+    assert(index < CHUNK_SIZE);
+    if (bits == 0) {
+        if (voxel == uniform)
+            return;
+        palette.assign(1, uniform);
+        refCounts.assign(1, CHUNK_SIZE);
+        livePaletteEntries = 1;
+        repack(1, {});
+        const bool occupied = uniform.id != 0;
+        buildOccupancy([occupied](std::size_t) { return occupied; });
+    }
+    else if (get(index) == voxel)
+        return;
+    dirty.mark(position(index));
+    // Updated first, as removing the last other voxel from the palette makes the chunk uniform
+    if ((get(index).id != 0) != (voxel.id != 0))
+        occupy(index, voxel.id != 0);
+
+    // Finding the palette entry may repack the chunk, so only read the old index afterwards
+    const std::uint32_t newIndex = paletteIndex(voxel);
+    if (bits == DIRECT_BITS) {
+        writeIndex(index, newIndex);
+        return;
+    }
+    const std::uint32_t oldIndex = readIndex(index);
+    writeIndex(index, newIndex);
+    if (refCounts[newIndex]++ == 0)
+        livePaletteEntries++;
+    release(oldIndex);
+}
+
+void Chunk::fill(const Voxel voxel)
+{
+    if (bits != 0 || uniform != voxel)
+        dirty = DirtyLayers::all();
+    makeUniform(voxel);
+}
+
+void Chunk::unpack(const std::span<Voxel, CHUNK_SIZE> out) const
+{
+    if (bits == 0) {
+        std::ranges::fill(out, uniform);
+        return;
+    }
+    const std::size_t perWord = std::size_t(1) << wordShift;
+    const std::uint64_t mask = (std::uint64_t(1) << bits) - 1;
+    for (std::size_t i = 0; i < data.size(); i++) {
+        std::uint64_t word = data[i];
+        Voxel* dst = out.data() + i * perWord;
+        if (bits == DIRECT_BITS) {
+            for (std::size_t j = 0; j < perWord; j++, word >>= bits)
+                dst[j] = std::bit_cast<Voxel>(std::uint16_t(word & mask));
+        }
+        else {
+            for (std::size_t j = 0; j < perWord; j++, word >>= bits)
+                dst[j] = palette[word & mask];
+        }
+    }
+}
+
+void Chunk::compact()
+{
+    if (bits != DIRECT_BITS)
+        return;
+    std::vector<std::uint32_t> remap(std::size_t(1) << DIRECT_BITS, UINT32_MAX);
+    std::vector<Voxel> newPalette;
+    std::vector<std::uint16_t> counts;
+    for (std::size_t i = 0; i < CHUNK_SIZE; i++) {
+        const std::uint32_t value = readIndex(i);
+        if (remap[value] == UINT32_MAX) {
+            remap[value] = std::uint32_t(newPalette.size());
+            newPalette.push_back(std::bit_cast<Voxel>(std::uint16_t(value)));
+            counts.push_back(0);
+        }
+        counts[remap[value]]++;
+    }
+
+    const std::uint32_t newBits = bitsFor(newPalette.size());
+    if (newBits == DIRECT_BITS)
+        return;
+    if (newBits == 0) {
+        makeUniform(newPalette.front());
+        return;
+    }
+    repack(newBits, remap);
+    livePaletteEntries = std::uint32_t(newPalette.size());
+    palette = std::move(newPalette);
+    refCounts = std::move(counts);
+}
+
+/// Header of a serialized chunk, followed by the palette, or the uniform voxel, and then the packed data
+struct SerializedChunk {
+    std::uint8_t bits;
+    std::uint8_t wordShift;
+    std::uint16_t paletteSize;
+};
+
+void Chunk::serialize(std::vector<std::uint8_t>& out) const
+{
+    const SerializedChunk header{bits, wordShift, std::uint16_t(bits == 0 ? 1 : palette.size())};
+    const std::size_t start = out.size();
+    out.resize(
+        start + sizeof(header) + header.paletteSize * sizeof(Voxel) + data.size() * sizeof(std::uint64_t)
+    );
+    std::uint8_t* dst = out.data() + start;
+    std::memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    if (bits == 0) {
+        std::memcpy(dst, &uniform, sizeof(Voxel));
+        return;
+    }
+    if (!palette.empty())
+        std::memcpy(dst, palette.data(), palette.size() * sizeof(Voxel));
+    dst += palette.size() * sizeof(Voxel);
+    std::memcpy(dst, data.data(), data.size() * sizeof(std::uint64_t));
+}
+
+Chunk Chunk::deserialize(const std::span<const std::uint8_t> data)
+{
+    SerializedChunk header{};
+    if (data.size() < sizeof(header))
+        throw FormattedError("Serialized chunk is too short, {} bytes", data.size());
+    std::memcpy(&header, data.data(), sizeof(header));
+    const std::uint32_t bits = header.bits;
+    const bool validBits = bits <= DIRECT_BITS && (bits == 0 || std::has_single_bit(bits));
+    if (!validBits || (bits != 0 && header.wordShift != 6 - std::countr_zero(bits)))
+        throw FormattedError("Serialized chunk has an invalid index width of {} bits", bits);
+    const std::size_t maxPaletteSize = bits == DIRECT_BITS ? 0 : std::size_t(1) << bits;
+    if ((header.paletteSize == 0 && bits != DIRECT_BITS) || header.paletteSize > maxPaletteSize)
+        throw FormattedError("Serialized chunk has {} palette entries for {} bits", header.paletteSize, bits);
+
+    const std::size_t paletteBytes = header.paletteSize * sizeof(Voxel);
+    const std::size_t dataWords = CHUNK_SIZE * bits / 64;
+    if (data.size() != sizeof(header) + paletteBytes + dataWords * sizeof(std::uint64_t))
+        throw FormattedError("Serialized chunk has the wrong size, {} bytes", data.size());
+
+    Chunk chunk;
+    const std::uint8_t* src = data.data() + sizeof(header);
+    if (bits == 0) {
+        std::memcpy(&chunk.uniform, src, sizeof(Voxel));
+        return chunk;
+    }
+    chunk.bits = std::uint8_t(bits);
+    chunk.wordShift = header.wordShift;
+    chunk.data.resize(dataWords);
+    std::memcpy(chunk.data.data(), src + paletteBytes, dataWords * sizeof(std::uint64_t));
+    if (bits == DIRECT_BITS) {
+        chunk.buildOccupancy([&](const std::size_t i) { return chunk.get(i).id != 0; });
+        return chunk;
+    }
+
+    chunk.palette.resize(header.paletteSize);
+    std::memcpy(chunk.palette.data(), src, paletteBytes);
+    // Reference counts are not stored, rebuild them and reject indices outside the palette
+    chunk.refCounts.assign(header.paletteSize, 0);
+    for (std::size_t i = 0; i < CHUNK_SIZE; i++) {
+        const std::uint32_t index = chunk.readIndex(i);
+        if (index >= header.paletteSize)
+            throw FormattedError("Serialized chunk references missing palette entry {}", index);
+        if (chunk.refCounts[index]++ == 0)
+            chunk.livePaletteEntries++;
+    }
+    chunk.buildOccupancy([&](const std::size_t i) { return chunk.get(i).id != 0; });
+    return chunk;
+}
+
+std::size_t Chunk::memoryUsage() const noexcept
+{
+    return sizeof(Chunk) + data.capacity() * sizeof(std::uint64_t) + palette.capacity() * sizeof(Voxel)
+           + refCounts.capacity() * sizeof(std::uint16_t) + columns.capacity() * sizeof(std::uint32_t);
+}
+
+std::size_t Chunk::occupiedCount() const noexcept
+{
+    if (bits == 0)
+        return uniform.id != 0 ? CHUNK_SIZE : 0;
+    std::size_t count = 0;
+    for (const std::uint32_t mask : columns)
+        count += std::size_t(std::popcount(mask));
+    return count;
+}
+
+void Chunk::writeIndex(const std::size_t index, const std::uint32_t value) noexcept
+{
+    std::uint64_t& word = data[index >> wordShift];
+    const std::size_t shift = (index & ((std::size_t(1) << wordShift) - 1)) * bits;
+    const std::uint64_t mask = ((std::uint64_t(1) << bits) - 1) << shift;
+    word = (word & ~mask) | (std::uint64_t(value) << shift & mask);
+}
+
+std::uint32_t Chunk::paletteIndex(const Voxel voxel)
+{
+    if (bits == DIRECT_BITS)
+        return rawValue(voxel);
+    const auto found = std::ranges::find(palette, voxel);
+    if (found != palette.end())
+        return std::uint32_t(found - palette.begin());
+
+    if (livePaletteEntries < palette.size()) {
+        const auto free = std::ranges::find(refCounts, 0);
+        const auto index = std::uint32_t(free - refCounts.begin());
+        palette[index] = voxel;
+        return index;
+    }
+    if (palette.size() == std::size_t(1) << bits) {
+        repackPalette(bitsFor(palette.size() + 1));
+        if (bits == DIRECT_BITS)
+            return rawValue(voxel);
+    }
+    palette.push_back(voxel);
+    refCounts.push_back(0);
+    return std::uint32_t(palette.size() - 1);
+}
+
+void Chunk::release(const std::uint32_t index)
+{
+    if (--refCounts[index] > 0)
+        return;
+    livePaletteEntries--;
+    // Only shrink once the palette would fit twice over in the smaller width, so a chunk with a
+    // palette right at a boundary does not repack on every edit
+    if (livePaletteEntries == 1 || bitsFor(livePaletteEntries * 2) < bits)
+        repackPalette(bitsFor(livePaletteEntries));
+}
+
+void Chunk::repackPalette(const std::uint32_t newBits)
+{
+    if (newBits == 0) {
+        makeUniform(palette[std::ranges::find_if(refCounts, [](auto count) { return count > 0; })
+                            - refCounts.begin()]);
+        return;
+    }
+    std::vector<std::uint32_t> remap(palette.size());
+    std::vector<Voxel> newPalette;
+    std::vector<std::uint16_t> counts;
+    newPalette.reserve(std::size_t(1) << std::min(newBits, MAX_PALETTE_BITS));
+    counts.reserve(newPalette.capacity());
+    for (std::size_t i = 0; i < palette.size(); i++) {
+        if (refCounts[i] == 0)
+            continue;
+        remap[i] = newBits == DIRECT_BITS ? rawValue(palette[i]) : std::uint32_t(newPalette.size());
+        newPalette.push_back(palette[i]);
+        counts.push_back(refCounts[i]);
+    }
+    repack(newBits, remap);
+    if (newBits == DIRECT_BITS) {
+        palette = std::vector<Voxel>();
+        refCounts = std::vector<std::uint16_t>();
+        livePaletteEntries = 0;
+    }
+    else {
+        palette = std::move(newPalette);
+        refCounts = std::move(counts);
+    }
+}
+
+/// Replaces the packed storage with zeroed storage of the new width, rewriting every voxel through remap
+/// unless it is empty
+void Chunk::repack(const std::uint32_t newBits, const std::span<const std::uint32_t> remap)
+{
+    assert(newBits > 0 && newBits <= DIRECT_BITS && std::has_single_bit(newBits));
+    const SlabVector<std::uint64_t> oldData = std::exchange(
+        data,
+        SlabVector<std::uint64_t>(CHUNK_SIZE * newBits / 64)
+    );
+    const std::uint32_t oldBits = bits, oldShift = wordShift;
+    bits = std::uint8_t(newBits);
+    wordShift = std::uint8_t(6 - std::countr_zero(newBits));
+    if (remap.empty() || oldBits == 0)
+        return;
+    const std::size_t perWord = std::size_t(1) << wordShift;
+    for (std::size_t i = 0; i < data.size(); i++) {
+        std::uint64_t word = 0;
+        for (std::size_t j = 0; j < perWord; j++) {
+            const std::uint32_t value = remap[extract(oldData.data(), oldBits, oldShift, i * perWord + j)];
+            word |= std::uint64_t(value) << j * newBits;
+        }
+        data[i] = word;
+    }
+}
+
+void Chunk::makeUniform(const Voxel voxel) noexcept
+{
+    uniform = voxel;
+    // assigning {} would keep the capacity, move from empty vectors to release the memory
+    data = SlabVector<std::uint64_t>();
+    palette = std::vector<Voxel>();
+    refCounts = std::vector<std::uint16_t>();
+    columns = SlabVector<std::uint32_t>();
+    bricks = {};
+    livePaletteEntries = 0;
+    bits = wordShift = 0;
+}
+
+void Chunk::occupy(const std::size_t index, const bool occupied) noexcept
+{
+    const std::size_t column = index / CHUNK_DIM, z = index % CHUNK_DIM;
+    const std::size_t x = column / CHUNK_DIM, y = column % CHUNK_DIM;
+    std::uint32_t& mask = columns[column];
+    mask = occupied ? mask | 1u << z : mask & ~(1u << z);
+
+    // Clearing the brick bit needs every column of the brick to be empty in its range of z
+    const std::size_t brickX = x / BRICK_DIM, brickY = y / BRICK_DIM, brickZ = z / BRICK_DIM;
+    bool any = occupied;
+    const std::uint32_t range = 0xFu << brickZ * BRICK_DIM;
+    for (std::size_t i = brickX * BRICK_DIM; !any && i < (brickX + 1) * BRICK_DIM; i++) {
+        for (std::size_t j = brickY * BRICK_DIM; !any && j < (brickY + 1) * BRICK_DIM; j++)
+            any = (columns[i * CHUNK_DIM + j] & range) != 0;
+    }
+    const std::uint64_t bit = std::uint64_t(1) << (brickY * BRICK_COUNT + brickZ);
+    bricks[brickX] = any ? bricks[brickX] | bit : bricks[brickX] & ~bit;
+}
+
 }// namespace dragonfire::voxel
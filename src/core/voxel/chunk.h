@@ -3,20 +3,264 @@
 //
 
 #pragma once
+#include "core/utility/slab_allocator.h"
 #include "voxel.h"
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cstdint>
 #include <glm/vec3.hpp>
+#include <span>
+#include <utility>
+#include <vector>
 
 namespace dragonfire::voxel {
+
+/// Layers of a chunk along each axis containing changed voxels, bit i + 1 of an axis is layer i.
+/// Bit 0 and bit 33 mark a change in the touching layer of the neighbouring chunk before and after the chunk.
+struct DirtyLayers {
+    std::array<std::uint64_t, 3> axes{};
+
+    [[nodiscard]] bool any() const noexcept { return (axes[0] | axes[1] | axes[2]) != 0; }
+
+    void mark(const glm::ivec3 position) noexcept
+    {
+        for (std::int32_t axis = 0; axis < 3; axis++)
+            axes[axis] |= std::uint64_t(1) << (position[axis] + 1);
+    }
+
+    /// Marks the layer of the neighbour touching the given face, in FACE_DIRECTIONS order, as changed
+    void markNeighbour(const std::uint8_t face) noexcept
+    {
+        axes[face / 2] |= std::uint64_t(1) << (face & 1 ? 33 : 0);
+    }
+
+    /// Faces of the chunk with a changed voxel on them as bits in FACE_DIRECTIONS order
+    [[nodiscard]] std::uint8_t borders() const noexcept
+    {
+        std::uint8_t out = 0;
+        for (std::int32_t axis = 0; axis < 3; axis++) {
+            out |= std::uint8_t(axes[axis] >> 1 & 1) << axis * 2;
+            out |= std::uint8_t(axes[axis] >> 32 & 1) << (axis * 2 + 1);
+        }
+        return out;
+    }
+
+    static constexpr DirtyLayers all() noexcept
+    {
+        constexpr std::uint64_t every = (std::uint64_t(1) << 34) - 1;
+        return {{every, every, every}};
+    }
+
+    DirtyLayers& operator|=(const DirtyLayers& other) noexcept
+    {
+        for (std::int32_t axis = 0; axis < 3; axis++)
+            axes[axis] |= other.axes[axis];
+        return *this;
+    }
+
+    bool operator==(const DirtyLayers& other) const = default;
+};
+
+/// Palette compressed cube of voxels.
+/// Each chunk stores the distinct voxels it contains in a palette, and each voxel as a bit packed index
+/// into that palette. Index widths are powers of two (1, 2, 4 or 8 bits) so an index never straddles a
+/// word. Uniform chunks store only their single voxel, and chunks with more than 256 distinct voxels
+/// store the raw 16 bit voxels directly. The storage is repacked automatically whenever the palette
+/// outgrows the current index width, or shrinks enough to fit in a smaller one.
+/// Writes that change a voxel mark its layers dirty, so meshes only need to rebuild the changed layers.
+/// Chunks also keep which voxels are not air as a bit mask per column, summarised per brick of 4^3 voxels,
+/// so code looking for the non air voxels can skip empty space a word at a time.
 class Chunk {
 public:
     static constexpr std::size_t CHUNK_DIM = 32;
     static constexpr std::size_t CHUNK_SIZE = CHUNK_DIM * CHUNK_DIM * CHUNK_DIM;
+    /// Size of an occupancy brick along each axis
+    static constexpr std::size_t BRICK_DIM = 4;
+    /// Number of occupancy bricks along each axis
+    static constexpr std::size_t BRICK_COUNT = CHUNK_DIM / BRICK_DIM;
+
+    Chunk() = default;
+
+    explicit Chunk(const Voxel voxel) : uniform(voxel) {}
+
+    /// Builds a chunk from uncompressed voxels, laid out the same way as linearIndex
+    static Chunk pack(std::span<const Voxel, CHUNK_SIZE> voxels);
+
+    Voxel operator[](const glm::ivec3 index) const { return get(linearIndex(index)); }
+
+    Voxel get(const std::size_t index) const
+    {
+        if (bits == 0)
+            return uniform;
+        const std::uint32_t value = readIndex(index);
+        return bits == DIRECT_BITS ? std::bit_cast<Voxel>(std::uint16_t(value)) : palette[value];
+    }
+
+    void set(glm::ivec3 index, Voxel voxel) { set(linearIndex(index), voxel); }
+
+    void set(std::size_t index, Voxel voxel);
+    /// Sets every voxel in the chunk, releasing the packed storage
+    void fill(Voxel voxel);
+    /// Decompresses the chunk into out, laid out the same way as linearIndex
+    void unpack(std::span<Voxel, CHUNK_SIZE> out) const;
+    /// Rebuilds the palette of a chunk storing raw voxels, repacking it if it now fits in fewer bits.
+    /// Chunks with a palette are compacted automatically as voxels are removed.
+    void compact();
+
+    /// Appends the packed storage of the chunk to out, in the machine's byte order
+    void serialize(std::vector<std::uint8_t>& out) const;
+    /***
+     * @brief Rebuilds a chunk written by serialize
+     * @throws FormattedError if data is not a valid serialized chunk
+     */
+    static Chunk deserialize(std::span<const std::uint8_t> data);
+
+    [[nodiscard]] bool isUniform() const noexcept { return bits == 0; }
 
-    Voxel operator [](const glm::ivec3 index) const {return voxels[index.x][index.y][index.z];}
+    /// Layers changed by set or fill since the last call to clearDirty
+    [[nodiscard]] const DirtyLayers& getDirty() const noexcept { return dirty; }
+
+    void clearDirty() noexcept { dirty = {}; }
+
+    /// Marks layers as changed, for writes that rebuild the chunk with pack
+    void markDirty(const DirtyLayers& layers) noexcept { dirty |= layers; }
+
+    /// Number of bits stored per voxel, 0 for uniform chunks and 16 for chunks storing raw voxels
+    [[nodiscard]] std::uint32_t bitsPerVoxel() const noexcept { return bits; }
+
+    /// Number of distinct voxels in the chunk, only tracked while the chunk has a palette
+    [[nodiscard]] std::size_t paletteSize() const noexcept { return bits == 0 ? 1 : livePaletteEntries; }
+
+    /// Approximate heap and inline memory used by this chunk in bytes
+    [[nodiscard]] std::size_t memoryUsage() const noexcept;
+
+    /// Non air voxels of the column at x, y, with bit z set if the voxel at z is not air
+    [[nodiscard]] std::uint32_t columnMask(const std::size_t x, const std::size_t y) const noexcept
+    {
+        if (bits == 0)
+            return uniform.id != 0 ? UINT32_MAX : 0;
+        return columns[x * CHUNK_DIM + y];
+    }
+
+    /// Bricks containing a non air voxel in the slab of bricks at bx, with bit by * BRICK_COUNT + bz set if
+    /// the brick at bx, by, bz is not all air
+    [[nodiscard]] std::uint64_t brickMask(const std::size_t bx) const noexcept
+    {
+        if (bits == 0)
+            return uniform.id != 0 ? UINT64_MAX : 0;
+        return bricks[bx];
+    }
+
+    /// Whether every voxel is air
+    [[nodiscard]] bool isEmpty() const noexcept
+    {
+        if (bits == 0)
+            return uniform.id == 0;
+        return std::ranges::all_of(bricks, [](const std::uint64_t mask) { return mask == 0; });
+    }
+
+    /// Number of voxels that are not air
+    [[nodiscard]] std::size_t occupiedCount() const noexcept;
+
+    /// Calls func with the linear index of every non air voxel in increasing order, skipping empty bricks
+    template<typename Func>
+    void forEachOccupied(Func&& func) const
+    {
+        if (bits == 0) {
+            for (std::size_t i = 0; uniform.id != 0 && i < CHUNK_SIZE; i++)
+                func(i);
+            return;
+        }
+        for (std::size_t x = 0; x < CHUNK_DIM; x++) {
+            const std::uint64_t slab = bricks[x / BRICK_DIM];
+            for (std::size_t y = 0; slab != 0 && y < CHUNK_DIM; y++) {
+                // Skip the whole row of bricks if it is empty
+                if ((slab >> (y / BRICK_DIM * BRICK_COUNT) & 0xFF) == 0) {
+                    y += BRICK_DIM - 1;
+                    continue;
+                }
+                const std::size_t column = x * CHUNK_DIM + y;
+                for (std::uint32_t mask = columns[column]; mask != 0; mask &= mask - 1)
+                    func(column * CHUNK_DIM + std::size_t(std::countr_zero(mask)));
+            }
+        }
+    }
+
+    static constexpr std::size_t linearIndex(const glm::ivec3 index) noexcept
+    {
+        return (std::size_t(index.x) * CHUNK_DIM + std::size_t(index.y)) * CHUNK_DIM + std::size_t(index.z);
+    }
+
+    static constexpr glm::ivec3 position(const std::size_t index) noexcept
+    {
+        const auto i = std::int32_t(index), dim = std::int32_t(CHUNK_DIM);
+        return {i / (dim * dim), i / dim % dim, i % dim};
+    }
+
+    /// The chunk containing a world voxel position
+    static constexpr glm::i32vec3 chunkOf(const glm::i32vec3 voxel) noexcept
+    {
+        // Arithmetic shift so negative coordinates round down
+        return {voxel.x >> 5, voxel.y >> 5, voxel.z >> 5};
+    }
+
+    /// Splits a world voxel position into the chunk containing it and the position within that chunk
+    static constexpr std::pair<glm::i32vec3, glm::ivec3> splitPosition(const glm::i32vec3 voxel) noexcept
+    {
+        constexpr auto mask = std::int32_t(CHUNK_DIM - 1);
+        return {chunkOf(voxel), glm::ivec3(voxel.x & mask, voxel.y & mask, voxel.z & mask)};
+    }
 
 private:
-    Voxel voxels[CHUNK_DIM][CHUNK_DIM][CHUNK_DIM]{};
+    static constexpr std::uint32_t DIRECT_BITS = 16;
+    static constexpr std::uint32_t MAX_PALETTE_BITS = 8;
+    static_assert(CHUNK_DIM == 32, "DirtyLayers stores one bit per layer in a 64 bit mask with the borders");
+    static_assert(CHUNK_DIM == 32, "chunkOf shifts by 5 to divide by the chunk size");
+    static_assert(BRICK_COUNT == 8, "Each brick slab is stored in a 64 bit mask");
+
+    /// Packed palette indices, pooled since chunks are loaded and unloaded constantly
+    SlabVector<std::uint64_t> data;
+    /// Occupancy of each column indexed x * CHUNK_DIM + y, empty while the chunk is uniform
+    SlabVector<std::uint32_t> columns;
+    /// Occupancy of each brick, see brickMask, only kept while the chunk is not uniform
+    std::array<std::uint64_t, BRICK_COUNT> bricks{};
+    std::vector<Voxel> palette;
+    /// Number of voxels referencing each palette entry, entries with a count of 0 are free
+    std::vector<std::uint16_t> refCounts;
+    std::uint32_t livePaletteEntries = 0;
+    DirtyLayers dirty;
+    Voxel uniform{};
+    std::uint8_t bits = 0;
+    /// log2 of the number of indices per 64 bit word
+    std::uint8_t wordShift = 0;
+
+    static std::uint32_t extract(
+        const std::uint64_t* words,
+        const std::uint32_t bits,
+        const std::uint32_t wordShift,
+        const std::size_t index
+    ) noexcept
+    {
+        const std::uint64_t word = words[index >> wordShift];
+        const std::size_t shift = (index & ((std::size_t(1) << wordShift) - 1)) * bits;
+        return std::uint32_t(word >> shift) & ((1u << bits) - 1);
+    }
+
+    std::uint32_t readIndex(const std::size_t index) const noexcept
+    {
+        return extract(data.data(), bits, wordShift, index);
+    }
+
+    void writeIndex(std::size_t index, std::uint32_t value) noexcept;
+    std::uint32_t paletteIndex(Voxel voxel);
+    void release(std::uint32_t index);
+    void repackPalette(std::uint32_t newBits);
+    void repack(std::uint32_t newBits, std::span<const std::uint32_t> remap);
+    void makeUniform(Voxel voxel) noexcept;
+    void occupy(std::size_t index, bool occupied) noexcept;
+    template<typename Func>
+    void buildOccupancy(Func&& occupied);
 };
 
 }// namespace dragonfire::voxel
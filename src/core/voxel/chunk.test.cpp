@@ -0,0 +1,341 @@
+#include "chunk.h"
+#include <algorithm>
+#include <catch.hpp>
+#include <memory>
+#include <random>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire::voxel;
+
+static Voxel voxel(const uint16_t id)
+{
+    return Voxel{id, 0};
+}
+
+/// The layout Chunk used before palette compression, kept as a baseline for the benchmarks
+struct FlatChunk {
+    Voxel voxels[Chunk::CHUNK_DIM][Chunk::CHUNK_DIM][Chunk::CHUNK_DIM]{};
+
+    Voxel operator[](const glm::ivec3 index) const { return voxels[index.x][index.y][index.z]; }
+};
+
+TEST_CASE("Palette Chunk")
+{
+    Chunk chunk;
+    REQUIRE(chunk.isUniform());
+    CHECK(chunk[{3, 4, 5}] == voxel(0));
+
+    SECTION("Grows and shrinks with the palette")
+    {
+        chunk.set({1, 2, 3}, voxel(7));
+        CHECK(chunk.bitsPerVoxel() == 1);
+        CHECK(chunk[{1, 2, 3}] == voxel(7));
+        CHECK(chunk[{3, 2, 1}] == voxel(0));
+
+        for (uint16_t i = 0; i < 20; i++)
+            chunk.set(Chunk::linearIndex({i, 0, 0}), voxel(100 + i));
+        CHECK(chunk.bitsPerVoxel() == 8);
+        CHECK(chunk.paletteSize() == 22);
+        for (uint16_t i = 0; i < 20; i++)
+            CHECK(chunk[{i, 0, 0}] == voxel(100 + i));
+        CHECK(chunk[{1, 2, 3}] == voxel(7));
+
+        for (uint16_t i = 0; i < 20; i++)
+            chunk.set(Chunk::linearIndex({i, 0, 0}), voxel(0));
+        CHECK(chunk.paletteSize() == 2);
+        CHECK(chunk.bitsPerVoxel() == 1);
+        CHECK(chunk[{1, 2, 3}] == voxel(7));
+
+        chunk.set({1, 2, 3}, voxel(0));
+        CHECK(chunk.isUniform());
+        CHECK(chunk.memoryUsage() == sizeof(Chunk));
+    }
+
+    SECTION("Stores raw voxels past 256 distinct values")
+    {
+        for (uint16_t i = 0; i < 300; i++)
+            chunk.set(i, voxel(i + 1));
+        CHECK(chunk.bitsPerVoxel() == 16);
+        for (uint16_t i = 0; i < 300; i++)
+            CHECK(chunk.get(i) == voxel(i + 1));
+
+        for (uint16_t i = 0; i < 300; i++)
+            chunk.set(i, voxel(i % 3));
+        chunk.compact();
+        CHECK(chunk.bitsPerVoxel() == 2);
+        CHECK(chunk.paletteSize() == 3);
+        for (uint16_t i = 0; i < 300; i++)
+            CHECK(chunk.get(i) == voxel(i % 3));
+    }
+
+    SECTION("Pack and unpack")
+    {
+        auto voxels = std::make_unique<Voxel[]>(Chunk::CHUNK_SIZE);
+        std::mt19937 rng(1234);
+        for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++)
+            voxels[i] = voxel(i < Chunk::CHUNK_SIZE / 2 ? 1 : uint16_t(rng() % 12));
+        const std::span<const Voxel, Chunk::CHUNK_SIZE> input(voxels.get(), Chunk::CHUNK_SIZE);
+        const Chunk packed = Chunk::pack(input);
+        CHECK(packed.bitsPerVoxel() == 4);
+
+        auto unpacked = std::make_unique<Voxel[]>(Chunk::CHUNK_SIZE);
+        packed.unpack(std::span<Voxel, Chunk::CHUNK_SIZE>(unpacked.get(), Chunk::CHUNK_SIZE));
+        CHECK(std::equal(voxels.get(), voxels.get() + Chunk::CHUNK_SIZE, unpacked.get()));
+    }
+
+    SECTION("Tracks dirty layers")
+    {
+        CHECK_FALSE(chunk.getDirty().any());
+        chunk.set({0, 5, 31}, voxel(0));
+        CHECK_FALSE(chunk.getDirty().any());
+
+        chunk.set({0, 5, 31}, voxel(4));
+        chunk.set({7, 5, 9}, voxel(4));
+        const DirtyLayers& dirty = chunk.getDirty();
+        CHECK(dirty.axes[0] == (1u << 1 | 1u << 8));
+        CHECK(dirty.axes[1] == 1u << 6);
+        CHECK(dirty.axes[2] == (1ull << 32 | 1u << 10));
+        // Edits on the -x and +z faces
+        CHECK(dirty.borders() == (1 << 0 | 1 << 5));
+
+        chunk.clearDirty();
+        chunk.fill(voxel(2));
+        CHECK(chunk.getDirty() == DirtyLayers::all());
+    }
+
+    SECTION("Serialize")
+    {
+        const auto roundTrip = [](const Chunk& original) {
+            std::vector<std::uint8_t> bytes;
+            original.serialize(bytes);
+            const Chunk copy = Chunk::deserialize(bytes);
+            CHECK(copy.bitsPerVoxel() == original.bitsPerVoxel());
+            CHECK(copy.paletteSize() == original.paletteSize());
+            for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++) {
+                if (copy.get(i) != original.get(i))
+                    return false;
+            }
+            return true;
+        };
+        CHECK(roundTrip(Chunk(voxel(7))));
+        for (uint16_t i = 0; i < 20; i++)
+            chunk.set(i * 97, voxel(i));
+        CHECK(roundTrip(chunk));
+        for (uint16_t i = 0; i < 300; i++)
+            chunk.set(i, voxel(i + 1));
+        CHECK(roundTrip(chunk));
+
+        // 3 palette entries with 2 bit indices
+        std::vector<std::uint8_t> bytes;
+        chunk.fill(voxel(0));
+        chunk.set(5, voxel(1));
+        chunk.set(6, voxel(2));
+        REQUIRE(chunk.bitsPerVoxel() == 2);
+        chunk.serialize(bytes);
+        CHECK_THROWS(Chunk::deserialize(std::span(bytes).first(bytes.size() - 1)));
+        std::vector<std::uint8_t> corrupt = bytes;
+        corrupt[0] = 3;
+        CHECK_THROWS(Chunk::deserialize(corrupt));
+        // Point every index at the missing 4th palette entry
+        std::ranges::fill(std::span(bytes).last(Chunk::CHUNK_SIZE / 4), 0xFF);
+        CHECK_THROWS(Chunk::deserialize(bytes));
+    }
+
+    SECTION("Fill")
+    {
+        chunk.set({0, 0, 0}, voxel(5));
+        chunk.fill(voxel(9));
+        CHECK(chunk.isUniform());
+        CHECK(chunk[{0, 0, 0}] == voxel(9));
+    }
+}
+
+/// Whether the occupancy masks of the chunk match its voxels exactly
+static bool occupancyMatches(const Chunk& chunk)
+{
+    std::size_t count = 0;
+    std::uint64_t bricks[Chunk::BRICK_COUNT]{};
+    for (std::size_t x = 0; x < Chunk::CHUNK_DIM; x++) {
+        for (std::size_t y = 0; y < Chunk::CHUNK_DIM; y++) {
+            std::uint32_t mask = 0;
+            for (std::size_t z = 0; z < Chunk::CHUNK_DIM; z++) {
+                if (chunk[glm::ivec3(x, y, z)].id == 0)
+                    continue;
+                mask |= 1u << z;
+                count++;
+                bricks[x / 4] |= std::uint64_t(1) << (y / 4 * 8 + z / 4);
+            }
+            if (chunk.columnMask(x, y) != mask)
+                return false;
+        }
+    }
+    for (std::size_t bx = 0; bx < Chunk::BRICK_COUNT; bx++) {
+        if (chunk.brickMask(bx) != bricks[bx])
+            return false;
+    }
+    std::vector<std::size_t> visited;
+    chunk.forEachOccupied([&](const std::size_t index) { visited.push_back(index); });
+    if (!std::ranges::is_sorted(visited) || std::ranges::adjacent_find(visited) != visited.end())
+        return false;
+    return visited.size() == count && chunk.occupiedCount() == count && chunk.isEmpty() == (count == 0);
+}
+
+TEST_CASE("Chunk Occupancy")
+{
+    std::mt19937 rng(7);
+    Chunk chunk;
+    CHECK(chunk.isEmpty());
+    CHECK(occupancyMatches(chunk));
+    CHECK(occupancyMatches(Chunk(voxel(3))));
+
+    SECTION("Stays exact through writes that change the storage")
+    {
+        // Few ids keep the palette small, then enough ids to switch to raw voxels and back
+        for (const uint16_t ids : {2, 6, 400, 2}) {
+            for (int i = 0; i < 3000; i++) {
+                // Clustered writes so whole bricks empty out again
+                const glm::ivec3 position(rng() % 8, rng() % 8, rng() % Chunk::CHUNK_DIM);
+                chunk.set(position, voxel(uint16_t(rng() % ids)));
+            }
+            REQUIRE(occupancyMatches(chunk));
+            chunk.compact();
+            REQUIRE(occupancyMatches(chunk));
+        }
+        for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++)
+            chunk.set(i, voxel(0));
+        CHECK(chunk.isUniform());
+        CHECK(occupancyMatches(chunk));
+    }
+
+    SECTION("Is rebuilt when packing and deserializing")
+    {
+        auto voxels = std::make_unique<Voxel[]>(Chunk::CHUNK_SIZE);
+        for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++)
+            voxels[i] = voxel(Chunk::position(i).z < 12 + int(rng() % 4) ? uint16_t(1 + rng() % 3) : 0);
+        chunk = Chunk::pack(std::span<const Voxel, Chunk::CHUNK_SIZE>(voxels.get(), Chunk::CHUNK_SIZE));
+        REQUIRE(occupancyMatches(chunk));
+        std::vector<std::uint8_t> bytes;
+        chunk.serialize(bytes);
+        CHECK(occupancyMatches(Chunk::deserialize(bytes)));
+
+        chunk.fill(voxel(0));
+        CHECK(chunk.isEmpty());
+        chunk.set({31, 31, 31}, voxel(5));
+        CHECK(chunk.occupiedCount() == 1);
+        CHECK(occupancyMatches(chunk));
+    }
+}
+
+TEST_CASE("Chunk Storage Benchmark", "[.][benchmark]")
+{
+    std::mt19937 rng(42);
+    // Stone below a bumpy surface with a few scattered ores, roughly what generated terrain looks like
+    auto voxels = std::make_unique<Voxel[]>(Chunk::CHUNK_SIZE);
+    auto flat = std::make_unique<FlatChunk>();
+    for (int x = 0; x < Chunk::CHUNK_DIM; x++) {
+        for (int y = 0; y < Chunk::CHUNK_DIM; y++) {
+            const int height = 16 + int(rng() % 4);
+            for (int z = 0; z < Chunk::CHUNK_DIM; z++) {
+                Voxel v = voxel(z < height ? 1 : 0);
+                if (z < height && rng() % 64 == 0)
+                    v = voxel(2 + rng() % 6);
+                voxels[Chunk::linearIndex({x, y, z})] = flat->voxels[x][y][z] = v;
+            }
+        }
+    }
+    const std::span<const Voxel, Chunk::CHUNK_SIZE> span(voxels.get(), Chunk::CHUNK_SIZE);
+    Chunk chunk = Chunk::pack(span);
+    spdlog::info(
+        "Chunk memory: flat {} bytes, palette terrain {} bytes ({} bits per voxel), uniform {} bytes",
+        sizeof(FlatChunk),
+        chunk.memoryUsage(),
+        chunk.bitsPerVoxel(),
+        Chunk().memoryUsage()
+    );
+
+    std::vector<glm::ivec3> indices(4096);
+    for (auto& index : indices)
+        index = glm::ivec3(rng() % Chunk::CHUNK_DIM, rng() % Chunk::CHUNK_DIM, rng() % Chunk::CHUNK_DIM);
+
+    BENCHMARK("Flat random reads")
+    {
+        uint32_t sum = 0;
+        for (const auto index : indices)
+            sum += (*flat)[index].id;
+        return sum;
+    };
+
+    BENCHMARK("Palette random reads")
+    {
+        uint32_t sum = 0;
+        for (const auto index : indices)
+            sum += chunk[index].id;
+        return sum;
+    };
+
+    BENCHMARK("Flat random writes")
+    {
+        for (const auto index : indices)
+            flat->voxels[index.x][index.y][index.z] = voxel(3);
+        return flat->voxels[0][0][0];
+    };
+
+    BENCHMARK("Palette random writes")
+    {
+        for (const auto index : indices)
+            chunk.set(index, voxel(3));
+        return chunk.get(0);
+    };
+
+    BENCHMARK("Palette pack") { return Chunk::pack(span); };
+
+    auto out = std::make_unique<Voxel[]>(Chunk::CHUNK_SIZE);
+    BENCHMARK("Palette unpack")
+    {
+        chunk.unpack(std::span<Voxel, Chunk::CHUNK_SIZE>(out.get(), Chunk::CHUNK_SIZE));
+        return out[0];
+    };
+}
+
+TEST_CASE("Chunk Occupancy Benchmark", "[.][benchmark]")
+{
+    std::mt19937 rng(42);
+    // A surface chunk with caves, and a mostly empty chunk with a few floating voxels
+    auto voxels = std::make_unique<Voxel[]>(Chunk::CHUNK_SIZE);
+    for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++) {
+        const glm::ivec3 position = Chunk::position(i);
+        voxels[i] = voxel(position.z < 16 && rng() % 8 != 0 ? 1 : 0);
+    }
+    const std::span<const Voxel, Chunk::CHUNK_SIZE> span(voxels.get(), Chunk::CHUNK_SIZE);
+    const Chunk surface = Chunk::pack(span);
+    Chunk sparse;
+    for (int i = 0; i < 64; i++)
+        sparse.set(glm::ivec3(rng() % 32, rng() % 32, rng() % 32), voxel(2));
+
+    const auto naive = [](const Chunk& chunk) {
+        std::size_t sum = 0;
+        for (int x = 0; x < Chunk::CHUNK_DIM; x++) {
+            for (int y = 0; y < Chunk::CHUNK_DIM; y++) {
+                for (int z = 0; z < Chunk::CHUNK_DIM; z++) {
+                    if (chunk[{x, y, z}].id != 0)
+                        sum += Chunk::linearIndex({x, y, z});
+                }
+            }
+        }
+        return sum;
+    };
+    const auto masked = [](const Chunk& chunk) {
+        std::size_t sum = 0;
+        chunk.forEachOccupied([&](const std::size_t index) { sum += index; });
+        return sum;
+    };
+    REQUIRE(naive(surface) == masked(surface));
+    REQUIRE(naive(sparse) == masked(sparse));
+    spdlog::info("Occupied voxels: surface {}, sparse {}", surface.occupiedCount(), sparse.occupiedCount());
+
+    BENCHMARK("Surface triple loop") { return naive(surface); };
+    BENCHMARK("Surface occupancy masks") { return masked(surface); };
+    BENCHMARK("Sparse triple loop") { return naive(sparse); };
+    BENCHMARK("Sparse occupancy masks") { return masked(sparse); };
+    BENCHMARK("Surface occupied count") { return surface.occupiedCount(); };
+}
@@ -0,0 +1,132 @@
+#include "chunk_map.h"
+#include <algorithm>
+#include <utility>
+
+namespace dragonfire::voxel {
+
+/// Index of the direction opposite to FACE_DIRECTIONS[face]
+static constexpr std::size_t opposite(const std::size_t face) noexcept
+{
+    return face ^ 1;
+}
+
+Chunk* ChunkMap::find(const glm::i32vec3 position) noexcept
+{
+    Region* region = findRegion(regionOf(position));
+    if (region == nullptr)
+        return nullptr;
+    const std::int32_t index = localIndex(position);
+    return region->loaded[index] ? &region->chunks[index] : nullptr;
+}
+
+const Chunk* ChunkMap::find(const glm::i32vec3 position) const noexcept
+{
+    const Region* region = findRegion(regionOf(position));
+    if (region == nullptr)
+        return nullptr;
+    const std::int32_t index = localIndex(position);
+    return region->loaded[index] ? &region->chunks[index] : nullptr;
+}
+
+Chunk& ChunkMap::insert(const glm::i32vec3 position, Chunk&& chunk)
+{
+    const glm::i32vec3 regionPos = regionOf(position);
+    auto& slot = regions[regionPos];
+    if (!slot) {
+        slot = std::make_unique<Region>();
+        for (std::size_t face = 0; face < FACE_DIRECTIONS.size(); face++) {
+            Region* neighbour = findRegion(regionPos + FACE_DIRECTIONS[face]);
+            slot->neighbours[face] = neighbour;
+            if (neighbour)
+                neighbour->neighbours[opposite(face)] = slot.get();
+        }
+    }
+    const std::int32_t index = localIndex(position);
+    if (!slot->loaded[index])
+        chunkCount++;
+    slot->loaded.set(index);
+    slot->chunks[index] = std::move(chunk);
+    return slot->chunks[index];
+}
+
+bool ChunkMap::erase(const glm::i32vec3 position)
+{
+    const glm::i32vec3 regionPos = regionOf(position);
+    const auto found = regions.find(regionPos);
+    if (found == regions.end())
+        return false;
+    Region& region = *found->second;
+    const std::int32_t index = localIndex(position);
+    if (!region.loaded[index])
+        return false;
+    region.loaded.reset(index);
+    region.chunks[index] = Chunk();
+    chunkCount--;
+    if (region.loaded.none()) {
+        for (std::size_t face = 0; face < FACE_DIRECTIONS.size(); face++) {
+            if (region.neighbours[face])
+                region.neighbours[face]->neighbours[opposite(face)] = nullptr;
+        }
+        regions.erase(found);
+    }
+    return true;
+}
+
+void ChunkMap::clear()
+{
+    regions.clear();
+    chunkCount = 0;
+}
+
+std::array<Chunk*, 6> ChunkMap::neighbours(const glm::i32vec3 position) noexcept
+{
+    std::array<Chunk*, 6> out{};
+    std::ranges::transform(std::as_const(*this).neighbours(position), out.begin(), [](const Chunk* chunk) {
+        return const_cast<Chunk*>(chunk);
+    });
+    return out;
+}
+
+std::array<const Chunk*, 6> ChunkMap::neighbours(const glm::i32vec3 position) const noexcept
+{
+    std::array<const Chunk*, 6> out{};
+    const Region* region = findRegion(regionOf(position));
+    if (region == nullptr) {
+        for (std::size_t face = 0; face < FACE_DIRECTIONS.size(); face++)
+            out[face] = find(position + FACE_DIRECTIONS[face]);
+        return out;
+    }
+    const glm::i32vec3 local = localPosition(localIndex(position));
+    for (std::size_t face = 0; face < FACE_DIRECTIONS.size(); face++) {
+        const glm::i32vec3 next = local + FACE_DIRECTIONS[face];
+        const bool inside = next.x >= 0 && next.y >= 0 && next.z >= 0 && next.x < REGION_DIM
+                            && next.y < REGION_DIM && next.z < REGION_DIM;
+        const Region* target = inside ? region : region->neighbours[face];
+        if (target == nullptr)
+            continue;
+        const std::int32_t index = localIndex(next);
+        out[face] = target->loaded[index] ? &target->chunks[index] : nullptr;
+    }
+    return out;
+}
+
+std::size_t ChunkMap::memoryUsage() const noexcept
+{
+    constexpr std::size_t regionSize = sizeof(Region) + sizeof(glm::i32vec3) + sizeof(void*);
+    std::size_t size = sizeof(ChunkMap) + regions.size() * regionSize;
+    for (const auto& [position, region] : regions) {
+        for (std::int32_t i = 0; i < REGION_SIZE; i++) {
+            if (region->loaded[i])
+                size += region->chunks[i].memoryUsage() - sizeof(Chunk);
+        }
+    }
+    return size;
+}
+
+ChunkMap::Region* ChunkMap::findRegion(const glm::i32vec3 regionPos) const noexcept
+{
+    const auto found = regions.find(regionPos);
+    return found == regions.end() ? nullptr : found->second.get();
+}
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,123 @@
+#pragma once
+#include "chunk.h"
+#include <ankerl/unordered_dense.h>
+#include <array>
+#include <bitset>
+#include <glm/vec3.hpp>
+#include <memory>
+
+namespace dragonfire::voxel {
+
+/// Hashes chunk or region coordinates, packing them into a single 64 bit key before mixing
+struct ChunkPositionHash {
+    using is_avalanching [[maybe_unused]] = void;// NOLINT(readability-identifier-naming)
+
+    std::uint64_t operator()(const glm::i32vec3 position) const noexcept
+    {
+        constexpr std::uint64_t mask = (1 << 21) - 1;
+        const std::uint64_t packed = (std::uint64_t(position.x) & mask) << 42
+                                     | (std::uint64_t(position.y) & mask) << 21
+                                     | (std::uint64_t(position.z) & mask);
+        return ankerl::unordered_dense::hash<std::uint64_t>{}(packed);
+    }
+};
+
+/// Directions of the 6 face neighbours of a chunk, in the order returned by ChunkMap::neighbours
+static constexpr std::array<glm::i32vec3, 6> FACE_DIRECTIONS = {{
+    {-1, 0, 0},
+    {1, 0, 0},
+    {0, -1, 0},
+    {0, 1, 0},
+    {0, 0, -1},
+    {0, 0, 1},
+}};
+
+/// Sparse map of chunks keyed by chunk coordinates.
+/// Chunks are stored in fixed size pages, called regions, of REGION_DIM^3 chunks so chunks near each other
+/// are near each other in memory and only one hash lookup is needed per region. A chunk's address is
+/// stable until that chunk is erased. Regions keep pointers to their face neighbours, so finding the
+/// neighbours of a chunk never needs more than the one lookup for the chunk's own region.
+/// Lookups may run concurrently, but inserting or erasing requires exclusive access.
+class ChunkMap {
+public:
+    static constexpr std::int32_t REGION_DIM = 8;
+    static constexpr std::int32_t REGION_SIZE = REGION_DIM * REGION_DIM * REGION_DIM;
+
+    ChunkMap() = default;
+    ~ChunkMap() = default;
+
+    /// Returns the chunk at the given chunk coordinates, or nullptr if it is not loaded
+    Chunk* find(glm::i32vec3 position) noexcept;
+    const Chunk* find(glm::i32vec3 position) const noexcept;
+
+    [[nodiscard]] bool contains(const glm::i32vec3 position) const noexcept
+    {
+        return find(position) != nullptr;
+    }
+
+    /// Inserts or replaces the chunk at the given position, returning its stable address
+    Chunk& insert(glm::i32vec3 position, Chunk&& chunk);
+    /// Removes the chunk, returns false if it was not loaded
+    bool erase(glm::i32vec3 position);
+    void clear();
+
+    /// Returns the loaded face neighbours of the chunk in the order of FACE_DIRECTIONS, nullptr if not loaded
+    std::array<Chunk*, 6> neighbours(glm::i32vec3 position) noexcept;
+    std::array<const Chunk*, 6> neighbours(glm::i32vec3 position) const noexcept;
+
+    /// Calls func(glm::i32vec3 position, Chunk& chunk) for every loaded chunk, grouped by region
+    template<typename Func>
+    void forEach(Func&& func)
+    {
+        for (auto& [regionPos, region] : regions) {
+            for (std::int32_t i = 0; i < REGION_SIZE; i++) {
+                if (region->loaded[i])
+                    func(regionPos * REGION_DIM + localPosition(i), region->chunks[i]);
+            }
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return chunkCount; }
+
+    [[nodiscard]] std::size_t regionCount() const noexcept { return regions.size(); }
+
+    /// Approximate memory used by the loaded chunks and the map itself in bytes
+    [[nodiscard]] std::size_t memoryUsage() const noexcept;
+
+    static constexpr glm::i32vec3 regionOf(const glm::i32vec3 position) noexcept
+    {
+        // Arithmetic shift so negative coordinates round down
+        return {position.x >> 3, position.y >> 3, position.z >> 3};
+    }
+
+    static constexpr std::int32_t localIndex(const glm::i32vec3 position) noexcept
+    {
+        constexpr std::int32_t mask = REGION_DIM - 1;
+        return ((position.x & mask) * REGION_DIM + (position.y & mask)) * REGION_DIM + (position.z & mask);
+    }
+
+    static constexpr glm::i32vec3 localPosition(const std::int32_t index) noexcept
+    {
+        return {index / (REGION_DIM * REGION_DIM), index / REGION_DIM % REGION_DIM, index % REGION_DIM};
+    }
+
+    ChunkMap(const ChunkMap& other) = delete;
+    ChunkMap& operator=(const ChunkMap& other) = delete;
+
+private:
+    static_assert(REGION_DIM == 8, "regionOf assumes 8 chunks per region axis");
+
+    struct Region {
+        Chunk chunks[REGION_SIZE];
+        std::bitset<REGION_SIZE> loaded;
+        /// Face neighbour regions in the order of FACE_DIRECTIONS, nullptr if not allocated
+        Region* neighbours[6]{};
+    };
+
+    ankerl::unordered_dense::map<glm::i32vec3, std::unique_ptr<Region>, ChunkPositionHash> regions;
+    std::size_t chunkCount = 0;
+
+    Region* findRegion(glm::i32vec3 regionPos) const noexcept;
+};
+
+}// namespace dragonfire::voxel
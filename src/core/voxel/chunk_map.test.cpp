@@ -0,0 +1,62 @@
+#include "chunk_map.h"
+#include <catch.hpp>
+
+using namespace dragonfire::voxel;
+
+TEST_CASE("Chunk Map")
+{
+    ChunkMap map;
+    CHECK(map.find({0, 0, 0}) == nullptr);
+
+    SECTION("Insert and erase")
+    {
+        Chunk& chunk = map.insert({-1, 5, -9}, Chunk(Voxel{4, 0}));
+        CHECK(map.size() == 1);
+        CHECK(map.find({-1, 5, -9}) == &chunk);
+        CHECK(chunk.get(0) == Voxel{4, 0});
+        CHECK(map.find({7, 5, -9}) == nullptr);
+
+        // Filling the rest of the region must not move the first chunk
+        for (int x = -8; x < 0; x++) {
+            for (int y = 0; y < 8; y++)
+                map.insert({x, y, -9}, Chunk());
+        }
+        CHECK(map.regionCount() == 1);
+        CHECK(map.find({-1, 5, -9}) == &chunk);
+
+        CHECK(map.erase({-1, 5, -9}));
+        CHECK_FALSE(map.erase({-1, 5, -9}));
+        CHECK(map.find({-1, 5, -9}) == nullptr);
+        CHECK(map.size() == 63);
+
+        std::size_t visited = 0;
+        map.forEach([&](const glm::i32vec3 position, Chunk&) {
+            CHECK(map.contains(position));
+            visited++;
+        });
+        CHECK(visited == 63);
+    }
+
+    SECTION("Neighbours across regions")
+    {
+        const glm::i32vec3 center{7, 3, -1};
+        Chunk& chunk = map.insert(center, Chunk());
+        for (const glm::i32vec3 direction : FACE_DIRECTIONS)
+            map.insert(center + direction, Chunk());
+        CHECK(map.regionCount() == 3);
+
+        const auto neighbours = map.neighbours(center);
+        for (std::size_t face = 0; face < FACE_DIRECTIONS.size(); face++) {
+            CHECK(neighbours[face] != nullptr);
+            CHECK(neighbours[face] == map.find(center + FACE_DIRECTIONS[face]));
+        }
+        CHECK(map.neighbours(center + FACE_DIRECTIONS[1])[0] == &chunk);
+
+        // Removing the only chunk in a region frees it, its neighbours must stop pointing at it
+        map.erase(center + FACE_DIRECTIONS[1]);
+        CHECK(map.regionCount() == 2);
+        CHECK(map.neighbours(center)[1] == nullptr);
+        map.insert(center + FACE_DIRECTIONS[1], Chunk());
+        CHECK(map.neighbours(center)[1] == map.find(center + FACE_DIRECTIONS[1]));
+    }
+}
@@ -0,0 +1,189 @@
+#include "chunk_streamer.h"
+#include "region_file.h"
+#include "terrain.h"
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <spdlog/spdlog.h>
+#include <tuple>
+
+namespace dragonfire::voxel {
+
+ChunkStreamer::ChunkStreamer(
+    ChunkMap& chunks,
+    TerrainGenerator& generator,
+    ThreadPool& pool,
+    const StreamingSettings& settings
+)
+    : settings(settings), chunks(chunks), generator(generator), pool(pool)
+{
+}
+
+ChunkStreamer::~ChunkStreamer() = default;
+
+std::span<const FeatureSpill> ChunkStreamer::getSpills() const noexcept
+{
+    return spills;
+}
+
+void ChunkStreamer::update(const std::span<const glm::vec3> observers)
+{
+    loaded.clear();
+    unloaded.clear();
+    bool moved = observers.size() != observerChunks.size();
+    for (std::size_t i = 0; i < observers.size() && !moved; i++)
+        moved = chunkPosition(observers[i]) != observerChunks[i];
+    if (moved) {
+        observerChunks.clear();
+        for (const glm::vec3 observer : observers)
+            observerChunks.push_back(chunkPosition(observer));
+        rebuildQueues();
+    }
+
+    insertFinished();
+    unloadChunks();
+    requestChunks();
+}
+
+bool ChunkStreamer::inRange(const glm::i32vec3 position, const std::int32_t extra) const noexcept
+{
+    const std::int32_t radius = settings.radius + extra, verticalRadius = settings.verticalRadius + extra;
+    return std::ranges::any_of(observerChunks, [&](const glm::i32vec3 observer) {
+        const glm::i32vec3 delta = position - observer;
+        const bool horizontal = delta.x * delta.x + delta.y * delta.y <= radius * radius;
+        return horizontal && std::abs(delta.z) <= verticalRadius;
+    });
+}
+
+glm::i32vec3 ChunkStreamer::chunkPosition(const glm::vec3 worldPosition) noexcept
+{
+    return glm::i32vec3(glm::floor(worldPosition / float(Chunk::CHUNK_DIM)));
+}
+
+void ChunkStreamer::rebuildQueues()
+{
+    loadQueue.clear();
+    unloadQueue.clear();
+    const std::int32_t radius = settings.radius, verticalRadius = settings.verticalRadius;
+    for (const glm::i32vec3 observer : observerChunks) {
+        for (std::int32_t x = -radius; x <= radius; x++) {
+            for (std::int32_t y = -radius; y <= radius; y++) {
+                if (x * x + y * y > radius * radius)
+                    continue;
+                for (std::int32_t z = -verticalRadius; z <= verticalRadius; z++) {
+                    const glm::i32vec3 position = observer + glm::i32vec3(x, y, z);
+                    if (!chunks.contains(position) && !requested.contains(position))
+                        loadQueue.push_back(position);
+                }
+            }
+        }
+    }
+
+    // Squared distance to the closest observer, weighting vertical distance the same as horizontal
+    const auto distance = [this](const glm::i32vec3 position) {
+        std::int32_t closest = INT32_MAX;
+        for (const glm::i32vec3 observer : observerChunks) {
+            const glm::i32vec3 delta = position - observer;
+            closest = std::min(closest, delta.x * delta.x + delta.y * delta.y + delta.z * delta.z);
+        }
+        return closest;
+    };
+    std::ranges::sort(loadQueue, [](const glm::i32vec3 a, const glm::i32vec3 b) {
+        return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    });
+    const auto duplicates = std::ranges::unique(loadQueue);
+    loadQueue.erase(duplicates.begin(), duplicates.end());
+    std::ranges::sort(loadQueue, std::greater{}, distance);
+
+    chunks.forEach([&](const glm::i32vec3 position, const Chunk&) {
+        if (!inRange(position, settings.unloadMargin))
+            unloadQueue.push_back(position);
+    });
+}
+
+void ChunkStreamer::insertFinished()
+{
+    results.clear();
+    spills.clear();
+    generator.poll(results, spills);
+    for (GeneratedChunk& result : results) {
+        requested.erase(result.position);
+        // The observers may have moved away while the chunk was being generated
+        if (!inRange(result.position, settings.unloadMargin)) {
+            generator.forgetChunks({&result.position, 1});
+            continue;
+        }
+        if (storage) {
+            try {
+                if (std::optional<Chunk> saved = storage->load(result.position))
+                    result.chunk = std::move(*saved);
+            }
+            catch (const std::exception& e) {
+                spdlog::error("Failed to load saved chunk, using the generated one: {}", e.what());
+            }
+        }
+        chunks.insert(result.position, std::move(result.chunk));
+        loaded.push_back(result.position);
+    }
+}
+
+void ChunkStreamer::unloadChunks()
+{
+    while (!unloadQueue.empty() && unloaded.size() < settings.maxUnloadsPerFrame) {
+        const glm::i32vec3 position = unloadQueue.back();
+        unloadQueue.pop_back();
+        if (!inRange(position, settings.unloadMargin) && chunks.contains(position))
+            unloaded.push_back(position);
+    }
+    saveChunks(unloaded);
+    for (const glm::i32vec3 position : unloaded) {
+        chunks.erase(position);
+        modified.erase(position);
+    }
+    // Their features are placed again if they are generated again
+    generator.forgetChunks(unloaded);
+}
+
+void ChunkStreamer::saveModified()
+{
+    batch.assign(modified.begin(), modified.end());
+    saveChunks(batch);
+    modified.clear();
+}
+
+void ChunkStreamer::saveChunks(const std::span<const glm::i32vec3> positions)
+{
+    if (storage == nullptr)
+        return;
+    saves.clear();
+    for (const glm::i32vec3 position : positions) {
+        const Chunk* chunk = chunks.find(position);
+        if (chunk && modified.contains(position))
+            saves.emplace_back(position, chunk);
+    }
+    if (saves.empty())
+        return;
+    // One batch, so each region file is written once
+    try {
+        storage->save(saves);
+    }
+    catch (const std::exception& e) {
+        spdlog::error("Failed to save {} modified chunks: {}", saves.size(), e.what());
+    }
+}
+
+void ChunkStreamer::requestChunks()
+{
+    batch.clear();
+    while (!loadQueue.empty() && batch.size() < settings.maxLoadsPerFrame
+           && requested.size() < settings.maxPendingLoads) {
+        const glm::i32vec3 position = loadQueue.back();
+        loadQueue.pop_back();
+        if (chunks.contains(position) || !requested.insert(position).second)
+            continue;
+        batch.push_back(position);
+    }
+    if (!batch.empty())
+        generator.generate(batch, pool);
+}
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,117 @@
+#pragma once
+#include "chunk_map.h"
+#include <ankerl/unordered_dense.h>
+#include <glm/vec3.hpp>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace dragonfire {
+class ThreadPool;
+}
+
+namespace dragonfire::voxel {
+class ChunkStorage;
+class TerrainGenerator;
+struct GeneratedChunk;
+struct FeatureSpill;
+
+struct StreamingSettings {
+    /// Chunks within this many chunks of an observer horizontally are loaded
+    std::int32_t radius = 8;
+    /// Chunks within this many chunks of an observer vertically are loaded
+    std::int32_t verticalRadius = 4;
+    /// Extra distance past the load radius before a chunk is unloaded, so chunks on the edge do not thrash
+    std::int32_t unloadMargin = 2;
+    /// Maximum number of chunks requested from the generator per update
+    std::uint32_t maxLoadsPerFrame = 64;
+    /// Maximum number of chunks unloaded per update
+    std::uint32_t maxUnloadsPerFrame = 64;
+    /// Maximum number of chunks being generated at once
+    std::uint32_t maxPendingLoads = 512;
+};
+
+/// Loads chunks within a radius of one or more observers into a ChunkMap, and unloads chunks that are
+/// out of range of every observer. The work done per update is capped by the StreamingSettings budgets,
+/// chunks closest to an observer are loaded first. With a ChunkStorage, modified chunks are saved when they
+/// are unloaded and the saved voxels replace the generated ones when they are loaded again.
+class ChunkStreamer {
+public:
+    StreamingSettings settings;
+
+    ChunkStreamer(
+        ChunkMap& chunks,
+        TerrainGenerator& generator,
+        ThreadPool& pool,
+        const StreamingSettings& settings = {}
+    );
+    ~ChunkStreamer();
+
+    /***
+     * @brief Inserts finished chunks and issues new load and unload work, meant to be called once per frame
+     * @param observers world space positions chunks should be loaded around
+     */
+    void update(std::span<const glm::vec3> observers);
+
+    /// Chunks inserted into the map by the last update
+    [[nodiscard]] std::span<const glm::i32vec3> getLoaded() const noexcept { return loaded; }
+
+    /// Chunks removed from the map by the last update
+    [[nodiscard]] std::span<const glm::i32vec3> getUnloaded() const noexcept { return unloaded; }
+
+    /// Features placed by the last update in chunks that were already inserted into the map
+    [[nodiscard]] std::span<const FeatureSpill> getSpills() const noexcept;
+
+    /// Number of chunks requested from the generator that have not been inserted yet
+    [[nodiscard]] std::size_t pendingLoads() const noexcept { return requested.size(); }
+
+    /// Number of chunks in range that still need to be requested or unloaded
+    [[nodiscard]] std::size_t queuedWork() const noexcept { return loadQueue.size() + unloadQueue.size(); }
+
+    /***
+     * @brief Sets where modified chunks are saved and loaded from, nullptr to only keep chunks in memory
+     *
+     * Saved chunks are still generated, so the features they place in their neighbours are the same, and
+     * their saved voxels are read on the calling thread when they finish. Must outlive the streamer.
+     */
+    void setStorage(ChunkStorage* chunkStorage) noexcept { storage = chunkStorage; }
+
+    /// Records that a loaded chunk changed since it was generated or loaded, so it is saved when unloaded
+    void markModified(const glm::i32vec3 position) { modified.insert(position); }
+
+    /// Saves every loaded chunk that was modified, such as before the terrain is closed
+    void saveModified();
+
+    /// Returns true if the chunk is within the given extra distance of the load radius of any observer
+    [[nodiscard]] bool inRange(glm::i32vec3 position, std::int32_t extra = 0) const noexcept;
+
+    static glm::i32vec3 chunkPosition(glm::vec3 worldPosition) noexcept;
+
+    ChunkStreamer(const ChunkStreamer& other) = delete;
+    ChunkStreamer& operator=(const ChunkStreamer& other) = delete;
+
+private:
+    ChunkMap& chunks;
+    TerrainGenerator& generator;
+    ThreadPool& pool;
+    ChunkStorage* storage = nullptr;
+    ankerl::unordered_dense::set<glm::i32vec3, ChunkPositionHash> modified;
+    std::vector<glm::i32vec3> observerChunks;
+    /// Sorted with the closest chunk last
+    std::vector<glm::i32vec3> loadQueue;
+    std::vector<glm::i32vec3> unloadQueue;
+    ankerl::unordered_dense::set<glm::i32vec3, ChunkPositionHash> requested;
+    std::vector<GeneratedChunk> results;
+    std::vector<FeatureSpill> spills;
+    std::vector<glm::i32vec3> batch, loaded, unloaded;
+    std::vector<std::pair<glm::i32vec3, const Chunk*>> saves;
+
+    void rebuildQueues();
+    void insertFinished();
+    void unloadChunks();
+    void requestChunks();
+    /// Saves the modified chunks among positions to the storage, logging failures
+    void saveChunks(std::span<const glm::i32vec3> positions);
+};
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,88 @@
+#include "collision.h"
+#include "core/utility/thread_scratch.h"
+#include <bit>
+
+namespace dragonfire::voxel {
+
+static constexpr auto DIM = std::int32_t(Chunk::CHUNK_DIM);
+
+static bool isSolid(const Voxel voxel, const std::span<const std::uint8_t> solid) noexcept
+{
+    return voxel.id < solid.size() ? solid[voxel.id] != 0 : voxel.id != 0;
+}
+
+/// Copy of the voxels of the chunk being built
+struct CollisionScratch {
+    Voxel voxels[Chunk::CHUNK_SIZE];
+    /// Solid voxels of each column, indexed [x][y] with bit z set if the voxel is solid
+    std::uint32_t columns[DIM][DIM];
+};
+
+void buildCollisionBoxes(
+    const Chunk& chunk,
+    std::vector<CollisionBox>& out,
+    const std::span<const std::uint8_t> solid
+)
+{
+    out.clear();
+    if (chunk.isUniform()) {
+        if (isSolid(chunk.get(0), solid))
+            out.push_back({glm::u8vec3(0), glm::u8vec3(DIM)});
+        return;
+    }
+
+    if (chunk.isEmpty())
+        return;
+
+    CollisionScratch& scratch = threadScratch<CollisionScratch>();
+    auto& columns = scratch.columns;
+    if (solid.empty()) {
+        // Every non air voxel is solid, so the chunk's occupancy is already the column masks
+        for (std::int32_t x = 0; x < DIM; x++) {
+            for (std::int32_t y = 0; y < DIM; y++)
+                columns[x][y] = chunk.columnMask(x, y);
+        }
+    }
+    else {
+        chunk.unpack(std::span<Voxel, Chunk::CHUNK_SIZE>(scratch.voxels, Chunk::CHUNK_SIZE));
+        for (std::int32_t x = 0; x < DIM; x++) {
+            for (std::int32_t y = 0; y < DIM; y++) {
+                const Voxel* column = scratch.voxels + Chunk::linearIndex({x, y, 0});
+                std::uint32_t bits = 0;
+                for (std::int32_t z = 0; z < DIM; z++)
+                    bits |= std::uint32_t(isSolid(column[z], solid)) << z;
+                columns[x][y] = bits;
+            }
+        }
+    }
+
+    for (std::int32_t x = 0; x < DIM; x++) {
+        for (std::int32_t y = 0; y < DIM; y++) {
+            while (columns[x][y]) {
+                const std::int32_t z = std::countr_zero(columns[x][y]);
+                const std::int32_t height = std::countr_one(columns[x][y] >> z);
+                const auto run = std::uint32_t(((1ull << height) - 1) << z);
+
+                std::int32_t depth = 1;
+                while (y + depth < DIM && (columns[x][y + depth] & run) == run)
+                    depth++;
+                std::int32_t width = 1;
+                for (; x + width < DIM; width++) {
+                    bool filled = true;
+                    for (std::int32_t i = y; i < y + depth && filled; i++)
+                        filled = (columns[x + width][i] & run) == run;
+                    if (!filled)
+                        break;
+                }
+
+                for (std::int32_t i = x; i < x + width; i++) {
+                    for (std::int32_t j = y; j < y + depth; j++)
+                        columns[i][j] &= ~run;
+                }
+                out.push_back({glm::u8vec3(x, y, z), glm::u8vec3(width, depth, height)});
+            }
+        }
+    }
+}
+
+}// namespace dragonfire::voxel
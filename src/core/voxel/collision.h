@@ -0,0 +1,33 @@
+#pragma once
+#include "chunk.h"
+#include <glm/ext/vector_uint3_sized.hpp>
+#include <span>
+#include <vector>
+
+namespace dragonfire::voxel {
+
+/// An axis aligned box of solid voxels in chunk local coordinates
+struct CollisionBox {
+    glm::u8vec3 min;
+    /// Size of the box in voxels along each axis
+    glm::u8vec3 size;
+
+    bool operator==(const CollisionBox& other) const = default;
+};
+
+/***
+ * @brief Covers the solid voxels of a chunk with as few non overlapping boxes as the greedy merge finds
+ *
+ * Runs of solid voxels along z are merged first, then extended along y and finally along x, using one 32 bit
+ * mask per column of the chunk. A uniform solid chunk is a single box.
+ * @param out the boxes, any existing boxes are cleared
+ * @param solid whether each voxel id blocks movement, such as VoxelRegistry::solidity. Ids past the end are
+ * solid unless they are air.
+ */
+void buildCollisionBoxes(
+    const Chunk& chunk,
+    std::vector<CollisionBox>& out,
+    std::span<const std::uint8_t> solid = {}
+);
+
+}// namespace dragonfire::voxel
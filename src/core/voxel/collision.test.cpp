@@ -0,0 +1,129 @@
+#include "collision.h"
+#include "terrain.h"
+#include <catch.hpp>
+#include <random>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+
+static constexpr Voxel STONE{1, 0};
+static constexpr Voxel GRASS{2, 1};
+
+/// Checks the boxes cover every solid voxel exactly once and nothing else, returns the number of solid voxels
+static std::size_t checkCoverage(
+    const Chunk& chunk,
+    const std::vector<CollisionBox>& boxes,
+    const std::span<const std::uint8_t> solid = {}
+)
+{
+    std::vector<std::uint8_t> covered(Chunk::CHUNK_SIZE);
+    for (const CollisionBox& box : boxes) {
+        const glm::i32vec3 max = glm::i32vec3(box.min) + glm::i32vec3(box.size);
+        REQUIRE((max.x <= Chunk::CHUNK_DIM && max.y <= Chunk::CHUNK_DIM && max.z <= Chunk::CHUNK_DIM));
+        for (std::int32_t x = box.min.x; x < box.min.x + box.size.x; x++) {
+            for (std::int32_t y = box.min.y; y < box.min.y + box.size.y; y++) {
+                for (std::int32_t z = box.min.z; z < box.min.z + box.size.z; z++)
+                    covered[Chunk::linearIndex({x, y, z})]++;
+            }
+        }
+    }
+    std::size_t solidCount = 0;
+    for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++) {
+        const Voxel voxel = chunk.get(i);
+        const bool isSolid = voxel.id < solid.size() ? solid[voxel.id] != 0 : voxel.id != 0;
+        REQUIRE(covered[i] == std::uint8_t(isSolid));
+        solidCount += isSolid;
+    }
+    return solidCount;
+}
+
+TEST_CASE("Collision Boxes")
+{
+    std::vector<CollisionBox> boxes;
+
+    SECTION("Uniform chunks")
+    {
+        buildCollisionBoxes(Chunk(STONE), boxes);
+        REQUIRE(boxes.size() == 1);
+        CHECK(boxes[0] == CollisionBox{glm::u8vec3(0), glm::u8vec3(Chunk::CHUNK_DIM)});
+        buildCollisionBoxes(Chunk(), boxes);
+        CHECK(boxes.empty());
+    }
+
+    SECTION("Merges runs into boxes")
+    {
+        Chunk chunk;
+        for (std::int32_t x = 2; x < 6; x++) {
+            for (std::int32_t y = 3; y < 10; y++) {
+                for (std::int32_t z = 0; z < 4; z++)
+                    chunk.set({x, y, z}, STONE);
+            }
+        }
+        chunk.set({20, 20, 20}, STONE);
+        buildCollisionBoxes(chunk, boxes);
+        REQUIRE(boxes.size() == 2);
+        CHECK(boxes[0] == CollisionBox{{2, 3, 0}, {4, 7, 4}});
+        CHECK(boxes[1] == CollisionBox{{20, 20, 20}, {1, 1, 1}});
+    }
+
+    SECTION("Random voxels")
+    {
+        std::mt19937 rng(9);
+        std::uniform_int_distribution<std::int32_t> position(0, Chunk::CHUNK_DIM - 1), pick(0, 2);
+        Chunk chunk;
+        for (std::int32_t i = 0; i < 8000; i++)
+            chunk.set({position(rng), position(rng), position(rng)}, pick(rng) == 0 ? GRASS : STONE);
+        buildCollisionBoxes(chunk, boxes);
+        checkCoverage(chunk, boxes);
+
+        // Grass can be walked through
+        const std::vector<std::uint8_t> solid = {0, 1, 0};
+        buildCollisionBoxes(chunk, boxes, solid);
+        checkCoverage(chunk, boxes, solid);
+    }
+
+    SECTION("Generated terrain")
+    {
+        const TerrainGenerator generator(42);
+        std::size_t solidCount = 0, boxCount = 0;
+        for (std::int32_t z = -3; z < 0; z++) {
+            const Chunk chunk = generator.genChunk({0, 0, z});
+            buildCollisionBoxes(chunk, boxes);
+            solidCount += checkCoverage(chunk, boxes);
+            boxCount += boxes.size();
+        }
+        CHECK(boxCount * 20 < solidCount);
+    }
+}
+
+TEST_CASE("Collision Box Benchmark", "[.][benchmark]")
+{
+    const TerrainGenerator generator(42);
+    std::vector<Chunk> chunks;
+    for (std::int32_t x = -4; x < 4; x++) {
+        for (std::int32_t y = -4; y < 4; y++) {
+            for (std::int32_t z = -3; z < 0; z++)
+                chunks.push_back(generator.genChunk({x, y, z}));
+        }
+    }
+    std::vector<CollisionBox> boxes;
+    std::size_t boxCount = 0;
+    for (const Chunk& chunk : chunks) {
+        buildCollisionBoxes(chunk, boxes);
+        boxCount += boxes.size();
+    }
+    spdlog::info(
+        "{} chunks covered by {} boxes, {:.1f} per chunk",
+        chunks.size(),
+        boxCount,
+        double(boxCount) / double(chunks.size())
+    );
+
+    BENCHMARK("Build boxes for a surface chunk") { buildCollisionBoxes(chunks[1], boxes); };
+    BENCHMARK("Build boxes for every chunk")
+    {
+        for (const Chunk& chunk : chunks)
+            buildCollisionBoxes(chunk, boxes);
+    };
+}
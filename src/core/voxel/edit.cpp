@@ -0,0 +1,330 @@
+#include "core/utility/formatted_error.h"
+#include "core/utility/thread_scratch.h"
+#include "edit.h"
+#include <algorithm>
+#include <cstring>
+#include <glm/common.hpp>
+
+namespace dragonfire::voxel {
+
+static constexpr auto DIM = std::int32_t(Chunk::CHUNK_DIM);
+/// Edits touching more voxels of a chunk than this unpack it and write whole rows, instead of setting each
+/// voxel in the packed storage
+static constexpr std::size_t BULK_VOXELS = 2048;
+
+std::size_t EditJournal::voxelCount() const noexcept
+{
+    std::size_t count = 0;
+    for (const EditRun& run : runList)
+        count += run.length;
+    return count;
+}
+
+void EditJournal::clear() noexcept
+{
+    chunkList.clear();
+    runList.clear();
+}
+
+void EditJournal::append(const EditJournal& other)
+{
+    for (const JournalChunk& chunk : other.chunkList)
+        addChunk(chunk.position, other.runs(chunk));
+}
+
+void EditJournal::addChunk(const glm::i32vec3 position, const std::span<const EditRun> runs)
+{
+    if (runs.empty())
+        return;
+    chunkList.push_back({position, std::uint32_t(runList.size()), std::uint32_t(runs.size())});
+    runList.insert(runList.end(), runs.begin(), runs.end());
+}
+
+void EditJournal::addVoxel(const glm::i32vec3 position, const std::uint16_t index, const Voxel voxel)
+{
+    if (!chunkList.empty() && chunkList.back().position == position) {
+        EditRun& last = runList.back();
+        if (last.voxel == voxel && std::size_t(last.start) + last.length == index) {
+            last.length++;
+            return;
+        }
+        if (std::size_t(last.start) + last.length <= index) {
+            runList.push_back({index, 1, voxel});
+            chunkList.back().runCount++;
+            return;
+        }
+    }
+    const EditRun run{index, 1, voxel};
+    addChunk(position, std::span(&run, 1));
+}
+
+/// Layout of a serialized journal, followed by the run count of each chunk and then every run
+struct JournalHeader {
+    std::uint32_t chunkCount;
+    std::uint32_t runCount;
+};
+
+struct SerializedChunk {
+    glm::i32vec3 position;
+    std::uint32_t runCount;
+};
+
+void EditJournal::serialize(std::vector<std::uint8_t>& out) const
+{
+    const JournalHeader header{std::uint32_t(chunkList.size()), std::uint32_t(runList.size())};
+    const auto write = [&]<typename T>(const std::span<const T> data) {
+        const auto* bytes = reinterpret_cast<const std::uint8_t*>(data.data());
+        out.insert(out.end(), bytes, bytes + data.size_bytes());
+    };
+    write(std::span(&header, 1));
+    for (const JournalChunk& chunk : chunkList) {
+        const SerializedChunk serialized{chunk.position, chunk.runCount};
+        write(std::span(&serialized, 1));
+    }
+    write(std::span<const EditRun>(runList));
+}
+
+EditJournal EditJournal::deserialize(const std::span<const std::uint8_t> data)
+{
+    std::size_t offset = 0;
+    const auto read = [&]<typename T>(T* out, const std::size_t count) {
+        const std::size_t size = sizeof(T) * count;
+        if (data.size() - offset < size)
+            throw FormattedError("Serialized edit journal is truncated");
+        std::memcpy(out, data.data() + offset, size);
+        offset += size;
+    };
+
+    JournalHeader header{};
+    read(&header, 1);
+    // Checked before allocating so a corrupt count can't ask for more memory than the data could describe
+    const std::size_t remaining = data.size() - offset;
+    if (remaining / sizeof(SerializedChunk) < header.chunkCount
+        || remaining / sizeof(EditRun) < header.runCount)
+        throw FormattedError("Serialized edit journal is truncated");
+
+    EditJournal journal;
+    journal.chunkList.reserve(header.chunkCount);
+    std::uint32_t firstRun = 0;
+    for (std::uint32_t i = 0; i < header.chunkCount; i++) {
+        SerializedChunk chunk{};
+        read(&chunk, 1);
+        if (chunk.runCount == 0 || header.runCount - firstRun < chunk.runCount)
+            throw FormattedError("Serialized edit journal chunks use more than its {} runs", header.runCount);
+        journal.chunkList.push_back({chunk.position, firstRun, chunk.runCount});
+        firstRun += chunk.runCount;
+    }
+    if (firstRun != header.runCount)
+        throw FormattedError("Serialized edit journal has runs outside of its chunks");
+    journal.runList.resize(header.runCount);
+    read(journal.runList.data(), journal.runList.size());
+    if (offset != data.size())
+        throw FormattedError("Serialized edit journal has {} trailing bytes", data.size() - offset);
+
+    for (const JournalChunk& chunk : journal.chunkList) {
+        std::size_t end = 0;
+        for (const EditRun& run : journal.runs(chunk)) {
+            if (run.start < end || run.length == 0 || std::size_t(run.start) + run.length > Chunk::CHUNK_SIZE)
+                throw FormattedError("Serialized edit journal has an invalid run at {}", run.start);
+            end = std::size_t(run.start) + run.length;
+        }
+    }
+    return journal;
+}
+
+std::size_t EditJournal::memoryUsage() const noexcept
+{
+    return sizeof(EditJournal) + chunkList.capacity() * sizeof(JournalChunk)
+           + runList.capacity() * sizeof(EditRun);
+}
+
+void EditTransaction::fill(const glm::i32vec3 min, const glm::i32vec3 max, const Voxel voxel)
+{
+    operations.push_back({min, max, OperationType::FILL, false, voxel, {}, 0});
+}
+
+void EditTransaction::replace(
+    const glm::i32vec3 min,
+    const glm::i32vec3 max,
+    const Voxel from,
+    const Voxel to
+)
+{
+    operations.push_back({min, max, OperationType::REPLACE, false, to, from, 0});
+}
+
+void EditTransaction::paste(const glm::i32vec3 origin, VoxelRegion region, const bool skipAir)
+{
+    const glm::i32vec3 max = origin + region.size;
+    operations.push_back({origin, max, OperationType::PASTE, skipAir, {}, {}, std::uint32_t(regions.size())});
+    regions.push_back(std::move(region));
+}
+
+void EditTransaction::clear() noexcept
+{
+    operations.clear();
+    regions.clear();
+}
+
+/// Buffers used while applying edits to a chunk
+struct EditScratch {
+    Voxel before[Chunk::CHUNK_SIZE];
+    Voxel after[Chunk::CHUNK_SIZE];
+    std::vector<EditRun> runs;
+    std::vector<std::pair<std::uint16_t, Voxel>> changes;
+};
+
+void EditTransaction::applyChunk(
+    const glm::i32vec3 position,
+    const std::span<const std::uint32_t> indices,
+    Chunk& chunk,
+    EditJournal& journal
+) const
+{
+    const glm::i32vec3 origin = position * DIM;
+    // Calls func(x, y, first, last) for each z row of the part of the operation inside the chunk, covering
+    // the voxels from first to last
+    const auto forEachRow = [&](const Operation& op, auto&& func) {
+        const glm::i32vec3 min = glm::clamp(op.min - origin, 0, DIM);
+        const glm::i32vec3 max = glm::clamp(op.max - origin, 0, DIM);
+        for (std::int32_t x = min.x; x < max.x; x++) {
+            for (std::int32_t y = min.y; y < max.y; y++)
+                func(x, y, min.z, max.z);
+        }
+    };
+    const auto volume = [&](const Operation& op) {
+        const glm::i32vec3 min = glm::clamp(op.min - origin, 0, DIM);
+        const glm::i32vec3 size = glm::max(glm::clamp(op.max - origin, 0, DIM) - min, 0);
+        return std::size_t(size.x) * std::size_t(size.y) * std::size_t(size.z);
+    };
+
+    EditScratch& scratch = threadScratch<EditScratch>();
+    std::size_t total = 0;
+    for (const std::uint32_t index : indices)
+        total += volume(operations[index]);
+
+    // Small edits write straight into the packed chunk, remembering the last value of each changed voxel
+    if (total < BULK_VOXELS) {
+        scratch.changes.clear();
+        for (const std::uint32_t index : indices) {
+            const Operation& op = operations[index];
+            const VoxelRegion* region = op.type == OperationType::PASTE ? &regions[op.region] : nullptr;
+            forEachRow(op, [&](const int x, const int y, const int first, const int last) {
+                for (std::int32_t z = first; z < last; z++) {
+                    const glm::ivec3 local(x, y, z);
+                    const Voxel current = chunk[local];
+                    Voxel voxel = op.voxel;
+                    if (op.type == OperationType::REPLACE && current != op.from)
+                        continue;
+                    if (region != nullptr) {
+                        voxel = (*region)[origin + local - op.min];
+                        if (op.skipAir && voxel.id == 0)
+                            continue;
+                    }
+                    if (voxel == current)
+                        continue;
+                    chunk.set(local, voxel);
+                    scratch.changes.emplace_back(std::uint16_t(Chunk::linearIndex(local)), voxel);
+                }
+            });
+        }
+        std::ranges::stable_sort(scratch.changes, {}, &std::pair<std::uint16_t, Voxel>::first);
+        scratch.runs.clear();
+        for (std::size_t i = 0; i < scratch.changes.size(); i++) {
+            // Only the last write to each voxel is recorded
+            if (i + 1 < scratch.changes.size() && scratch.changes[i + 1].first == scratch.changes[i].first)
+                continue;
+            const auto [index, voxel] = scratch.changes[i];
+            EditRun* last = scratch.runs.empty() ? nullptr : &scratch.runs.back();
+            if (last != nullptr && last->voxel == voxel && last->start + last->length == index)
+                last->length++;
+            else
+                scratch.runs.push_back({index, 1, voxel});
+        }
+        journal.addChunk(position, scratch.runs);
+        return;
+    }
+
+    // Larger edits unpack the chunk and write whole rows
+    chunk.unpack(scratch.after);
+    std::ranges::copy(scratch.after, scratch.before);
+    for (const std::uint32_t index : indices) {
+        const Operation& op = operations[index];
+        const VoxelRegion* region = op.type == OperationType::PASTE ? &regions[op.region] : nullptr;
+        forEachRow(op, [&](const int x, const int y, const int first, const int last) {
+            Voxel* begin = scratch.after + Chunk::linearIndex({x, y, first});
+            Voxel* end = begin + (last - first);
+            switch (op.type) {
+                case OperationType::FILL: std::fill(begin, end, op.voxel); break;
+                case OperationType::REPLACE: std::replace(begin, end, op.from, op.voxel); break;
+                case OperationType::PASTE: {
+                    const Voxel* source = region->voxels.data()
+                                          + region->index(origin + glm::i32vec3(x, y, first) - op.min);
+                    if (!op.skipAir)
+                        std::copy(source, source + (end - begin), begin);
+                    else {
+                        for (Voxel* voxel = begin; voxel != end; voxel++, source++)
+                            *voxel = source->id == 0 ? *voxel : *source;
+                    }
+                    break;
+                }
+            }
+        });
+    }
+
+    // Compare four voxels at a time to skip unchanged parts quickly
+    DirtyLayers dirty;
+    scratch.runs.clear();
+    for (std::size_t word = 0; word < Chunk::CHUNK_SIZE; word += 4) {
+        if (std::memcmp(scratch.before + word, scratch.after + word, sizeof(Voxel) * 4) == 0)
+            continue;
+        for (std::size_t i = word; i < word + 4; i++) {
+            const Voxel voxel = scratch.after[i];
+            if (scratch.before[i] == voxel)
+                continue;
+            dirty.mark(Chunk::position(i));
+            EditRun* last = scratch.runs.empty() ? nullptr : &scratch.runs.back();
+            if (last != nullptr && last->voxel == voxel && last->start + last->length == i)
+                last->length++;
+            else
+                scratch.runs.push_back({std::uint16_t(i), 1, voxel});
+        }
+    }
+    if (scratch.runs.empty())
+        return;
+    dirty |= chunk.getDirty();
+    chunk = Chunk::pack(scratch.after);
+    chunk.markDirty(dirty);
+    journal.addChunk(position, scratch.runs);
+}
+
+void applyRuns(Chunk& chunk, const std::span<const EditRun> runs)
+{
+    std::size_t total = 0;
+    for (const EditRun& run : runs)
+        total += run.length;
+    if (runs.size() == 1 && total == Chunk::CHUNK_SIZE) {
+        chunk.fill(runs[0].voxel);
+        return;
+    }
+    if (total < BULK_VOXELS) {
+        for (const EditRun& run : runs) {
+            for (std::size_t i = run.start; i < std::size_t(run.start) + run.length; i++)
+                chunk.set(i, run.voxel);
+        }
+        return;
+    }
+
+    EditScratch& scratch = threadScratch<EditScratch>();
+    chunk.unpack(scratch.after);
+    DirtyLayers dirty = chunk.getDirty();
+    for (const EditRun& run : runs) {
+        std::fill_n(scratch.after + run.start, run.length, run.voxel);
+        for (std::size_t i = run.start; i < std::size_t(run.start) + run.length; i++)
+            dirty.mark(Chunk::position(i));
+    }
+    chunk = Chunk::pack(scratch.after);
+    chunk.markDirty(dirty);
+}
+
+}// namespace dragonfire::voxel
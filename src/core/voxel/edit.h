@@ -0,0 +1,160 @@
+#pragma once
+#include "chunk.h"
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <span>
+#include <vector>
+
+namespace dragonfire::voxel {
+
+/// Box of voxels copied out of the terrain, laid out the same way as Chunk::linearIndex
+struct VoxelRegion {
+    glm::i32vec3 size{};
+    std::vector<Voxel> voxels;
+
+    [[nodiscard]] std::size_t index(const glm::i32vec3 position) const noexcept
+    {
+        const std::size_t column = std::size_t(position.x) * std::size_t(size.y) + std::size_t(position.y);
+        return column * std::size_t(size.z) + std::size_t(position.z);
+    }
+
+    [[nodiscard]] Voxel operator[](const glm::i32vec3 position) const { return voxels[index(position)]; }
+};
+
+/// Voxels of a chunk from start to start + length, in the order of Chunk::linearIndex, all set to voxel
+struct EditRun {
+    std::uint16_t start;
+    std::uint16_t length;
+    Voxel voxel;
+
+    bool operator==(const EditRun& other) const = default;
+};
+
+/// Changes to a single chunk in a journal
+struct JournalChunk {
+    /// Position of the chunk in chunk coordinates
+    glm::i32vec3 position;
+    std::uint32_t firstRun;
+    std::uint32_t runCount;
+};
+
+/***
+ * @brief Compact record of the voxels changed by a set of edits, as runs of equal voxels per chunk
+ *
+ * Systems that react to edits, such as remeshing, lighting, physics, saving and replication, read the
+ * journal instead of hooking each voxel write. Filling a whole chunk is a single run. A chunk may appear more
+ * than once, later entries were applied after earlier ones.
+ */
+class EditJournal {
+public:
+    [[nodiscard]] std::span<const JournalChunk> chunks() const noexcept { return chunkList; }
+
+    [[nodiscard]] std::span<const EditRun> runs(const JournalChunk& chunk) const noexcept
+    {
+        return std::span(runList).subspan(chunk.firstRun, chunk.runCount);
+    }
+
+    /// Calls func with the world position and new value of every changed voxel, in the order applied
+    template<typename Func>
+    void forEachVoxel(Func&& func) const
+    {
+        constexpr auto dim = std::int32_t(Chunk::CHUNK_DIM);
+        for (const JournalChunk& chunk : chunkList) {
+            for (const EditRun& run : runs(chunk)) {
+                for (std::size_t i = run.start; i < std::size_t(run.start) + run.length; i++)
+                    func(chunk.position * dim + glm::i32vec3(Chunk::position(i)), run.voxel);
+            }
+        }
+    }
+
+    /// Number of voxels changed, counting a voxel changed twice twice
+    [[nodiscard]] std::size_t voxelCount() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept { return chunkList.empty(); }
+
+    void clear() noexcept;
+    /// Appends the changes of another journal after the changes of this one
+    void append(const EditJournal& other);
+    /// Appends the changes of a chunk, runs must be in increasing order and not overlap
+    void addChunk(glm::i32vec3 position, std::span<const EditRun> runs);
+    /// Records a change of a single voxel, extending the last run if the voxel directly follows it
+    void addVoxel(glm::i32vec3 position, std::uint16_t index, Voxel voxel);
+
+    /// Appends the journal to out, in the machine's byte order
+    void serialize(std::vector<std::uint8_t>& out) const;
+    /***
+     * @brief Rebuilds a journal written by serialize
+     * @throws FormattedError if data is not a valid serialized journal
+     */
+    static EditJournal deserialize(std::span<const std::uint8_t> data);
+
+    /// Approximate heap and inline memory used by this journal in bytes
+    [[nodiscard]] std::size_t memoryUsage() const noexcept;
+
+private:
+    std::vector<JournalChunk> chunkList;
+    std::vector<EditRun> runList;
+};
+
+/***
+ * @brief Bulk voxel edits collected to be applied together with Terrain::apply
+ *
+ * Operations are applied in the order they were added. Boxes are given by their min corner and the corner
+ * one past their max, in world voxel coordinates, and empty boxes are ignored.
+ */
+class EditTransaction {
+public:
+    void set(glm::i32vec3 position, Voxel voxel) { fill(position, position + 1, voxel); }
+
+    void fill(glm::i32vec3 min, glm::i32vec3 max, Voxel voxel);
+    /// Changes every voxel equal to from in the box to to
+    void replace(glm::i32vec3 min, glm::i32vec3 max, Voxel from, Voxel to);
+    /***
+     * @brief Writes a region copied with Terrain::copy with its min corner at origin
+     * @param skipAir leaves the voxels where the region is air unchanged
+     */
+    void paste(glm::i32vec3 origin, VoxelRegion region, bool skipAir = false);
+
+    [[nodiscard]] bool empty() const noexcept { return operations.empty(); }
+
+    [[nodiscard]] std::size_t size() const noexcept { return operations.size(); }
+
+    void clear() noexcept;
+
+private:
+    friend class Terrain;
+
+    enum class OperationType : std::uint8_t {
+        FILL,
+        REPLACE,
+        PASTE,
+    };
+
+    struct Operation {
+        glm::i32vec3 min, max;
+        OperationType type;
+        bool skipAir;
+        Voxel voxel, from;
+        /// Index of the pasted region in regions
+        std::uint32_t region;
+    };
+
+    std::vector<Operation> operations;
+    std::vector<VoxelRegion> regions;
+
+    /***
+     * @brief Applies operations to a chunk, recording the voxels that changed
+     * @param indices the operations touching the chunk, in the order they were added
+     */
+    void applyChunk(
+        glm::i32vec3 position,
+        std::span<const std::uint32_t> indices,
+        Chunk& chunk,
+        EditJournal& journal
+    ) const;
+};
+
+/// Writes the runs of a journal into a chunk, marking the changed layers dirty
+void applyRuns(Chunk& chunk, std::span<const EditRun> runs);
+
+}// namespace dragonfire::voxel
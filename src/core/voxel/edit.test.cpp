@@ -0,0 +1,223 @@
+#include "core/utility/formatted_error.h"
+#include "core/utility/thread_pool.h"
+#include "terrain.h"
+#include <catch.hpp>
+#include <chrono>
+#include <random>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+
+static constexpr Voxel STONE{1, 0};
+static constexpr Voxel DIRT{2, 0};
+static constexpr Voxel GLASS{4, 1};
+static constexpr Voxel WOOD{6, 0};
+
+/// Loads the generated chunks from min to max into the terrain
+static void loadChunks(Terrain& terrain, const glm::i32vec3 min, const glm::i32vec3 max)
+{
+    for (int x = min.x; x <= max.x; x++) {
+        for (int y = min.y; y <= max.y; y++) {
+            for (int z = min.z; z <= max.z; z++)
+                terrain.getChunks().insert({x, y, z}, terrain.getGenerator().genChunk({x, y, z}));
+        }
+    }
+}
+
+/// Whether both terrains have the same voxels in the box from min to one before max
+static bool sameVoxels(const Terrain& a, const Terrain& b, const glm::i32vec3 min, const glm::i32vec3 max)
+{
+    for (int x = min.x; x < max.x; x++) {
+        for (int y = min.y; y < max.y; y++) {
+            for (int z = min.z; z < max.z; z++) {
+                if (a.getVoxel({x, y, z}) != b.getVoxel({x, y, z}))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void fillEach(Terrain& terrain, const glm::i32vec3 min, const glm::i32vec3 max, const Voxel voxel)
+{
+    for (int x = min.x; x < max.x; x++) {
+        for (int y = min.y; y < max.y; y++) {
+            for (int z = min.z; z < max.z; z++)
+                terrain.setVoxel({x, y, z}, voxel);
+        }
+    }
+}
+
+TEST_CASE("Edit Transactions", "[voxel]")
+{
+    ThreadPool pool(1);
+    Terrain terrain(1, pool), reference(1, pool), original(1, pool);
+    const glm::i32vec3 low(-1, -1, -2), high(1, 1, 1);
+    loadChunks(terrain, low, high);
+    loadChunks(reference, low, high);
+    loadChunks(original, low, high);
+    const glm::i32vec3 worldMin = low * 32, worldMax = (high + 1) * 32;
+
+    SECTION("Operations match setting each voxel in order")
+    {
+        EditTransaction transaction;
+        transaction.fill({-40, -10, -20}, {20, 30, 10}, STONE);
+        transaction.set({0, 0, 0}, GLASS);
+        transaction.replace({-64, -64, -64}, {64, 64, 64}, STONE, DIRT);
+        transaction.set({5, 5, 5}, WOOD);
+        transaction.fill({3, 3, 3}, {2, 8, 8}, GLASS);
+        transaction.fill({60, 60, 60}, {100, 100, 100}, WOOD);
+        const EditJournal journal = terrain.apply(transaction);
+
+        fillEach(reference, {-40, -10, -20}, {20, 30, 10}, STONE);
+        reference.setVoxel({0, 0, 0}, GLASS);
+        for (int x = worldMin.x; x < worldMax.x; x++) {
+            for (int y = worldMin.y; y < worldMax.y; y++) {
+                for (int z = worldMin.z; z < worldMax.z; z++) {
+                    if (reference.getVoxel({x, y, z}) == STONE)
+                        reference.setVoxel({x, y, z}, DIRT);
+                }
+            }
+        }
+        reference.setVoxel({5, 5, 5}, WOOD);
+        fillEach(reference, {60, 60, 60}, {100, 100, 100}, WOOD);
+        REQUIRE(sameVoxels(terrain, reference, worldMin, worldMax));
+
+        // Each chunk is recorded once with the final value of every voxel that changed
+        std::size_t changed = 0;
+        for (int x = worldMin.x; x < worldMax.x; x++) {
+            for (int y = worldMin.y; y < worldMax.y; y++) {
+                for (int z = worldMin.z; z < worldMax.z; z++)
+                    changed += original.getVoxel({x, y, z}) != terrain.getVoxel({x, y, z});
+            }
+        }
+        CHECK(journal.voxelCount() == changed);
+        CHECK(terrain.getJournal().voxelCount() == changed);
+        bool recorded = true;
+        journal.forEachVoxel([&](const glm::i32vec3 position, const Voxel voxel) {
+            recorded &= terrain.getVoxel(position) == voxel && original.getVoxel(position) != voxel;
+        });
+        CHECK(recorded);
+        CHECK(terrain.getEdits().size() == reference.getEdits().size());
+        for (const auto& [position, priority] : reference.getEdits())
+            CHECK(terrain.getEdits().contains(position));
+        terrain.getChunks().forEach([&](const glm::i32vec3 position, const Chunk& chunk) {
+            CHECK(chunk.getDirty() == reference.getChunks().find(position)->getDirty());
+        });
+
+        SECTION("Replaying the journal reproduces the edits")
+        {
+            Terrain replica(1, pool);
+            loadChunks(replica, low, high);
+            std::vector<std::uint8_t> bytes;
+            journal.serialize(bytes);
+            replica.apply(EditJournal::deserialize(bytes));
+            CHECK(sameVoxels(replica, terrain, worldMin, worldMax));
+            CHECK(replica.getJournal().voxelCount() == journal.voxelCount());
+        }
+    }
+
+    SECTION("Filling a whole chunk is a single run")
+    {
+        EditTransaction transaction;
+        transaction.fill({0, 0, 0}, {32, 32, 32}, GLASS);
+        const EditJournal journal = terrain.apply(transaction);
+        REQUIRE(journal.chunks().size() == 1);
+        CHECK(journal.runs(journal.chunks()[0]).size() == 1);
+        CHECK(terrain.getChunks().find({0, 0, 0})->isUniform());
+        CHECK(terrain.getChunks().find({0, 0, 0})->getDirty().borders() == 0x3F);
+        CHECK(terrain.apply(transaction).empty());
+    }
+
+    SECTION("Copied regions paste back the same voxels")
+    {
+        const glm::i32vec3 min(-20, -5, -40), max(10, 20, 8);
+        const VoxelRegion region = terrain.copy(min, max);
+        REQUIRE(region.size == max - min);
+        CHECK(region[{0, 0, 0}] == terrain.getVoxel(min));
+        CHECK(region[{29, 24, 47}] == terrain.getVoxel(max - 1));
+
+        EditTransaction transaction;
+        const glm::i32vec3 offset(4, -7, 3);
+        transaction.paste(min + offset, region);
+        terrain.apply(transaction);
+        for (int x = min.x; x < max.x; x++) {
+            for (int y = min.y; y < max.y; y++) {
+                for (int z = min.z; z < max.z; z++) {
+                    const glm::i32vec3 position(x, y, z);
+                    REQUIRE(terrain.getVoxel(position + offset) == region[position - min]);
+                }
+            }
+        }
+
+        SECTION("Air is skipped when asked")
+        {
+            VoxelRegion sparse;
+            sparse.size = {2, 1, 1};
+            sparse.voxels = {Voxel{}, WOOD};
+            transaction.clear();
+            transaction.fill({0, 0, 0}, {2, 1, 1}, GLASS);
+            transaction.paste({0, 0, 0}, sparse, true);
+            terrain.apply(transaction);
+            CHECK(terrain.getVoxel({0, 0, 0}) == GLASS);
+            CHECK(terrain.getVoxel({1, 0, 0}) == WOOD);
+        }
+    }
+
+    SECTION("Corrupt journals are rejected")
+    {
+        EditTransaction transaction;
+        transaction.fill({0, 0, 0}, {8, 8, 8}, GLASS);
+        std::vector<std::uint8_t> bytes;
+        terrain.apply(transaction).serialize(bytes);
+        CHECK(EditJournal::deserialize(bytes).voxelCount() == 512);
+        std::vector truncated(bytes.begin(), bytes.end() - 1);
+        CHECK_THROWS_AS(EditJournal::deserialize(truncated), FormattedError);
+        bytes.push_back(0);
+        CHECK_THROWS_AS(EditJournal::deserialize(bytes), FormattedError);
+    }
+}
+
+TEST_CASE("Edit Transaction Benchmark", "[.][benchmark]")
+{
+    ThreadPool pool(1);
+    Terrain terrain(1, pool);
+    loadChunks(terrain, {-2, -2, -2}, {1, 1, 1});
+    const glm::i32vec3 min(-50, -50, -50), max(50, 50, 50);
+    const std::size_t voxels = 100 * 100 * 100;
+
+    std::mt19937 rng(3);
+    const auto timed = [&](auto&& func) {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    const double each = timed([&] { fillEach(terrain, min, max, (rng() & 1) ? STONE : GLASS); });
+    terrain.clearEdits();
+    EditJournal journal;
+    const double bulk = timed([&] {
+        EditTransaction transaction;
+        transaction.fill(min, max, DIRT);
+        transaction.replace(min, max, DIRT, WOOD);
+        journal = terrain.apply(transaction);
+    });
+    std::vector<std::uint8_t> bytes;
+    journal.serialize(bytes);
+    spdlog::info(
+        "{} voxel fill: setVoxel {:.1f}ms, transaction {:.1f}ms, journal of {} voxels in {} bytes",
+        voxels,
+        each,
+        bulk,
+        journal.voxelCount(),
+        bytes.size()
+    );
+
+    BENCHMARK("Fill and replace 100^3")
+    {
+        EditTransaction transaction;
+        transaction.fill(min, max, (rng() & 1) ? STONE : GLASS);
+        transaction.replace(min, max, STONE, DIRT);
+        return terrain.apply(transaction).voxelCount();
+    };
+}
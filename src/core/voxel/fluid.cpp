@@ -0,0 +1,255 @@
+#include "fluid.h"
+#include "core/utility/formatted_error.h"
+#include "core/utility/thread_pool.h"
+#include "terrain.h"
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+namespace dragonfire::voxel {
+
+static constexpr auto DIM = std::int32_t(Chunk::CHUNK_DIM);
+static constexpr glm::ivec3 UP(0, 0, 1);
+/// Read in place of voxels in chunks that are not loaded, fluid doesn't flow into them
+static constexpr Voxel UNLOADED{Voxel::MAX_VOXEL_COUNT - 1, 0};
+
+/// The chunks around a chunk being stepped, so voxels just past its borders can be read
+class Neighbourhood {
+public:
+    Neighbourhood(const ChunkMap& chunks, const glm::i32vec3 position)
+    {
+        for (std::int32_t x = -1; x <= 1; x++) {
+            for (std::int32_t y = -1; y <= 1; y++) {
+                for (std::int32_t z = -1; z <= 1; z++)
+                    neighbours[slot({x, y, z})] = chunks.find(position + glm::i32vec3(x, y, z));
+            }
+        }
+    }
+
+    [[nodiscard]] const Chunk* center() const noexcept { return neighbours[slot({0, 0, 0})]; }
+
+    /// Returns the voxel at a position relative to the center chunk, at most one chunk outside of it
+    [[nodiscard]] Voxel operator[](const glm::ivec3 local) const noexcept
+    {
+        // -1, 0 or 1 along each axis, for positions from -DIM to 2 * DIM - 1
+        const glm::ivec3 offset = (local + DIM) / DIM - 1;
+        const Chunk* chunk = neighbours[slot(offset)];
+        return chunk ? (*chunk)[local - offset * DIM] : UNLOADED;
+    }
+
+private:
+    std::array<const Chunk*, 27> neighbours{};
+
+    static std::size_t slot(const glm::ivec3 offset) noexcept
+    {
+        return std::size_t((offset.x + 1) * 9 + (offset.y + 1) * 3 + offset.z + 1);
+    }
+};
+
+/// Voxel of the type with a name in the registry
+static Voxel findVoxel(const VoxelRegistry& voxelTypes, const std::string_view name)
+{
+    const auto id = voxelTypes.find(name);
+    if (!id)
+        throw FormattedError("Voxel type \"{}\" used by the fluid simulation is not registered", name);
+    const Voxel voxel{std::uint16_t(*id), 0};
+    return Voxel{voxel.id, voxelTypes.isTransparent(voxel)};
+}
+
+FluidSimulation::FluidSimulation(
+    Terrain& terrain,
+    const VoxelRegistry& voxelTypes,
+    const FluidSettings& settings
+)
+    : terrain(terrain), settings(settings), solidified(findVoxel(voxelTypes, settings.solidified))
+{
+    for (std::size_t i = 0; i < fluidCount(); i++) {
+        const std::string& name = settings.fluids[i].name;
+        sources[i] = findVoxel(voxelTypes, name);
+        // The flowing levels are found by offsetting the id of the source, so they must follow it in order
+        for (std::uint8_t level = SOURCE_LEVEL - 1; level > 0; level--) {
+            const std::size_t id = sources[i].id + SOURCE_LEVEL - level;
+            const std::string expected = fmt::format("{}_{}", name, level);
+            if (id >= voxelTypes.size() || voxelTypes[Voxel{std::uint16_t(id), 0}].name != expected) {
+                throw FormattedError(
+                    "Fluid \"{}\" needs its flowing level \"{}\" registered right after it, as id {}",
+                    name,
+                    expected,
+                    id
+                );
+            }
+        }
+    }
+}
+
+std::size_t FluidSimulation::fluidIndex(const Voxel voxel) const noexcept
+{
+    for (std::size_t i = 0; i < fluidCount(); i++) {
+        const std::uint16_t first = sources[i].id;
+        if (voxel.id >= first && voxel.id < first + SOURCE_LEVEL)
+            return i;
+    }
+    return fluidCount();
+}
+
+std::uint8_t FluidSimulation::fluidLevel(const Voxel voxel) const noexcept
+{
+    const std::size_t fluid = fluidIndex(voxel);
+    if (fluid == fluidCount())
+        return 0;
+    return std::uint8_t(SOURCE_LEVEL - (voxel.id - sources[fluid].id));
+}
+
+Voxel FluidSimulation::fluidVoxel(const std::size_t fluid, const std::uint8_t level) const noexcept
+{
+    const Voxel source = sources[fluid];
+    return Voxel{std::uint16_t(source.id + SOURCE_LEVEL - level), source.transparent};
+}
+
+void FluidSimulation::voxelsChanged(const EditJournal& changes)
+{
+    changes.forEachVoxel([&](const glm::i32vec3 position, Voxel) { activate(position); });
+}
+
+void FluidSimulation::activate(const glm::i32vec3 position)
+{
+    const auto add = [&](const glm::i32vec3 world) {
+        const auto [chunk, local] = Chunk::splitPosition(world);
+        active[chunk].push_back(std::uint16_t(Chunk::linearIndex(local)));
+    };
+    add(position);
+    for (const glm::ivec3 direction : FACE_DIRECTIONS)
+        add(position + direction);
+}
+
+std::uint32_t FluidSimulation::update(const double deltaTime, ThreadPool& pool)
+{
+    accumulator += deltaTime * settings.tickRate;
+    std::uint32_t ticks = 0;
+    for (; accumulator >= 1.0 && ticks < settings.maxTicksPerUpdate; ticks++) {
+        tick(pool);
+        accumulator -= 1.0;
+    }
+    // Ticks that didn't fit are dropped, so the simulation slows down instead of falling further behind
+    accumulator = std::fmod(accumulator, 1.0);
+    return ticks;
+}
+
+EditJournal FluidSimulation::tick(ThreadPool& pool)
+{
+    std::uint32_t steppingMask = 0;
+    for (std::size_t i = 0; i < fluidCount(); i++) {
+        if (tickCount % std::max(settings.fluids[i].interval, 1u) == 0)
+            steppingMask |= 1u << i;
+    }
+
+    // The active cells are moved out so changes made during the tick activate cells for the next one
+    steps.resize(active.size());
+    std::size_t count = 0;
+    for (auto& [position, cells] : active) {
+        ChunkStep& chunkStep = steps[count++];
+        chunkStep.position = position;
+        chunkStep.cells.swap(cells);
+    }
+    active.clear();
+    // Sorted so the journal is the same no matter the order cells were activated in
+    std::sort(steps.begin(), steps.end(), [](const ChunkStep& a, const ChunkStep& b) {
+        return std::tie(a.position.x, a.position.y, a.position.z)
+               < std::tie(b.position.x, b.position.y, b.position.z);
+    });
+    parallelFor(pool, steps.size(), [&](const std::size_t i) { step(steps[i], steppingMask); });
+
+    EditJournal changes;
+    for (ChunkStep& chunkStep : steps) {
+        if (!chunkStep.runs.empty())
+            changes.addChunk(chunkStep.position, chunkStep.runs);
+        if (!chunkStep.waiting.empty()) {
+            std::vector<std::uint16_t>& cells = active[chunkStep.position];
+            cells.insert(cells.end(), chunkStep.waiting.begin(), chunkStep.waiting.end());
+        }
+    }
+    tickCount++;
+    if (!changes.empty()) {
+        terrain.apply(changes, RemeshPriority::VISIBLE);
+        voxelsChanged(changes);
+    }
+    return changes;
+}
+
+void FluidSimulation::step(ChunkStep& chunkStep, const std::uint32_t steppingMask) const
+{
+    chunkStep.runs.clear();
+    chunkStep.waiting.clear();
+    const Neighbourhood neighbourhood(terrain.getChunks(), chunkStep.position);
+    if (neighbourhood.center() == nullptr)
+        return;
+    std::vector<std::uint16_t>& cells = chunkStep.cells;
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+    for (const std::uint16_t index : cells) {
+        const glm::ivec3 local = Chunk::position(index);
+        const Voxel current = neighbourhood[local];
+        const std::size_t fluid = fluidIndex(current);
+        // Solid voxels and sources never change, everything else is rebuilt from the fluid flowing into it
+        if (current.id != 0 && (fluid == fluidCount() || fluidLevel(current) == SOURCE_LEVEL))
+            continue;
+
+        std::array<std::uint8_t, FluidSettings::FLUID_COUNT> levels{};
+        const std::size_t above = fluidIndex(neighbourhood[local + UP]);
+        if (above < fluidCount())
+            levels[above] = SOURCE_LEVEL - 1;
+        for (std::size_t face = 0; face < 4; face++) {
+            const glm::ivec3 side = local + FACE_DIRECTIONS[face];
+            const Voxel voxel = neighbourhood[side];
+            const std::size_t sideFluid = fluidIndex(voxel);
+            if (sideFluid == fluidCount())
+                continue;
+            const std::uint8_t level = fluidLevel(voxel), decay = settings.fluids[sideFluid].decay;
+            // Fluid only spreads sideways once it can't fall any further
+            const Voxel below = neighbourhood[side - UP];
+            const bool falls = below.id == 0 || (isFluid(below) && fluidLevel(below) < SOURCE_LEVEL);
+            if (level <= decay || falls)
+                continue;
+            levels[sideFluid] = std::max(levels[sideFluid], std::uint8_t(level - decay));
+        }
+
+        std::uint32_t involved = fluid < fluidCount() ? 1u << fluid : 0;
+        std::size_t strongest = fluidCount(), flowing = 0;
+        for (std::size_t i = 0; i < fluidCount(); i++) {
+            if (levels[i] == 0)
+                continue;
+            involved |= 1u << i;
+            flowing++;
+            if (strongest == fluidCount() || levels[i] > levels[strongest])
+                strongest = i;
+        }
+        if ((involved & steppingMask) != involved) {
+            chunkStep.waiting.push_back(index);
+            continue;
+        }
+
+        Voxel next{};
+        if (flowing > 1)
+            next = solidified;
+        else if (flowing == 1)
+            next = fluidVoxel(strongest, levels[strongest]);
+        if (next == current)
+            continue;
+        std::vector<EditRun>& runs = chunkStep.runs;
+        if (!runs.empty() && runs.back().voxel == next && runs.back().start + runs.back().length == index)
+            runs.back().length++;
+        else
+            runs.push_back({index, 1, next});
+    }
+}
+
+std::size_t FluidSimulation::activeCount() const noexcept
+{
+    std::size_t count = 0;
+    for (const auto& [position, cells] : active)
+        count += cells.size();
+    return count;
+}
+
+}// namespace dragonfire::voxel
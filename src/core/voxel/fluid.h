@@ -0,0 +1,136 @@
+#pragma once
+#include "chunk_map.h"
+#include "edit.h"
+#include "voxel.h"
+#include <ankerl/unordered_dense.h>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace dragonfire {
+class ThreadPool;
+}
+
+namespace dragonfire::voxel {
+class Terrain;
+
+/// A fluid such as water or lava. Each fluid takes eight consecutive voxel ids, the source followed by its
+/// flowing levels from 7 down to 1.
+struct FluidType {
+    /// Name of the source voxel type, registered right before its flowing levels named <name>_7 to <name>_1
+    std::string name;
+    /// Levels lost for each voxel the fluid flows sideways
+    std::uint8_t decay = 1;
+    /// Ticks between steps of the fluid, so lava can flow slower than water
+    std::uint32_t interval = 1;
+};
+
+struct FluidSettings {
+    static constexpr std::size_t FLUID_COUNT = 2;
+    std::array<FluidType, FLUID_COUNT> fluids{
+        FluidType{.name = "water"},
+        FluidType{.name = "lava", .decay = 2, .interval = 3},
+    };
+    /// Name of the voxel type left where two different fluids flow into the same voxel
+    std::string solidified = "stone";
+    /// Ticks per second run by FluidSimulation::update
+    double tickRate = 20.0;
+    /// Most ticks run by a single update, so a slow frame doesn't stall the following ones
+    std::uint32_t maxTicksPerUpdate = 4;
+};
+
+/***
+ * @brief Cellular automaton flowing fluids through the terrain
+ *
+ * Only the active cells of each chunk are simulated, the voxels around recent changes, so a tick costs time
+ * in proportion to the fluid that is moving rather than the size of the terrain. Each tick reads the voxels
+ * as they were when it started and collects the new voxels separately, so chunks are stepped in parallel and
+ * the result is the same on every machine. Changes are applied with Terrain::apply like any other edit, so
+ * remeshing, lighting and physics pick them up from the terrain journal.
+ */
+class FluidSimulation {
+public:
+    /***
+     * @param voxelTypes registry the voxels of the fluids and the solidified voxel are looked up in by name
+     * @throws FormattedError if a voxel type isn't registered, or a fluid isn't followed by its seven
+     * flowing levels
+     */
+    FluidSimulation(Terrain& terrain, const VoxelRegistry& voxelTypes, const FluidSettings& settings = {});
+
+    /***
+     * @brief Activates the voxels around every change in a journal
+     *
+     * Call with the edits made outside the simulation, such as Terrain::getJournal before update in a
+     * frame, so fluid starts flowing when a voxel next to it is removed. Ticks activate the voxels around
+     * their own changes.
+     */
+    void voxelsChanged(const EditJournal& changes);
+    /// Activates a single voxel and its neighbours, such as a fluid placed by world generation
+    void activate(glm::i32vec3 position);
+
+    /***
+     * @brief Runs the ticks due after deltaTime seconds at the tick rate, up to maxTicksPerUpdate
+     *
+     * Must not be called from a worker of the pool.
+     * @return the number of ticks run
+     */
+    std::uint32_t update(double deltaTime, ThreadPool& pool);
+    /***
+     * @brief Steps every active voxel once on the pool, blocking until the step is applied to the terrain
+     *
+     * Must not be called from a worker of the pool.
+     * @return the voxels changed by the tick
+     */
+    EditJournal tick(ThreadPool& pool);
+
+    [[nodiscard]] bool isFluid(Voxel voxel) const noexcept { return fluidIndex(voxel) < fluidCount(); }
+
+    /// Returns 8 for a source, 1 to 7 for flowing fluid and 0 for any other voxel
+    [[nodiscard]] std::uint8_t fluidLevel(Voxel voxel) const noexcept;
+    /// Returns the voxel of a fluid at a level from 1 to 8
+    [[nodiscard]] Voxel fluidVoxel(std::size_t fluid, std::uint8_t level) const noexcept;
+
+    /// Number of voxels to be stepped by the next tick
+    [[nodiscard]] std::size_t activeCount() const noexcept;
+
+    /// Number of chunks with active voxels
+    [[nodiscard]] std::size_t activeChunkCount() const noexcept { return active.size(); }
+
+    [[nodiscard]] std::uint64_t getTickCount() const noexcept { return tickCount; }
+
+    FluidSimulation(const FluidSimulation& other) = delete;
+    FluidSimulation& operator=(const FluidSimulation& other) = delete;
+
+private:
+    static constexpr std::uint8_t SOURCE_LEVEL = 8;
+
+    /// Work of a chunk during a tick, only touched by the worker stepping the chunk
+    struct ChunkStep {
+        glm::i32vec3 position;
+        std::vector<std::uint16_t> cells;
+        /// Changed voxels in increasing index order
+        std::vector<EditRun> runs;
+        /// Cells waiting for a fluid that doesn't step this tick
+        std::vector<std::uint16_t> waiting;
+    };
+
+    Terrain& terrain;
+    const FluidSettings settings;
+    /// Source voxel of each fluid, found in the registry by name
+    std::array<Voxel, FluidSettings::FLUID_COUNT> sources;
+    Voxel solidified;
+    ankerl::unordered_dense::map<glm::i32vec3, std::vector<std::uint16_t>, ChunkPositionHash> active;
+    std::vector<ChunkStep> steps;
+    std::uint64_t tickCount = 0;
+    double accumulator = 0.0;
+
+    [[nodiscard]] static constexpr std::size_t fluidCount() noexcept { return FluidSettings::FLUID_COUNT; }
+
+    /// Index of the fluid in settings, or fluidCount() if the voxel isn't a fluid
+    [[nodiscard]] std::size_t fluidIndex(Voxel voxel) const noexcept;
+    void step(ChunkStep& chunkStep, std::uint32_t steppingMask) const;
+};
+
+}// namespace dragonfire::voxel
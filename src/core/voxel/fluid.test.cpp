@@ -0,0 +1,214 @@
+#include "core/utility/formatted_error.h"
+#include "core/utility/thread_pool.h"
+#include "fluid.h"
+#include "terrain.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <catch.hpp>
+#include <chrono>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+using namespace dragonfire::voxel::test;
+
+static constexpr Voxel STONE{1, 0};
+
+/// Places a voxel the way a player would, activating the simulation around it
+static void place(Terrain& terrain, FluidSimulation& fluids, const glm::i32vec3 position, const Voxel voxel)
+{
+    terrain.setVoxel(position, voxel);
+    fluids.voxelsChanged(terrain.getJournal());
+    terrain.clearEdits();
+}
+
+/// Ticks until no voxel is active, returns the number of ticks
+static int settle(FluidSimulation& fluids, ThreadPool& pool)
+{
+    int ticks = 0;
+    while (fluids.activeCount() > 0 && ticks < 1000) {
+        fluids.tick(pool);
+        ticks++;
+    }
+    return ticks;
+}
+
+TEST_CASE("Fluid Simulation", "[voxel]")
+{
+    ThreadPool pool(2);
+    Terrain terrain(1, pool);
+    loadFlatChunks(terrain, {-1, -1, 0}, {1, 1, 1}, STONE);
+    FluidSimulation fluids(terrain, voxelTypes());
+    const Voxel water = fluids.fluidVoxel(0, 8), lava = fluids.fluidVoxel(1, 8);
+    const auto level = [&](const glm::i32vec3 position) {
+        return fluids.fluidLevel(*terrain.getVoxel(position));
+    };
+
+    SECTION("Water spreads over the floor, losing a level per voxel")
+    {
+        place(terrain, fluids, {0, 0, 1}, water);
+        CHECK(settle(fluids, pool) < 20);
+        for (std::int32_t x = -8; x <= 8; x++)
+            CHECK(level({x, 0, 1}) == std::max(8 - std::abs(x), 0));
+        CHECK(level({3, -2, 1}) == 3);
+        CHECK(level({0, 0, 2}) == 0);
+        CHECK(*terrain.getVoxel({0, 0, 0}) == STONE);
+        CHECK(fluids.activeChunkCount() == 0);
+
+        SECTION("Removing the source drains the flow")
+        {
+            place(terrain, fluids, {0, 0, 1}, Voxel{});
+            settle(fluids, pool);
+            for (std::int32_t x = -8; x <= 8; x++)
+                CHECK(level({x, 0, 1}) == 0);
+        }
+
+        SECTION("Walls stop the flow")
+        {
+            EditTransaction wall;
+            wall.fill({2, -10, 1}, {3, 11, 2}, STONE);
+            terrain.apply(wall);
+            fluids.voxelsChanged(terrain.getJournal());
+            terrain.clearEdits();
+            settle(fluids, pool);
+            CHECK(level({1, 0, 1}) == 7);
+            CHECK(level({3, 0, 1}) == 0);
+            CHECK(level({4, 0, 1}) == 0);
+        }
+    }
+
+    SECTION("Water falls before spreading")
+    {
+        place(terrain, fluids, {0, 0, 10}, water);
+        settle(fluids, pool);
+        for (std::int32_t z = 1; z < 10; z++)
+            CHECK(level({0, 0, z}) == 7);
+        CHECK(level({1, 0, 5}) == 0);
+        CHECK(level({1, 0, 1}) == 6);
+        CHECK(level({6, 0, 1}) == 1);
+        CHECK(level({7, 0, 1}) == 0);
+    }
+
+    SECTION("Lava flows slower and not as far")
+    {
+        place(terrain, fluids, {0, 0, 1}, lava);
+        fluids.tick(pool);
+        CHECK(level({1, 0, 1}) == 6);
+        fluids.tick(pool);
+        CHECK(level({2, 0, 1}) == 0);
+        settle(fluids, pool);
+        CHECK(level({2, 0, 1}) == 4);
+        CHECK(level({3, 0, 1}) == 2);
+        CHECK(level({4, 0, 1}) == 0);
+        CHECK(fluids.isFluid(*terrain.getVoxel({3, 0, 1})));
+        CHECK_FALSE(terrain.getVoxel({3, 0, 1})->transparent);
+    }
+
+    SECTION("Water and lava meeting turn to stone")
+    {
+        place(terrain, fluids, {-2, 0, 1}, water);
+        place(terrain, fluids, {2, 0, 1}, lava);
+        settle(fluids, pool);
+        CHECK(*terrain.getVoxel({0, 0, 1}) == STONE);
+        CHECK(level({-1, 0, 1}) == 7);
+        CHECK(level({1, 0, 1}) == 6);
+    }
+
+    SECTION("Changes go through the terrain journal")
+    {
+        place(terrain, fluids, {31, 31, 1}, water);
+        const EditJournal changes = fluids.tick(pool);
+        CHECK(changes.voxelCount() == 4);
+        CHECK(terrain.getJournal().voxelCount() == 4);
+        CHECK(terrain.getEdits().contains({1, 0, 0}));
+        CHECK(terrain.getEdits().contains({0, 1, 0}));
+    }
+}
+
+TEST_CASE("Fluid Simulation Is Deterministic", "[voxel]")
+{
+    // The same flow on different thread counts, with the chunks activated in a different order
+    const auto run = [](const std::uint32_t threads, const bool reversed) {
+        ThreadPool pool(threads);
+        Terrain terrain(1, pool);
+        loadFlatChunks(terrain, {-1, -1, 0}, {1, 1, 1}, STONE);
+        FluidSimulation fluids(terrain, voxelTypes());
+        std::vector<glm::i32vec3> sources{{-5, 30, 1}, {31, 31, 12}, {40, -3, 1}, {10, 10, 1}};
+        if (reversed)
+            std::reverse(sources.begin(), sources.end());
+        for (const glm::i32vec3 source : sources)
+            place(terrain, fluids, source, fluids.fluidVoxel(source.x == 10 ? 1 : 0, 8));
+        EditJournal all;
+        for (int i = 0; i < 12; i++)
+            all.append(fluids.tick(pool));
+        std::vector<std::uint8_t> serialized;
+        all.serialize(serialized);
+        return serialized;
+    };
+    const auto expected = run(1, false);
+    CHECK(expected.size() > 1000);
+    CHECK(run(3, true) == expected);
+}
+
+TEST_CASE("Fluid Simulation Voxel Types", "[voxel]")
+{
+    ThreadPool pool(1);
+    Terrain terrain(1, pool);
+
+    SECTION("Fluids are found by name")
+    {
+        const VoxelRegistry types = voxelTypes();
+        FluidSimulation fluids(terrain, types);
+        CHECK(fluids.fluidVoxel(0, 8).id == types.getId("water"));
+        CHECK(fluids.fluidVoxel(0, 8).transparent == 1);
+        CHECK(fluids.fluidVoxel(1, 1).id == types.getId("lava_1"));
+        CHECK(fluids.fluidLevel(Voxel{std::uint16_t(types.getId("water_3")), 0}) == 3);
+    }
+
+    SECTION("Missing voxel types are reported")
+    {
+        VoxelRegistry types;
+        types.loadJsonString(R"([{"name": "air"}, {"name": "stone"}, {"name": "water"},
+            {"name": "water_7"}])");
+        CHECK_THROWS_AS(FluidSimulation(terrain, types), FormattedError);
+        FluidSettings settings;
+        settings.solidified = "obsidian";
+        CHECK_THROWS_AS(FluidSimulation(terrain, voxelTypes(), settings), FormattedError);
+    }
+}
+
+TEST_CASE("Fluid Simulation Benchmark", "[.][benchmark]")
+{
+    ThreadPool pool;
+    Terrain terrain(1, pool);
+    loadFlatChunks(terrain, {-4, -4, 0}, {3, 3, 0}, STONE);
+    FluidSimulation fluids(terrain, voxelTypes());
+    // Sources on a grid, flowing until the whole floor is covered
+    for (std::int32_t x = -120; x < 128; x += 16) {
+        for (std::int32_t y = -120; y < 128; y += 16)
+            place(terrain, fluids, {x, y, 1}, fluids.fluidVoxel(0, 8));
+    }
+    std::size_t cells = 0;
+    int ticks = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (fluids.activeCount() > 0) {
+        cells += fluids.activeCount();
+        fluids.tick(pool);
+        terrain.clearEdits();
+        ticks++;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+    spdlog::info(
+        "Flooded {} chunks in {} ticks, {:.2f}ms per tick, {:.1f}M active cells/s",
+        terrain.getChunks().size(),
+        ticks,
+        ms / ticks,
+        double(cells) / ms / 1000.0
+    );
+
+    BENCHMARK("Tick with no active cells")
+    {
+        return fluids.tick(pool).voxelCount();
+    };
+}
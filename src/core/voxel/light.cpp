@@ -0,0 +1,484 @@
+#include "core/utility/thread_pool.h"
+#include "core/utility/thread_scratch.h"
+#include "light.h"
+#include <algorithm>
+#include <cassert>
+
+namespace dragonfire::voxel {
+
+static constexpr auto DIM = std::int32_t(Chunk::CHUNK_DIM);
+static constexpr std::uint8_t MAX_LEVEL = ChunkLight::MAX_LEVEL;
+static constexpr std::uint8_t FACE_DOWN = 4, FACE_UP = 5;
+
+// Flags of a queued update
+/// The update is to sky light rather than block light
+static constexpr std::uint8_t SKY_CHANNEL = 1;
+/// Crossed into the chunk from a neighbour. Incoming removals check the voxel they arrive at, and incoming
+/// additions only apply if they brighten it.
+static constexpr std::uint8_t INCOMING = 2;
+/// An incoming removal from the voxel directly above
+static constexpr std::uint8_t FROM_ABOVE = 4;
+/// An emitting voxel, which is lit even if it is opaque
+static constexpr std::uint8_t SOURCE = 8;
+
+static bool isOpaque(const Voxel voxel) noexcept
+{
+    return voxel.id != 0 && !voxel.transparent;
+}
+
+static std::uint8_t levelOf(const std::uint8_t value, const bool sky) noexcept
+{
+    return sky ? value >> 4 : value & MAX_LEVEL;
+}
+
+static std::uint8_t withLevel(const std::uint8_t value, const bool sky, const std::uint8_t level) noexcept
+{
+    return sky ? std::uint8_t((value & MAX_LEVEL) | level << 4) : std::uint8_t((value & 0xF0) | level);
+}
+
+/// Level of light after moving one voxel through a face, full sky light travels down without fading
+static std::uint8_t spread(const std::uint8_t level, const bool sky, const std::size_t face) noexcept
+{
+    if (sky && face == FACE_DOWN && level == MAX_LEVEL)
+        return level;
+    return level == 0 ? 0 : level - 1;
+}
+
+/// Index of the voxel touching a face in the layer of the chunk on the other side of it
+static std::uint16_t wrappedIndex(const glm::ivec3 position) noexcept
+{
+    constexpr std::int32_t mask = DIM - 1;
+    return std::uint16_t(Chunk::linearIndex({position.x & mask, position.y & mask, position.z & mask}));
+}
+
+/// Calls func(index) for the voxel at each (u, v) in a layer of a chunk along the face's axis
+template<typename Func>
+static void forEachInLayer(const std::size_t face, const std::int32_t layer, Func&& func)
+{
+    const std::int32_t axis = std::int32_t(face / 2);
+    for (std::int32_t u = 0; u < DIM; u++) {
+        for (std::int32_t v = 0; v < DIM; v++) {
+            glm::ivec3 position;
+            position[axis] = layer;
+            position[(axis + 1) % 3] = u;
+            position[(axis + 2) % 3] = v;
+            func(std::uint16_t(Chunk::linearIndex(position)));
+        }
+    }
+}
+
+void ChunkLight::set(const std::size_t index, const std::uint8_t value)
+{
+    if (data.empty()) {
+        if (value == uniform)
+            return;
+        data.assign(Chunk::CHUNK_SIZE, uniform);
+    }
+    data[index] = value;
+}
+
+void ChunkLight::fill(const std::uint8_t value)
+{
+    SlabVector<std::uint8_t>().swap(data);
+    uniform = value;
+}
+
+void ChunkLight::compact()
+{
+    if (data.empty())
+        return;
+    if (std::ranges::all_of(data, [&](const std::uint8_t value) { return value == data[0]; }))
+        fill(data[0]);
+}
+
+void ChunkLight::unpack(const std::span<std::uint8_t, Chunk::CHUNK_SIZE> out) const
+{
+    if (data.empty())
+        std::ranges::fill(out, uniform);
+    else
+        std::ranges::copy(data, out.begin());
+}
+
+LightEngine::LightEngine(const ChunkMap& chunks, std::vector<std::uint8_t> emission)
+    : chunks(chunks), emission(std::move(emission))
+{
+    for (std::uint8_t& level : this->emission)
+        level = std::min(level, MAX_LEVEL);
+}
+
+void LightEngine::addChunk(const glm::i32vec3 position)
+{
+    baking.insert(position);
+    work.erase(position);
+}
+
+void LightEngine::removeChunk(const glm::i32vec3 position)
+{
+    lights.erase(position);
+    work.erase(position);
+    baking.erase(position);
+    changed.erase(position);
+}
+
+void LightEngine::voxelChanged(const glm::i32vec3 position)
+{
+    const auto [chunkPos, local] = Chunk::splitPosition(position);
+    const auto found = lights.find(chunkPos);
+    const Chunk* chunk = chunks.find(chunkPos);
+    if (found == lights.end() || chunk == nullptr || baking.contains(chunkPos))
+        return;
+
+    // Darken the voxel, removal then clears the light that passed through it and relights it from its
+    // neighbours if it lets light through
+    const auto index = std::uint16_t(Chunk::linearIndex(local));
+    const std::uint8_t value = found->second.get(index);
+    found->second.set(index, 0);
+    ChunkWork& chunkWork = work[chunkPos];
+    chunkWork.dirty.mark(local);
+    chunkWork.removals.push_back({index, std::uint8_t(value >> 4), SKY_CHANNEL});
+    chunkWork.removals.push_back({index, std::uint8_t(value & MAX_LEVEL), 0});
+    if (const std::uint8_t level = emitted((*chunk)[local]))
+        chunkWork.additions.push_back({index, level, SOURCE});
+}
+
+void LightEngine::voxelsChanged(const EditJournal& changes)
+{
+    changes.forEachVoxel([&](const glm::i32vec3 position, Voxel) { voxelChanged(position); });
+}
+
+void LightEngine::update(ThreadPool& pool)
+{
+    if (!baking.empty()) {
+        // Every map insertion happens before the workers start, so the references they hold stay valid
+        std::vector<std::pair<ChunkLight*, ChunkWork*>> targets;
+        std::vector<glm::i32vec3> positions(baking.begin(), baking.end());
+        for (const glm::i32vec3 position : positions) {
+            lights[position];
+            work[position];
+        }
+        for (const glm::i32vec3 position : positions)
+            targets.emplace_back(&lights.find(position)->second, &work.find(position)->second);
+        parallelFor(pool, positions.size(), [&](const std::size_t i) {
+            bake(positions[i], *targets[i].first, *targets[i].second);
+        });
+
+        // Chunks below a new chunk were lit as if open to the sky, so remove the sky light from their top
+        for (const glm::i32vec3 position : positions) {
+            const glm::i32vec3 below = position - glm::i32vec3(0, 0, 1);
+            const auto found = lights.find(below);
+            if (found == lights.end() || baking.contains(below))
+                continue;
+            ChunkWork& belowWork = work[below];
+            forEachInLayer(FACE_DOWN, DIM - 1, [&](const std::uint16_t index) {
+                const std::uint8_t value = found->second.get(index);
+                if (value >> 4 != MAX_LEVEL)
+                    return;
+                found->second.set(index, withLevel(value, true, 0));
+                belowWork.dirty.mark(Chunk::position(index));
+                belowWork.removals.push_back({index, MAX_LEVEL, SKY_CHANNEL});
+            });
+        }
+        baking.clear();
+    }
+
+    runRounds(pool, true);
+    runRounds(pool, false);
+
+    for (auto& [position, chunkWork] : work) {
+        const auto found = lights.find(position);
+        if (found == lights.end())
+            continue;
+        found->second.compact();
+        changed[position] |= chunkWork.dirty;
+        const std::uint8_t borders = chunkWork.dirty.borders();
+        for (std::uint8_t face = 0; face < 6; face++) {
+            const glm::i32vec3 neighbour = position + FACE_DIRECTIONS[face];
+            if (borders >> face & 1 && lights.contains(neighbour))
+                changed[neighbour].markNeighbour(face ^ 1);
+        }
+    }
+    work.clear();
+}
+
+const ChunkLight* LightEngine::find(const glm::i32vec3 position) const noexcept
+{
+    const auto found = lights.find(position);
+    return found == lights.end() ? nullptr : &found->second;
+}
+
+std::array<const ChunkLight*, 6> LightEngine::neighbours(const glm::i32vec3 position) const noexcept
+{
+    std::array<const ChunkLight*, 6> out{};
+    for (std::size_t face = 0; face < FACE_DIRECTIONS.size(); face++)
+        out[face] = find(position + FACE_DIRECTIONS[face]);
+    return out;
+}
+
+std::uint8_t LightEngine::getLight(const glm::i32vec3 position) const noexcept
+{
+    const auto [chunkPos, local] = Chunk::splitPosition(position);
+    const ChunkLight* light = find(chunkPos);
+    return light ? light->get(Chunk::linearIndex(local)) : 0;
+}
+
+std::size_t LightEngine::memoryUsage() const noexcept
+{
+    std::size_t usage = sizeof(LightEngine);
+    for (const auto& [position, light] : lights)
+        usage += sizeof(position) + light.memoryUsage();
+    return usage;
+}
+
+/// Copy of the voxels of the chunk being lit
+struct LightScratch {
+    Voxel voxels[Chunk::CHUNK_SIZE];
+};
+
+/***
+ * @brief Lights a new chunk and queues the light it spreads
+ *
+ * Sky light fills each column down from the top if the chunk is open to the sky, and emitting voxels are
+ * queued as sources. Light from neighbours that are already lit is queued as if it crossed the border.
+ */
+void LightEngine::bake(const glm::i32vec3 position, ChunkLight& light, ChunkWork& chunkWork) const
+{
+    const Chunk* chunk = chunks.find(position);
+    assert(chunk != nullptr);
+    light.fill(0);
+    chunkWork.dirty = DirtyLayers::all();
+    const bool openSky = chunks.find(position + FACE_DIRECTIONS[FACE_UP]) == nullptr;
+
+    if (chunk->isUniform()) {
+        const Voxel voxel = chunk->get(0);
+        const std::uint8_t level = emitted(voxel);
+        const bool sky = openSky && !isOpaque(voxel);
+        light.fill(std::uint8_t((sky ? MAX_LEVEL << 4 : 0) | level));
+        // Every voxel is lit the same, so only the voxels on the borders can spread light anywhere
+        for (std::size_t face = 0; face < 6; face++) {
+            forEachInLayer(face, face & 1 ? DIM - 1 : 0, [&](const std::uint16_t index) {
+                if (sky && face != FACE_UP)
+                    chunkWork.additions.push_back({index, MAX_LEVEL, SKY_CHANNEL});
+                if (level > 0)
+                    chunkWork.additions.push_back({index, level, SOURCE});
+            });
+        }
+        if (isOpaque(voxel))
+            return;
+    }
+    else {
+        LightScratch& scratch = threadScratch<LightScratch>();
+        chunk->unpack(std::span<Voxel, Chunk::CHUNK_SIZE>(scratch.voxels, Chunk::CHUNK_SIZE));
+        const auto opaque = [&](const glm::ivec3 local) {
+            return isOpaque(scratch.voxels[Chunk::linearIndex(local)]);
+        };
+        if (openSky) {
+            for (std::int32_t x = 0; x < DIM; x++) {
+                for (std::int32_t y = 0; y < DIM; y++) {
+                    for (std::int32_t z = DIM - 1; z >= 0 && !opaque({x, y, z}); z--)
+                        light.set(Chunk::linearIndex({x, y, z}), ChunkLight::FULL_SKY);
+                }
+            }
+            // Only lit voxels on the border or beside an unlit voxel can spread their light any further
+            for (std::int32_t x = 0; x < DIM; x++) {
+                for (std::int32_t y = 0; y < DIM; y++) {
+                    for (std::int32_t z = DIM - 1; z >= 0 && !opaque({x, y, z}); z--) {
+                        bool edge = z == 0 || x == 0 || y == 0 || x == DIM - 1 || y == DIM - 1;
+                        for (std::size_t face = 0; face < 4 && !edge; face++) {
+                            const glm::ivec3 neighbour = glm::ivec3(x, y, z) + FACE_DIRECTIONS[face];
+                            edge = !opaque(neighbour) && light.sky(Chunk::linearIndex(neighbour)) < MAX_LEVEL;
+                        }
+                        const auto index = std::uint16_t(Chunk::linearIndex({x, y, z}));
+                        if (edge)
+                            chunkWork.additions.push_back({index, MAX_LEVEL, SKY_CHANNEL});
+                    }
+                }
+            }
+        }
+        for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++) {
+            if (const std::uint8_t level = emitted(scratch.voxels[i]))
+                chunkWork.additions.push_back({std::uint16_t(i), level, SOURCE});
+        }
+    }
+
+    // Light already in lit neighbours crosses into the chunk
+    for (std::size_t face = 0; face < 6; face++) {
+        const glm::i32vec3 neighbourPos = position + FACE_DIRECTIONS[face];
+        const auto found = lights.find(neighbourPos);
+        if (found == lights.end() || baking.contains(neighbourPos))
+            continue;
+        const ChunkLight& neighbour = found->second;
+        if (neighbour.isUniform() && neighbour.get(0) == 0)
+            continue;
+        // Light crosses from the neighbour in the opposite direction of the face
+        const std::size_t inward = face ^ 1;
+        const std::int32_t layer = face & 1 ? DIM - 1 : 0;
+        const std::int32_t axis = std::int32_t(face / 2);
+        forEachInLayer(face, layer, [&](const std::uint16_t index) {
+            glm::ivec3 outside = Chunk::position(index);
+            outside[axis] += face & 1 ? 1 : -1;
+            const std::uint8_t value = neighbour.get(wrappedIndex(outside));
+            for (const bool sky : {true, false}) {
+                const std::uint8_t level = spread(levelOf(value, sky), sky, inward);
+                const auto flags = std::uint8_t(INCOMING | (sky ? SKY_CHANNEL : 0));
+                if (level > 0)
+                    chunkWork.additions.push_back({index, level, flags});
+            }
+        });
+    }
+}
+
+/***
+ * @brief Processes the queued removals or additions of a chunk until they run out
+ *
+ * Removals hold a voxel that was darkened and the level it had. Its neighbours that were lit less brightly
+ * got their light through it, so they are darkened in turn, while brighter neighbours are queued as
+ * additions to relight the darkened area. Additions hold a voxel and the level it should have, and spread
+ * to every neighbour they brighten. Anything crossing a border goes to the outbox of that face.
+ */
+void LightEngine::flood(
+    const Chunk& chunk,
+    ChunkLight& light,
+    ChunkWork& chunkWork,
+    const bool removing
+) const
+{
+    const bool uniform = chunk.isUniform();
+    LightScratch& scratch = threadScratch<LightScratch>();
+    if (!uniform)
+        chunk.unpack(std::span<Voxel, Chunk::CHUNK_SIZE>(scratch.voxels, Chunk::CHUNK_SIZE));
+    const auto voxelAt = [&](const std::size_t index) {
+        return uniform ? chunk.get(0) : scratch.voxels[index];
+    };
+    const auto setLevel = [&](const std::uint16_t index, const bool sky, const std::uint8_t level) {
+        light.set(index, withLevel(light.get(index), sky, level));
+        chunkWork.dirty.mark(Chunk::position(index));
+    };
+
+    if (removing) {
+        std::vector<Update>& queue = chunkWork.removals;
+        // Checks whether a voxel next to one darkened from the given level got its light through it
+        const auto check = [&](
+                               const std::uint16_t index,
+                               const std::uint8_t removed,
+                               const std::uint8_t flags
+                           ) {
+            const bool sky = flags & SKY_CHANNEL;
+            const std::uint8_t level = levelOf(light.get(index), sky);
+            if (level == 0)
+                return;
+            // Full sky light from above is not dimmer than the voxel it came from, but still came through it
+            const bool column = flags & FROM_ABOVE && sky && level == MAX_LEVEL && removed == MAX_LEVEL;
+            if (level < removed || column) {
+                setLevel(index, sky, 0);
+                queue.push_back({index, level, std::uint8_t(flags & SKY_CHANNEL)});
+                if (const std::uint8_t emitting = sky ? 0 : emitted(voxelAt(index)))
+                    chunkWork.additions.push_back({index, emitting, SOURCE});
+            }
+            else
+                chunkWork.additions.push_back({index, level, std::uint8_t(flags & SKY_CHANNEL)});
+        };
+
+        for (std::size_t head = 0; head < queue.size(); head++) {
+            const Update update = queue[head];
+            if (update.flags & INCOMING) {
+                check(update.index, update.level, update.flags);
+                continue;
+            }
+            const glm::ivec3 position = Chunk::position(update.index);
+            for (std::size_t face = 0; face < 6; face++) {
+                const glm::ivec3 neighbour = position + FACE_DIRECTIONS[face];
+                const std::uint8_t above = face == FACE_DOWN ? FROM_ABOVE : 0;
+                const auto flags = std::uint8_t((update.flags & SKY_CHANNEL) | above);
+                if (neighbour[face / 2] >= 0 && neighbour[face / 2] < DIM)
+                    check(std::uint16_t(Chunk::linearIndex(neighbour)), update.level, flags);
+                else {
+                    const auto incoming = std::uint8_t(flags | INCOMING);
+                    chunkWork.outbox[face].push_back({wrappedIndex(neighbour), update.level, incoming});
+                }
+            }
+        }
+        queue.clear();
+        return;
+    }
+
+    std::vector<Update>& queue = chunkWork.additions;
+    for (std::size_t head = 0; head < queue.size(); head++) {
+        const Update update = queue[head];
+        const bool sky = update.flags & SKY_CHANNEL;
+        const std::uint8_t current = levelOf(light.get(update.index), sky);
+        if (update.level > current) {
+            if (!(update.flags & SOURCE) && isOpaque(voxelAt(update.index)))
+                continue;
+            setLevel(update.index, sky, update.level);
+        }
+        else if (update.level < current || update.flags & INCOMING)
+            continue;
+
+        const glm::ivec3 position = Chunk::position(update.index);
+        for (std::size_t face = 0; face < 6; face++) {
+            const std::uint8_t level = spread(update.level, sky, face);
+            if (level == 0)
+                continue;
+            const glm::ivec3 neighbour = position + FACE_DIRECTIONS[face];
+            if (neighbour[face / 2] < 0 || neighbour[face / 2] >= DIM) {
+                const auto flags = std::uint8_t((sky ? SKY_CHANNEL : 0) | INCOMING);
+                chunkWork.outbox[face].push_back({wrappedIndex(neighbour), level, flags});
+                continue;
+            }
+            const auto index = std::uint16_t(Chunk::linearIndex(neighbour));
+            if (levelOf(light.get(index), sky) < level && !isOpaque(voxelAt(index))) {
+                setLevel(index, sky, level);
+                queue.push_back({index, level, std::uint8_t(sky ? SKY_CHANNEL : 0)});
+            }
+        }
+    }
+    queue.clear();
+}
+
+void LightEngine::runRounds(ThreadPool& pool, const bool removing)
+{
+    std::vector<glm::i32vec3> active;
+    std::vector<std::pair<ChunkLight*, ChunkWork*>> targets;
+    while (true) {
+        active.clear();
+        targets.clear();
+        for (auto& [position, chunkWork] : work) {
+            if (!(removing ? chunkWork.removals : chunkWork.additions).empty())
+                active.push_back(position);
+        }
+        if (active.empty())
+            return;
+
+        for (const glm::i32vec3 position : active)
+            targets.emplace_back(&lights.find(position)->second, &work.find(position)->second);
+        parallelFor(pool, active.size(), [&](const std::size_t i) {
+            const auto [light, chunkWork] = targets[i];
+            if (const Chunk* chunk = chunks.find(active[i]))
+                flood(*chunk, *light, *chunkWork, removing);
+        });
+
+        // Hand the light crossing each border to the neighbour, adding entries may move the others so they
+        // are looked up again
+        for (const glm::i32vec3 position : active) {
+            for (std::size_t face = 0; face < 6; face++) {
+                const glm::i32vec3 neighbour = position + FACE_DIRECTIONS[face];
+                if (!work.find(position)->second.outbox[face].empty() && lights.contains(neighbour))
+                    work[neighbour];
+            }
+        }
+        for (const glm::i32vec3 position : active) {
+            ChunkWork& chunkWork = work.find(position)->second;
+            for (std::size_t face = 0; face < 6; face++) {
+                std::vector<Update>& outbox = chunkWork.outbox[face];
+                const auto found = work.find(position + FACE_DIRECTIONS[face]);
+                if (!outbox.empty() && found != work.end()) {
+                    std::vector<Update>& queue = removing ? found->second.removals : found->second.additions;
+                    queue.insert(queue.end(), outbox.begin(), outbox.end());
+                }
+                outbox.clear();
+            }
+        }
+    }
+}
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,155 @@
+#pragma once
+#include "chunk_map.h"
+#include "core/utility/slab_allocator.h"
+#include "edit.h"
+#include <ankerl/unordered_dense.h>
+#include <array>
+#include <span>
+#include <vector>
+
+namespace dragonfire {
+class ThreadPool;
+}
+
+namespace dragonfire::voxel {
+
+/// Light level of every voxel in a chunk, sky light in the high nibble and block light in the low nibble.
+/// Chunks lit the same everywhere, such as open air or solid rock, store the single value.
+class ChunkLight {
+public:
+    static constexpr std::uint8_t MAX_LEVEL = 15;
+    /// Full sky light and no block light
+    static constexpr std::uint8_t FULL_SKY = MAX_LEVEL << 4;
+
+    ChunkLight() = default;
+
+    explicit ChunkLight(const std::uint8_t value) : uniform(value) {}
+
+    [[nodiscard]] std::uint8_t get(const std::size_t index) const noexcept
+    {
+        return data.empty() ? uniform : data[index];
+    }
+
+    [[nodiscard]] std::uint8_t sky(const std::size_t index) const noexcept { return get(index) >> 4; }
+
+    [[nodiscard]] std::uint8_t block(const std::size_t index) const noexcept
+    {
+        return get(index) & MAX_LEVEL;
+    }
+
+    void set(std::size_t index, std::uint8_t value);
+    /// Sets every voxel in the chunk, releasing the per voxel storage
+    void fill(std::uint8_t value);
+    /// Releases the per voxel storage if every voxel has the same light
+    void compact();
+    /// Decompresses the light into out, laid out the same way as Chunk::linearIndex
+    void unpack(std::span<std::uint8_t, Chunk::CHUNK_SIZE> out) const;
+
+    [[nodiscard]] bool isUniform() const noexcept { return data.empty(); }
+
+    /// Approximate heap and inline memory used by this chunk's light in bytes
+    [[nodiscard]] std::size_t memoryUsage() const noexcept { return sizeof(ChunkLight) + data.capacity(); }
+
+private:
+    SlabVector<std::uint8_t> data;
+    std::uint8_t uniform = 0;
+};
+
+/***
+ * @brief Sky and block light of loaded chunks, propagated by breadth first flood fill
+ *
+ * Sky light enters through the top of chunks with no loaded chunk above them. It travels straight down at
+ * full strength and loses a level per voxel in every other direction. Block light spreads from emitting
+ * voxels, losing a level per voxel. Opaque voxels block both, but still emit their own light.
+ *
+ * Edits are relit incrementally: the light that passed through the edited voxel is removed, then the
+ * voxels left lit around the removed area flood back into it. Work is partitioned by chunk. Each round, every
+ * chunk with pending work is flood filled by a single worker, and light crossing a chunk border is handed to
+ * the neighbour for the next round. Removal finishes in every chunk before any light is added back.
+ *
+ * Light is not updated when a chunk unloads, so chunks below an unloaded chunk keep their light until they
+ * are reloaded.
+ */
+class LightEngine {
+public:
+    /***
+     * @param chunks the voxels to light, must not change while update runs
+     * @param emission block light emitted by each voxel id, ids past the end emit no light
+     */
+    explicit LightEngine(const ChunkMap& chunks, std::vector<std::uint8_t> emission = {});
+
+    /// Queues a newly loaded chunk to be lit on the next update, along with the changes it causes nearby
+    void addChunk(glm::i32vec3 position);
+    /// Drops the light of an unloaded chunk
+    void removeChunk(glm::i32vec3 position);
+    /// Queues the voxel at a world position to be relit on the next update, call after changing the voxel
+    void voxelChanged(glm::i32vec3 position);
+    /// Queues every voxel changed in a journal to be relit on the next update
+    void voxelsChanged(const EditJournal& changes);
+
+    /***
+     * @brief Propagates every queued change on the pool, blocking until the light has settled
+     *
+     * Must not be called from a worker of the pool.
+     */
+    void update(ThreadPool& pool);
+
+    /// Returns the light of a chunk, or nullptr if it is not lit
+    [[nodiscard]] const ChunkLight* find(glm::i32vec3 position) const noexcept;
+
+    /// Returns the light of the face neighbours of a chunk in the order of FACE_DIRECTIONS, nullptr if not
+    /// lit
+    [[nodiscard]] std::array<const ChunkLight*, 6> neighbours(glm::i32vec3 position) const noexcept;
+
+    /// Returns the light at a world position, 0 if the chunk is not lit
+    [[nodiscard]] std::uint8_t getLight(glm::i32vec3 position) const noexcept;
+
+    /// Layers of each chunk whose light changed since the last call to clearChanged, including the
+    /// neighbours of changed border voxels, so meshes can be updated
+    [[nodiscard]] const auto& getChanged() const noexcept { return changed; }
+
+    void clearChanged() noexcept { changed.clear(); }
+
+    /// Number of chunks queued to be lit or with queued edits
+    [[nodiscard]] std::size_t pending() const noexcept { return baking.size() + work.size(); }
+
+    /// Approximate memory used by the light of every chunk in bytes
+    [[nodiscard]] std::size_t memoryUsage() const noexcept;
+
+    LightEngine(const LightEngine& other) = delete;
+    LightEngine& operator=(const LightEngine& other) = delete;
+
+private:
+    /// A change queued in a chunk, see light.cpp for how each queue interprets it
+    struct Update {
+        std::uint16_t index;
+        std::uint8_t level;
+        std::uint8_t flags;
+    };
+
+    /// Queued changes of a chunk during an update, only touched by the worker flood filling the chunk
+    struct ChunkWork {
+        std::vector<Update> removals, additions;
+        /// Changes crossing each face, moved to the neighbour's queues after each round
+        std::array<std::vector<Update>, 6> outbox;
+        DirtyLayers dirty;
+    };
+
+    const ChunkMap& chunks;
+    std::vector<std::uint8_t> emission;
+    ankerl::unordered_dense::map<glm::i32vec3, ChunkLight, ChunkPositionHash> lights;
+    ankerl::unordered_dense::map<glm::i32vec3, ChunkWork, ChunkPositionHash> work;
+    ankerl::unordered_dense::set<glm::i32vec3, ChunkPositionHash> baking;
+    ankerl::unordered_dense::map<glm::i32vec3, DirtyLayers, ChunkPositionHash> changed;
+
+    [[nodiscard]] std::uint8_t emitted(Voxel voxel) const noexcept
+    {
+        return voxel.id < emission.size() ? emission[voxel.id] : 0;
+    }
+
+    void bake(glm::i32vec3 position, ChunkLight& light, ChunkWork& chunkWork) const;
+    void flood(const Chunk& chunk, ChunkLight& light, ChunkWork& chunkWork, bool removing) const;
+    void runRounds(ThreadPool& pool, bool removing);
+};
+
+}// namespace dragonfire::voxel
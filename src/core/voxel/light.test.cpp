@@ -0,0 +1,346 @@
+#include "chunk_streamer.h"
+#include "core/utility/thread_pool.h"
+#include "light.h"
+#include "mesher.h"
+#include "terrain.h"
+#include "test_helpers.h"
+#include <catch.hpp>
+#include <deque>
+#include <random>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+using namespace dragonfire::voxel::test;
+
+static constexpr Voxel STONE{1, 0};
+static constexpr Voxel GLASS{5, 1};
+static constexpr Voxel TORCH{6, 1};
+static constexpr Voxel LAVA{7, 0};
+static const std::vector<std::uint8_t> EMISSION = {0, 0, 0, 0, 0, 0, 14, 10};
+
+/// Lights a box of loaded chunks from scratch with a single flood fill over the whole box, for comparison
+class ReferenceLight {
+public:
+    ReferenceLight(const ChunkMap& chunks, const glm::i32vec3 lowChunk, const glm::i32vec3 highChunk)
+        : low(lowChunk * std::int32_t(Chunk::CHUNK_DIM)),
+          size((highChunk - lowChunk + 1) * std::int32_t(Chunk::CHUNK_DIM)), levels(size.x * size.y * size.z)
+    {
+        std::vector<Voxel> voxels(levels.size());
+        for (std::size_t i = 0; i < voxels.size(); i++)
+            voxels[i] = getVoxel(chunks, position(i));
+        const auto opaque = [&](const std::size_t i) { return voxels[i].id != 0 && !voxels[i].transparent; };
+
+        std::deque<std::size_t> queue;
+        for (std::int32_t x = 0; x < size.x; x++) {
+            for (std::int32_t y = 0; y < size.y; y++) {
+                for (std::int32_t z = size.z - 1; z >= 0 && !opaque(index({x, y, z})); z--) {
+                    levels[index({x, y, z})] = ChunkLight::FULL_SKY;
+                    queue.push_back(index({x, y, z}));
+                }
+            }
+        }
+        for (std::size_t i = 0; i < voxels.size(); i++) {
+            if (voxels[i].id < EMISSION.size() && EMISSION[voxels[i].id] > 0) {
+                levels[i] |= EMISSION[voxels[i].id];
+                queue.push_back(i);
+            }
+        }
+
+        while (!queue.empty()) {
+            const std::size_t i = queue.front();
+            queue.pop_front();
+            const glm::i32vec3 local = position(i) - low;
+            for (std::size_t face = 0; face < 6; face++) {
+                const glm::i32vec3 next = local + FACE_DIRECTIONS[face];
+                const bool inside = next.x >= 0 && next.y >= 0 && next.z >= 0;
+                if (!inside || next.x >= size.x || next.y >= size.y || next.z >= size.z)
+                    continue;
+                const std::size_t j = index(next);
+                if (opaque(j))
+                    continue;
+                const std::uint8_t sky = levels[i] >> 4, block = levels[i] & ChunkLight::MAX_LEVEL;
+                const bool column = face == 4 && sky == ChunkLight::MAX_LEVEL;
+                const std::uint8_t nextSky = column ? sky : sky > 0 ? sky - 1 : 0;
+                const std::uint8_t nextBlock = block > 0 ? block - 1 : 0;
+                const std::uint8_t oldSky = levels[j] >> 4, oldBlock = levels[j] & ChunkLight::MAX_LEVEL;
+                if (nextSky > oldSky || nextBlock > oldBlock) {
+                    levels[j] = std::uint8_t(std::max(nextSky, oldSky) << 4 | std::max(nextBlock, oldBlock));
+                    queue.push_back(j);
+                }
+            }
+        }
+    }
+
+    [[nodiscard]] std::uint8_t get(const glm::i32vec3 world) const { return levels[index(world - low)]; }
+
+    /// Number of voxels whose light differs from the engine's
+    [[nodiscard]] std::size_t differences(const LightEngine& engine) const
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < levels.size(); i++)
+            count += engine.getLight(position(i)) != levels[i];
+        return count;
+    }
+
+private:
+    glm::i32vec3 low, size;
+    std::vector<std::uint8_t> levels;
+
+    [[nodiscard]] std::size_t index(const glm::i32vec3 local) const
+    {
+        return (std::size_t(local.x) * size.y + local.y) * size.z + local.z;
+    }
+
+    [[nodiscard]] glm::i32vec3 position(const std::size_t i) const
+    {
+        const auto z = std::int32_t(i % size.z), y = std::int32_t(i / size.z % size.y);
+        return low + glm::i32vec3(std::int32_t(i / size.z / size.y), y, z);
+    }
+};
+
+TEST_CASE("Chunk Light")
+{
+    ChunkLight light(ChunkLight::FULL_SKY);
+    CHECK(light.isUniform());
+    CHECK(light.sky(100) == 15);
+    CHECK(light.block(100) == 0);
+
+    light.set(100, ChunkLight::FULL_SKY);
+    CHECK(light.isUniform());
+    light.set(100, 0x3A);
+    CHECK_FALSE(light.isUniform());
+    CHECK(light.sky(100) == 3);
+    CHECK(light.block(100) == 10);
+    CHECK(light.get(101) == ChunkLight::FULL_SKY);
+    CHECK(light.memoryUsage() >= Chunk::CHUNK_SIZE);
+
+    std::array<std::uint8_t, Chunk::CHUNK_SIZE> unpacked{};
+    light.unpack(unpacked);
+    CHECK(unpacked[100] == 0x3A);
+    CHECK(unpacked[0] == ChunkLight::FULL_SKY);
+
+    light.compact();
+    CHECK_FALSE(light.isUniform());
+    light.set(100, ChunkLight::FULL_SKY);
+    light.compact();
+    CHECK(light.isUniform());
+    CHECK(light.memoryUsage() == sizeof(ChunkLight));
+}
+
+TEST_CASE("Light Propagation")
+{
+    ChunkMap chunks;
+    ThreadPool pool(2);
+    LightEngine engine(chunks, EMISSION);
+    const auto addChunks = [&] {
+        chunks.forEach([&](const glm::i32vec3 position, Chunk&) { engine.addChunk(position); });
+        engine.update(pool);
+    };
+
+    SECTION("Sky light under an overhang")
+    {
+        for (std::int32_t x = 0; x < 32; x++) {
+            for (std::int32_t y = 0; y < 32; y++) {
+                setVoxel(chunks, {x, y, 0}, STONE);
+                if (x < 8 && y < 8)
+                    setVoxel(chunks, {x, y, 10}, STONE);
+            }
+        }
+        addChunks();
+        CHECK(engine.getLight({20, 20, 5}) == ChunkLight::FULL_SKY);
+        CHECK(engine.getLight({20, 20, 0}) == 0);
+        // The nearest open column is 5 voxels away
+        CHECK(engine.getLight({3, 3, 5}) >> 4 == 10);
+        CHECK(engine.getLight({0, 0, 9}) >> 4 == 7);
+        CHECK(engine.pending() == 0);
+        CHECK(engine.getChanged().contains({0, 0, 0}));
+
+        // Glass lets light through but shades nothing under it
+        setVoxel(chunks, {20, 20, 20}, GLASS);
+        engine.voxelChanged({20, 20, 20});
+        engine.update(pool);
+        CHECK(engine.getLight({20, 20, 5}) == ChunkLight::FULL_SKY);
+    }
+
+    SECTION("Block light crosses chunks")
+    {
+        chunks.insert({0, 0, 0}, Chunk());
+        chunks.insert({1, 0, 0}, Chunk());
+        chunks.insert({0, 0, 1}, Chunk(STONE));
+        chunks.insert({1, 0, 1}, Chunk(STONE));
+        setVoxel(chunks, {28, 5, 5}, TORCH);
+        addChunks();
+        for (std::int32_t d = 0; d < 15; d++)
+            CHECK(engine.getLight({28 + d, 5, 5}) == 14 - d);
+        CHECK(engine.getLight({28, 5, 5 + 3}) == 11);
+        // Stone above blocks both sky light and block light
+        CHECK(engine.getLight({28, 5, 32}) == 0);
+
+        engine.clearChanged();
+        setVoxel(chunks, {28, 5, 5}, Voxel{});
+        engine.voxelChanged({28, 5, 5});
+        engine.update(pool);
+        CHECK(engine.getLight({28, 5, 5}) == 0);
+        CHECK(engine.getLight({35, 5, 5}) == 0);
+        CHECK(engine.find({0, 0, 0})->isUniform());
+        CHECK(engine.find({1, 0, 0})->isUniform());
+        // The removed light crossed the border, so both chunks need remeshing
+        CHECK(engine.getChanged().contains({0, 0, 0}));
+        CHECK(engine.getChanged().contains({1, 0, 0}));
+    }
+
+    SECTION("Opaque emitters")
+    {
+        chunks.insert({0, 0, 0}, Chunk());
+        setVoxel(chunks, {10, 10, 10}, LAVA);
+        setVoxel(chunks, {11, 10, 10}, STONE);
+        addChunks();
+        CHECK((engine.getLight({10, 10, 10}) & 15) == 10);
+        CHECK((engine.getLight({11, 10, 10}) & 15) == 0);
+        // Light goes around the stone, 4 voxels from the lava
+        CHECK((engine.getLight({12, 10, 10}) & 15) == 6);
+    }
+
+    SECTION("Incremental updates match a full relight")
+    {
+        const TerrainGenerator generator(42);
+        const glm::i32vec3 low(-1, -1, -3), high(0, 0, -1);
+        std::vector<glm::i32vec3> positions;
+        for (std::int32_t x = low.x; x <= high.x; x++) {
+            for (std::int32_t y = low.y; y <= high.y; y++) {
+                for (std::int32_t z = low.z; z <= high.z; z++)
+                    positions.emplace_back(x, y, z);
+            }
+        }
+        // Loading the top layer last takes away the sky light the layer below started with
+        for (const glm::i32vec3 position : positions) {
+            chunks.insert(position, generator.genChunk(position));
+            if (position.z < high.z)
+                engine.addChunk(position);
+        }
+        engine.update(pool);
+        for (const glm::i32vec3 position : positions) {
+            if (position.z == high.z)
+                engine.addChunk(position);
+        }
+        engine.update(pool);
+        CHECK(ReferenceLight(chunks, low, high).differences(engine) == 0);
+
+        std::mt19937 rng(3);
+        std::uniform_int_distribution<std::int32_t> horizontal(-32, 31), vertical(-96, -1), pick(0, 3);
+        for (std::int32_t round = 0; round < 20; round++) {
+            for (std::int32_t edit = 0; edit < 10; edit++) {
+                const glm::i32vec3 position(horizontal(rng), horizontal(rng), vertical(rng));
+                const Voxel voxels[] = {Voxel{}, STONE, TORCH, GLASS};
+                setVoxel(chunks, position, voxels[pick(rng)]);
+                engine.voxelChanged(position);
+            }
+            engine.update(pool);
+            REQUIRE(ReferenceLight(chunks, low, high).differences(engine) == 0);
+        }
+    }
+}
+
+TEST_CASE("Lit Chunk Meshing")
+{
+    ChunkMap chunks;
+    for (std::int32_t x = 0; x < 32; x++) {
+        for (std::int32_t y = 0; y < 32; y++) {
+            setVoxel(chunks, {x, y, 0}, STONE);
+            if (x < 8 && y < 8)
+                setVoxel(chunks, {x, y, 10}, STONE);
+        }
+    }
+    setVoxel(chunks, {20, 20, 1}, TORCH);
+    ThreadPool pool(2);
+    LightEngine engine(chunks, EMISSION);
+    engine.addChunk({0, 0, 0});
+    engine.update(pool);
+
+    ChunkBorders borders;
+    borders.gather(std::as_const(chunks).neighbours({0, 0, 0}));
+    borders.gatherLight(engine.neighbours({0, 0, 0}));
+    ChunkMesh mesh;
+    meshChunk(*chunks.find({0, 0, 0}), borders, mesh, engine.find({0, 0, 0}));
+
+    // Every voxel under a quad facing up has the light of the quad above it
+    std::size_t shaded = 0;
+    for (const MeshQuad& quad : mesh.quads) {
+        if (quad.face != 5)
+            continue;
+        shaded += quad.light != ChunkLight::FULL_SKY;
+        for (std::int32_t x = quad.position.x; x < quad.position.x + quad.width; x++) {
+            for (std::int32_t y = quad.position.y; y < quad.position.y + quad.height; y++)
+                REQUIRE(engine.getLight({x, y, quad.position.z + 1}) == quad.light);
+        }
+    }
+    CHECK(shaded > 0);
+
+    // Without light every face is lit by the sky and the floor merges into fewer quads
+    ChunkMesh unlit;
+    meshChunk(*chunks.find({0, 0, 0}), borders, unlit);
+    CHECK(std::ranges::all_of(unlit.quads, [](const MeshQuad& quad) {
+        return quad.light == ChunkLight::FULL_SKY;
+    }));
+    CHECK(unlit.quads.size() < mesh.quads.size());
+
+    ChunkMesher mesher(pool);
+    mesher.setLighting(&engine);
+    mesher.submit(chunks, {0, 0, 0});
+    std::vector<MeshedChunk> meshed;
+    while (mesher.pending() > 0) {
+        pool.waitIdle();
+        mesher.poll(meshed);
+    }
+    REQUIRE(meshed.size() == 1);
+    CHECK(meshed[0].mesh.quads == mesh.quads);
+}
+
+TEST_CASE("Light Benchmark", "[.][benchmark]")
+{
+    ChunkMap chunks;
+    const TerrainGenerator generator(42);
+    for (std::int32_t x = -8; x < 8; x++) {
+        for (std::int32_t y = -8; y < 8; y++) {
+            for (std::int32_t z = -4; z < 4; z++)
+                chunks.insert({x, y, z}, generator.genChunk({x, y, z}));
+        }
+    }
+    ThreadPool pool;
+    LightEngine engine(chunks, EMISSION);
+
+    const auto start = std::chrono::steady_clock::now();
+    chunks.forEach([&](const glm::i32vec3 position, Chunk&) { engine.addChunk(position); });
+    engine.update(pool);
+    const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    spdlog::info(
+        "Lit {} chunks on {} threads in {:.1f} ms, {:.0f} chunks/s, {:.2f} MiB of light",
+        chunks.size(),
+        pool.threadCount(),
+        time.count() * 1000.0,
+        double(chunks.size()) / time.count(),
+        double(engine.memoryUsage()) / double(1 << 20)
+    );
+
+    // Find a surface voxel to edit, the first solid voxel below the sky in the middle of the world
+    glm::i32vec3 surface(3, 5, 127);
+    while (getVoxel(chunks, surface).id == 0)
+        surface.z--;
+    const glm::i32vec3 above = surface + glm::i32vec3(0, 0, 1);
+    bool placed = false;
+    BENCHMARK("Single edit")
+    {
+        placed = !placed;
+        setVoxel(chunks, above, placed ? STONE : Voxel{});
+        engine.voxelChanged(above);
+        engine.update(pool);
+    };
+    BENCHMARK("Place and remove torch")
+    {
+        placed = !placed;
+        setVoxel(chunks, above, placed ? TORCH : Voxel{});
+        engine.voxelChanged(above);
+        engine.update(pool);
+    };
+}
@@ -0,0 +1,210 @@
+#include "core/utility/thread_scratch.h"
+#include "lod.h"
+#include "terrain.h"
+#include <algorithm>
+#include <cassert>
+#include <glm/glm.hpp>
+
+namespace dragonfire::voxel {
+
+static constexpr auto DIM = std::int32_t(Chunk::CHUNK_DIM);
+static constexpr std::int32_t HALF = DIM / 2;
+
+/// Offset of a child within its parent, children are indexed x * 4 + y * 2 + z
+static constexpr glm::i32vec3 childOffset(const std::size_t index) noexcept
+{
+    return {std::int32_t(index >> 2), std::int32_t(index >> 1 & 1), std::int32_t(index & 1)};
+}
+
+/// Buffers used while downsampling
+struct DownsampleScratch {
+    Voxel child[Chunk::CHUNK_SIZE];
+    Voxel out[Chunk::CHUNK_SIZE];
+};
+
+/// Picks the voxel representing a 2x2x2 block, voxels are ordered with the top layer last
+static Voxel representative(const std::array<Voxel, 8>& voxels) noexcept
+{
+    // Most blocks are entirely air or entirely one material
+    if (std::ranges::all_of(voxels, [&](const Voxel voxel) { return voxel == voxels[0]; }))
+        return voxels[0];
+    Voxel best{};
+    std::uint32_t bestCount = 0, solid = 0;
+    for (const Voxel voxel : voxels) {
+        if (voxel.id == 0)
+            continue;
+        solid++;
+        const auto count = std::uint32_t(std::ranges::count(voxels, voxel));
+        // Ties go to the later, higher voxel
+        if (count >= bestCount) {
+            best = voxel;
+            bestCount = count;
+        }
+    }
+    return solid >= voxels.size() / 2 ? best : Voxel{};
+}
+
+/// Fills the octant of out covered by a child with a single voxel
+static void fillOctant(Voxel* out, const glm::ivec3 base, const Voxel voxel) noexcept
+{
+    for (std::int32_t x = 0; x < HALF; x++) {
+        for (std::int32_t y = 0; y < HALF; y++) {
+            Voxel* column = out + Chunk::linearIndex(base + glm::ivec3(x, y, 0));
+            std::fill_n(column, HALF, voxel);
+        }
+    }
+}
+
+Chunk downsample(const std::array<const Chunk*, 8>& children)
+{
+    const bool sameUniform = std::ranges::all_of(children, [&](const Chunk* child) {
+        return child && child->isUniform() && child->get(0) == children[0]->get(0);
+    });
+    if (sameUniform)
+        return Chunk(children[0]->get(0));
+
+    DownsampleScratch& scratch = threadScratch<DownsampleScratch>();
+    for (std::size_t i = 0; i < children.size(); i++) {
+        const glm::ivec3 base = childOffset(i) * HALF;
+        const Chunk* child = children[i];
+        if (child == nullptr || child->isUniform()) {
+            // Every block of a uniform child holds 8 of the same voxel, which is its own representative
+            fillOctant(scratch.out, base, child ? child->get(0) : Voxel{});
+            continue;
+        }
+        child->unpack(scratch.child);
+        for (std::int32_t x = 0; x < HALF; x++) {
+            for (std::int32_t y = 0; y < HALF; y++) {
+                for (std::int32_t z = 0; z < HALF; z++) {
+                    std::array<Voxel, 8> block;
+                    for (std::int32_t j = 0; j < 8; j++) {
+                        // z varies slowest so the top layer of the block is last
+                        const glm::ivec3 offset(j & 1, j >> 1 & 1, j >> 2);
+                        block[j] = scratch.child[Chunk::linearIndex(glm::ivec3(x, y, z) * 2 + offset)];
+                    }
+                    scratch.out[Chunk::linearIndex(base + glm::ivec3(x, y, z))] = representative(block);
+                }
+            }
+        }
+    }
+    return Chunk::pack(std::span<const Voxel, Chunk::CHUNK_SIZE>(scratch.out, Chunk::CHUNK_SIZE));
+}
+
+void LodSelection::select(const glm::vec3 observer, const LodSettings& settings)
+{
+    assert(settings.levelCount > 0 && settings.levelCount <= MAX_LOD_LEVELS);
+    nodes.clear();
+    for (auto& level : levels)
+        level.clear();
+
+    // Start from every node of the coarsest level in range and split the ones too close for their level
+    const std::uint32_t top = settings.levelCount - 1;
+    const glm::vec3 center = observer / float(DIM);
+    const glm::vec3 extent(settings.viewDistance, settings.viewDistance, settings.verticalViewDistance);
+    // Arithmetic shift so negative coordinates round down
+    const glm::i32vec3 low = glm::i32vec3(glm::floor(center - extent)) >> std::int32_t(top);
+    const glm::i32vec3 high = glm::i32vec3(glm::floor(center + extent)) >> std::int32_t(top);
+    for (std::int32_t x = low.x; x <= high.x; x++) {
+        for (std::int32_t y = low.y; y <= high.y; y++) {
+            for (std::int32_t z = low.z; z <= high.z; z++)
+                visit({{x, y, z}, top}, center, settings);
+        }
+    }
+}
+
+void LodSelection::visit(const LodNode& node, const glm::vec3 center, const LodSettings& settings)
+{
+    // Distance in chunks of level 0 from the observer to the closest point of the node
+    const float size = float(1 << node.level);
+    const glm::vec3 min = glm::vec3(node.position) * size;
+    const glm::vec3 delta = glm::clamp(center, min, min + size) - center;
+    if (glm::length(glm::vec2(delta.x, delta.y)) > settings.viewDistance
+        || std::abs(delta.z) > settings.verticalViewDistance)
+        return;
+
+    if (node.level > 0 && glm::length(delta) < settings.fullDetailRadius * float(1 << (node.level - 1))) {
+        for (std::size_t i = 0; i < 8; i++)
+            visit({node.position * 2 + childOffset(i), node.level - 1}, center, settings);
+        return;
+    }
+    nodes.push_back(node);
+    levels[node.level].insert(node.position);
+}
+
+LodTerrain::LodTerrain(const TerrainGenerator& generator, const ChunkMap* chunks)
+    : generator(generator), chunks(chunks)
+{
+}
+
+const Chunk& LodTerrain::get(const LodNode& node)
+{
+    assert(node.level < MAX_LOD_LEVELS);
+    if (const Chunk* chunk = find(node))
+        return *chunk;
+
+    std::unique_ptr<Chunk> chunk;
+    if (node.level > 0) {
+        std::array<const Chunk*, 8> children{};
+        for (std::size_t i = 0; i < children.size(); i++)
+            children[i] = find({node.position * 2 + childOffset(i), node.level - 1});
+        if (std::ranges::all_of(children, [](const Chunk* child) { return child != nullptr; }))
+            chunk = std::make_unique<Chunk>(downsample(children));
+    }
+    if (!chunk)
+        chunk = std::make_unique<Chunk>(generator.genChunk(node.position, node.level));
+    return *levels[node.level].emplace(node.position, std::move(chunk)).first->second;
+}
+
+void LodTerrain::mesh(const LodNode& node, const LodSelection& selection, ChunkMesh& out)
+{
+    // Faces against a neighbour drawn at another level, or not drawn at all, border air and stay visible
+    static const Chunk air;
+    std::array<const Chunk*, 6> neighbours{};
+    for (std::size_t face = 0; face < FACE_DIRECTIONS.size(); face++) {
+        const LodNode neighbour{node.position + FACE_DIRECTIONS[face], node.level};
+        neighbours[face] = selection.contains(neighbour) ? &get(neighbour) : &air;
+    }
+    ChunkBorders borders;
+    borders.gather(neighbours);
+    meshChunk(get(node), borders, out);
+}
+
+void LodTerrain::evict(const LodSelection& selection)
+{
+    for (std::uint32_t level = 0; level < MAX_LOD_LEVELS; level++) {
+        std::erase_if(levels[level], [&](const auto& entry) {
+            return !selection.contains({entry.first, level});
+        });
+    }
+}
+
+std::size_t LodTerrain::cachedCount() const noexcept
+{
+    std::size_t count = 0;
+    for (const LevelMap& level : levels)
+        count += level.size();
+    return count;
+}
+
+std::size_t LodTerrain::memoryUsage() const noexcept
+{
+    constexpr std::size_t entrySize = sizeof(glm::i32vec3) + sizeof(void*);
+    std::size_t usage = sizeof(LodTerrain);
+    for (const LevelMap& level : levels) {
+        for (const auto& [position, chunk] : level)
+            usage += entrySize + chunk->memoryUsage();
+    }
+    return usage;
+}
+
+const Chunk* LodTerrain::find(const LodNode& node) const
+{
+    if (node.level == 0 && chunks != nullptr) {
+        if (const Chunk* chunk = chunks->find(node.position))
+            return chunk;
+    }
+    const auto found = levels[node.level].find(node.position);
+    return found == levels[node.level].end() ? nullptr : found->second.get();
+}
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,108 @@
+#pragma once
+#include "chunk_map.h"
+#include "mesher.h"
+#include <ankerl/unordered_dense.h>
+#include <array>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace dragonfire::voxel {
+class TerrainGenerator;
+
+static constexpr std::uint32_t MAX_LOD_LEVELS = 8;
+
+/// A chunk at a level of detail. A chunk of level L covers 2^L x 2^L x 2^L chunks of level 0, and each of
+/// its voxels spans 2^L voxels along each axis.
+struct LodNode {
+    /// Position in chunks of the node's level
+    glm::i32vec3 position;
+    std::uint32_t level = 0;
+
+    bool operator==(const LodNode& other) const = default;
+};
+
+struct LodSettings {
+    /// Chunks within this many chunks of the observer are full resolution, each coarser level starts at twice
+    /// the distance of the level before it
+    float fullDetailRadius = 4.0f;
+    /// Number of levels used, including full resolution, at most MAX_LOD_LEVELS
+    std::uint32_t levelCount = 5;
+    /// Nodes further than this many chunks from the observer horizontally are not selected
+    float viewDistance = 64.0f;
+    /// Nodes further than this many chunks from the observer vertically are not selected
+    float verticalViewDistance = 8.0f;
+};
+
+/***
+ * @brief Builds the chunk of the next coarser level from its 8 children
+ *
+ * Each voxel is chosen from the 2x2x2 voxels it covers. It is air unless at least half of them are solid,
+ * otherwise it is the most common solid voxel, with ties going to the highest voxel so surfaces keep their
+ * top layer.
+ * @param children indexed x * 4 + y * 2 + z by the offset of the child within the parent
+ */
+Chunk downsample(const std::array<const Chunk*, 8>& children);
+
+/// Nodes covering the terrain around an observer without overlapping, finer close to the observer
+class LodSelection {
+public:
+    /// Replaces the selected nodes with the ones for an observer at a world space position
+    void select(glm::vec3 observer, const LodSettings& settings);
+
+    [[nodiscard]] std::span<const LodNode> getNodes() const noexcept { return nodes; }
+
+    [[nodiscard]] bool contains(const LodNode& node) const
+    {
+        return node.level < MAX_LOD_LEVELS && levels[node.level].contains(node.position);
+    }
+
+private:
+    std::vector<LodNode> nodes;
+    std::array<ankerl::unordered_dense::set<glm::i32vec3, ChunkPositionHash>, MAX_LOD_LEVELS> levels;
+
+    void visit(const LodNode& node, glm::vec3 center, const LodSettings& settings);
+};
+
+/// Chunks of every level of detail, built lazily. Level 0 chunks come from the chunk map when loaded,
+/// coarser chunks are downsampled from the level below when all 8 children are cached, and otherwise every
+/// chunk is generated directly at its level.
+class LodTerrain {
+public:
+    /// @param chunks full resolution chunks to use when loaded, may be null
+    explicit LodTerrain(const TerrainGenerator& generator, const ChunkMap* chunks = nullptr);
+
+    /// Returns the chunk of a node, building it if it is not cached. The reference stays valid until the node
+    /// is evicted.
+    const Chunk& get(const LodNode& node);
+
+    /***
+     * @brief Meshes a selected node. Faces are culled against neighbours selected at the same level, while
+     * faces bordering a node drawn at another level are kept so the seams between levels are closed.
+     * Quads are in voxels of the node's level.
+     */
+    void mesh(const LodNode& node, const LodSelection& selection, ChunkMesh& out);
+
+    /// Drops the cached chunks of nodes that are not selected
+    void evict(const LodSelection& selection);
+
+    [[nodiscard]] std::size_t cachedCount() const noexcept;
+
+    /// Approximate memory used by the cached chunks in bytes
+    [[nodiscard]] std::size_t memoryUsage() const noexcept;
+
+    LodTerrain(const LodTerrain& other) = delete;
+    LodTerrain& operator=(const LodTerrain& other) = delete;
+
+private:
+    /// Chunks are boxed so references returned by get survive the map growing
+    using LevelMap = ankerl::unordered_dense::map<glm::i32vec3, std::unique_ptr<Chunk>, ChunkPositionHash>;
+
+    const TerrainGenerator& generator;
+    const ChunkMap* chunks;
+    std::array<LevelMap, MAX_LOD_LEVELS> levels;
+
+    const Chunk* find(const LodNode& node) const;
+};
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,245 @@
+#include "chunk_streamer.h"
+#include "core/utility/thread_pool.h"
+#include "lod.h"
+#include "terrain.h"
+#include <catch.hpp>
+#include <fmt/ranges.h>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+
+static constexpr Voxel STONE{1, 0};
+static constexpr Voxel DIRT{2, 0};
+static constexpr Voxel GRASS{3, 0};
+
+static std::array<const Chunk*, 8> childrenOf(const LodNode& node, LodTerrain& terrain)
+{
+    std::array<const Chunk*, 8> children{};
+    for (std::int32_t i = 0; i < 8; i++) {
+        const glm::i32vec3 offset(i >> 2, i >> 1 & 1, i & 1);
+        children[i] = &terrain.get({node.position * 2 + offset, node.level - 1});
+    }
+    return children;
+}
+
+TEST_CASE("Level of Detail Downsampling")
+{
+    const Chunk air, stone(STONE);
+
+    SECTION("Uniform children")
+    {
+        const Chunk parent = downsample({&stone, &stone, &stone, &stone, &stone, &stone, &stone, &stone});
+        CHECK(parent.isUniform());
+        CHECK(parent[{0, 0, 0}] == STONE);
+    }
+
+    SECTION("Representative voxels")
+    {
+        Chunk child;
+        for (std::int32_t x = 0; x < 2; x++) {
+            for (std::int32_t y = 0; y < 2; y++) {
+                // Grass on top of dirt keeps the top layer on a tie
+                child.set({x, y, 0}, DIRT);
+                child.set({x, y, 1}, GRASS);
+                // Less than half solid is air
+                if (x + y < 2)
+                    child.set({2 + x, y, 0}, STONE);
+                child.set({4 + x, y, 0}, STONE);
+                // The majority wins over the top layer
+                child.set({6 + x, y, 0}, DIRT);
+                child.set({6 + x, y, 1}, x + y == 0 ? STONE : DIRT);
+            }
+        }
+        const Chunk parent = downsample({&child, nullptr, &air, &air, &air, &air, &air, &stone});
+        CHECK(parent[{0, 0, 0}] == GRASS);
+        CHECK(parent[{1, 0, 0}] == Voxel{});
+        CHECK(parent[{2, 0, 0}] == STONE);
+        CHECK(parent[{3, 0, 0}] == DIRT);
+        CHECK(parent[{10, 10, 10}] == Voxel{});
+        CHECK(parent[{16, 16, 16}] == STONE);
+        CHECK(parent[{31, 31, 31}] == STONE);
+        CHECK(parent[{15, 31, 31}] == Voxel{});
+    }
+}
+
+TEST_CASE("Direct Level of Detail Generation")
+{
+    TerrainSettings settings;
+    settings.caveThreshold = 2.0f;
+    const TerrainGenerator generator(42, settings);
+    LodTerrain terrain(generator);
+
+    // Generating a coarse level directly samples the same surface as downsampling the full resolution chunks
+    std::size_t matching = 0, total = 0;
+    for (std::int32_t z = -2; z <= 1; z++) {
+        const LodNode node{{0, 0, z}, 1};
+        const Chunk direct = generator.genChunk(node.position, node.level);
+        const Chunk downsampled = downsample(childrenOf(node, terrain));
+        for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++)
+            matching += (direct.get(i).id == 0) == (downsampled.get(i).id == 0);
+        total += Chunk::CHUNK_SIZE;
+    }
+    CHECK(double(matching) / double(total) > 0.98);
+}
+
+TEST_CASE("Level of Detail Selection")
+{
+    LodSettings settings;
+    settings.fullDetailRadius = 2.0f;
+    settings.levelCount = 4;
+    settings.viewDistance = 20.0f;
+    settings.verticalViewDistance = 4.0f;
+    const glm::vec3 observer(100.0f, -50.0f, 10.0f);
+    LodSelection selection;
+    selection.select(observer, settings);
+
+    // Count how many nodes cover each chunk of level 0
+    ankerl::unordered_dense::map<glm::i32vec3, std::uint32_t, ChunkPositionHash> coverage;
+    std::uint32_t coarsest = 0;
+    for (const LodNode& node : selection.getNodes()) {
+        CHECK(selection.contains(node));
+        coarsest = std::max(coarsest, node.level);
+        const std::int32_t size = 1 << node.level;
+        for (std::int32_t x = 0; x < size; x++) {
+            for (std::int32_t y = 0; y < size; y++) {
+                for (std::int32_t z = 0; z < size; z++)
+                    coverage[node.position * size + glm::i32vec3(x, y, z)]++;
+            }
+        }
+    }
+    CHECK(coarsest == 3);
+    CHECK(std::ranges::all_of(coverage, [](const auto& entry) { return entry.second == 1; }));
+
+    const glm::i32vec3 center = ChunkStreamer::chunkPosition(observer);
+    CHECK(selection.contains({center, 0}));
+    CHECK_FALSE(selection.contains({center >> 1, 1}));
+    // Every chunk well within the view distance is covered
+    for (std::int32_t x = -18; x <= 18; x++) {
+        for (std::int32_t y = -18; y <= 18; y++) {
+            for (std::int32_t z = -3; z <= 3; z++) {
+                if (x * x + y * y <= 18 * 18)
+                    CHECK(coverage.contains(center + glm::i32vec3(x, y, z)));
+            }
+        }
+    }
+}
+
+TEST_CASE("Level of Detail Terrain")
+{
+    const TerrainGenerator generator(42);
+
+    SECTION("Coarse chunks are downsampled from cached children")
+    {
+        LodTerrain terrain(generator);
+        const LodNode node{{0, 0, -1}, 1};
+        const auto children = childrenOf(node, terrain);
+        const Chunk expected = downsample(children);
+        const Chunk& parent = terrain.get(node);
+        for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++)
+            REQUIRE(parent.get(i) == expected.get(i));
+        CHECK(terrain.cachedCount() == 9);
+    }
+
+    SECTION("Seams between levels are closed")
+    {
+        ChunkMap chunks;
+        chunks.insert({0, 0, -2}, Chunk(STONE));
+        chunks.insert({1, 0, -2}, Chunk(STONE));
+        LodTerrain terrain(generator, &chunks);
+        LodSettings settings;
+        settings.fullDetailRadius = 1.0f;
+        settings.levelCount = 2;
+        settings.viewDistance = 4.0f;
+        settings.verticalViewDistance = 4.0f;
+        LodSelection selection;
+        selection.select({16.0f, 16.0f, 16.0f}, settings);
+        const LodNode node{{0, 0, -2}, 0};
+        REQUIRE(selection.contains(node));
+        REQUIRE(selection.contains({{1, 0, -2}, 0}));
+        REQUIRE(selection.contains({{0, 0, -2}, 1}));
+
+        // Faces towards the coarser node below are kept, faces towards the solid node beside it are culled
+        ChunkMesh mesh;
+        terrain.mesh(node, selection, mesh);
+        CHECK(std::ranges::count(mesh.quads, 4, &MeshQuad::face) == 1);
+        CHECK(std::ranges::count(mesh.quads, 1, &MeshQuad::face) == 0);
+        CHECK(terrain.cachedCount() > 0);
+        terrain.evict(selection);
+        CHECK(terrain.cachedCount() <= selection.getNodes().size());
+    }
+}
+
+TEST_CASE("Level of Detail Benchmark", "[.][benchmark]")
+{
+    // Compare full resolution chunks against the selected levels of detail over the same view distance
+    LodSettings settings;
+    settings.fullDetailRadius = 4.0f;
+    settings.levelCount = 4;
+    settings.viewDistance = 16.0f;
+    settings.verticalViewDistance = 3.0f;
+    const glm::vec3 observer(0.0f, 0.0f, -40.0f);
+    const glm::i32vec3 center = ChunkStreamer::chunkPosition(observer);
+    const auto radius = std::int32_t(settings.viewDistance);
+    const auto height = std::int32_t(settings.verticalViewDistance);
+
+    ThreadPool pool;
+    TerrainGenerator generator(42);
+    std::vector<glm::i32vec3> positions;
+    for (std::int32_t x = -radius; x <= radius; x++) {
+        for (std::int32_t y = -radius; y <= radius; y++) {
+            for (std::int32_t z = -height; z <= height; z++) {
+                if (x * x + y * y <= radius * radius)
+                    positions.push_back(center + glm::i32vec3(x, y, z));
+            }
+        }
+    }
+    generator.generate(positions, pool);
+    pool.waitIdle();
+    std::vector<GeneratedChunk> generated;
+    generator.poll(generated);
+    ChunkMap chunks;
+    for (GeneratedChunk& result : generated)
+        chunks.insert(result.position, std::move(result.chunk));
+
+    ChunkMesh mesh;
+    std::size_t fullTriangles = 0;
+    for (const glm::i32vec3 position : positions) {
+        ChunkBorders borders;
+        borders.gather(std::as_const(chunks).neighbours(position));
+        meshChunk(*chunks.find(position), borders, mesh);
+        fullTriangles += mesh.triangleCount();
+    }
+
+    LodSelection selection;
+    selection.select(observer, settings);
+    LodTerrain terrain(generator);
+    std::size_t lodTriangles = 0;
+    std::array<std::size_t, MAX_LOD_LEVELS> levelCounts{};
+    for (const LodNode& node : selection.getNodes()) {
+        terrain.mesh(node, selection, mesh);
+        lodTriangles += mesh.triangleCount();
+        levelCounts[node.level]++;
+    }
+    terrain.evict(selection);
+
+    spdlog::info(
+        "Full resolution: {} chunks, {} triangles, {:.1f} MiB",
+        positions.size(),
+        fullTriangles,
+        double(chunks.memoryUsage()) / (1024.0 * 1024.0)
+    );
+    spdlog::info(
+        "Level of detail: {} nodes ({}), {} triangles, {:.1f} MiB",
+        selection.getNodes().size(),
+        fmt::join(std::span(levelCounts).first(settings.levelCount), "/"),
+        lodTriangles,
+        double(terrain.memoryUsage()) / (1024.0 * 1024.0)
+    );
+
+    BENCHMARK("Select") { selection.select(observer, settings); };
+    const LodNode node{{0, 0, -1}, 1};
+    const auto children = childrenOf(node, terrain);
+    BENCHMARK("Downsample") { return downsample(children); };
+    BENCHMARK("Generate level 1 directly") { return generator.genChunk(node.position, node.level); };
+}
@@ -0,0 +1,404 @@
+#include "core/utility/thread_pool.h"
+#include "core/utility/thread_scratch.h"
+#include "mesher.h"
+#include <bit>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <optional>
+
+namespace dragonfire::voxel {
+
+static constexpr auto DIM = std::int32_t(Chunk::CHUNK_DIM);
+
+/// Chunk coordinates of the voxel at layer along the normal axis and (u, v) in the plane
+static constexpr glm::ivec3 toChunk(
+    const QuadAxes axes,
+    const std::int32_t layer,
+    const std::int32_t u,
+    const std::int32_t v
+)
+{
+    glm::ivec3 position;
+    position[axes.normal] = layer;
+    position[axes.u] = u;
+    position[axes.v] = v;
+    return position;
+}
+
+static bool isSolid(const Voxel voxel) noexcept
+{
+    return voxel.id != 0;
+}
+
+static bool isOpaque(const Voxel voxel) noexcept
+{
+    return voxel.id != 0 && !voxel.transparent;
+}
+
+/// Slices of each face to build, bit i of a face is the slice at layer i
+using SliceMask = std::array<std::uint32_t, 6>;
+
+static SliceMask dirtySlices(const DirtyLayers& dirty) noexcept
+{
+    SliceMask slices{};
+    for (std::uint8_t face = 0; face < 6; face++) {
+        const std::uint64_t layers = dirty.axes[face / 2];
+        // A face depends on its own voxel and the voxel it touches, one layer further in the face's direction
+        const std::uint64_t touched = face & 1 ? layers | layers >> 1 : layers | layers << 1;
+        slices[face] = std::uint32_t(touched >> 1);
+    }
+    return slices;
+}
+
+/// Index of the slice a quad belongs to, quads in a mesh are sorted by it
+static std::int32_t sliceOf(const MeshQuad& quad) noexcept
+{
+    return quad.face * DIM + quad.position[quadAxes(quad.face).normal];
+}
+
+std::array<glm::i32vec3, 4> quadCorners(const MeshQuad& quad) noexcept
+{
+    const QuadAxes axes = quadAxes(quad.face);
+    glm::i32vec3 origin(quad.position), u{}, v{};
+    // Faces on the positive side of a voxel lie on the far side of it
+    if (quad.face & 1)
+        origin[axes.normal] += 1;
+    u[axes.u] = quad.width;
+    v[axes.v] = quad.height;
+    // u x v points along the positive normal for x and z faces but the negative normal for y faces
+    const bool positive = quad.face & 1;
+    const bool flip = axes.normal == 1 ? positive : !positive;
+    if (flip)
+        return {origin, origin + v, origin + u + v, origin + u};
+    return {origin, origin + u, origin + u + v, origin + v};
+}
+
+void ChunkBorders::gather(const std::array<const Chunk*, 6>& neighbours)
+{
+    for (std::uint8_t face = 0; face < 6; face++) {
+        const Chunk* neighbour = neighbours[face];
+        loaded[face] = neighbour != nullptr;
+        light[face].fill(ChunkLight::FULL_SKY);
+        if (neighbour == nullptr)
+            continue;
+        std::array<Voxel, PLANE_SIZE>& plane = planes[face];
+        if (neighbour->isUniform()) {
+            plane.fill(neighbour->get(0));
+            continue;
+        }
+        // The layer touching this chunk is the far side of a negative neighbour and the near side of a
+        // positive one
+        const QuadAxes axes = quadAxes(face);
+        const std::int32_t layer = face & 1 ? 0 : DIM - 1;
+        for (std::int32_t u = 0; u < DIM; u++) {
+            for (std::int32_t v = 0; v < DIM; v++)
+                plane[u * DIM + v] = neighbour->get(Chunk::linearIndex(toChunk(axes, layer, u, v)));
+        }
+    }
+}
+
+void ChunkBorders::gatherLight(const std::array<const ChunkLight*, 6>& neighbours)
+{
+    for (std::uint8_t face = 0; face < 6; face++) {
+        const ChunkLight* neighbour = neighbours[face];
+        std::array<std::uint8_t, PLANE_SIZE>& plane = light[face];
+        if (neighbour == nullptr)
+            continue;
+        if (neighbour->isUniform()) {
+            plane.fill(neighbour->get(0));
+            continue;
+        }
+        const QuadAxes axes = quadAxes(face);
+        const std::int32_t layer = face & 1 ? 0 : DIM - 1;
+        for (std::int32_t u = 0; u < DIM; u++) {
+            for (std::int32_t v = 0; v < DIM; v++)
+                plane[u * DIM + v] = neighbour->get(Chunk::linearIndex(toChunk(axes, layer, u, v)));
+        }
+    }
+}
+
+/// Buffers used while meshing
+struct MeshScratch {
+    Voxel voxels[Chunk::CHUNK_SIZE];
+    std::uint8_t light[Chunk::CHUNK_SIZE];
+    /// Solid and opaque bits of each row of voxels along each axis, indexed [axis][u * DIM + v].
+    /// Bit 0 is the voxel in the negative neighbour, bits 1 to 32 are the chunk and bit 33 is the voxel
+    /// in the positive neighbour.
+    std::uint64_t solid[3][ChunkBorders::PLANE_SIZE];
+    std::uint64_t opaque[3][ChunkBorders::PLANE_SIZE];
+    /// Visible faces of each slice, indexed [face][layer][u] with one bit per v
+    std::uint32_t faces[6][DIM][DIM];
+};
+
+/// Builds the solid and opaque row masks along every axis, including the neighbouring voxels on either end
+static void buildMasks(MeshScratch& scratch, const ChunkBorders& borders)
+{
+    std::memset(scratch.solid, 0, sizeof(scratch.solid));
+    std::memset(scratch.opaque, 0, sizeof(scratch.opaque));
+    for (std::int32_t x = 0; x < DIM; x++) {
+        for (std::int32_t y = 0; y < DIM; y++) {
+            const Voxel* column = scratch.voxels + Chunk::linearIndex({x, y, 0});
+            for (std::int32_t z = 0; z < DIM; z++) {
+                const Voxel voxel = column[z];
+                if (!isSolid(voxel))
+                    continue;
+                const std::uint64_t opaque = isOpaque(voxel);
+                scratch.solid[0][y * DIM + z] |= 1ull << (x + 1);
+                scratch.solid[1][x * DIM + z] |= 1ull << (y + 1);
+                scratch.solid[2][x * DIM + y] |= 1ull << (z + 1);
+                scratch.opaque[0][y * DIM + z] |= opaque << (x + 1);
+                scratch.opaque[1][x * DIM + z] |= opaque << (y + 1);
+                scratch.opaque[2][x * DIM + y] |= opaque << (z + 1);
+            }
+        }
+    }
+
+    for (std::uint8_t face = 0; face < 6; face++) {
+        const std::int32_t axis = face / 2;
+        const std::uint32_t bit = face & 1 ? DIM + 1 : 0;
+        for (std::size_t i = 0; i < ChunkBorders::PLANE_SIZE; i++) {
+            // Neighbours that are not loaded hide the faces touching them
+            const Voxel voxel = borders.loaded[face] ? borders.planes[face][i] : Voxel{1, 0};
+            scratch.solid[axis][i] |= std::uint64_t(isSolid(voxel)) << bit;
+            scratch.opaque[axis][i] |= std::uint64_t(isOpaque(voxel)) << bit;
+        }
+    }
+}
+
+/// Finds the visible faces of every voxel in the given slices and scatters them into per slice face masks
+static void cullFaces(MeshScratch& scratch, const ChunkBorders& borders, const SliceMask& slices)
+{
+    std::memset(scratch.faces, 0, sizeof(scratch.faces));
+    const auto voxelAt
+        = [&](const QuadAxes axes, const std::int32_t layer, const std::int32_t u, const std::int32_t v) {
+              if (layer < 0)
+                  return borders.planes[axes.normal * 2][u * DIM + v];
+              if (layer >= DIM)
+                  return borders.planes[axes.normal * 2 + 1][u * DIM + v];
+              return scratch.voxels[Chunk::linearIndex(toChunk(axes, layer, u, v))];
+          };
+
+    for (std::int32_t axis = 0; axis < 3; axis++) {
+        const QuadAxes axes = quadAxes(std::uint8_t(axis * 2));
+        for (std::int32_t u = 0; u < DIM; u++) {
+            for (std::int32_t v = 0; v < DIM; v++) {
+                const std::uint64_t solid = scratch.solid[axis][u * DIM + v];
+                const std::uint64_t opaque = scratch.opaque[axis][u * DIM + v];
+                const std::uint64_t translucent = solid & ~opaque;
+                for (std::uint8_t side = 0; side < 2; side++) {
+                    // Shift the neighbouring voxel in the face's direction on to each voxel's bit
+                    const std::uint64_t touching = side ? opaque >> 1 : opaque << 1;
+                    const std::uint64_t touchingTranslucent = side ? translucent >> 1 : translucent << 1;
+                    const std::uint8_t face = axis * 2 + side;
+                    std::uint64_t visible = solid & ~touching;
+                    visible = visible >> 1 & slices[face];
+
+                    // Translucent voxels touching other translucent voxels only show a face if they differ
+                    std::uint64_t check = (translucent & touchingTranslucent) >> 1 & visible;
+                    while (check) {
+                        const std::int32_t layer = std::countr_zero(check);
+                        check &= check - 1;
+                        const std::int32_t next = side ? layer + 1 : layer - 1;
+                        if (voxelAt(axes, layer, u, v) == voxelAt(axes, next, u, v))
+                            visible &= ~(1ull << layer);
+                    }
+
+                    while (visible) {
+                        const std::int32_t layer = std::countr_zero(visible);
+                        visible &= visible - 1;
+                        scratch.faces[face][layer][u] |= 1u << v;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// Greedily merges the visible faces of each rebuilt slice into quads, first along v and then along u,
+/// joining faces with the same voxel and light. The quads of the other slices are copied from previous.
+static void mergeFaces(
+    MeshScratch& scratch,
+    const ChunkBorders& borders,
+    const SliceMask& slices,
+    const std::span<const MeshQuad> previous,
+    ChunkMesh& out
+)
+{
+    std::size_t kept = 0;
+    for (std::uint8_t face = 0; face < 6; face++) {
+        const QuadAxes axes = quadAxes(face);
+        for (std::int32_t layer = 0; layer < DIM; layer++) {
+            const std::int32_t slice = face * DIM + layer;
+            const bool rebuild = slices[face] >> layer & 1;
+            for (; kept < previous.size() && sliceOf(previous[kept]) == slice; kept++) {
+                if (!rebuild)
+                    out.quads.push_back(previous[kept]);
+            }
+            if (!rebuild)
+                continue;
+
+            std::uint32_t* rows = scratch.faces[face][layer];
+            const auto voxelAt = [&](const std::int32_t u, const std::int32_t v) {
+                return scratch.voxels[Chunk::linearIndex(toChunk(axes, layer, u, v))];
+            };
+            // A face is lit by the voxel it touches, found in the neighbour's plane past the chunk's border
+            const std::int32_t touching = face & 1 ? layer + 1 : layer - 1;
+            const bool border = touching < 0 || touching >= DIM;
+            const auto lightAt = [&](const std::int32_t u, const std::int32_t v) {
+                if (border)
+                    return borders.light[face][u * DIM + v];
+                return scratch.light[Chunk::linearIndex(toChunk(axes, touching, u, v))];
+            };
+            const auto matches = [&](const std::int32_t u, const std::int32_t v, const MeshQuad& quad) {
+                return voxelAt(u, v) == quad.voxel && lightAt(u, v) == quad.light;
+            };
+            for (std::int32_t u = 0; u < DIM; u++) {
+                while (rows[u]) {
+                    const std::int32_t v = std::countr_zero(rows[u]);
+                    const glm::ivec3 position = toChunk(axes, layer, u, v);
+                    MeshQuad quad{glm::u8vec3(position), face, 1, 1, voxelAt(u, v), lightAt(u, v)};
+                    std::int32_t height = 1;
+                    while (v + height < DIM && rows[u] >> (v + height) & 1 && matches(u, v + height, quad))
+                        height++;
+                    const auto run = std::uint32_t(((1ull << height) - 1) << v);
+
+                    std::int32_t width = 1;
+                    for (; u + width < DIM && (rows[u + width] & run) == run; width++) {
+                        bool same = true;
+                        for (std::int32_t i = v; i < v + height && same; i++)
+                            same = matches(u + width, i, quad);
+                        if (!same)
+                            break;
+                    }
+                    for (std::int32_t i = u; i < u + width; i++)
+                        rows[i] &= ~run;
+
+                    quad.width = std::uint8_t(width);
+                    quad.height = std::uint8_t(height);
+                    out.quads.push_back(quad);
+                }
+            }
+        }
+    }
+}
+
+static void buildMesh(
+    const Chunk& chunk,
+    const ChunkBorders& borders,
+    const SliceMask& slices,
+    const std::span<const MeshQuad> previous,
+    ChunkMesh& out,
+    const ChunkLight* light
+)
+{
+    out.quads.clear();
+    // A uniform chunk can only have faces on its borders, and none at all if it is air
+    if (chunk.isUniform() && !isSolid(chunk.get(0)))
+        return;
+
+    MeshScratch& scratch = threadScratch<MeshScratch>();
+    chunk.unpack(std::span<Voxel, Chunk::CHUNK_SIZE>(scratch.voxels, Chunk::CHUNK_SIZE));
+    if (light)
+        light->unpack(std::span<std::uint8_t, Chunk::CHUNK_SIZE>(scratch.light, Chunk::CHUNK_SIZE));
+    else
+        std::ranges::fill(scratch.light, ChunkLight::FULL_SKY);
+    buildMasks(scratch, borders);
+    cullFaces(scratch, borders, slices);
+    mergeFaces(scratch, borders, slices, previous, out);
+}
+
+void meshChunk(const Chunk& chunk, const ChunkBorders& borders, ChunkMesh& out, const ChunkLight* light)
+{
+    buildMesh(chunk, borders, dirtySlices(DirtyLayers::all()), {}, out, light);
+}
+
+void remeshChunk(
+    const Chunk& chunk,
+    const ChunkBorders& borders,
+    const DirtyLayers& dirty,
+    const ChunkMesh& previous,
+    ChunkMesh& out,
+    const ChunkLight* light
+)
+{
+    assert(&previous != &out);
+    buildMesh(chunk, borders, dirtySlices(dirty), previous.quads, out, light);
+}
+
+ChunkMesher::ChunkMesher(ThreadPool& pool) : pool(pool) {}
+
+ChunkMesher::~ChunkMesher()
+{
+    // Tasks still queued on the pool reference this mesher
+    tasks.wait();
+}
+
+bool ChunkMesher::submit(
+    const ChunkMap& chunks,
+    const glm::i32vec3 position,
+    const ChunkMesh* previous,
+    const DirtyLayers& dirty
+)
+{
+    const Chunk* chunk = chunks.find(position);
+    if (chunk == nullptr)
+        return false;
+
+    struct Job {
+        Chunk chunk;
+        ChunkBorders borders;
+        std::optional<ChunkMesh> previous;
+        DirtyLayers dirty;
+        std::optional<ChunkLight> light;
+    };
+
+    const auto job = std::make_shared<Job>();
+    job->chunk = *chunk;
+    job->borders.gather(chunks.neighbours(position));
+    if (lighting) {
+        if (const ChunkLight* light = lighting->find(position))
+            job->light = *light;
+        job->borders.gatherLight(lighting->neighbours(position));
+    }
+    if (previous) {
+        job->previous = *previous;
+        job->dirty = dirty;
+    }
+    const std::uint64_t version = nextVersion++;
+    latest[position] = version;
+    tasks.submit(pool, [this, job, position, version] {
+        MeshedChunk result{position, {}, version, computeVisibility(job->chunk)};
+        const ChunkLight* light = job->light ? &*job->light : nullptr;
+        if (job->previous)
+            remeshChunk(job->chunk, job->borders, job->dirty, *job->previous, result.mesh, light);
+        else
+            meshChunk(job->chunk, job->borders, result.mesh, light);
+        completed.push(std::move(result));
+    });
+    return true;
+}
+
+void ChunkMesher::cancel(const glm::i32vec3 position)
+{
+    latest.erase(position);
+}
+
+std::size_t ChunkMesher::poll(std::vector<MeshedChunk>& out)
+{
+    results.clear();
+    completed.drain(results);
+    std::size_t count = 0;
+    for (MeshedChunk& result : results) {
+        const auto found = latest.find(result.position);
+        if (found == latest.end() || found->second != result.version)
+            continue;
+        latest.erase(found);
+        out.push_back(std::move(result));
+        count++;
+    }
+    return count;
+}
+
+}// namespace dragonfire::voxel
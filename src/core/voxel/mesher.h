@@ -0,0 +1,167 @@
+#pragma once
+#include "chunk_map.h"
+#include "core/utility/completion_queue.h"
+#include "core/utility/thread_pool.h"
+#include "light.h"
+#include "visibility.h"
+#include <ankerl/unordered_dense.h>
+#include <array>
+#include <bitset>
+#include <glm/ext/vector_uint3_sized.hpp>
+#include <vector>
+
+namespace dragonfire::voxel {
+
+/// A rectangle of identical voxel faces produced by greedy merging
+struct MeshQuad {
+    /// Chunk local coordinates of the voxel at the minimum corner of the quad
+    glm::u8vec3 position;
+    /// Index into FACE_DIRECTIONS of the direction the quad faces
+    std::uint8_t face;
+    /// Size of the quad in voxels along the u and v axes of its plane, see quadAxes
+    std::uint8_t width, height;
+    Voxel voxel;
+    /// Light of the voxels the quad faces into, sky light in the high nibble and block light in the low
+    std::uint8_t light = ChunkLight::FULL_SKY;
+
+    bool operator==(const MeshQuad& other) const = default;
+};
+
+struct ChunkMesh {
+    /// Sorted by face and then by layer along the face's normal
+    std::vector<MeshQuad> quads;
+
+    [[nodiscard]] std::size_t triangleCount() const noexcept { return quads.size() * 2; }
+
+    [[nodiscard]] bool empty() const noexcept { return quads.empty(); }
+};
+
+/// Axes of the plane of a face, the normal axis and the u and v axes a quad's width and height run along
+struct QuadAxes {
+    std::int32_t normal, u, v;
+};
+
+/// X faces span (y, z), Y faces span (x, z) and Z faces span (x, y)
+constexpr QuadAxes quadAxes(const std::uint8_t face) noexcept
+{
+    switch (face / 2) {
+        case 0: return {0, 1, 2};
+        case 1: return {1, 0, 2};
+        default: return {2, 0, 1};
+    }
+}
+
+/***
+ * @brief Computes the 4 corners of a quad in chunk local coordinates
+ * @return the corners in counter-clockwise order viewed from the direction the quad faces
+ */
+std::array<glm::i32vec3, 4> quadCorners(const MeshQuad& quad) noexcept;
+
+/// The voxels of the 6 face neighbours touching a chunk, copied so a chunk can be meshed without access to
+/// the chunk map. Faces bordering a neighbour that is not loaded are treated as hidden.
+struct ChunkBorders {
+    static constexpr std::size_t PLANE_SIZE = Chunk::CHUNK_DIM * Chunk::CHUNK_DIM;
+
+    /// Neighbour voxels touching the chunk in the order of FACE_DIRECTIONS, each indexed u * CHUNK_DIM + v
+    /// using the plane axes from quadAxes
+    std::array<std::array<Voxel, PLANE_SIZE>, 6> planes;
+    /// Light of the neighbour voxels, laid out the same way as planes
+    std::array<std::array<std::uint8_t, PLANE_SIZE>, 6> light;
+    std::bitset<6> loaded;
+
+    /// Copies the touching layer of each neighbour, nullptr neighbours are marked as not loaded. The light
+    /// is reset to full sky light.
+    void gather(const std::array<const Chunk*, 6>& neighbours);
+    /// Copies the light of the touching layer of each neighbour, call after gather
+    void gatherLight(const std::array<const ChunkLight*, 6>& neighbours);
+};
+
+/***
+ * @brief Builds the visible faces of a chunk, merging adjacent identical faces into larger quads
+ *
+ * Faces are culled with one 64 bit mask per row of voxels, a face is visible if the voxel is not air
+ * and the voxel it touches is not opaque. Faces between two identical transparent voxels are also culled.
+ * Each quad takes the light of the voxels it faces into, and faces only merge if their light matches.
+ * @param out the mesh to write to, any existing quads are cleared
+ * @param light the light of the chunk, if null every face is fully lit by the sky
+ */
+void meshChunk(
+    const Chunk& chunk,
+    const ChunkBorders& borders,
+    ChunkMesh& out,
+    const ChunkLight* light = nullptr
+);
+
+/***
+ * @brief Rebuilds only the slices of a mesh that can be affected by the dirty layers, copying the rest
+ * @param dirty layers changed since previous was built, including changes to the neighbours' touching layers
+ * @param previous the mesh of the chunk before the changes, must not be out
+ */
+void remeshChunk(
+    const Chunk& chunk,
+    const ChunkBorders& borders,
+    const DirtyLayers& dirty,
+    const ChunkMesh& previous,
+    ChunkMesh& out,
+    const ChunkLight* light = nullptr
+);
+
+struct MeshedChunk {
+    glm::i32vec3 position;
+    ChunkMesh mesh;
+    std::uint64_t version = 0;
+    /// Faces of the chunk that see each other, for occlusion culling
+    ChunkVisibility visibility;
+};
+
+/// Meshes chunks on a thread pool. The chunk and its borders are copied when a chunk is submitted, so the
+/// chunk map may be modified while the mesh is being built.
+class ChunkMesher {
+public:
+    explicit ChunkMesher(ThreadPool& pool);
+    /// Waits for any meshing tasks still on the pool
+    ~ChunkMesher();
+
+    /***
+     * @brief Queues the chunk at position to be meshed, replacing any earlier request for it
+     * @param previous if not null, only the slices affected by dirty are rebuilt and the rest are copied from
+     * previous, which is copied so it does not need to outlive the call
+     * @return false if the chunk is not loaded
+     */
+    bool submit(
+        const ChunkMap& chunks,
+        glm::i32vec3 position,
+        const ChunkMesh* previous = nullptr,
+        const DirtyLayers& dirty = DirtyLayers::all()
+    );
+    /// Discards the result of any in flight request for the chunk, such as when it is unloaded
+    void cancel(glm::i32vec3 position);
+
+    /// Lights the meshes of chunks submitted after this call, null to mesh everything fully lit. The light
+    /// is copied when a chunk is submitted, so it must not be updated during a submit.
+    void setLighting(const LightEngine* engine) noexcept { lighting = engine; }
+
+    /***
+     * @brief Moves finished meshes to the end of out, skipping results made stale by a later submit or cancel
+     * @return the number of meshes added to out
+     */
+    std::size_t poll(std::vector<MeshedChunk>& out);
+
+    /// Number of chunks submitted whose meshes have not been polled yet
+    [[nodiscard]] std::size_t pending() const noexcept { return latest.size(); }
+
+    ChunkMesher(const ChunkMesher& other) = delete;
+    ChunkMesher& operator=(const ChunkMesher& other) = delete;
+
+private:
+    ThreadPool& pool;
+    const LightEngine* lighting = nullptr;
+    CompletionQueue<MeshedChunk> completed;
+    /// Version of the newest request for each chunk with a request in flight
+    ankerl::unordered_dense::map<glm::i32vec3, std::uint64_t, ChunkPositionHash> latest;
+    std::vector<MeshedChunk> results;
+    std::uint64_t nextVersion = 1;
+    TaskGroup tasks;
+};
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,408 @@
+#include "core/utility/thread_pool.h"
+#include "light.h"
+#include "mesher.h"
+#include "remesh_scheduler.h"
+#include "terrain.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <catch.hpp>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <utility>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+
+static constexpr Voxel STONE{1, 0};
+static constexpr Voxel GLASS{4, 1};
+static constexpr Voxel TINTED_GLASS{5, 1};
+
+/// The generated chunk around the surface with the most distinct voxels
+static std::pair<glm::i32vec3, Chunk> surfaceChunk(const TerrainGenerator& generator)
+{
+    std::pair<glm::i32vec3, Chunk> best;
+    for (int z = -3; z <= 2; z++) {
+        Chunk chunk = generator.genChunk({0, 0, z});
+        if (chunk.paletteSize() > best.second.paletteSize())
+            best = {{0, 0, z}, std::move(chunk)};
+    }
+    return best;
+}
+
+static ChunkBorders airBorders()
+{
+    ChunkBorders borders;
+    const Chunk air;
+    borders.gather({&air, &air, &air, &air, &air, &air});
+    return borders;
+}
+
+static std::size_t faceArea(const ChunkMesh& mesh)
+{
+    std::size_t area = 0;
+    for (const MeshQuad& quad : mesh.quads)
+        area += std::size_t(quad.width) * quad.height;
+    return area;
+}
+
+TEST_CASE("Chunk Meshing")
+{
+    Chunk chunk;
+    ChunkMesh mesh;
+
+    SECTION("Single voxel")
+    {
+        chunk.set({5, 6, 7}, STONE);
+        meshChunk(chunk, airBorders(), mesh);
+        REQUIRE(mesh.quads.size() == 6);
+        for (const MeshQuad& quad : mesh.quads) {
+            CHECK(quad.position == glm::u8vec3(5, 6, 7));
+            CHECK(quad.width == 1);
+            CHECK(quad.height == 1);
+            CHECK(quad.voxel == STONE);
+
+            // Every corner lies on the face of the voxel, wound counter-clockwise around its normal
+            const auto corners = quadCorners(quad);
+            const glm::i32vec3 normal = FACE_DIRECTIONS[quad.face];
+            const glm::i32vec3 a = corners[1] - corners[0], b = corners[2] - corners[0];
+            const glm::i32vec3 cross(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+            CHECK(cross == normal);
+        }
+    }
+
+    SECTION("Uniform chunks")
+    {
+        meshChunk(chunk, airBorders(), mesh);
+        CHECK(mesh.empty());
+
+        chunk.fill(STONE);
+        meshChunk(chunk, ChunkBorders{}, mesh);
+        CHECK(mesh.empty());
+
+        meshChunk(chunk, airBorders(), mesh);
+        REQUIRE(mesh.quads.size() == 6);
+        CHECK(faceArea(mesh) == 6 * ChunkBorders::PLANE_SIZE);
+    }
+
+    SECTION("Greedy merging")
+    {
+        for (int x = 0; x < Chunk::CHUNK_DIM; x++) {
+            for (int y = 0; y < Chunk::CHUNK_DIM; y++) {
+                for (int z = 0; z < 4; z++)
+                    chunk.set({x, y, z}, STONE);
+            }
+        }
+        // Neighbours that are not loaded hide the sides and bottom
+        meshChunk(chunk, ChunkBorders{}, mesh);
+        REQUIRE(mesh.quads.size() == 1);
+        CHECK(mesh.quads[0].face == 5);
+        CHECK(mesh.quads[0].position.z == 3);
+        CHECK(mesh.quads[0].width == Chunk::CHUNK_DIM);
+        CHECK(mesh.quads[0].height == Chunk::CHUNK_DIM);
+
+        meshChunk(chunk, airBorders(), mesh);
+        CHECK(mesh.quads.size() == 6);
+        CHECK(faceArea(mesh) == 2 * ChunkBorders::PLANE_SIZE + 4 * 4 * Chunk::CHUNK_DIM);
+    }
+
+    SECTION("Transparent voxels")
+    {
+        chunk.set({5, 5, 5}, GLASS);
+        chunk.set({6, 5, 5}, GLASS);
+        meshChunk(chunk, airBorders(), mesh);
+        CHECK(mesh.quads.size() == 6);
+        CHECK(faceArea(mesh) == 10);
+
+        chunk.set({6, 5, 5}, TINTED_GLASS);
+        meshChunk(chunk, airBorders(), mesh);
+        CHECK(mesh.quads.size() == 12);
+
+        // Opaque voxels show their face to transparent ones, but not the other way around
+        chunk.set({6, 5, 5}, STONE);
+        meshChunk(chunk, airBorders(), mesh);
+        CHECK(mesh.quads.size() == 11);
+        CHECK(std::ranges::none_of(mesh.quads, [](const MeshQuad& quad) {
+            return quad.voxel == GLASS && quad.face == 1;
+        }));
+    }
+
+    SECTION("Neighbour chunks")
+    {
+        const auto positiveXFaces = [&] {
+            return std::ranges::count_if(mesh.quads, [](const MeshQuad& quad) { return quad.face == 1; });
+        };
+        chunk.set({31, 0, 0}, STONE);
+        Chunk neighbour;
+        neighbour.set({0, 0, 0}, STONE);
+        ChunkBorders borders;
+        borders.gather({nullptr, &neighbour, nullptr, nullptr, nullptr, nullptr});
+        meshChunk(chunk, borders, mesh);
+        CHECK(positiveXFaces() == 0);
+
+        neighbour.set({0, 0, 0}, GLASS);
+        borders.gather({nullptr, &neighbour, nullptr, nullptr, nullptr, nullptr});
+        meshChunk(chunk, borders, mesh);
+        CHECK(positiveXFaces() == 1);
+    }
+}
+
+TEST_CASE("Threaded Chunk Meshing")
+{
+    ThreadPool pool(2);
+    ChunkMap chunks;
+    Chunk chunk;
+    chunk.set({1, 1, 1}, STONE);
+    for (int x = 0; x < 4; x++)
+        chunks.insert({x, 0, 0}, Chunk(chunk));
+
+    ChunkMesher mesher(pool);
+    for (int x = 0; x < 4; x++)
+        CHECK(mesher.submit(chunks, {x, 0, 0}));
+    CHECK_FALSE(mesher.submit(chunks, {9, 9, 9}));
+    // Resubmitting replaces the earlier request and cancelling drops it
+    CHECK(mesher.submit(chunks, {0, 0, 0}));
+    mesher.cancel({3, 0, 0});
+    CHECK(mesher.pending() == 3);
+
+    pool.waitIdle();
+    std::vector<MeshedChunk> meshes;
+    CHECK(mesher.poll(meshes) == 3);
+    CHECK(mesher.pending() == 0);
+    for (const MeshedChunk& meshed : meshes) {
+        CHECK(meshed.position != glm::i32vec3(3, 0, 0));
+        CHECK(meshed.mesh.quads.size() == 6);
+    }
+}
+
+TEST_CASE("Incremental Remeshing")
+{
+    const TerrainGenerator generator(42);
+    auto [position, chunk] = surfaceChunk(generator);
+    Chunk neighbour = generator.genChunk(position + glm::i32vec3(1, 0, 0));
+    ChunkBorders borders;
+    borders.gather({nullptr, &neighbour, nullptr, nullptr, nullptr, nullptr});
+
+    ChunkMesh previous, incremental, full;
+    meshChunk(chunk, borders, previous);
+    std::mt19937 rng(7);
+    const Voxel voxels[] = {Voxel{}, STONE, GLASS};
+    for (int round = 0; round < 50; round++) {
+        chunk.clearDirty();
+        for (int i = 0; i <= round % 4; i++) {
+            const auto coord = [&] { return std::int32_t(rng() % Chunk::CHUNK_DIM); };
+            chunk.set({coord(), coord(), coord()}, voxels[rng() % 3]);
+        }
+        DirtyLayers dirty = chunk.getDirty();
+        if (round % 3 == 0) {
+            const std::int32_t y = rng() % Chunk::CHUNK_DIM, z = rng() % Chunk::CHUNK_DIM;
+            neighbour.set({0, y, z}, voxels[rng() % 3]);
+            borders.gather({nullptr, &neighbour, nullptr, nullptr, nullptr, nullptr});
+            dirty.markNeighbour(1);
+        }
+
+        remeshChunk(chunk, borders, dirty, previous, incremental);
+        meshChunk(chunk, borders, full);
+        REQUIRE(incremental.quads == full.quads);
+        std::swap(previous, incremental);
+    }
+}
+
+TEST_CASE("Remesh Scheduling")
+{
+    ThreadPool pool(2);
+    StreamingSettings streaming;
+    streaming.radius = 1;
+    streaming.verticalRadius = 1;
+    Terrain terrain(7, pool, streaming);
+    ChunkMesher mesher(pool);
+    RemeshScheduler scheduler(terrain, mesher);
+
+    ankerl::unordered_dense::map<glm::i32vec3, ChunkMesh, ChunkPositionHash> current;
+    std::vector<MeshedChunk> meshes;
+    const glm::vec3 observer(0.0f);
+    const auto runFrame = [&] {
+        terrain.update(std::span(&observer, 1));
+        scheduler.update();
+        pool.waitIdle();
+        meshes.clear();
+        scheduler.poll(meshes);
+        for (const MeshedChunk& meshed : meshes)
+            current[meshed.position] = meshed.mesh;
+    };
+    const auto matchesFullMesh = [&](const glm::i32vec3 position) {
+        const ChunkMap& chunks = terrain.getChunks();
+        ChunkBorders borders;
+        borders.gather(chunks.neighbours(position));
+        ChunkMesh full;
+        meshChunk(*chunks.find(position), borders, full);
+        return full.quads == current[position].quads;
+    };
+
+    for (int frame = 0; frame < 1000; frame++) {
+        runFrame();
+        const ChunkStreamer& streamer = terrain.getStreamer();
+        if (streamer.queuedWork() + streamer.pendingLoads() + scheduler.queued() + scheduler.inFlight() == 0)
+            break;
+    }
+    REQUIRE(terrain.getChunks().size() == 15);
+    REQUIRE(current.size() == terrain.getChunks().size());
+    terrain.getChunks().forEach([&](const glm::i32vec3 position, const Chunk&) {
+        CHECK(matchesFullMesh(position));
+    });
+
+    SECTION("Edits in a frame are merged and only touch neighbours on a shared border")
+    {
+        CHECK(terrain.setVoxel({31, 4, 4}, TINTED_GLASS));
+        CHECK(terrain.setVoxel({10, 4, 4}, GLASS));
+        CHECK(terrain.getVoxel({10, 4, 4}) == GLASS);
+        CHECK_FALSE(terrain.setVoxel({1000, 0, 0}, STONE));
+        runFrame();
+        REQUIRE(meshes.size() == 2);
+        for (const MeshedChunk& meshed : meshes) {
+            CHECK((meshed.position == glm::i32vec3(0, 0, 0) || meshed.position == glm::i32vec3(1, 0, 0)));
+            CHECK(matchesFullMesh(meshed.position));
+        }
+    }
+
+    SECTION("Visible edits are submitted before background work")
+    {
+        scheduler.settings.maxBackgroundJobsPerFrame = 0;
+        terrain.setVoxel({-20, 4, 4}, TINTED_GLASS, RemeshPriority::BACKGROUND);
+        runFrame();
+        CHECK(meshes.empty());
+        CHECK(scheduler.queued() == 1);
+
+        terrain.setVoxel({4, 4, 4}, TINTED_GLASS);
+        runFrame();
+        REQUIRE(meshes.size() == 1);
+        CHECK(meshes[0].position == glm::i32vec3(0, 0, 0));
+        CHECK(matchesFullMesh({0, 0, 0}));
+
+        scheduler.settings.maxBackgroundJobsPerFrame = 64;
+        runFrame();
+        REQUIRE(meshes.size() == 1);
+        CHECK(meshes[0].position == glm::i32vec3(-1, 0, 0));
+        CHECK(matchesFullMesh({-1, 0, 0}));
+    }
+}
+
+TEST_CASE("Lit Remesh Scheduling")
+{
+    ThreadPool pool(2);
+    Terrain terrain(7, pool);
+    test::loadFlatChunks(terrain, {-1, -1, 0}, {1, 1, 1}, STONE);
+    ChunkMesher mesher(pool);
+    RemeshScheduler scheduler(terrain, mesher);
+    constexpr Voxel torch{6, 0};
+    std::vector<std::uint8_t> emission(torch.id + 1, 0);
+    emission[torch.id] = 14;
+    LightEngine light(terrain.getChunks(), emission);
+    scheduler.setLighting(&light);
+    terrain.getChunks().forEach([&](const glm::i32vec3 position, const Chunk&) { light.addChunk(position); });
+
+    std::vector<MeshedChunk> meshes;
+    const auto runFrame = [&] {
+        light.voxelsChanged(terrain.getJournal());
+        light.update(pool);
+        scheduler.update();
+        pool.waitIdle();
+        meshes.clear();
+        scheduler.poll(meshes);
+    };
+    const auto matchesLitMesh = [&](const MeshedChunk& meshed) {
+        const ChunkMap& chunks = terrain.getChunks();
+        ChunkBorders borders;
+        borders.gather(chunks.neighbours(meshed.position));
+        borders.gatherLight(light.neighbours(meshed.position));
+        ChunkMesh full;
+        meshChunk(*chunks.find(meshed.position), borders, full, light.find(meshed.position));
+        return full.quads == meshed.mesh.quads;
+    };
+
+    // Chunks not meshed yet are meshed in full when their light is first baked
+    runFrame();
+    CHECK_FALSE(meshes.empty());
+    for (const MeshedChunk& meshed : meshes)
+        CHECK(matchesLitMesh(meshed));
+    CHECK(light.getChanged().empty());
+
+    // The torch's light crosses into the neighbour, which is remeshed without being edited itself
+    REQUIRE(terrain.setVoxel({1, 5, 1}, torch));
+    runFrame();
+    const auto neighbour = std::ranges::find(meshes, glm::i32vec3(-1, 0, 0), &MeshedChunk::position);
+    REQUIRE(neighbour != meshes.end());
+    CHECK(matchesLitMesh(*neighbour));
+    CHECK(std::ranges::any_of(neighbour->mesh.quads, [](const MeshQuad& quad) {
+        return (quad.light & ChunkLight::MAX_LEVEL) > 0;
+    }));
+}
+
+TEST_CASE("Chunk Meshing Benchmark", "[.][benchmark]")
+{
+    // Mesh a block of generated terrain spanning the whole height range of the surface, only chunks with
+    // every neighbour loaded are measured
+    const TerrainGenerator generator(42);
+    ChunkMap chunks;
+    for (int x = 0; x < 6; x++) {
+        for (int y = 0; y < 6; y++) {
+            for (int z = -3; z <= 2; z++)
+                chunks.insert({x, y, z}, generator.genChunk({x, y, z}));
+        }
+    }
+    std::vector<std::pair<const Chunk*, ChunkBorders>> inputs;
+    chunks.forEach([&](const glm::i32vec3 position, const Chunk& chunk) {
+        const auto neighbours = std::as_const(chunks).neighbours(position);
+        if (std::ranges::find(neighbours, nullptr) != neighbours.end())
+            return;
+        inputs.emplace_back(&chunk, ChunkBorders{});
+        inputs.back().second.gather(neighbours);
+    });
+    REQUIRE(!inputs.empty());
+
+    ChunkMesh mesh;
+    std::size_t triangles = 0, faces = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& [chunk, borders] : inputs) {
+        meshChunk(*chunk, borders, mesh);
+        triangles += mesh.triangleCount();
+        faces += faceArea(mesh);
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    spdlog::info(
+        "Meshed {} chunks: {:.3f} ms per chunk, {:.0f} triangles per chunk ({:.0f} before greedy merging)",
+        inputs.size(),
+        elapsed.count() / double(inputs.size()),
+        double(triangles) / double(inputs.size()),
+        double(faces * 2) / double(inputs.size())
+    );
+
+    const auto surface = std::ranges::max_element(inputs, {}, [](const auto& input) {
+        return input.first->paletteSize();
+    });
+    BENCHMARK("Surface chunk")
+    {
+        meshChunk(*surface->first, surface->second, mesh);
+        return mesh.triangleCount();
+    };
+
+    BENCHMARK("All chunks")
+    {
+        std::size_t count = 0;
+        for (const auto& [chunk, borders] : inputs) {
+            meshChunk(*chunk, borders, mesh);
+            count += mesh.triangleCount();
+        }
+        return count;
+    };
+
+    // A single voxel edit in the middle of the surface chunk, rebuilding only the slices it touches
+    ChunkMesh previous;
+    meshChunk(*surface->first, surface->second, previous);
+    DirtyLayers dirty;
+    dirty.mark({16, 16, 16});
+    BENCHMARK("Surface chunk single edit remesh")
+    {
+        remeshChunk(*surface->first, surface->second, dirty, previous, mesh);
+        return mesh.triangleCount();
+    };
+}
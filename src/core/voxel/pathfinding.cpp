@@ -0,0 +1,761 @@
+#include "core/utility/thread_pool.h"
+#include "core/utility/thread_scratch.h"
+#include "pathfinding.h"
+#include "terrain.h"
+#include <algorithm>
+#include <glm/common.hpp>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <tuple>
+
+namespace dragonfire::voxel {
+
+static constexpr auto DIM = std::int32_t(Chunk::CHUNK_DIM);
+static constexpr glm::ivec3 UP(0, 0, 1);
+static constexpr std::array<glm::ivec3, 4> HORIZONTAL = {{{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}}};
+
+static bool isSolid(const Voxel voxel, const std::span<const std::uint8_t> solid) noexcept
+{
+    return voxel.id < solid.size() ? solid[voxel.id] != 0 : voxel.id != 0;
+}
+
+static bool isInside(const glm::ivec3 local) noexcept
+{
+    return local.x >= 0 && local.y >= 0 && local.z >= 0 && local.x < DIM && local.y < DIM && local.z < DIM;
+}
+
+static bool lessThan(const glm::i32vec3 a, const glm::i32vec3 b) noexcept
+{
+    return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+}
+
+Passability::Passability(const Chunk& chunk, const std::span<const std::uint8_t> solid) : uniform(false)
+{
+    if (chunk.isUniform()) {
+        uniform = !isSolid(chunk.get(0), solid);
+        return;
+    }
+    // Air is always passable, so only the occupied voxels are read
+    bits.assign(Chunk::CHUNK_SIZE / 64, ~std::uint64_t(0));
+    chunk.forEachOccupied([&](const std::size_t index) {
+        if (isSolid(chunk.get(index), solid))
+            bits[index / 64] &= ~(std::uint64_t(1) << index % 64);
+    });
+}
+
+struct Pathfinder::ChunkGraph {
+    struct Edge {
+        std::uint32_t target;
+        std::uint32_t cost;
+    };
+
+    /// World position of each entrance node
+    std::vector<glm::i32vec3> nodes;
+    /// Paths from node i to the other nodes of the chunk, edges[firstEdge[i]] up to edges[firstEdge[i + 1]]
+    std::vector<std::uint32_t> firstEdge;
+    std::vector<Edge> edges;
+    /// Voxels in neighbouring chunks node i steps to, laid out the same way as edges
+    std::vector<std::uint32_t> firstCrossing;
+    std::vector<glm::i32vec3> crossings;
+    ankerl::unordered_dense::map<glm::i32vec3, std::uint32_t, ChunkPositionHash> index;
+};
+
+struct Pathfinder::Snapshot {
+    template<typename T>
+    using ChunkTable =
+        ankerl::unordered_dense::map<glm::i32vec3, std::shared_ptr<const T>, ChunkPositionHash>;
+
+    ChunkTable<Passability> passability;
+    ChunkTable<ChunkGraph> graphs;
+};
+
+/// Passability of the 3^3 chunks around a chunk, read with positions relative to the center chunk
+class WalkView {
+public:
+    explicit WalkView(const std::array<const Passability*, 27>& chunks) : chunks(chunks) {}
+
+    /// Unloaded chunks are neither passable nor blocked, so nothing walks into or stands on them
+    [[nodiscard]] bool passable(const glm::ivec3 local) const noexcept
+    {
+        const Passability* chunk = find(local);
+        return chunk != nullptr && chunk->get(Chunk::linearIndex(local - offset(local) * DIM));
+    }
+
+    [[nodiscard]] bool blocked(const glm::ivec3 local) const noexcept
+    {
+        const Passability* chunk = find(local);
+        return chunk != nullptr && !chunk->get(Chunk::linearIndex(local - offset(local) * DIM));
+    }
+
+    /// Whether an agent fits in the voxel and the one above it, standing on a solid voxel
+    [[nodiscard]] bool standable(const glm::ivec3 local) const noexcept
+    {
+        return passable(local) && passable(local + UP) && blocked(local - UP);
+    }
+
+    /***
+     * @brief Calls func with every voxel an agent standing at from can move to
+     *
+     * Moves are symmetric, an agent that can move from a to b can also move from b to a.
+     */
+    template<typename Func>
+    void forEachMove(const glm::ivec3 from, Func&& func) const
+    {
+        for (const glm::ivec3 direction : HORIZONTAL) {
+            const glm::ivec3 side = from + direction;
+            if (standable(side))
+                func(side);
+            else if (standable(side + UP) && passable(from + UP + UP))
+                func(side + UP);
+            else if (standable(side - UP) && passable(side + UP))
+                func(side - UP);
+        }
+    }
+
+private:
+    std::array<const Passability*, 27> chunks;
+
+    /// Offset of the chunk holding a position, positions must be within one chunk of the center
+    static glm::ivec3 offset(const glm::ivec3 local) noexcept { return (local + DIM) / DIM - 1; }
+
+    [[nodiscard]] const Passability* find(const glm::ivec3 local) const noexcept
+    {
+        const glm::ivec3 chunk = offset(local) + 1;
+        return chunks[(chunk.x * 3 + chunk.y) * 3 + chunk.z];
+    }
+};
+
+static WalkView viewOf(const Pathfinder::Snapshot& snapshot, const glm::i32vec3 position)
+{
+    std::array<const Passability*, 27> chunks{};
+    for (std::int32_t x = -1; x <= 1; x++) {
+        for (std::int32_t y = -1; y <= 1; y++) {
+            for (std::int32_t z = -1; z <= 1; z++) {
+                const auto found = snapshot.passability.find(position + glm::i32vec3(x, y, z));
+                if (found != snapshot.passability.end())
+                    chunks[((x + 1) * 3 + y + 1) * 3 + z + 1] = found->second.get();
+            }
+        }
+    }
+    return WalkView(chunks);
+}
+
+static const Pathfinder::ChunkGraph* graphOf(
+    const Pathfinder::Snapshot& snapshot,
+    const glm::i32vec3 position
+)
+{
+    const auto found = snapshot.graphs.find(position);
+    return found == snapshot.graphs.end() ? nullptr : found->second.get();
+}
+
+/// Lower bound on the moves between two voxels, each move goes one voxel sideways and at most one up or down
+static std::uint32_t heuristic(const glm::i32vec3 a, const glm::i32vec3 b) noexcept
+{
+    const glm::i32vec3 delta = glm::abs(a - b);
+    return std::uint32_t(std::max(delta.x + delta.y, delta.z));
+}
+
+/// Searches over the voxels an agent can stand in inside the center chunk of a view
+struct LocalSearch {
+    static constexpr std::uint16_t UNVISITED = std::numeric_limits<std::uint16_t>::max();
+    static_assert(Chunk::CHUNK_SIZE < UNVISITED, "voxel indices and distances must fit in 16 bits");
+
+    std::vector<std::uint16_t> distance = std::vector<std::uint16_t>(Chunk::CHUNK_SIZE, UNVISITED);
+    std::vector<std::uint16_t> parent = std::vector<std::uint16_t>(Chunk::CHUNK_SIZE);
+    /// Voxels in the order they were visited, so they can be reset quickly
+    std::vector<std::uint16_t> visited;
+    /// Open voxels of find, as the estimated cost in the high 16 bits and the voxel in the low 16 bits
+    std::vector<std::uint32_t> open;
+
+    /// Breadth first search from start, visiting every voxel reachable inside the chunk
+    void run(const WalkView& view, const glm::ivec3 start)
+    {
+        reset(start);
+        // Visited voxels are in breadth first order, so the list is also the queue
+        for (std::size_t head = 0; head < visited.size(); head++) {
+            const std::uint16_t current = visited[head];
+            view.forEachMove(Chunk::position(current), [&](const glm::ivec3 next) {
+                if (!isInside(next))
+                    return;
+                const auto index = std::uint16_t(Chunk::linearIndex(next));
+                if (distance[index] != UNVISITED)
+                    return;
+                distance[index] = std::uint16_t(distance[current] + 1);
+                parent[index] = current;
+                visited.push_back(index);
+            });
+        }
+    }
+
+    /***
+     * @brief A* search from start to goal, which on open ground only visits the voxels near the shortest path
+     * @return whether the goal was reached
+     */
+    bool find(const WalkView& view, const glm::ivec3 start, const glm::ivec3 goal)
+    {
+        reset(start);
+        const auto target = std::uint16_t(Chunk::linearIndex(goal));
+        const auto entry = [&](const std::uint16_t index) {
+            const std::uint32_t estimate = distance[index] + heuristic(Chunk::position(index), goal);
+            return estimate << 16 | index;
+        };
+        open.clear();
+        open.push_back(entry(visited.front()));
+        while (!open.empty()) {
+            std::ranges::pop_heap(open, std::greater{});
+            const std::uint32_t top = open.back();
+            open.pop_back();
+            const auto current = std::uint16_t(top & 0xffff);
+            if (current == target)
+                return true;
+            // Voxels are pushed again when a shorter path is found, so skip the older entries
+            if (top != entry(current))
+                continue;
+            view.forEachMove(Chunk::position(current), [&](const glm::ivec3 next) {
+                if (!isInside(next))
+                    return;
+                const auto index = std::uint16_t(Chunk::linearIndex(next));
+                if (distance[index] <= distance[current] + 1)
+                    return;
+                if (distance[index] == UNVISITED)
+                    visited.push_back(index);
+                distance[index] = std::uint16_t(distance[current] + 1);
+                parent[index] = current;
+                open.push_back(entry(index));
+                std::ranges::push_heap(open, std::greater{});
+            });
+        }
+        return false;
+    }
+
+    [[nodiscard]] bool reached(const glm::ivec3 local) const noexcept
+    {
+        return distance[Chunk::linearIndex(local)] != UNVISITED;
+    }
+
+    void reset(const glm::ivec3 start)
+    {
+        for (const std::uint16_t index : visited)
+            distance[index] = UNVISITED;
+        visited.clear();
+        const auto first = std::uint16_t(Chunk::linearIndex(start));
+        distance[first] = 0;
+        parent[first] = first;
+        visited.push_back(first);
+    }
+
+    /// Appends the world positions after the start up to a visited voxel
+    void appendPath(const glm::i32vec3 origin, const glm::ivec3 target, std::vector<glm::i32vec3>& out) const
+    {
+        const std::size_t first = out.size();
+        for (auto index = std::uint16_t(Chunk::linearIndex(target)); parent[index] != index;
+             index = parent[index])
+            out.push_back(origin + Chunk::position(index));
+        std::reverse(out.begin() + std::ptrdiff_t(first), out.end());
+    }
+};
+
+/***
+ * @brief Finds the entrances of a chunk and the shortest paths between them
+ *
+ * A crossing is a move from a voxel of the chunk into a neighbouring chunk. Crossings into the same chunk
+ * whose voxels are a move apart on both sides form an entrance, and the middle crossing of each entrance
+ * becomes a node. The middle is picked from the crossings ordered the same way from either side, so both
+ * chunks pick the same pair of voxels and their graphs link up.
+ */
+static std::shared_ptr<const Pathfinder::ChunkGraph> buildGraph(
+    const glm::i32vec3 position,
+    const WalkView& view
+)
+{
+    struct Crossing {
+        glm::ivec3 from, to;
+    };
+
+    std::vector<Crossing> crossings;
+    for (std::int32_t x = 0; x < DIM; x++) {
+        for (std::int32_t y = 0; y < DIM; y++) {
+            const bool edge = x == 0 || y == 0 || x == DIM - 1 || y == DIM - 1;
+            for (std::int32_t z = 0; z < DIM; z += edge ? 1 : DIM - 1) {
+                if (!view.standable({x, y, z}))
+                    continue;
+                view.forEachMove({x, y, z}, [&](const glm::ivec3 to) {
+                    if (!isInside(to))
+                        crossings.push_back({{x, y, z}, to});
+                });
+            }
+        }
+    }
+    // Sorted by the voxel inside, so the crossings of a voxel can be found by binary search
+    const auto byFrom = [](const Crossing& crossing) { return Chunk::linearIndex(crossing.from); };
+    std::ranges::sort(crossings, {}, byFrom);
+
+    std::vector<std::size_t> groups(crossings.size());
+    std::iota(groups.begin(), groups.end(), 0);
+    const auto root = [&](std::size_t i) {
+        while (groups[i] != i)
+            i = groups[i] = groups[groups[i]];
+        return i;
+    };
+    const auto chunkOffset = [](const glm::ivec3 local) { return (local + DIM) / DIM - 1; };
+    std::vector<glm::ivec3> outside;
+    for (std::size_t i = 0; i < crossings.size(); i++) {
+        const Crossing& crossing = crossings[i];
+        outside.clear();
+        view.forEachMove(crossing.to, [&](const glm::ivec3 to) { outside.push_back(to); });
+        view.forEachMove(crossing.from, [&](const glm::ivec3 from) {
+            if (!isInside(from))
+                return;
+            const auto range = std::ranges::equal_range(crossings, Chunk::linearIndex(from), {}, byFrom);
+            for (const Crossing& other : range) {
+                const bool adjacent = std::ranges::find(outside, other.to) != outside.end();
+                if (adjacent && chunkOffset(other.to) == chunkOffset(crossing.to))
+                    groups[root(std::size_t(&other - crossings.data()))] = root(i);
+            }
+        });
+    }
+
+    const glm::i32vec3 origin = position * DIM;
+    std::vector<std::vector<Crossing>> entrances;
+    ankerl::unordered_dense::map<std::size_t, std::size_t> entranceOf;
+    for (std::size_t i = 0; i < crossings.size(); i++) {
+        const auto [found, inserted] = entranceOf.try_emplace(root(i), entrances.size());
+        if (inserted)
+            entrances.emplace_back();
+        entrances[found->second].push_back(crossings[i]);
+    }
+
+    auto graph = std::make_shared<Pathfinder::ChunkGraph>();
+    std::vector<std::vector<glm::i32vec3>> nodeCrossings;
+    for (std::vector<Crossing>& entrance : entrances) {
+        // Each crossing ordered as the pair of world positions with the one in the lower chunk first
+        const bool lower = lessThan(position, position + chunkOffset(entrance.front().to));
+        const auto key = [&](const Crossing& crossing) {
+            const glm::i32vec3 from = origin + crossing.from, to = origin + crossing.to;
+            const glm::i32vec3 first = lower ? from : to, second = lower ? to : from;
+            return std::make_tuple(first.x, first.y, first.z, second.x, second.y, second.z);
+        };
+        std::ranges::sort(entrance, [&](const Crossing& a, const Crossing& b) { return key(a) < key(b); });
+        const Crossing& middle = entrance[entrance.size() / 2];
+        const glm::i32vec3 node = origin + middle.from;
+        const auto [found, inserted] = graph->index.try_emplace(node, std::uint32_t(graph->nodes.size()));
+        if (inserted) {
+            graph->nodes.push_back(node);
+            nodeCrossings.emplace_back();
+        }
+        nodeCrossings[found->second].push_back(origin + middle.to);
+    }
+
+    LocalSearch& search = threadScratch<LocalSearch>();
+    graph->firstEdge.reserve(graph->nodes.size() + 1);
+    graph->firstCrossing.reserve(graph->nodes.size() + 1);
+    for (std::size_t i = 0; i < graph->nodes.size(); i++) {
+        graph->firstEdge.push_back(std::uint32_t(graph->edges.size()));
+        graph->firstCrossing.push_back(std::uint32_t(graph->crossings.size()));
+        graph->crossings.insert(graph->crossings.end(), nodeCrossings[i].begin(), nodeCrossings[i].end());
+        search.run(view, graph->nodes[i] - origin);
+        for (std::size_t j = 0; j < graph->nodes.size(); j++) {
+            const glm::ivec3 local = graph->nodes[j] - origin;
+            if (i != j && search.reached(local))
+                graph->edges.push_back({std::uint32_t(j), search.distance[Chunk::linearIndex(local)]});
+        }
+    }
+    graph->firstEdge.push_back(std::uint32_t(graph->edges.size()));
+    graph->firstCrossing.push_back(std::uint32_t(graph->crossings.size()));
+    return graph;
+}
+
+/***
+ * @brief Finds a path over the chunk graphs of a snapshot
+ *
+ * The start and goal are linked to the nodes of their chunks by a search inside each chunk, then A* finds
+ * the shortest path over the nodes, which is refined into voxels one chunk at a time.
+ */
+static PathResult solve(
+    const Pathfinder::Snapshot& snapshot,
+    const std::uint64_t id,
+    const glm::i32vec3 start,
+    const glm::i32vec3 goal,
+    const std::uint32_t maxExpanded
+)
+{
+    PathResult result{id};
+    const auto [startChunk, startLocal] = Chunk::splitPosition(start);
+    const auto [goalChunk, goalLocal] = Chunk::splitPosition(goal);
+    const WalkView startView = viewOf(snapshot, startChunk);
+    const WalkView goalView = viewOf(snapshot, goalChunk);
+    if (!startView.standable(startLocal) || !goalView.standable(goalLocal))
+        return result;
+    LocalSearch& search = threadScratch<LocalSearch>();
+    if (startChunk == goalChunk) {
+        if (search.find(startView, startLocal, goalLocal)) {
+            result.path.push_back(start);
+            search.appendPath(startChunk * DIM, goalLocal, result.path);
+            return result;
+        }
+    }
+    const Pathfinder::ChunkGraph* startGraph = graphOf(snapshot, startChunk);
+    const Pathfinder::ChunkGraph* goalGraph = graphOf(snapshot, goalChunk);
+    if (startGraph == nullptr || goalGraph == nullptr)
+        return result;
+
+    // Moves are symmetric, so the distance from the goal to a node is the distance from the node to the goal
+    std::vector<std::uint32_t> goalCosts(goalGraph->nodes.size(), std::numeric_limits<std::uint32_t>::max());
+    search.run(goalView, goalLocal);
+    for (std::size_t i = 0; i < goalGraph->nodes.size(); i++) {
+        const glm::ivec3 local = goalGraph->nodes[i] - goalChunk * DIM;
+        if (search.reached(local))
+            goalCosts[i] = search.distance[Chunk::linearIndex(local)];
+    }
+
+    // Abstract nodes are keyed by their world position, the start and goal by positions no node can have
+    constexpr glm::i32vec3 START(std::numeric_limits<std::int32_t>::min(), 0, 0);
+    constexpr glm::i32vec3 GOAL(std::numeric_limits<std::int32_t>::min(), 1, 0);
+    struct Visit {
+        std::uint32_t cost;
+        glm::i32vec3 parent;
+        bool closed;
+    };
+    struct Open {
+        std::uint32_t estimate, cost;
+        glm::i32vec3 node;
+
+        /// Lowest estimate first, preferring the node furthest along on ties
+        bool operator<(const Open& other) const noexcept
+        {
+            return std::tie(estimate, other.cost) > std::tie(other.estimate, cost);
+        }
+    };
+    ankerl::unordered_dense::map<glm::i32vec3, Visit, ChunkPositionHash> visits;
+    std::priority_queue<Open> open;
+    const auto push = [&](const glm::i32vec3 node, const glm::i32vec3 parent, const std::uint32_t cost) {
+        const auto [found, inserted] = visits.try_emplace(node, Visit{cost, parent, false});
+        if (!inserted) {
+            if (found->second.closed || found->second.cost <= cost)
+                return;
+            found->second = {cost, parent, false};
+        }
+        open.push({cost + (node == GOAL ? 0 : heuristic(node, goal)), cost, node});
+    };
+
+    search.run(startView, startLocal);
+    for (const glm::i32vec3 node : startGraph->nodes) {
+        const glm::ivec3 local = node - startChunk * DIM;
+        if (search.reached(local))
+            push(node, START, search.distance[Chunk::linearIndex(local)]);
+    }
+    bool found = false;
+    while (!open.empty()) {
+        const Open top = open.top();
+        open.pop();
+        Visit& visit = visits.find(top.node)->second;
+        if (visit.closed || visit.cost != top.cost)
+            continue;
+        visit.closed = true;
+        if (top.node == GOAL) {
+            found = true;
+            break;
+        }
+        if (++result.expanded > maxExpanded)
+            return result;
+        const glm::i32vec3 chunk = Chunk::chunkOf(top.node);
+        const Pathfinder::ChunkGraph& graph = *graphOf(snapshot, chunk);
+        const std::uint32_t node = graph.index.find(top.node)->second;
+        if (chunk == goalChunk && goalCosts[node] != std::numeric_limits<std::uint32_t>::max())
+            push(GOAL, top.node, top.cost + goalCosts[node]);
+        for (std::uint32_t i = graph.firstEdge[node]; i < graph.firstEdge[node + 1]; i++)
+            push(graph.nodes[graph.edges[i].target], top.node, top.cost + graph.edges[i].cost);
+        for (std::uint32_t i = graph.firstCrossing[node]; i < graph.firstCrossing[node + 1]; i++) {
+            // Neighbours built from older passability may not have a matching node yet
+            const glm::i32vec3 crossing = graph.crossings[i];
+            const Pathfinder::ChunkGraph* other = graphOf(snapshot, Chunk::chunkOf(crossing));
+            if (other != nullptr && other->index.contains(crossing))
+                push(crossing, top.node, top.cost + 1);
+        }
+    }
+    if (!found)
+        return result;
+
+    std::vector<glm::i32vec3> waypoints{goal};
+    for (glm::i32vec3 node = visits.find(GOAL)->second.parent; node != START;) {
+        waypoints.push_back(node);
+        node = visits.find(node)->second.parent;
+    }
+    std::reverse(waypoints.begin(), waypoints.end());
+    result.path.push_back(start);
+    for (const glm::i32vec3 waypoint : waypoints) {
+        const auto [chunk, local] = Chunk::splitPosition(result.path.back());
+        const auto [nextChunk, nextLocal] = Chunk::splitPosition(waypoint);
+        if (chunk != nextChunk) {
+            // Crossing into the next chunk is a single move
+            result.path.push_back(waypoint);
+            continue;
+        }
+        if (local == nextLocal)
+            continue;
+        if (!search.find(viewOf(snapshot, chunk), local, nextLocal)) {
+            // The graph was built before the latest passability of the chunk, it will be rebuilt
+            result.path.clear();
+            return result;
+        }
+        search.appendPath(chunk * DIM, nextLocal, result.path);
+    }
+    return result;
+}
+
+Pathfinder::Pathfinder(
+    Terrain& terrain,
+    ThreadPool& pool,
+    const std::span<const std::uint8_t> solid,
+    const PathfinderSettings& settings
+)
+    : settings(settings), terrain(terrain), pool(pool), solid(solid)
+{
+}
+
+Pathfinder::~Pathfinder()
+{
+    // Tasks still queued on the pool reference this
+    tasks.wait();
+}
+
+std::uint64_t Pathfinder::request(const glm::i32vec3 start, const glm::i32vec3 goal)
+{
+    const std::uint64_t id = nextId++;
+    queued.push_back({id, start, goal});
+    requested++;
+    return id;
+}
+
+void Pathfinder::update()
+{
+    for (const glm::i32vec3 position : terrain.getStreamer().getUnloaded()) {
+        const auto found = chunks.find(position);
+        if (found == chunks.end())
+            continue;
+        building -= found->second.buildingPassability + found->second.buildingGraph;
+        chunks.erase(found);
+        markNeighbours(position);
+        snapshotDirty = true;
+    }
+    for (const glm::i32vec3 position : terrain.getStreamer().getLoaded())
+        addChunk(position);
+    const EditJournal& journal = terrain.getJournal();
+    for (const JournalChunk& edited : journal.chunks()) {
+        // Only voxels within two of the border can change the moves of the neighbours
+        const auto nearBorder = [](const EditRun& run) {
+            if (run.length >= DIM)
+                return true;
+            const auto near = [](const std::int32_t value) { return value < 2 || value >= DIM - 2; };
+            for (std::size_t i = run.start; i < std::size_t(run.start + run.length); i++) {
+                const glm::ivec3 local = Chunk::position(i);
+                if (near(local.x) || near(local.y) || near(local.z))
+                    return true;
+            }
+            return false;
+        };
+        invalidate(edited.position, std::ranges::any_of(journal.runs(edited), nearBorder));
+    }
+    applyBuilds();
+    submitBuilds();
+    submitRequests();
+}
+
+std::size_t Pathfinder::poll(std::vector<PathResult>& out)
+{
+    const std::size_t count = solved.drain(out);
+    requested -= count;
+    return count;
+}
+
+void Pathfinder::addChunk(const glm::i32vec3 position)
+{
+    ChunkState& state = chunks[position];
+    state.passabilityVersion = ++versions;
+    state.passabilityDirty = true;
+    state.neighboursDirty = true;
+}
+
+std::size_t Pathfinder::graphCount() const noexcept
+{
+    const auto built = [](const auto& entry) { return entry.second.graph != nullptr; };
+    return std::size_t(std::ranges::count_if(chunks, built));
+}
+
+std::size_t Pathfinder::nodeCount() const noexcept
+{
+    std::size_t count = 0;
+    for (const auto& [position, state] : chunks)
+        count += state.graph == nullptr ? 0 : state.graph->nodes.size();
+    return count;
+}
+
+std::size_t Pathfinder::pendingBuilds() const noexcept
+{
+    std::size_t count = 0;
+    for (const auto& [position, state] : chunks) {
+        count += state.passabilityDirty || state.buildingPassability;
+        count += state.graphDirty || state.buildingGraph;
+    }
+    return count;
+}
+
+void Pathfinder::invalidate(const glm::i32vec3 position, const bool neighbours)
+{
+    const auto found = chunks.find(position);
+    if (found == chunks.end())
+        return;
+    // The old passability and graph are kept for searches until the new ones are built
+    found->second.passabilityVersion = ++versions;
+    found->second.passabilityDirty = true;
+    found->second.neighboursDirty |= neighbours;
+}
+
+bool Pathfinder::neighbourPending(const glm::i32vec3 position) const
+{
+    for (std::int32_t x = -1; x <= 1; x++) {
+        for (std::int32_t y = -1; y <= 1; y++) {
+            for (std::int32_t z = -1; z <= 1; z++) {
+                const auto found = chunks.find(position + glm::i32vec3(x, y, z));
+                if (found == chunks.end())
+                    continue;
+                if (found->second.passabilityDirty || found->second.buildingPassability)
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+void Pathfinder::markNeighbours(const glm::i32vec3 position)
+{
+    for (std::int32_t x = -1; x <= 1; x++) {
+        for (std::int32_t y = -1; y <= 1; y++) {
+            for (std::int32_t z = -1; z <= 1; z++) {
+                const auto found = chunks.find(position + glm::i32vec3(x, y, z));
+                if (found == chunks.end() || (x == 0 && y == 0 && z == 0))
+                    continue;
+                found->second.graphVersion = ++versions;
+                found->second.graphDirty = true;
+            }
+        }
+    }
+}
+
+void Pathfinder::applyBuilds()
+{
+    builtResults.clear();
+    built.drain(builtResults);
+    for (Built& result : builtResults) {
+        // Chunks unloaded while building were already forgotten
+        const auto found = chunks.find(result.position);
+        if (found == chunks.end())
+            continue;
+        ChunkState& state = found->second;
+        if (result.passability != nullptr) {
+            if (state.buildingPassability) {
+                state.buildingPassability = false;
+                building--;
+            }
+            if (result.version != state.passabilityVersion)
+                continue;
+            state.passability = std::move(result.passability);
+            state.graphVersion = ++versions;
+            state.graphDirty = true;
+            if (state.neighboursDirty)
+                markNeighbours(result.position);
+            state.neighboursDirty = false;
+        }
+        else {
+            if (state.buildingGraph) {
+                state.buildingGraph = false;
+                building--;
+            }
+            if (result.version != state.graphVersion)
+                continue;
+            state.graph = std::move(result.graph);
+        }
+        snapshotDirty = true;
+    }
+}
+
+void Pathfinder::submitBuilds()
+{
+    for (auto& [position, state] : chunks) {
+        if (building >= settings.maxPendingBuilds)
+            return;
+        if (!state.passabilityDirty || state.buildingPassability)
+            continue;
+        const Chunk* chunk = terrain.getChunks().find(position);
+        if (chunk == nullptr)
+            continue;
+        // Copied so the chunk can be edited while its passability is built
+        const auto copy = std::make_shared<Chunk>(*chunk);
+        state.passabilityDirty = false;
+        state.buildingPassability = true;
+        building++;
+        tasks.submit(pool, [this, copy, position, version = state.passabilityVersion] {
+            built.push({position, version, std::make_shared<Passability>(*copy, solid), nullptr});
+        });
+    }
+    for (auto& [position, state] : chunks) {
+        if (building >= settings.maxPendingBuilds)
+            return;
+        // Waiting for the neighbours' passability avoids building the graph again as each of them arrives
+        if (!state.graphDirty || state.buildingGraph || state.passability == nullptr)
+            continue;
+        if (neighbourPending(position))
+            continue;
+        // Passability is immutable once built, so sharing it with the worker is enough
+        std::array<std::shared_ptr<const Passability>, 27> neighbourhood;
+        for (std::int32_t x = -1; x <= 1; x++) {
+            for (std::int32_t y = -1; y <= 1; y++) {
+                for (std::int32_t z = -1; z <= 1; z++) {
+                    const auto found = chunks.find(position + glm::i32vec3(x, y, z));
+                    if (found != chunks.end())
+                        neighbourhood[((x + 1) * 3 + y + 1) * 3 + z + 1] = found->second.passability;
+                }
+            }
+        }
+        state.graphDirty = false;
+        state.buildingGraph = true;
+        building++;
+        tasks.submit(pool, [this, neighbourhood, position, version = state.graphVersion] {
+            std::array<const Passability*, 27> view{};
+            std::ranges::transform(neighbourhood, view.begin(), [](const auto& ptr) { return ptr.get(); });
+            built.push({position, version, nullptr, buildGraph(position, WalkView(view))});
+        });
+    }
+}
+
+void Pathfinder::submitRequests()
+{
+    if (queued.empty())
+        return;
+    if (snapshotDirty || snapshot == nullptr) {
+        auto next = std::make_shared<Snapshot>();
+        for (const auto& [position, state] : chunks) {
+            if (state.passability != nullptr)
+                next->passability.emplace(position, state.passability);
+            if (state.graph != nullptr)
+                next->graphs.emplace(position, state.graph);
+        }
+        snapshot = std::move(next);
+        snapshotDirty = false;
+    }
+    const std::size_t perTask = std::max<std::size_t>(settings.requestsPerTask, 1);
+    for (std::size_t first = 0; first < queued.size(); first += perTask) {
+        const auto end = queued.begin() + std::ptrdiff_t(std::min(queued.size(), first + perTask));
+        std::vector<Request> batch(queued.begin() + std::ptrdiff_t(first), end);
+        const std::uint32_t maxExpanded = settings.maxExpanded;
+        tasks.submit(pool, [this, batch = std::move(batch), current = snapshot, maxExpanded] {
+            for (const Request& request : batch)
+                solved.push(solve(*current, request.id, request.start, request.goal, maxExpanded));
+        });
+    }
+    queued.clear();
+}
+
+}// namespace dragonfire::voxel
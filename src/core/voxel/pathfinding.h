@@ -0,0 +1,179 @@
+#pragma once
+#include "chunk_map.h"
+#include "core/utility/completion_queue.h"
+#include "core/utility/thread_pool.h"
+#include <ankerl/unordered_dense.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace dragonfire::voxel {
+class Terrain;
+
+/// Which voxels of a chunk an agent can move through, one bit per voxel in the order of Chunk::linearIndex
+class Passability {
+public:
+    /// A chunk passable everywhere or nowhere
+    explicit Passability(const bool uniform = true) : uniform(uniform) {}
+
+    /***
+     * @param solid whether each voxel id blocks movement, such as VoxelRegistry::solidity. Ids past the end
+     * are solid unless they are air.
+     */
+    Passability(const Chunk& chunk, std::span<const std::uint8_t> solid);
+
+    [[nodiscard]] bool get(const std::size_t index) const noexcept
+    {
+        return bits.empty() ? uniform : (bits[index / 64] >> index % 64 & 1) != 0;
+    }
+
+    [[nodiscard]] bool isUniform() const noexcept { return bits.empty(); }
+
+private:
+    std::vector<std::uint64_t> bits;
+    bool uniform;
+};
+
+/// Result of a path request, delivered through Pathfinder::poll
+struct PathResult {
+    std::uint64_t id;
+    /// Positions the agent stands at from the start to the goal, both included, empty if there is no path
+    /// through the loaded terrain
+    std::vector<glm::i32vec3> path;
+    /// Abstract nodes expanded by the search, for profiling
+    std::uint32_t expanded = 0;
+};
+
+struct PathfinderSettings {
+    /// Requests solved by each task on the pool
+    std::uint32_t requestsPerTask = 8;
+    /// Abstract nodes expanded before a search gives up, so unreachable goals don't search the whole world
+    std::uint32_t maxExpanded = 20000;
+    /// Maximum number of chunk graph builds in flight at once
+    std::uint32_t maxPendingBuilds = 64;
+};
+
+/***
+ * @brief Hierarchical path finder for agents walking over voxel terrain, in the style of HPA*
+ *
+ * Agents are two voxels tall and stand on solid voxels. They move to the four horizontal neighbours of a
+ * voxel, stepping up or down by one voxel if there is headroom. Each chunk is a cluster: the walkable
+ * crossings into each neighbouring chunk are grouped into entrances, and an abstract graph links the
+ * entrances of the chunk by the length of the shortest path between them inside it. Paths are found over the
+ * abstract graphs and then refined into voxels one chunk at a time, so the cost of a search grows with the
+ * number of chunks crossed rather than the number of voxels.
+ *
+ * Chunk graphs are rebuilt on the thread pool when a chunk or one of its neighbours changes, from a snapshot
+ * of their passability. Requests are solved in batches on the pool against a snapshot of every chunk graph,
+ * so they never read the chunks themselves while the main thread edits them.
+ */
+class Pathfinder {
+public:
+    PathfinderSettings settings;
+
+    /***
+     * @param solid whether each voxel id blocks movement, see VoxelRegistry::solidity. Must outlive this.
+     */
+    Pathfinder(
+        Terrain& terrain,
+        ThreadPool& pool,
+        std::span<const std::uint8_t> solid = {},
+        const PathfinderSettings& settings = {}
+    );
+    /// Waits for any builds and searches still on the pool
+    ~Pathfinder();
+
+    /***
+     * @brief Queues a path from the voxel an agent stands in at start to the voxel it should stand in at goal
+     * @return the id of the result delivered through poll
+     */
+    std::uint64_t request(glm::i32vec3 start, glm::i32vec3 goal);
+
+    /***
+     * @brief Rebuilds the graphs of loaded and edited chunks and submits the queued requests, meant to be
+     * called once per frame
+     *
+     * Reads the terrain's edit journal and the chunks it loaded and unloaded, so it must be called after
+     * Terrain::update and before RemeshScheduler::update clears the edits.
+     */
+    void update();
+
+    /***
+     * @brief Moves every finished request to the end of out
+     * @return the number of results added to out
+     */
+    std::size_t poll(std::vector<PathResult>& out);
+
+    /// Builds the graph of a chunk that was inserted into the terrain without being streamed in
+    void addChunk(glm::i32vec3 position);
+
+    /// Number of chunks with a built graph
+    [[nodiscard]] std::size_t graphCount() const noexcept;
+
+    /// Number of entrance nodes in every built graph
+    [[nodiscard]] std::size_t nodeCount() const noexcept;
+
+    /// Number of chunk passability and graph builds queued or in flight
+    [[nodiscard]] std::size_t pendingBuilds() const noexcept;
+
+    /// Number of requests not yet delivered through poll
+    [[nodiscard]] std::size_t pendingRequests() const noexcept { return requested; }
+
+    Pathfinder(const Pathfinder& other) = delete;
+    Pathfinder& operator=(const Pathfinder& other) = delete;
+
+    /// Entrances of a chunk and the shortest paths between them, see pathfinding.cpp
+    struct ChunkGraph;
+    /// Passability and graphs of every chunk at the time requests were submitted
+    struct Snapshot;
+
+private:
+    struct Request {
+        std::uint64_t id;
+        glm::i32vec3 start, goal;
+    };
+
+    struct ChunkState {
+        std::shared_ptr<const Passability> passability;
+        std::shared_ptr<const ChunkGraph> graph;
+        /// Changed whenever the chunk or a neighbour changes, so builds started before are discarded
+        std::uint64_t passabilityVersion = 0, graphVersion = 0;
+        bool passabilityDirty = true, graphDirty = false;
+        /// Set when the chunk is loaded or edited near its border, which can change the entrances of its
+        /// neighbours
+        bool neighboursDirty = true;
+        bool buildingPassability = false, buildingGraph = false;
+    };
+
+    struct Built {
+        glm::i32vec3 position;
+        std::uint64_t version;
+        std::shared_ptr<const Passability> passability;
+        std::shared_ptr<const ChunkGraph> graph;
+    };
+
+    Terrain& terrain;
+    ThreadPool& pool;
+    std::span<const std::uint8_t> solid;
+    ankerl::unordered_dense::map<glm::i32vec3, ChunkState, ChunkPositionHash> chunks;
+    std::vector<Request> queued;
+    std::shared_ptr<const Snapshot> snapshot;
+    bool snapshotDirty = true;
+    CompletionQueue<Built> built;
+    CompletionQueue<PathResult> solved;
+    std::vector<Built> builtResults;
+    std::uint64_t nextId = 1, versions = 0;
+    std::size_t requested = 0, building = 0;
+    TaskGroup tasks;
+
+    void invalidate(glm::i32vec3 position, bool neighbours);
+    [[nodiscard]] bool neighbourPending(glm::i32vec3 position) const;
+    void markNeighbours(glm::i32vec3 position);
+    void applyBuilds();
+    void submitBuilds();
+    void submitRequests();
+};
+
+}// namespace dragonfire::voxel
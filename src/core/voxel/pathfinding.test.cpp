@@ -0,0 +1,248 @@
+#include "core/utility/thread_pool.h"
+#include "pathfinding.h"
+#include "terrain.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <catch.hpp>
+#include <chrono>
+#include <glm/common.hpp>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+
+static constexpr Voxel STONE{1, 0};
+
+/// Loads air chunks from min to max with a stone floor at z = 0, so agents stand at z = 1
+static void loadFlatChunks(
+    Terrain& terrain,
+    Pathfinder& pathfinder,
+    const glm::i32vec3 min,
+    const glm::i32vec3 max
+)
+{
+    test::loadFlatChunks(terrain, min, max, STONE);
+    terrain.getChunks().forEach([&](const glm::i32vec3 position, const Chunk&) {
+        pathfinder.addChunk(position);
+    });
+}
+
+/// Updates until every chunk graph is built
+static void settle(Pathfinder& pathfinder, Terrain& terrain, ThreadPool& pool)
+{
+    for (int i = 0; i < 100; i++) {
+        pathfinder.update();
+        terrain.clearEdits();
+        pool.waitIdle();
+        if (pathfinder.pendingBuilds() == 0)
+            return;
+    }
+    FAIL("Chunk graphs never finished building");
+}
+
+static PathResult findPath(
+    Pathfinder& pathfinder,
+    ThreadPool& pool,
+    const glm::i32vec3 start,
+    const glm::i32vec3 goal
+)
+{
+    const std::uint64_t id = pathfinder.request(start, goal);
+    std::vector<PathResult> results;
+    while (results.empty()) {
+        pathfinder.update();
+        pool.waitIdle();
+        pathfinder.poll(results);
+    }
+    REQUIRE(results.size() == 1);
+    CHECK(results[0].id == id);
+    return std::move(results[0]);
+}
+
+/// Checks every step of a path is a single move onto a voxel an agent can stand in
+static void checkPath(
+    Terrain& terrain,
+    const PathResult& result,
+    const glm::i32vec3 start,
+    const glm::i32vec3 goal
+)
+{
+    REQUIRE_FALSE(result.path.empty());
+    CHECK(result.path.front() == start);
+    CHECK(result.path.back() == goal);
+    for (std::size_t i = 0; i < result.path.size(); i++) {
+        const glm::i32vec3 position = result.path[i];
+        CHECK(terrain.getVoxel(position)->id == 0);
+        CHECK(terrain.getVoxel(position + glm::i32vec3(0, 0, 1))->id == 0);
+        CHECK(terrain.getVoxel(position - glm::i32vec3(0, 0, 1))->id != 0);
+        if (i == 0)
+            continue;
+        const glm::i32vec3 step = glm::abs(position - result.path[i - 1]);
+        CHECK(step.x + step.y == 1);
+        CHECK(step.z <= 1);
+    }
+}
+
+TEST_CASE("Pathfinding", "[voxel]")
+{
+    ThreadPool pool(2);
+    Terrain terrain(1, pool);
+    Pathfinder pathfinder(terrain, pool);
+    loadFlatChunks(terrain, pathfinder, {-1, -1, 0}, {1, 1, 0});
+    settle(pathfinder, terrain, pool);
+    CHECK(pathfinder.graphCount() == 9);
+    CHECK(pathfinder.nodeCount() > 0);
+
+    SECTION("Paths inside a chunk are shortest")
+    {
+        const PathResult result = findPath(pathfinder, pool, {1, 1, 1}, {10, 5, 1});
+        checkPath(terrain, result, {1, 1, 1}, {10, 5, 1});
+        CHECK(result.path.size() == 14);
+        CHECK(result.expanded == 0);
+    }
+
+    SECTION("Paths cross chunks through their entrances")
+    {
+        const PathResult result = findPath(pathfinder, pool, {-20, -20, 1}, {50, 40, 1});
+        checkPath(terrain, result, {-20, -20, 1}, {50, 40, 1});
+        CHECK(result.path.size() >= 131);
+        CHECK(result.path.size() < 200);
+        CHECK(result.expanded > 0);
+    }
+
+    SECTION("Agents step up and down single voxels")
+    {
+        EditTransaction step;
+        step.fill({5, -32, 1}, {8, 64, 2}, STONE);
+        terrain.apply(step);
+        settle(pathfinder, terrain, pool);
+        const PathResult result = findPath(pathfinder, pool, {1, 0, 1}, {40, 0, 1});
+        checkPath(terrain, result, {1, 0, 1}, {40, 0, 1});
+        CHECK(std::ranges::count_if(result.path, [](const glm::i32vec3 p) { return p.z == 2; }) >= 3);
+    }
+
+    SECTION("Walls are walked around")
+    {
+        EditTransaction wall;
+        wall.fill({10, -32, 1}, {11, 64, 4}, STONE);
+        wall.fill({10, 50, 1}, {11, 51, 4}, Voxel{});
+        terrain.apply(wall);
+        settle(pathfinder, terrain, pool);
+        const PathResult result = findPath(pathfinder, pool, {5, 0, 1}, {15, 0, 1});
+        checkPath(terrain, result, {5, 0, 1}, {15, 0, 1});
+        CHECK(std::ranges::count(result.path, glm::i32vec3(10, 50, 1)) == 1);
+
+        SECTION("Closing the gap leaves no path")
+        {
+            terrain.setVoxel({10, 50, 2}, STONE);
+            settle(pathfinder, terrain, pool);
+            CHECK(findPath(pathfinder, pool, {5, 0, 1}, {15, 0, 1}).path.empty());
+        }
+    }
+
+    SECTION("Goals an agent can't stand in have no path")
+    {
+        CHECK(findPath(pathfinder, pool, {0, 0, 1}, {0, 0, 5}).path.empty());
+        CHECK(findPath(pathfinder, pool, {0, 0, 1}, {0, 0, 0}).path.empty());
+        CHECK(findPath(pathfinder, pool, {0, 0, 1}, {200, 0, 1}).path.empty());
+    }
+
+    SECTION("Only edits near a border rebuild the neighbouring graphs")
+    {
+        terrain.setVoxel({16, 16, 10}, STONE);
+        pathfinder.update();
+        terrain.clearEdits();
+        pool.waitIdle();
+        pathfinder.update();
+        CHECK(pathfinder.pendingBuilds() == 1);
+        settle(pathfinder, terrain, pool);
+
+        terrain.setVoxel({31, 16, 1}, STONE);
+        pathfinder.update();
+        terrain.clearEdits();
+        pool.waitIdle();
+        pathfinder.update();
+        CHECK(pathfinder.pendingBuilds() == 9);
+        settle(pathfinder, terrain, pool);
+        CHECK(pathfinder.pendingRequests() == 0);
+    }
+}
+
+TEST_CASE("Pathfinding Benchmark", "[.][benchmark]")
+{
+    ThreadPool pool;
+    Terrain terrain(1, pool);
+    Pathfinder pathfinder(terrain, pool);
+    TerrainGenerator generator(3);
+    constexpr std::int32_t radius = 6;
+    for (std::int32_t x = -radius; x < radius; x++) {
+        for (std::int32_t y = -radius; y < radius; y++) {
+            for (std::int32_t z = -3; z < 2; z++) {
+                terrain.getChunks().insert({x, y, z}, generator.genChunk({x, y, z}));
+                pathfinder.addChunk({x, y, z});
+            }
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    settle(pathfinder, terrain, pool);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    spdlog::info(
+        "Built {} chunk graphs with {} nodes in {:.2f}ms",
+        pathfinder.graphCount(),
+        pathfinder.nodeCount(),
+        std::chrono::duration<double, std::milli>(elapsed).count()
+    );
+
+    // Standing positions on the surface of random columns
+    const auto surface = [&](const std::int32_t x, const std::int32_t y) {
+        for (std::int32_t z = 62; z > -96; z--) {
+            if (terrain.getVoxel({x, y, z - 1})->id != 0)
+                return glm::i32vec3(x, y, z);
+        }
+        return glm::i32vec3(x, y, 0);
+    };
+    std::vector<std::pair<glm::i32vec3, glm::i32vec3>> pairs;
+    std::uint64_t state = 12345;
+    const auto next = [&] {
+        state = state * 6364136223846793005 + 1442695040888963407;
+        return std::int32_t(state >> 33) % (radius * 32 - 16);
+    };
+    for (int i = 0; i < 256; i++)
+        pairs.emplace_back(surface(next(), next()), surface(-next(), -next()));
+
+    const auto run = [&] {
+        for (const auto& [from, to] : pairs)
+            pathfinder.request(from, to);
+        std::vector<PathResult> results;
+        while (pathfinder.pendingRequests() > 0) {
+            pathfinder.update();
+            pool.waitIdle();
+            pathfinder.poll(results);
+        }
+        return results;
+    };
+    start = std::chrono::steady_clock::now();
+    const std::vector<PathResult> results = run();
+    elapsed = std::chrono::steady_clock::now() - start;
+    const double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+    std::size_t found = 0, expanded = 0, length = 0;
+    for (const PathResult& result : results) {
+        found += !result.path.empty();
+        expanded += result.expanded;
+        length += result.path.size();
+    }
+    spdlog::info(
+        "{} of {} paths found in {:.2f}ms, {:.0f} paths/s, {:.1f} nodes expanded and {:.1f} voxels per path",
+        found,
+        results.size(),
+        ms,
+        double(results.size()) / ms * 1000.0,
+        double(expanded) / double(results.size()),
+        double(length) / double(std::max<std::size_t>(found, 1))
+    );
+
+    BENCHMARK("256 paths")
+    {
+        return run().size();
+    };
+}
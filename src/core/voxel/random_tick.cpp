@@ -0,0 +1,166 @@
+#include "random_tick.h"
+#include "core/utility/rng.h"
+#include "core/utility/thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+
+namespace dragonfire::voxel {
+
+/// Chunks sampled by each task, so a tick over many chunks doesn't queue a task per chunk
+static constexpr std::size_t CHUNKS_PER_TASK = 16;
+/// Size of a section along each axis, signed for voxel positions
+static constexpr auto SECTION = std::int32_t(RandomTicker::SECTION_DIM);
+
+RandomTicker::RandomTicker(
+    const ChunkMap& chunks,
+    std::vector<std::uint8_t> tickable,
+    const std::uint64_t seed,
+    const std::uint32_t samplesPerSection
+)
+    : chunks(chunks), tickable(std::move(tickable)), seed(seed), samplesPerSection(samplesPerSection)
+{
+}
+
+void RandomTicker::setTickable(std::vector<std::uint8_t> table)
+{
+    tickable = std::move(table);
+    for (auto& [position, ticks] : chunkTicks)
+        ticks.stale = true;
+}
+
+void RandomTicker::addChunk(const glm::i32vec3 position)
+{
+    chunkTicks[position] = ChunkTicks{};
+}
+
+void RandomTicker::removeChunk(const glm::i32vec3 position)
+{
+    chunkTicks.erase(position);
+}
+
+void RandomTicker::voxelsChanged(const EditJournal& changes)
+{
+    for (const JournalChunk& entry : changes.chunks()) {
+        if (const auto found = chunkTicks.find(entry.position); found != chunkTicks.end())
+            found->second.stale = true;
+    }
+}
+
+std::size_t RandomTicker::tick(ThreadPool& pool, std::vector<RandomTick>& out)
+{
+    const auto start = std::chrono::steady_clock::now();
+    stats.tickRuns++;
+    // Entries are reused between ticks so their pick vectors keep their capacity
+    std::size_t count = 0;
+    for (auto& [position, ticks] : chunkTicks) {
+        const auto isZero = [](const std::uint16_t sectionCount) { return sectionCount == 0; };
+        if (!ticks.stale && std::ranges::all_of(ticks.counts, isZero)) {
+            stats.skippedSections += SECTION_COUNT;
+            continue;
+        }
+        if (count == samples.size())
+            samples.emplace_back();
+        samples[count].position = position;
+        samples[count].ticks = &ticks;
+        count++;
+    }
+    samples.resize(count);
+    // Sorted so the picks are handled in the same order no matter the order chunks were loaded in
+    std::sort(samples.begin(), samples.end(), [](const ChunkSample& a, const ChunkSample& b) {
+        return std::tie(a.position.x, a.position.y, a.position.z)
+               < std::tie(b.position.x, b.position.y, b.position.z);
+    });
+
+    const std::size_t tasks = (samples.size() + CHUNKS_PER_TASK - 1) / CHUNKS_PER_TASK;
+    parallelFor(pool, tasks, [&](const std::size_t task) {
+        const std::size_t end = std::min(samples.size(), (task + 1) * CHUNKS_PER_TASK);
+        for (std::size_t i = task * CHUNKS_PER_TASK; i < end; i++) {
+            ChunkSample& chunkSample = samples[i];
+            chunkSample.picked.clear();
+            chunkSample.recounted = false;
+            const Chunk* chunk = chunks.find(chunkSample.position);
+            if (chunk == nullptr)
+                continue;
+            if (chunkSample.ticks->stale) {
+                recount(*chunk, *chunkSample.ticks);
+                chunkSample.recounted = true;
+            }
+            sample(*chunk, chunkSample);
+        }
+    });
+
+    const std::size_t first = out.size();
+    for (const ChunkSample& chunkSample : samples) {
+        stats.recountedSections += chunkSample.recounted ? SECTION_COUNT : 0;
+        for (const std::uint16_t sectionCount : chunkSample.ticks->counts) {
+            if (sectionCount == 0)
+                stats.skippedSections++;
+            else
+                stats.sampledSections++;
+        }
+        out.insert(out.end(), chunkSample.picked.begin(), chunkSample.picked.end());
+    }
+    tickCount++;
+    const std::size_t picked = out.size() - first;
+    stats.ticks += picked;
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    stats.milliseconds += std::chrono::duration<double, std::milli>(elapsed).count();
+    return picked;
+}
+
+std::uint32_t RandomTicker::tickableCount(const glm::i32vec3 chunk, const glm::ivec3 local) const noexcept
+{
+    const auto found = chunkTicks.find(chunk);
+    if (found == chunkTicks.end() || found->second.stale)
+        return 0;
+    return found->second.counts[sectionIndex(local)];
+}
+
+std::size_t RandomTicker::sectionIndex(const glm::ivec3 local) noexcept
+{
+    constexpr auto axes = std::int32_t(SECTIONS_PER_AXIS);
+    const glm::ivec3 section = local / SECTION;
+    return std::size_t((section.x * axes + section.y) * axes + section.z);
+}
+
+void RandomTicker::recount(const Chunk& chunk, ChunkTicks& ticks) const
+{
+    ticks.stale = false;
+    if (chunk.isUniform()) {
+        const bool all = isTickable(chunk.get(0));
+        ticks.counts.fill(all ? std::uint16_t(SECTION_DIM * SECTION_DIM * SECTION_DIM) : 0);
+        return;
+    }
+    // Air is never tickable, so only the occupied voxels are read
+    ticks.counts.fill(0);
+    chunk.forEachOccupied([&](const std::size_t index) {
+        if (isTickable(chunk.get(index)))
+            ticks.counts[sectionIndex(Chunk::position(index))]++;
+    });
+}
+
+void RandomTicker::sample(const Chunk& chunk, ChunkSample& chunkSample) const
+{
+    const glm::i32vec3 origin = chunkSample.position * std::int32_t(Chunk::CHUNK_DIM);
+    RNG rng(seed ^ ChunkPositionHash{}(chunkSample.position) ^ tickCount * 0x9e3779b97f4a7c15);
+    const auto& counts = chunkSample.ticks->counts;
+    for (std::size_t section = 0; section < SECTION_COUNT; section++) {
+        if (counts[section] == 0)
+            continue;
+        constexpr auto axes = std::int32_t(SECTIONS_PER_AXIS);
+        const auto index = std::int32_t(section);
+        const glm::ivec3 corner = glm::ivec3(index / (axes * axes), index / axes % axes, index % axes)
+                                  * SECTION;
+        for (std::uint32_t i = 0; i < samplesPerSection; i++) {
+            static_assert(SECTION_DIM == 16, "samples take 4 random bits per axis");
+            const std::uint64_t bits = rng.next();
+            const glm::ivec3 local = corner + glm::ivec3(bits & 15, bits >> 4 & 15, bits >> 8 & 15);
+            const Voxel voxel = chunk[local];
+            if (isTickable(voxel))
+                chunkSample.picked.push_back({origin + local, voxel});
+        }
+    }
+}
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,132 @@
+#pragma once
+#include "chunk_map.h"
+#include "edit.h"
+#include <ankerl/unordered_dense.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace dragonfire {
+class ThreadPool;
+}
+
+namespace dragonfire::voxel {
+
+/// A tickable voxel picked by a random tick
+struct RandomTick {
+    /// World position of the voxel
+    glm::i32vec3 position;
+    Voxel voxel;
+
+    bool operator==(const RandomTick& other) const = default;
+};
+
+/// Work done by the calls to RandomTicker::tick since the last RandomTicker::resetStats, added up
+struct RandomTickStats {
+    /// Calls to tick
+    std::size_t tickRuns = 0;
+    /// Sections sampled and sections skipped because they hold no tickable voxel
+    std::size_t sampledSections = 0, skippedSections = 0;
+    /// Sections recounted after being loaded or edited
+    std::size_t recountedSections = 0;
+    /// Tickable voxels picked
+    std::size_t ticks = 0;
+    double milliseconds = 0.0;
+};
+
+/***
+ * @brief Picks random voxels of the loaded chunks each tick, for slow gameplay such as crops growing, grass
+ * spreading and fire
+ *
+ * Each chunk is split into sections, and a fixed number of voxels is sampled from every section per tick so
+ * a voxel is ticked at the same average rate anywhere in the world. Sections keep a count of their tickable
+ * voxels and are skipped while it is 0, so the large majority of the terrain that is rock, dirt and air costs
+ * nothing beyond a lookup. Picks come from an RNG seeded by the world seed, the chunk and the tick number,
+ * so the same world ticks the same voxels.
+ */
+class RandomTicker {
+public:
+    static constexpr std::size_t SECTION_DIM = 16;
+    static constexpr std::size_t SECTIONS_PER_AXIS = Chunk::CHUNK_DIM / SECTION_DIM;
+    static constexpr std::size_t SECTION_COUNT = SECTIONS_PER_AXIS * SECTIONS_PER_AXIS * SECTIONS_PER_AXIS;
+
+    /***
+     * @param chunks the voxels to tick, must not change while tick runs
+     * @param tickable whether each voxel id is tickable, as VoxelRegistry::tickability, ids past the end are
+     * not tickable
+     * @param samplesPerSection voxels sampled from each section per tick
+     */
+    RandomTicker(
+        const ChunkMap& chunks,
+        std::vector<std::uint8_t> tickable,
+        std::uint64_t seed,
+        std::uint32_t samplesPerSection = 3
+    );
+
+    /// Replaces the tickable voxel ids, such as after voxel types are loaded, recounting every chunk
+    void setTickable(std::vector<std::uint8_t> table);
+    /// Counts the tickable voxels of a newly loaded chunk on the next tick
+    void addChunk(glm::i32vec3 position);
+    void removeChunk(glm::i32vec3 position);
+    /// Recounts the tickable voxels of every chunk changed in a journal on the next tick
+    void voxelsChanged(const EditJournal& changes);
+
+    /***
+     * @brief Samples every section with a tickable voxel on the pool, blocking until all chunks are done
+     *
+     * Must not be called from a worker of the pool.
+     * @param out the tickable voxels picked are appended to it, sorted by chunk, so they can be handled in
+     * the same order every run
+     * @return the number of voxels added to out
+     */
+    std::size_t tick(ThreadPool& pool, std::vector<RandomTick>& out);
+
+    [[nodiscard]] const RandomTickStats& getStats() const noexcept { return stats; }
+
+    /// Starts adding up the stats again, such as once per frame when several ticks may run in one frame
+    void resetStats() noexcept { stats = {}; }
+
+    [[nodiscard]] std::uint64_t getTickCount() const noexcept { return tickCount; }
+
+    /// Number of tickable voxels counted in the section of a chunk containing a local position, 0 for chunks
+    /// that are not added or have not been counted yet
+    [[nodiscard]] std::uint32_t tickableCount(glm::i32vec3 chunk, glm::ivec3 local) const noexcept;
+
+    RandomTicker(const RandomTicker& other) = delete;
+    RandomTicker& operator=(const RandomTicker& other) = delete;
+
+private:
+    struct ChunkTicks {
+        std::array<std::uint16_t, SECTION_COUNT> counts{};
+        /// Set when the chunk is added or edited, counts are rebuilt on the next tick
+        bool stale = true;
+    };
+
+    /// Work of a chunk during a tick, only touched by the worker sampling it
+    struct ChunkSample {
+        glm::i32vec3 position;
+        ChunkTicks* ticks;
+        std::vector<RandomTick> picked;
+        bool recounted;
+    };
+
+    const ChunkMap& chunks;
+    std::vector<std::uint8_t> tickable;
+    const std::uint64_t seed;
+    const std::uint32_t samplesPerSection;
+    ankerl::unordered_dense::map<glm::i32vec3, ChunkTicks, ChunkPositionHash> chunkTicks;
+    std::vector<ChunkSample> samples;
+    std::uint64_t tickCount = 0;
+    RandomTickStats stats;
+
+    [[nodiscard]] bool isTickable(const Voxel voxel) const noexcept
+    {
+        return voxel.id < tickable.size() && tickable[voxel.id];
+    }
+
+    static std::size_t sectionIndex(glm::ivec3 local) noexcept;
+    void recount(const Chunk& chunk, ChunkTicks& ticks) const;
+    void sample(const Chunk& chunk, ChunkSample& chunkSample) const;
+};
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,180 @@
+#include "core/utility/thread_pool.h"
+#include "random_tick.h"
+#include "terrain.h"
+#include <algorithm>
+#include <catch.hpp>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+
+static constexpr Voxel STONE{1, 0};
+static constexpr Voxel GRASS{3, 0};
+/// Only grass is tickable
+static const std::vector<std::uint8_t> TICKABLE{0, 0, 0, 1};
+
+/// A chunk of stone up to z, with a layer of grass at z
+static Chunk grassChunk(const std::int32_t z)
+{
+    std::vector<Voxel> voxels(Chunk::CHUNK_SIZE);
+    for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++) {
+        const std::int32_t height = Chunk::position(i).z;
+        voxels[i] = height < z ? STONE : height == z ? GRASS : Voxel{};
+    }
+    return Chunk::pack(std::span<const Voxel, Chunk::CHUNK_SIZE>(voxels));
+}
+
+TEST_CASE("Random Ticks", "[voxel]")
+{
+    ThreadPool pool(2);
+    ChunkMap chunks;
+    chunks.insert({0, 0, 0}, grassChunk(10));
+    chunks.insert({1, 0, 0}, Chunk(STONE));
+    chunks.insert({0, 0, 1}, Chunk());
+    RandomTicker ticker(chunks, TICKABLE, 5);
+    for (const glm::i32vec3 position : {glm::i32vec3(0, 0, 0), glm::i32vec3(1, 0, 0), glm::i32vec3(0, 0, 1)})
+        ticker.addChunk(position);
+    std::vector<RandomTick> ticks;
+    ticker.tick(pool, ticks);
+
+    SECTION("Sections are counted once and skipped without tickable voxels")
+    {
+        CHECK(ticker.getStats().recountedSections == 3 * RandomTicker::SECTION_COUNT);
+        CHECK(ticker.tickableCount({0, 0, 0}, {0, 0, 10}) == 256);
+        CHECK(ticker.tickableCount({0, 0, 0}, {31, 31, 0}) == 256);
+        CHECK(ticker.tickableCount({0, 0, 0}, {0, 0, 20}) == 0);
+        CHECK(ticker.tickableCount({1, 0, 0}, {0, 0, 0}) == 0);
+        ticker.resetStats();
+        ticker.tick(pool, ticks);
+        CHECK(ticker.getStats().tickRuns == 1);
+        CHECK(ticker.getStats().recountedSections == 0);
+        CHECK(ticker.getStats().sampledSections == 4);
+        CHECK(ticker.getStats().skippedSections == 3 * RandomTicker::SECTION_COUNT - 4);
+    }
+
+    SECTION("Stats add up over ticks until reset")
+    {
+        ticker.tick(pool, ticks);
+        CHECK(ticker.getStats().tickRuns == 2);
+        CHECK(ticker.getStats().sampledSections == 8);
+        CHECK(ticker.getStats().recountedSections == 3 * RandomTicker::SECTION_COUNT);
+        CHECK(ticker.getStats().ticks == ticks.size());
+        ticker.resetStats();
+        CHECK(ticker.getStats().tickRuns == 0);
+        CHECK(ticker.getStats().milliseconds == 0.0);
+    }
+
+    SECTION("Only tickable voxels are picked, at the expected rate")
+    {
+        ticks.clear();
+        constexpr int tickCount = 1000;
+        for (int i = 0; i < tickCount; i++)
+            ticker.tick(pool, ticks);
+        for (const RandomTick& tick : ticks) {
+            CHECK(tick.voxel == GRASS);
+            CHECK(tick.position.z == 10);
+        }
+        // 4 sections with 256 of 4096 voxels tickable, sampled 3 times per tick
+        const double expected = tickCount * 4 * 3 / 16.0;
+        CHECK(double(ticks.size()) > expected * 0.8);
+        CHECK(double(ticks.size()) < expected * 1.2);
+    }
+
+    SECTION("Edited chunks are recounted")
+    {
+        EditJournal journal;
+        chunks.find({1, 0, 0})->set(glm::ivec3(5, 5, 20), GRASS);
+        journal.addVoxel({1, 0, 0}, std::uint16_t(Chunk::linearIndex({5, 5, 20})), GRASS);
+        ticker.voxelsChanged(journal);
+        ticker.resetStats();
+        ticker.tick(pool, ticks);
+        CHECK(ticker.getStats().recountedSections == RandomTicker::SECTION_COUNT);
+        CHECK(ticker.tickableCount({1, 0, 0}, {5, 5, 20}) == 1);
+        CHECK(ticker.getStats().sampledSections == 5);
+    }
+
+    SECTION("Removed chunks are not ticked")
+    {
+        ticker.removeChunk({0, 0, 0});
+        ticks.clear();
+        ticker.resetStats();
+        for (int i = 0; i < 100; i++)
+            ticker.tick(pool, ticks);
+        CHECK(ticks.empty());
+        CHECK(ticker.getStats().sampledSections == 0);
+    }
+
+    SECTION("Changing the tickable voxels recounts every chunk")
+    {
+        ticker.setTickable({0, 1});
+        ticker.tick(pool, ticks);
+        CHECK(ticker.tickableCount({1, 0, 0}, {0, 0, 0}) == 4096);
+        // The stone under the grass
+        CHECK(ticker.tickableCount({0, 0, 0}, {0, 0, 10}) == 2560);
+        CHECK(ticker.tickableCount({0, 0, 0}, {0, 0, 20}) == 0);
+    }
+}
+
+TEST_CASE("Random Ticks Are Deterministic", "[voxel]")
+{
+    const auto run = [](const std::uint32_t threads, const bool reversed) {
+        ThreadPool pool(threads);
+        ChunkMap chunks;
+        std::vector<glm::i32vec3> positions;
+        for (std::int32_t x = -3; x < 3; x++) {
+            for (std::int32_t y = -3; y < 3; y++)
+                positions.emplace_back(x, y, 0);
+        }
+        if (reversed)
+            std::reverse(positions.begin(), positions.end());
+        RandomTicker ticker(chunks, TICKABLE, 11);
+        for (const glm::i32vec3 position : positions) {
+            chunks.insert(position, grassChunk(position.x + 12));
+            ticker.addChunk(position);
+        }
+        std::vector<RandomTick> ticks;
+        for (int i = 0; i < 50; i++)
+            ticker.tick(pool, ticks);
+        return ticks;
+    };
+    const std::vector<RandomTick> expected = run(1, false);
+    CHECK(expected.size() > 100);
+    CHECK(run(3, true) == expected);
+}
+
+TEST_CASE("Random Tick Benchmark", "[.][benchmark]")
+{
+    ThreadPool pool;
+    TerrainGenerator generator(3);
+    ChunkMap chunks;
+    RandomTicker ticker(chunks, TICKABLE, 3);
+    for (std::int32_t x = -6; x < 6; x++) {
+        for (std::int32_t y = -6; y < 6; y++) {
+            for (std::int32_t z = -3; z < 1; z++) {
+                chunks.insert({x, y, z}, generator.genChunk({x, y, z}));
+                ticker.addChunk({x, y, z});
+            }
+        }
+    }
+    std::vector<RandomTick> ticks;
+    ticker.tick(pool, ticks);
+    const RandomTickStats counted = ticker.getStats();
+    ticker.resetStats();
+    ticker.tick(pool, ticks);
+    const RandomTickStats& stats = ticker.getStats();
+    spdlog::info(
+        "{} chunks counted in {:.2f}ms, {} of {} sections hold grass, {} voxels ticked in {:.3f}ms",
+        chunks.size(),
+        counted.milliseconds,
+        stats.sampledSections,
+        stats.sampledSections + stats.skippedSections,
+        stats.ticks,
+        stats.milliseconds
+    );
+
+    BENCHMARK("Random tick")
+    {
+        ticks.clear();
+        return ticker.tick(pool, ticks);
+    };
+}
@@ -0,0 +1,250 @@
+#include "raycast.h"
+#include <algorithm>
+#include <cassert>
+#include <glm/glm.hpp>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+namespace dragonfire::voxel {
+
+static constexpr auto DIM = std::int32_t(Chunk::CHUNK_DIM);
+static constexpr auto BRICK = std::int32_t(Chunk::BRICK_DIM);
+static constexpr float INF = std::numeric_limits<float>::infinity();
+/// Tolerance when converting box faces to voxels, so a face lying on a voxel boundary is outside that voxel
+static constexpr float FACE_EPSILON = 1e-4f;
+
+/// Direct mapped cache of chunk lookups, shared by every ray of a batch. Each slot covers one chunk of every
+/// 4x4x4 block, so the chunks around a ray never evict each other.
+class ChunkCache {
+public:
+    explicit ChunkCache(const ChunkMap& chunks) : chunks(chunks) {}
+
+    /// Returns the chunk, or nullptr if it is not loaded
+    const Chunk* find(const glm::i32vec3 position) noexcept
+    {
+        Entry& entry = entries[(position.x & 3) << 4 | (position.y & 3) << 2 | (position.z & 3)];
+        if (!entry.valid || entry.position != position)
+            entry = {position, chunks.find(position), true};
+        return entry.chunk;
+    }
+
+    Voxel get(const glm::i32vec3 voxel) noexcept
+    {
+        const glm::i32vec3 chunkPos = Chunk::chunkOf(voxel);
+        const Chunk* chunk = find(chunkPos);
+        return chunk ? (*chunk)[voxel - chunkPos * DIM] : Voxel{};
+    }
+
+private:
+    struct Entry {
+        glm::i32vec3 position;
+        const Chunk* chunk;
+        bool valid;
+    };
+
+    const ChunkMap& chunks;
+    Entry entries[64]{};
+};
+
+/// True if every voxel of a chunk is air, unloaded chunks count as air
+static bool isEmpty(const Chunk* chunk) noexcept
+{
+    return chunk == nullptr || chunk->isEmpty();
+}
+
+/// Voxel grid traversal along a line, visiting every voxel the line passes through in order
+struct GridWalk {
+    glm::vec3 origin, direction;
+    glm::i32vec3 voxel, step;
+    /// Distance along the line to the next boundary on each axis, and between boundaries on each axis
+    glm::vec3 next, delta;
+    /// Distance along the line to where it entered the current voxel
+    float distance = 0.0f;
+    /// Axis of the last boundary crossed, -1 before the first step
+    std::int32_t axis = -1;
+
+    GridWalk(const glm::vec3 origin, const glm::vec3 direction, const glm::i32vec3 start)
+        : origin(origin), direction(direction), voxel(start)
+    {
+        for (std::int32_t i = 0; i < 3; i++) {
+            step[i] = direction[i] > 0.0f ? 1 : direction[i] < 0.0f ? -1 : 0;
+            delta[i] = step[i] == 0 ? INF : std::abs(1.0f / direction[i]);
+        }
+        resetBoundaries();
+    }
+
+    void advance() noexcept
+    {
+        axis = next.x < next.y ? (next.x < next.z ? 0 : 2) : (next.y < next.z ? 1 : 2);
+        distance = std::max(distance, next[axis]);
+        voxel[axis] += step[axis];
+        next[axis] += delta[axis];
+    }
+
+    /// Jumps to the first voxel past the cube of size voxels at cell, such as a chunk or an occupancy brick
+    void leaveCell(const glm::i32vec3 cell, const std::int32_t size) noexcept
+    {
+        float exit = INF;
+        for (std::int32_t i = 0; i < 3; i++) {
+            if (step[i] == 0)
+                continue;
+            const float boundary = float((cell[i] + (step[i] > 0)) * size);
+            const float t = (boundary - origin[i]) / direction[i];
+            if (t < exit) {
+                exit = t;
+                axis = i;
+            }
+        }
+        distance = std::max(distance, exit);
+        voxel = glm::i32vec3(glm::floor(origin + direction * distance));
+        // The crossed axis is set exactly, rounding could otherwise leave the line inside the cell
+        voxel[axis] = step[axis] > 0 ? (cell[axis] + 1) * size : cell[axis] * size - 1;
+        resetBoundaries();
+    }
+
+    [[nodiscard]] glm::i32vec3 normal() const noexcept
+    {
+        glm::i32vec3 normal(0);
+        if (axis >= 0)
+            normal[axis] = -step[axis];
+        return normal;
+    }
+
+private:
+    void resetBoundaries() noexcept
+    {
+        for (std::int32_t i = 0; i < 3; i++) {
+            const float boundary = float(voxel[i] + (step[i] > 0));
+            next[i] = step[i] == 0 ? INF : std::max((boundary - origin[i]) / direction[i], distance);
+        }
+    }
+};
+
+static RayHit castRay(ChunkCache& cache, const Ray& ray)
+{
+    const float length = glm::length(ray.direction);
+    if (length == 0.0f)
+        return {};
+    GridWalk walk(ray.origin, ray.direction / length, glm::i32vec3(glm::floor(ray.origin)));
+    while (walk.distance <= ray.maxDistance) {
+        const glm::i32vec3 chunkPos = Chunk::chunkOf(walk.voxel);
+        const Chunk* chunk = cache.find(chunkPos);
+        if (isEmpty(chunk)) {
+            walk.leaveCell(chunkPos, DIM);
+            continue;
+        }
+        // Walk the chunk until the ray hits something or leaves it, jumping over bricks that are all air and
+        // reading the occupancy masks rather than decoding the voxels the ray passes through
+        const glm::i32vec3 base = chunkPos * DIM;
+        while (Chunk::chunkOf(walk.voxel) == chunkPos) {
+            const glm::ivec3 local = walk.voxel - base;
+            const glm::ivec3 brick = local / BRICK;
+            if ((chunk->brickMask(brick.x) >> (brick.y * Chunk::BRICK_COUNT + brick.z) & 1) == 0)
+                walk.leaveCell(base / BRICK + brick, BRICK);
+            else if ((chunk->columnMask(local.x, local.y) >> local.z & 1) != 0) {
+                const Voxel voxel = (*chunk)[local];
+                return {walk.voxel, walk.normal(), voxel, walk.distance, true};
+            }
+            else
+                walk.advance();
+            if (walk.distance > ray.maxDistance)
+                return {};
+        }
+    }
+    return {};
+}
+
+/// First voxel of the box along an axis when moving in the given direction, the voxel containing its face
+static std::int32_t leadingVoxel(const float face, const std::int32_t step) noexcept
+{
+    if (step > 0)
+        return std::int32_t(std::ceil(face - FACE_EPSILON)) - 1;
+    return std::int32_t(std::floor(face + FACE_EPSILON));
+}
+
+static SweepHit sweepBox(ChunkCache& cache, const Aabb& box, const glm::vec3 motion)
+{
+    const float length = glm::length(motion);
+    if (length == 0.0f)
+        return {};
+    const glm::vec3 direction = motion / length;
+
+    // Walk the leading corner through the grid, the start voxel is the one just inside the box
+    glm::vec3 lead;
+    glm::i32vec3 start;
+    for (std::int32_t i = 0; i < 3; i++) {
+        lead[i] = direction[i] > 0.0f ? box.max[i] : box.min[i];
+        start[i] = leadingVoxel(lead[i], direction[i] > 0.0f ? 1 : -1);
+    }
+    GridWalk walk(lead, direction, start);
+    while (true) {
+        walk.advance();
+        if (walk.distance > length)
+            return {length, {}, {}, false};
+
+        // Check the layer of voxels the leading face enters
+        const glm::vec3 min = box.min + direction * walk.distance;
+        const glm::vec3 max = box.max + direction * walk.distance;
+        const glm::i32vec3 low(glm::floor(min + FACE_EPSILON));
+        const glm::i32vec3 high = glm::i32vec3(glm::ceil(max - FACE_EPSILON)) - 1;
+        glm::i32vec3 first = low, last = high;
+        first[walk.axis] = last[walk.axis] = walk.voxel[walk.axis];
+        for (std::int32_t x = first.x; x <= last.x; x++) {
+            for (std::int32_t y = first.y; y <= last.y; y++) {
+                for (std::int32_t z = first.z; z <= last.z; z++) {
+                    if (cache.get({x, y, z}).id != 0)
+                        return {walk.distance, walk.normal(), {x, y, z}, true};
+                }
+            }
+        }
+    }
+}
+
+/// Indices of the items ordered by the chunk containing the given position of each
+template<typename T, typename Position>
+static std::span<const std::uint32_t> chunkOrder(const std::span<const T> items, Position&& position)
+{
+    thread_local std::vector<std::uint32_t> order;
+    thread_local std::vector<std::pair<glm::i32vec3, std::uint32_t>> keys;
+    keys.clear();
+    for (std::uint32_t i = 0; i < items.size(); i++)
+        keys.emplace_back(Chunk::chunkOf(glm::i32vec3(glm::floor(position(items[i])))), i);
+    std::ranges::sort(keys, [](const auto& a, const auto& b) {
+        const glm::i32vec3 chunkA = a.first, chunkB = b.first;
+        return std::tie(chunkA.x, chunkA.y, chunkA.z) < std::tie(chunkB.x, chunkB.y, chunkB.z);
+    });
+    order.resize(keys.size());
+    std::ranges::transform(keys, order.begin(), [](const auto& key) { return key.second; });
+    return order;
+}
+
+void raycast(const ChunkMap& chunks, const std::span<const Ray> rays, const std::span<RayHit> out)
+{
+    assert(out.size() >= rays.size());
+    ChunkCache cache(chunks);
+    for (const std::uint32_t i : chunkOrder(rays, [](const Ray& ray) { return ray.origin; }))
+        out[i] = castRay(cache, rays[i]);
+}
+
+RayHit raycast(const ChunkMap& chunks, const Ray& ray)
+{
+    ChunkCache cache(chunks);
+    return castRay(cache, ray);
+}
+
+void sweep(const ChunkMap& chunks, const std::span<const BoxSweep> sweeps, const std::span<SweepHit> out)
+{
+    assert(out.size() >= sweeps.size());
+    ChunkCache cache(chunks);
+    for (const std::uint32_t i : chunkOrder(sweeps, [](const BoxSweep& sweep) { return sweep.box.min; }))
+        out[i] = sweepBox(cache, sweeps[i].box, sweeps[i].motion);
+}
+
+SweepHit sweep(const ChunkMap& chunks, const Aabb& box, const glm::vec3 motion)
+{
+    ChunkCache cache(chunks);
+    return sweepBox(cache, box, motion);
+}
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,73 @@
+#pragma once
+#include "chunk_map.h"
+#include <glm/vec3.hpp>
+#include <span>
+
+namespace dragonfire::voxel {
+
+struct Ray {
+    /// World space origin
+    glm::vec3 origin;
+    /// Does not need to be normalized
+    glm::vec3 direction;
+    float maxDistance = 64.0f;
+};
+
+struct RayHit {
+    /// World position of the voxel hit
+    glm::i32vec3 position{};
+    /// Normal of the face the ray entered through, zero if the ray started inside a solid voxel
+    glm::i32vec3 normal{};
+    Voxel voxel{};
+    /// Distance along the ray to the face hit
+    float distance = 0.0f;
+    bool hit = false;
+};
+
+/// Axis aligned box in world space
+struct Aabb {
+    glm::vec3 min, max;
+};
+
+struct BoxSweep {
+    Aabb box;
+    glm::vec3 motion;
+};
+
+struct SweepHit {
+    /// Distance the box can move along the motion before touching a solid voxel, the full length of the
+    /// motion if nothing was hit
+    float distance = 0.0f;
+    /// Normal of the face hit, zero if nothing was hit
+    glm::i32vec3 normal{};
+    /// World position of the first solid voxel the box touches
+    glm::i32vec3 position{};
+    bool hit = false;
+};
+
+/***
+ * @brief Finds the first non air voxel along each ray
+ *
+ * Rays walk the voxel grid one chunk at a time, and chunks that are not loaded or are entirely air are
+ * crossed in a single step. Rays are processed in the order of the chunk they start in so consecutive rays
+ * reuse the same chunk lookups. Safe to call from multiple threads at once while the map is not modified.
+ * @param out one hit per ray, in the same order as rays
+ */
+void raycast(const ChunkMap& chunks, std::span<const Ray> rays, std::span<RayHit> out);
+
+RayHit raycast(const ChunkMap& chunks, const Ray& ray);
+
+/***
+ * @brief Moves each box along its motion until it touches a non air voxel
+ *
+ * The leading corner of the box walks the grid with the same traversal as a ray, checking the layer of
+ * voxels the leading face enters at each step. Voxels already overlapping the box are ignored so a box
+ * resting against a surface can slide along it. Safe to call from multiple threads at once while the map is
+ * not modified.
+ * @param out one hit per sweep, in the same order as sweeps
+ */
+void sweep(const ChunkMap& chunks, std::span<const BoxSweep> sweeps, std::span<SweepHit> out);
+
+SweepHit sweep(const ChunkMap& chunks, const Aabb& box, glm::vec3 motion);
+
+}// namespace dragonfire::voxel
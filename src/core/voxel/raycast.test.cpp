@@ -0,0 +1,198 @@
+#include "core/utility/thread_pool.h"
+#include "raycast.h"
+#include "terrain.h"
+#include "test_helpers.h"
+#include <catch.hpp>
+#include <glm/glm.hpp>
+#include <random>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+using namespace dragonfire::voxel::test;
+
+static constexpr Voxel STONE{1, 0};
+
+/// Loads generated terrain in the given range of chunks
+static void generateTerrain(ChunkMap& chunks, const glm::i32vec3 low, const glm::i32vec3 high)
+{
+    const TerrainGenerator generator(42);
+    for (std::int32_t x = low.x; x <= high.x; x++) {
+        for (std::int32_t y = low.y; y <= high.y; y++) {
+            for (std::int32_t z = low.z; z <= high.z; z++)
+                chunks.insert({x, y, z}, generator.genChunk({x, y, z}));
+        }
+    }
+}
+
+/// Random rays starting above the surface of generated terrain, aimed mostly downwards
+static std::vector<Ray> randomRays(const std::size_t count, const float range, const float maxDistance)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-range, range), unit(-1.0f, 1.0f);
+    std::vector<Ray> rays(count);
+    for (Ray& ray : rays) {
+        ray.origin = glm::vec3(position(rng), position(rng), 52.0f + unit(rng) * 4.0f);
+        ray.direction = glm::vec3(unit(rng), unit(rng), unit(rng) - 1.0f);
+        ray.maxDistance = maxDistance;
+    }
+    return rays;
+}
+
+TEST_CASE("Raycast")
+{
+    ChunkMap chunks;
+
+    SECTION("Hits across unloaded and empty chunks")
+    {
+        setVoxel(chunks, {-70, 5, -3}, STONE);
+        chunks.insert({0, 0, -1}, Chunk());
+        const RayHit hit = raycast(chunks, {{10.5f, 5.5f, -2.5f}, {-1.0f, 0.0f, 0.0f}, 100.0f});
+        REQUIRE(hit.hit);
+        CHECK(hit.position == glm::i32vec3(-70, 5, -3));
+        CHECK(hit.normal == glm::i32vec3(1, 0, 0));
+        CHECK(hit.voxel == STONE);
+        CHECK(hit.distance == Approx(79.5f));
+
+        CHECK_FALSE(raycast(chunks, {{10.5f, 5.5f, -2.5f}, {-1.0f, 0.0f, 0.0f}, 79.0f}).hit);
+        CHECK_FALSE(raycast(chunks, {{10.5f, 5.5f, -2.5f}, {1.0f, 0.0f, 0.0f}, 1000.0f}).hit);
+        CHECK_FALSE(raycast(chunks, {{10.5f, 5.5f, -2.5f}, {0.0f, 0.0f, 0.0f}, 100.0f}).hit);
+    }
+
+    SECTION("Uniform solid chunks")
+    {
+        chunks.insert({0, 0, -1}, Chunk(STONE));
+        const RayHit hit = raycast(chunks, {{3.25f, 39.5f, 8.0f}, {0.0f, -1.0f, -1.0f}, 100.0f});
+        REQUIRE(hit.hit);
+        CHECK(hit.position == glm::i32vec3(3, 31, -1));
+        CHECK(hit.normal == glm::i32vec3(0, 0, 1));
+        CHECK(hit.distance == Approx(std::sqrt(128.0f)));
+
+        const RayHit inside = raycast(chunks, {{3.5f, 3.5f, -3.5f}, {0.0f, 0.0f, 1.0f}, 10.0f});
+        CHECK(inside.hit);
+        CHECK(inside.distance == 0.0f);
+        CHECK(inside.normal == glm::i32vec3(0));
+    }
+
+    SECTION("Matches sampling the ray")
+    {
+        generateTerrain(chunks, {-4, -4, -4}, {3, 3, 2});
+        const std::vector<Ray> rays = randomRays(500, 60.0f, 160.0f);
+        std::vector<RayHit> hits(rays.size());
+        raycast(chunks, rays, hits);
+        std::size_t hitCount = 0;
+        for (std::size_t i = 0; i < rays.size(); i++) {
+            const Ray& ray = rays[i];
+            const glm::vec3 direction = glm::normalize(ray.direction);
+            const RayHit single = raycast(chunks, ray);
+            REQUIRE(single.hit == hits[i].hit);
+            REQUIRE(single.position == hits[i].position);
+
+            // No solid voxel is sampled before the hit, and the hit voxel is entered at the hit distance
+            const float end = hits[i].hit ? hits[i].distance - 0.01f : ray.maxDistance;
+            for (float t = 0.0f; t < end; t += 0.05f)
+                REQUIRE(getVoxel(chunks, glm::i32vec3(glm::floor(ray.origin + direction * t))).id == 0);
+            if (hits[i].hit) {
+                hitCount++;
+                const glm::vec3 entry = ray.origin + direction * (hits[i].distance + 0.001f);
+                CHECK(glm::i32vec3(glm::floor(entry)) == hits[i].position);
+                CHECK(getVoxel(chunks, hits[i].position) == hits[i].voxel);
+            }
+        }
+        CHECK(hitCount > rays.size() / 2);
+    }
+}
+
+TEST_CASE("Box Sweep")
+{
+    ChunkMap chunks;
+    for (std::int32_t x = -8; x < 8; x++) {
+        for (std::int32_t y = -8; y < 8; y++)
+            setVoxel(chunks, {x, y, -1}, STONE);
+    }
+    setVoxel(chunks, {3, 0, 0}, STONE);
+    const Aabb box{{-0.3f, -0.3f, 0.0f}, {0.3f, 0.3f, 1.8f}};
+
+    SECTION("Lands on the floor")
+    {
+        const Aabb falling{box.min + glm::vec3(0.0f, 0.0f, 5.0f), box.max + glm::vec3(0.0f, 0.0f, 5.0f)};
+        const SweepHit hit = sweep(chunks, falling, {0.0f, 0.0f, -10.0f});
+        REQUIRE(hit.hit);
+        CHECK(hit.distance == Approx(5.0f));
+        CHECK(hit.normal == glm::i32vec3(0, 0, 1));
+        CHECK(hit.position.z == -1);
+    }
+
+    SECTION("Slides along the floor into a wall")
+    {
+        const SweepHit hit = sweep(chunks, box, {4.0f, 0.0f, 0.0f});
+        REQUIRE(hit.hit);
+        CHECK(hit.distance == Approx(2.7f));
+        CHECK(hit.normal == glm::i32vec3(-1, 0, 0));
+        CHECK(hit.position == glm::i32vec3(3, 0, 0));
+
+        const SweepHit clear = sweep(chunks, box, {-4.0f, 0.0f, 0.0f});
+        CHECK_FALSE(clear.hit);
+        CHECK(clear.distance == Approx(4.0f));
+    }
+
+    SECTION("Diagonal motion")
+    {
+        // The box has not moved past the wall voxel along y by the time it reaches it
+        const SweepHit hit = sweep(chunks, box, {4.0f, 1.0f, 0.0f});
+        REQUIRE(hit.hit);
+        CHECK(hit.normal == glm::i32vec3(-1, 0, 0));
+        CHECK(hit.distance == Approx(2.7f * std::sqrt(17.0f) / 4.0f));
+
+        const std::vector<BoxSweep> sweeps = {
+            {box, {4.0f, 1.0f, 0.0f}},
+            {box, {0.0f, 4.0f, 0.0f}},
+            {box, {0.0f, 0.0f, 3.0f}},
+        };
+        std::vector<SweepHit> hits(sweeps.size());
+        sweep(chunks, sweeps, hits);
+        CHECK(hits[0].distance == hit.distance);
+        CHECK_FALSE(hits[1].hit);
+        CHECK_FALSE(hits[2].hit);
+    }
+}
+
+TEST_CASE("Raycast Benchmark", "[.][benchmark]")
+{
+    ChunkMap chunks;
+    generateTerrain(chunks, {-8, -8, -4}, {7, 7, 3});
+    const std::vector<Ray> shortRays = randomRays(100000, 200.0f, 32.0f);
+    const std::vector<Ray> longRays = randomRays(100000, 200.0f, 256.0f);
+    std::vector<RayHit> hits(shortRays.size());
+
+    const auto measure = [&](const std::vector<Ray>& rays) {
+        const auto start = std::chrono::steady_clock::now();
+        raycast(chunks, rays, hits);
+        const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        return double(rays.size()) / time.count();
+    };
+    spdlog::info("Short rays: {:.2f} million rays/s", measure(shortRays) / 1e6);
+    spdlog::info("Long rays: {:.2f} million rays/s", measure(longRays) / 1e6);
+
+    // Batches split across the pool, each worker casting its own slice
+    ThreadPool pool;
+    constexpr std::size_t batchSize = 4096;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t first = 0; first < longRays.size(); first += batchSize) {
+        const std::size_t count = std::min(batchSize, longRays.size() - first);
+        pool.submit([&, first, count] {
+            raycast(chunks, std::span(longRays).subspan(first, count), std::span(hits).subspan(first, count));
+        });
+    }
+    pool.waitIdle();
+    const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    spdlog::info(
+        "Long rays on {} threads: {:.2f} million rays/s",
+        pool.threadCount(),
+        double(longRays.size()) / time.count() / 1e6
+    );
+
+    BENCHMARK("Cast 1000 short rays") { raycast(chunks, std::span(shortRays).first(1000), hits); };
+    const Aabb box{{-0.3f, -0.3f, 40.0f}, {0.3f, 0.3f, 41.8f}};
+    BENCHMARK("Sweep box") { return sweep(chunks, box, {3.0f, 2.0f, -80.0f}); };
+}
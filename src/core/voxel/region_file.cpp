@@ -0,0 +1,290 @@
+#include "region_file.h"
+#include "core/utility/formatted_error.h"
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+#include <zstd.h>
+
+namespace dragonfire::voxel {
+
+/// Fastest standard level, chunks are mostly long runs so higher levels gain little
+static constexpr int COMPRESSION_LEVEL = 1;
+/// Largest possible serialized chunk, 16 bit voxels with no palette plus the header
+static constexpr std::size_t MAX_CHUNK_SIZE = Chunk::CHUNK_SIZE * sizeof(std::uint16_t) + 64;
+
+struct RegionHeader {
+    std::array<char, 4> magic;
+    std::uint32_t version;
+};
+
+static constexpr RegionHeader REGION_HEADER = {{'D', 'F', 'R', 'G'}, 1};
+
+/// Compression contexts reused by every save and load on a thread
+struct ZstdContexts {
+    ZSTD_CCtx* compress = ZSTD_createCCtx();
+    ZSTD_DCtx* decompress = ZSTD_createDCtx();
+
+    ZstdContexts() = default;
+
+    ~ZstdContexts()
+    {
+        ZSTD_freeCCtx(compress);
+        ZSTD_freeDCtx(decompress);
+    }
+
+    ZstdContexts(const ZstdContexts& other) = delete;
+    ZstdContexts& operator=(const ZstdContexts& other) = delete;
+};
+
+static ZstdContexts& zstdContexts()
+{
+    thread_local ZstdContexts contexts;
+    return contexts;
+}
+
+template<typename T>
+static T readValue(const std::uint8_t* src) noexcept
+{
+    T value;
+    std::memcpy(&value, src, sizeof(T));
+    return value;
+}
+
+RegionFile::RegionFile(std::filesystem::path path) : path(std::move(path))
+{
+    if (!std::filesystem::exists(this->path) || std::filesystem::file_size(this->path) == 0)
+        create();
+    file.open(this->path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file)
+        throw FormattedError("Failed to open region file {}", this->path.string());
+    map = MappedFile(this->path);
+    end = map.length();
+
+    constexpr std::size_t tableOffset = sizeof(RegionHeader);
+    if (end < tableOffset + sizeof(table))
+        throw FormattedError("Region file {} is truncated", this->path.string());
+    const auto header = readValue<RegionHeader>(map.data().data());
+    if (header.magic != REGION_HEADER.magic || header.version != REGION_HEADER.version)
+        throw FormattedError("{} is not a region file of a supported version", this->path.string());
+    std::memcpy(table.data(), map.data().data() + tableOffset, sizeof(table));
+
+    liveBytes = tableOffset + sizeof(table);
+    for (const ColumnEntry& column : table) {
+        if (column.count == 0)
+            continue;
+        const std::uint8_t* directory = mapped(column.offset, column.count * sizeof(ChunkEntry));
+        liveBytes += column.count * sizeof(ChunkEntry);
+        for (std::uint32_t i = 0; i < column.count; i++) {
+            const auto entry = readValue<ChunkEntry>(directory + i * sizeof(ChunkEntry));
+            mapped(entry.offset, entry.size);
+            liveBytes += entry.size;
+        }
+    }
+}
+
+std::optional<Chunk> RegionFile::load(const glm::i32vec3 position)
+{
+    ChunkEntry entry{};
+    if (!findEntry(position, entry))
+        return std::nullopt;
+    const std::uint8_t* payload = mapped(entry.offset, entry.size);
+
+    thread_local std::vector<std::uint8_t> buffer;
+    const unsigned long long contentSize = ZSTD_getFrameContentSize(payload, entry.size);
+    if (contentSize == ZSTD_CONTENTSIZE_ERROR || contentSize == ZSTD_CONTENTSIZE_UNKNOWN
+        || contentSize > MAX_CHUNK_SIZE)
+        throw FormattedError("Chunk at height {} in {} is corrupt", position.z, path.string());
+    buffer.resize(contentSize);
+    const std::size_t size
+        = ZSTD_decompressDCtx(zstdContexts().decompress, buffer.data(), buffer.size(), payload, entry.size);
+    if (ZSTD_isError(size))
+        throw FormattedError("Failed to decompress chunk in {}: {}", path.string(), ZSTD_getErrorName(size));
+    return Chunk::deserialize(std::span(buffer.data(), size));
+}
+
+bool RegionFile::contains(const glm::i32vec3 position)
+{
+    ChunkEntry entry{};
+    return findEntry(position, entry);
+}
+
+void RegionFile::save(const glm::i32vec3 position, const Chunk& chunk)
+{
+    const std::pair<glm::i32vec3, const Chunk*> record(position, &chunk);
+    save(std::span(&record, 1));
+}
+
+void RegionFile::save(const std::span<const std::pair<glm::i32vec3, const Chunk*>> chunks)
+{
+    std::vector<std::pair<glm::i32vec3, const Chunk*>> sorted(chunks.begin(), chunks.end());
+    std::ranges::stable_sort(sorted, [](const auto& a, const auto& b) {
+        const std::size_t columnA = columnIndex(a.first), columnB = columnIndex(b.first);
+        return columnA < columnB || (columnA == columnB && a.first.z < b.first.z);
+    });
+
+    // Everything new is appended in one write, the table is only relinked once it has been written
+    std::vector<std::uint8_t> appended, serialized;
+    std::vector<ChunkEntry> entries;
+    std::vector<std::size_t> relinked;
+    std::array<ColumnEntry, COLUMN_COUNT> newTable = table;
+    std::uint64_t newLiveBytes = liveBytes;
+    for (auto iter = sorted.begin(); iter != sorted.end();) {
+        const std::size_t column = columnIndex(iter->first);
+        const ColumnEntry old = table[column];
+        const std::size_t oldSize = old.count * sizeof(ChunkEntry);
+        entries.resize(old.count);
+        if (old.count > 0)
+            std::memcpy(entries.data(), mapped(old.offset, oldSize), oldSize);
+        newLiveBytes -= oldSize;
+
+        for (; iter != sorted.end() && columnIndex(iter->first) == column; ++iter) {
+            serialized.clear();
+            iter->second->serialize(serialized);
+            const std::size_t offset = appended.size();
+            appended.resize(offset + ZSTD_compressBound(serialized.size()));
+            const std::size_t size = ZSTD_compressCCtx(
+                zstdContexts().compress,
+                appended.data() + offset,
+                appended.size() - offset,
+                serialized.data(),
+                serialized.size(),
+                COMPRESSION_LEVEL
+            );
+            if (ZSTD_isError(size))
+                throw FormattedError("Failed to compress chunk: {}", ZSTD_getErrorName(size));
+            appended.resize(offset + size);
+
+            const ChunkEntry entry{iter->first.z, std::uint32_t(size), end + offset};
+            const auto found = std::ranges::lower_bound(entries, entry.z, {}, &ChunkEntry::z);
+            if (found != entries.end() && found->z == entry.z) {
+                newLiveBytes -= found->size;
+                *found = entry;
+            }
+            else
+                entries.insert(found, entry);
+            newLiveBytes += size;
+        }
+
+        const std::size_t directoryOffset = appended.size();
+        const std::size_t directorySize = entries.size() * sizeof(ChunkEntry);
+        appended.resize(directoryOffset + directorySize);
+        std::memcpy(appended.data() + directoryOffset, entries.data(), directorySize);
+        newTable[column] = {end + directoryOffset, std::uint32_t(entries.size()), 0};
+        newLiveBytes += directorySize;
+        relinked.push_back(column);
+    }
+    if (relinked.empty())
+        return;
+
+    write(end, appended.data(), appended.size());
+    file.flush();
+    for (const std::size_t column : relinked)
+        write(sizeof(RegionHeader) + column * sizeof(ColumnEntry), &newTable[column], sizeof(ColumnEntry));
+    file.flush();
+    if (!file)
+        throw FormattedError("Failed to write region file {}", path.string());
+    table = newTable;
+    end += appended.size();
+    liveBytes = newLiveBytes;
+}
+
+const std::uint8_t* RegionFile::mapped(const std::uint64_t offset, const std::uint64_t size)
+{
+    if (offset + size > end || offset + size < offset)
+        throw FormattedError("Region file {} references data past the end of the file", path.string());
+    if (offset + size > map.length())
+        map = MappedFile(path);
+    return map.data().data() + offset;
+}
+
+bool RegionFile::findEntry(const glm::i32vec3 position, ChunkEntry& out)
+{
+    const ColumnEntry& column = table[columnIndex(position)];
+    if (column.count == 0)
+        return false;
+    const std::uint8_t* directory = mapped(column.offset, column.count * sizeof(ChunkEntry));
+    // Entries may be unaligned, so binary search by copying out each probed entry
+    std::size_t low = 0, high = column.count;
+    while (low < high) {
+        const std::size_t mid = (low + high) / 2;
+        if (readValue<ChunkEntry>(directory + mid * sizeof(ChunkEntry)).z < position.z)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == column.count)
+        return false;
+    out = readValue<ChunkEntry>(directory + low * sizeof(ChunkEntry));
+    return out.z == position.z;
+}
+
+void RegionFile::create()
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    const std::array<ColumnEntry, COLUMN_COUNT> emptyTable{};
+    out.write(reinterpret_cast<const char*>(&REGION_HEADER), sizeof(REGION_HEADER));
+    out.write(reinterpret_cast<const char*>(emptyTable.data()), sizeof(emptyTable));
+    if (!out)
+        throw FormattedError("Failed to create region file {}", path.string());
+}
+
+void RegionFile::write(const std::uint64_t offset, const void* data, const std::size_t size)
+{
+    file.seekp(std::streamoff(offset));
+    file.write(static_cast<const char*>(data), std::streamsize(size));
+    if (!file)
+        throw FormattedError("Failed to write region file {}", path.string());
+}
+
+ChunkStorage::ChunkStorage(std::filesystem::path directory) : directory(std::move(directory))
+{
+    std::filesystem::create_directories(this->directory);
+}
+
+ChunkStorage ChunkStorage::inWriteDir(const std::string_view directory)
+{
+    const std::string dir(directory);
+    File::mkdir(dir.c_str());
+    return ChunkStorage(File::nativeWritePath(dir));
+}
+
+std::optional<Chunk> ChunkStorage::load(const glm::i32vec3 position)
+{
+    RegionFile* file = region(position, false);
+    return file ? file->load(position) : std::nullopt;
+}
+
+void ChunkStorage::save(const glm::i32vec3 position, const Chunk& chunk)
+{
+    region(position, true)->save(position, chunk);
+}
+
+void ChunkStorage::save(const std::span<const std::pair<glm::i32vec3, const Chunk*>> chunks)
+{
+    batch.assign(chunks.begin(), chunks.end());
+    std::ranges::stable_sort(batch, [](const auto& a, const auto& b) {
+        const glm::i32vec3 regionA = RegionFile::regionOf(a.first), regionB = RegionFile::regionOf(b.first);
+        return regionA.x < regionB.x || (regionA.x == regionB.x && regionA.y < regionB.y);
+    });
+    for (auto first = batch.begin(); first != batch.end();) {
+        const glm::i32vec3 regionPos = RegionFile::regionOf(first->first);
+        const auto last = std::find_if(first, batch.end(), [&](const auto& record) {
+            return RegionFile::regionOf(record.first) != regionPos;
+        });
+        region(first->first, true)->save(std::span(first, last));
+        first = last;
+    }
+}
+
+RegionFile* ChunkStorage::region(const glm::i32vec3 position, const bool create)
+{
+    const glm::i32vec3 regionPos = RegionFile::regionOf(position);
+    if (const auto found = regions.find(regionPos); found != regions.end())
+        return found->second.get();
+    std::filesystem::path path = directory / fmt::format("r.{}.{}.dfr", regionPos.x, regionPos.y);
+    if (!create && !std::filesystem::exists(path))
+        return nullptr;
+    return regions.emplace(regionPos, std::make_unique<RegionFile>(std::move(path))).first->second.get();
+}
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,138 @@
+#pragma once
+#include "chunk_map.h"
+#include "core/file.h"
+#include <ankerl/unordered_dense.h>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace dragonfire::voxel {
+
+/// Chunks of REGION_COLUMNS x REGION_COLUMNS chunk columns stored in a single file, at any height.
+///
+/// The file starts with a table holding the location of each column's directory, which lists the zstd
+/// compressed payload of every chunk saved in the column sorted by height. Reads go through a memory map,
+/// so loading a chunk is a table lookup, a binary search of the directory and a decompress.
+/// Saves append the new payloads and a new directory to the end of the file and then relink the column's
+/// table entry, so existing data is never rewritten and a save interrupted before the relink leaves the
+/// previous version of the column readable. Replaced payloads stay in the file, see garbageBytes.
+/// Positions passed to a region file must lie in its region, see regionOf.
+class RegionFile {
+public:
+    static constexpr std::int32_t REGION_COLUMNS = 32;
+    static constexpr std::size_t COLUMN_COUNT = REGION_COLUMNS * REGION_COLUMNS;
+
+    /***
+     * @brief Opens the region file at a native path, creating it if it does not exist
+     * @throws FormattedError if the file exists but is not a valid region file
+     */
+    explicit RegionFile(std::filesystem::path path);
+
+    /***
+     * @brief Loads a chunk from the file
+     * @param position chunk coordinates of the chunk
+     * @return the chunk, or nullopt if it was never saved
+     * @throws FormattedError if the stored chunk is corrupt
+     */
+    [[nodiscard]] std::optional<Chunk> load(glm::i32vec3 position);
+
+    [[nodiscard]] bool contains(glm::i32vec3 position);
+
+    void save(glm::i32vec3 position, const Chunk& chunk);
+    /// Saves several chunks, appending one new directory per column and relinking each column once.
+    /// If a position appears more than once the last chunk for it is kept.
+    void save(std::span<const std::pair<glm::i32vec3, const Chunk*>> chunks);
+
+    /// Length of the file in bytes
+    [[nodiscard]] std::size_t fileSize() const noexcept { return end; }
+
+    /// Bytes of the file taken by payloads and directories that have since been replaced
+    [[nodiscard]] std::size_t garbageBytes() const noexcept { return end - liveBytes; }
+
+    [[nodiscard]] const std::filesystem::path& getPath() const noexcept { return path; }
+
+    static constexpr glm::i32vec3 regionOf(const glm::i32vec3 position) noexcept
+    {
+        // Arithmetic shift so negative coordinates round down, regions span every height
+        return {position.x >> 5, position.y >> 5, 0};
+    }
+
+    RegionFile(const RegionFile& other) = delete;
+    RegionFile& operator=(const RegionFile& other) = delete;
+
+private:
+    static_assert(REGION_COLUMNS == 32, "regionOf shifts by log2 of REGION_COLUMNS");
+
+    struct ColumnEntry {
+        /// Offset of the column's directory
+        std::uint64_t offset;
+        /// Number of chunks in the column's directory
+        std::uint32_t count;
+        std::uint32_t reserved;
+    };
+
+    struct ChunkEntry {
+        std::int32_t z;
+        /// Compressed size of the chunk's payload
+        std::uint32_t size;
+        std::uint64_t offset;
+    };
+
+    std::filesystem::path path;
+    std::fstream file;
+    MappedFile map;
+    std::array<ColumnEntry, COLUMN_COUNT> table{};
+    std::uint64_t end = 0;
+    std::uint64_t liveBytes = 0;
+
+    /// Returns the mapped bytes of a range of the file, remapping the file if it grew since it was mapped
+    const std::uint8_t* mapped(std::uint64_t offset, std::uint64_t size);
+    /// Finds the directory entry of a chunk, false if the chunk is not saved
+    bool findEntry(glm::i32vec3 position, ChunkEntry& out);
+    void create();
+    void write(std::uint64_t offset, const void* data, std::size_t size);
+
+    static constexpr std::size_t columnIndex(const glm::i32vec3 position) noexcept
+    {
+        return std::size_t(position.x & (REGION_COLUMNS - 1)) * REGION_COLUMNS
+               + std::size_t(position.y & (REGION_COLUMNS - 1));
+    }
+};
+
+/// Saves and loads chunks to region files in one directory.
+/// Region files are opened on first use and stay open until the storage is destroyed.
+class ChunkStorage {
+public:
+    /// @param directory native path of the directory holding the region files, created if missing
+    explicit ChunkStorage(std::filesystem::path directory);
+
+    /// Creates storage in a directory of the PhysFs write directory set up by File::init
+    static ChunkStorage inWriteDir(std::string_view directory = "regions");
+
+    /// Loads a chunk, returning nullopt if it was never saved
+    [[nodiscard]] std::optional<Chunk> load(glm::i32vec3 position);
+
+    void save(glm::i32vec3 position, const Chunk& chunk);
+    /// Saves a batch of chunks, writing to each region file once
+    void save(std::span<const std::pair<glm::i32vec3, const Chunk*>> chunks);
+
+    [[nodiscard]] std::size_t openRegionCount() const noexcept { return regions.size(); }
+
+    [[nodiscard]] const std::filesystem::path& getDirectory() const noexcept { return directory; }
+
+private:
+    std::filesystem::path directory;
+    ankerl::unordered_dense::map<glm::i32vec3, std::unique_ptr<RegionFile>, ChunkPositionHash> regions;
+    std::vector<std::pair<glm::i32vec3, const Chunk*>> batch;
+
+    /// Returns the open region file containing a chunk, or nullptr if create is false and it does not exist
+    RegionFile* region(glm::i32vec3 position, bool create);
+};
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,223 @@
+#include "core/utility/thread_pool.h"
+#include "region_file.h"
+#include "terrain.h"
+#include <catch.hpp>
+#include <fmt/format.h>
+#include <random>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+
+/// Empty directory removed with everything in it at the end of a test
+struct TempDirectory {
+    std::filesystem::path path = std::filesystem::temp_directory_path()
+                                 / fmt::format("dragonfire-test-{}", std::random_device()());
+
+    TempDirectory() { std::filesystem::create_directories(path); }
+
+    ~TempDirectory() { std::filesystem::remove_all(path); }
+};
+
+static bool sameVoxels(const Chunk& a, const Chunk& b)
+{
+    for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++) {
+        if (a.get(i) != b.get(i))
+            return false;
+    }
+    return true;
+}
+
+TEST_CASE("Region Files")
+{
+    const TempDirectory directory;
+    const std::filesystem::path path = directory.path / "r.-1.0.dfr";
+    const TerrainGenerator generator(42);
+    const std::vector<glm::i32vec3> positions = {{-1, 0, -3}, {-1, 0, 2}, {-32, 31, -1}, {-5, 7, -2}};
+    std::vector<Chunk> chunks;
+    std::vector<std::pair<glm::i32vec3, const Chunk*>> records;
+    chunks.reserve(positions.size());
+    for (const glm::i32vec3 position : positions) {
+        records.emplace_back(position, &chunks.emplace_back(generator.genChunk(position)));
+        REQUIRE(RegionFile::regionOf(position) == glm::i32vec3(-1, 0, 0));
+    }
+
+    SECTION("Saves and loads chunks")
+    {
+        RegionFile region(path);
+        CHECK_FALSE(region.load(positions[0]));
+        region.save(records);
+        for (std::size_t i = 0; i < positions.size(); i++) {
+            const std::optional<Chunk> loaded = region.load(positions[i]);
+            REQUIRE(loaded);
+            CHECK(sameVoxels(*loaded, chunks[i]));
+        }
+        CHECK_FALSE(region.contains({-1, 0, 0}));
+        CHECK_FALSE(region.contains({-2, 0, -3}));
+        CHECK(region.garbageBytes() == 0);
+    }
+
+    SECTION("Appends and relinks replaced chunks")
+    {
+        std::size_t size, garbage;
+        {
+            RegionFile region(path);
+            region.save(records);
+            size = region.fileSize();
+            Chunk edited = chunks[1];
+            edited.set({4, 5, 6}, Voxel{9, 0});
+            region.save(positions[1], edited);
+            CHECK(region.fileSize() > size);
+            CHECK(region.garbageBytes() > 0);
+            chunks[1] = std::move(edited);
+            size = region.fileSize();
+            garbage = region.garbageBytes();
+        }
+        RegionFile region(path);
+        CHECK(region.fileSize() == size);
+        CHECK(region.garbageBytes() == garbage);
+        for (std::size_t i = 0; i < positions.size(); i++)
+            CHECK(sameVoxels(*region.load(positions[i]), chunks[i]));
+    }
+
+    SECTION("Rejects other files")
+    {
+        std::ofstream(path, std::ios::binary) << "not a region file";
+        CHECK_THROWS(RegionFile(path));
+    }
+}
+
+TEST_CASE("Chunk Storage")
+{
+    const TempDirectory directory;
+    std::vector<std::pair<glm::i32vec3, Chunk>> chunks;
+    for (std::int32_t x = -40; x <= 40; x += 20) {
+        for (std::int32_t z = -1; z <= 1; z++) {
+            Chunk chunk;
+            chunk.set({x & 31, 3, z + 1}, Voxel{std::uint16_t(x + 100), 0});
+            chunks.emplace_back(glm::i32vec3(x, -x, z), std::move(chunk));
+        }
+    }
+    std::vector<std::pair<glm::i32vec3, const Chunk*>> records;
+    for (const auto& [position, chunk] : chunks)
+        records.emplace_back(position, &chunk);
+
+    {
+        ChunkStorage storage(directory.path);
+        storage.save(records);
+        CHECK(storage.openRegionCount() == 5);
+    }
+    ChunkStorage storage(directory.path);
+    for (const auto& [position, chunk] : chunks) {
+        const std::optional<Chunk> loaded = storage.load(position);
+        REQUIRE(loaded);
+        CHECK(sameVoxels(*loaded, chunk));
+    }
+    CHECK_FALSE(storage.load({1000, 1000, 0}));
+    CHECK_FALSE(std::filesystem::exists(directory.path / "r.31.31.dfr"));
+}
+
+TEST_CASE("Chunk Streaming With Storage")
+{
+    const TempDirectory directory;
+    ThreadPool pool(2);
+    StreamingSettings settings;
+    settings.radius = 1;
+    settings.verticalRadius = 1;
+    settings.unloadMargin = 0;
+    const auto streamAll = [&](Terrain& terrain, const glm::vec3 observer) {
+        ChunkStreamer& streamer = terrain.getStreamer();
+        for (int frame = 0; frame < 1000; frame++) {
+            terrain.update(std::span(&observer, 1));
+            if (streamer.queuedWork() == 0 && streamer.pendingLoads() == 0)
+                break;
+            pool.waitIdle();
+        }
+    };
+    const glm::vec3 home(10.0f), away(10000.0f, 10.0f, 10.0f);
+    const glm::i32vec3 edited(5, 6, 7), untouched(40, 6, 7);
+    const Voxel marker{200, 0};
+
+    ChunkStorage storage(directory.path);
+    {
+        Terrain terrain(7, pool, settings);
+        terrain.getStreamer().setStorage(&storage);
+        streamAll(terrain, home);
+        REQUIRE(terrain.setVoxel(edited, marker));
+        terrain.clearEdits();
+
+        // Only the modified chunk is written when the observer leaves
+        streamAll(terrain, away);
+        CHECK(storage.load({0, 0, 0}));
+        CHECK_FALSE(storage.load({1, 0, 0}));
+
+        streamAll(terrain, home);
+        CHECK(terrain.getVoxel(edited) == marker);
+        REQUIRE(terrain.setVoxel(untouched, marker));
+        terrain.getStreamer().saveModified();
+    }
+
+    // A new terrain with the same storage loads both edits in place of the generated voxels
+    Terrain terrain(7, pool, settings);
+    terrain.getStreamer().setStorage(&storage);
+    streamAll(terrain, home);
+    CHECK(terrain.getVoxel(edited) == marker);
+    CHECK(terrain.getVoxel(untouched) == marker);
+}
+
+TEST_CASE("Region File Benchmark", "[.][benchmark]")
+{
+    // 1000 chunks of generated terrain, 10 x 10 columns spanning the surface
+    std::vector<glm::i32vec3> positions;
+    for (std::int32_t x = 0; x < 10; x++) {
+        for (std::int32_t y = 0; y < 10; y++) {
+            for (std::int32_t z = -6; z < 4; z++)
+                positions.emplace_back(x, y, z);
+        }
+    }
+    ThreadPool pool;
+    TerrainGenerator generator(42);
+    generator.generate(positions, pool);
+    pool.waitIdle();
+    std::vector<GeneratedChunk> generated;
+    generator.poll(generated);
+    REQUIRE(generated.size() == positions.size());
+    std::vector<std::pair<glm::i32vec3, const Chunk*>> records;
+    std::size_t memory = 0;
+    for (const GeneratedChunk& result : generated) {
+        records.emplace_back(result.position, &result.chunk);
+        memory += result.chunk.memoryUsage();
+    }
+
+    const TempDirectory directory;
+    const auto saveStart = std::chrono::steady_clock::now();
+    {
+        ChunkStorage storage(directory.path);
+        storage.save(records);
+    }
+    const std::chrono::duration<double> saveTime = std::chrono::steady_clock::now() - saveStart;
+
+    ChunkStorage storage(directory.path);
+    const auto loadStart = std::chrono::steady_clock::now();
+    for (const glm::i32vec3 position : positions)
+        REQUIRE(storage.load(position));
+    const std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+
+    const std::size_t fileSize = std::filesystem::file_size(directory.path / "r.0.0.dfr");
+    spdlog::info(
+        "{} chunks, {:.1f} KiB in memory, {:.1f} KiB on disk, save {:.0f} chunks/s, load {:.0f} chunks/s",
+        positions.size(),
+        double(memory) / 1024.0,
+        double(fileSize) / 1024.0,
+        double(positions.size()) / saveTime.count(),
+        double(positions.size()) / loadTime.count()
+    );
+
+    BENCHMARK("Load 1000 chunks")
+    {
+        std::size_t count = 0;
+        for (const glm::i32vec3 position : positions)
+            count += storage.load(position)->paletteSize();
+        return count;
+    };
+}
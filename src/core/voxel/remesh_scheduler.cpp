@@ -0,0 +1,144 @@
+#include "remesh_scheduler.h"
+#include "light.h"
+#include "terrain.h"
+#include <algorithm>
+
+namespace dragonfire::voxel {
+
+RemeshScheduler::RemeshScheduler(Terrain& terrain, ChunkMesher& mesher, const RemeshSettings& settings)
+    : settings(settings), terrain(terrain), mesher(mesher)
+{
+}
+
+void RemeshScheduler::update()
+{
+    ChunkMap& chunks = terrain.getChunks();
+    const ChunkStreamer& streamer = terrain.getStreamer();
+    for (const glm::i32vec3 position : streamer.getUnloaded()) {
+        mesher.cancel(position);
+        requests.erase(position);
+        submitted.erase(position);
+        meshes.erase(position);
+    }
+    for (const glm::i32vec3 position : streamer.getLoaded()) {
+        request(position, {}, true, RemeshPriority::BACKGROUND);
+        // Faces of the neighbours on the old edge of the loaded area may now be hidden
+        requestNeighbours(position, 0x3F, RemeshPriority::BACKGROUND);
+    }
+
+    for (const auto& [position, priority] : terrain.getEdits()) {
+        Chunk* chunk = chunks.find(position);
+        if (chunk == nullptr || !chunk->getDirty().any())
+            continue;
+        const DirtyLayers dirty = chunk->getDirty();
+        chunk->clearDirty();
+        request(position, dirty, false, priority);
+        requestNeighbours(position, dirty.borders(), priority);
+    }
+    if (lighting) {
+        // Light spreading from a visible edit is remeshed along with it. The changed layers already include
+        // the borders of neighbours, so they are not requested separately.
+        const bool visible = std::ranges::any_of(terrain.getEdits(), [](const auto& edit) {
+            return edit.second == RemeshPriority::VISIBLE;
+        });
+        const RemeshPriority priority = visible ? RemeshPriority::VISIBLE : RemeshPriority::BACKGROUND;
+        for (const auto& [position, layers] : lighting->getChanged()) {
+            if (chunks.contains(position))
+                request(position, layers, false, priority);
+        }
+        lighting->clearChanged();
+    }
+    terrain.clearEdits();
+
+    submitQueued(visibleQueue, RemeshPriority::VISIBLE);
+    const std::size_t pending = mesher.pending();
+    const std::size_t capacity = pending < settings.maxPendingJobs ? settings.maxPendingJobs - pending : 0;
+    submitQueued(
+        backgroundQueue,
+        RemeshPriority::BACKGROUND,
+        std::min<std::size_t>(capacity, settings.maxBackgroundJobsPerFrame)
+    );
+}
+
+void RemeshScheduler::setLighting(LightEngine* engine) noexcept
+{
+    lighting = engine;
+    mesher.setLighting(engine);
+}
+
+std::size_t RemeshScheduler::poll(std::vector<MeshedChunk>& out)
+{
+    const std::size_t first = out.size();
+    const std::size_t count = mesher.poll(out);
+    for (std::size_t i = first; i < out.size(); i++) {
+        submitted.erase(out[i].position);
+        meshes[out[i].position] = out[i].mesh;
+    }
+    return count;
+}
+
+void RemeshScheduler::request(
+    const glm::i32vec3 position,
+    const DirtyLayers& dirty,
+    const bool full,
+    const RemeshPriority priority
+)
+{
+    const auto [iter, inserted] = requests.try_emplace(position);
+    Request& request = iter->second;
+    request.dirty |= dirty;
+    request.full |= full;
+    if (!inserted && priority <= request.priority)
+        return;
+    // Upgraded requests leave a stale entry in the background queue, which is skipped when reached
+    request.priority = priority;
+    (priority == RemeshPriority::VISIBLE ? visibleQueue : backgroundQueue).push_back(position);
+}
+
+void RemeshScheduler::requestNeighbours(
+    const glm::i32vec3 position,
+    const std::uint8_t faces,
+    const RemeshPriority priority
+)
+{
+    const ChunkMap& chunks = terrain.getChunks();
+    for (std::uint8_t face = 0; face < FACE_DIRECTIONS.size(); face++) {
+        const glm::i32vec3 neighbour = position + FACE_DIRECTIONS[face];
+        if (!(faces >> face & 1) || !chunks.contains(neighbour))
+            continue;
+        // The neighbour sees this chunk through its opposite face
+        DirtyLayers border;
+        border.markNeighbour(face ^ 1);
+        request(neighbour, border, false, priority);
+    }
+}
+
+void RemeshScheduler::submitQueued(
+    std::vector<glm::i32vec3>& queue,
+    const RemeshPriority priority,
+    const std::size_t budget
+)
+{
+    const ChunkMap& chunks = terrain.getChunks();
+    std::size_t count = 0, kept = 0;
+    for (const glm::i32vec3 position : queue) {
+        const auto found = requests.find(position);
+        if (found == requests.end() || found->second.priority != priority)
+            continue;
+        if (count >= budget || submitted.contains(position)) {
+            queue[kept++] = position;
+            continue;
+        }
+        const Request request = found->second;
+        requests.erase(found);
+        const auto mesh = meshes.find(position);
+        const bool incremental = !request.full && mesh != meshes.end();
+        if (mesher.submit(chunks, position, incremental ? &mesh->second : nullptr, request.dirty)) {
+            submitted.insert(position);
+            count++;
+        }
+    }
+    queue.resize(kept);
+}
+
+}// namespace dragonfire::voxel
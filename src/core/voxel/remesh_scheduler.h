@@ -0,0 +1,94 @@
+#pragma once
+#include "chunk_map.h"
+#include "mesher.h"
+#include <ankerl/unordered_dense.h>
+#include <limits>
+#include <vector>
+
+namespace dragonfire::voxel {
+class LightEngine;
+class Terrain;
+
+enum class RemeshPriority : std::uint8_t {
+    /// Newly loaded chunks and other work the player is not waiting on
+    BACKGROUND,
+    /// Edits the player can see, such as placing or breaking a voxel
+    VISIBLE,
+};
+
+struct RemeshSettings {
+    /// Maximum number of background meshing jobs submitted per update, visible edits are never deferred
+    std::uint32_t maxBackgroundJobsPerFrame = 64;
+    /// Background jobs are not submitted while this many meshing jobs are in flight
+    std::uint32_t maxPendingJobs = 256;
+};
+
+/// Decides which chunks of a Terrain to mesh each frame.
+/// Every edit to a chunk during a frame is merged into a single job that only rebuilds the slices touching
+/// the changed layers, and neighbours are remeshed only when a changed voxel lies on the border they share.
+/// Visible edits are submitted before any background work, and a chunk never has more than one job in
+/// flight, so later edits wait for the previous mesh to finish instead of racing it.
+class RemeshScheduler {
+public:
+    RemeshSettings settings;
+
+    RemeshScheduler(Terrain& terrain, ChunkMesher& mesher, const RemeshSettings& settings = {});
+
+    /***
+     * @brief Collects the chunks loaded, unloaded and edited since the last update and submits meshing jobs.
+     * Meant to be called once per frame, after Terrain::update and after the LightEngine is updated.
+     */
+    void update();
+
+    /***
+     * @brief Lights the meshes with an engine, also remeshing the layers whose light changed on each update,
+     * nullptr to mesh everything fully lit
+     *
+     * The changes of the engine are cleared by update. Must outlive the scheduler.
+     */
+    void setLighting(LightEngine* engine) noexcept;
+
+    /***
+     * @brief Moves finished meshes to the end of out, keeping a copy of each to remesh incrementally later
+     * @return the number of meshes added to out
+     */
+    std::size_t poll(std::vector<MeshedChunk>& out);
+
+    /// Number of chunks waiting to be submitted
+    [[nodiscard]] std::size_t queued() const noexcept { return requests.size(); }
+
+    /// Number of chunks with a meshing job in flight
+    [[nodiscard]] std::size_t inFlight() const noexcept { return submitted.size(); }
+
+    RemeshScheduler(const RemeshScheduler& other) = delete;
+    RemeshScheduler& operator=(const RemeshScheduler& other) = delete;
+
+private:
+    struct Request {
+        DirtyLayers dirty;
+        /// Rebuild the whole mesh, such as for a chunk that has not been meshed yet
+        bool full = false;
+        RemeshPriority priority = RemeshPriority::BACKGROUND;
+    };
+
+    Terrain& terrain;
+    ChunkMesher& mesher;
+    LightEngine* lighting = nullptr;
+    ankerl::unordered_dense::map<glm::i32vec3, Request, ChunkPositionHash> requests;
+    ankerl::unordered_dense::set<glm::i32vec3, ChunkPositionHash> submitted;
+    /// The last mesh built for each loaded chunk, incremental jobs copy the slices that did not change
+    ankerl::unordered_dense::map<glm::i32vec3, ChunkMesh, ChunkPositionHash> meshes;
+    /// Chunks in the order they were requested, may contain positions that were already submitted
+    std::vector<glm::i32vec3> visibleQueue, backgroundQueue;
+
+    void request(glm::i32vec3 position, const DirtyLayers& dirty, bool full, RemeshPriority priority);
+    /// Requests the layers touching the given chunk in each of its loaded neighbours
+    void requestNeighbours(glm::i32vec3 position, std::uint8_t faces, RemeshPriority priority);
+    void submitQueued(
+        std::vector<glm::i32vec3>& queue,
+        RemeshPriority priority,
+        std::size_t budget = std::numeric_limits<std::size_t>::max()
+    );
+};
+
+}// namespace dragonfire::voxel
@@ -2,12 +2,23 @@
 // Created by josh on 6/29/24.
 //
 
+#include "core/utility/rng.h"
+#include "core/utility/thread_pool.h"
+#include "core/utility/thread_scratch.h"
 #include "terrain.h"
+#include <algorithm>
+#include <glm/common.hpp>
+#include <tuple>
 
 namespace dragonfire::voxel {
-TerrainGenerator::TerrainGenerator(const uint64_t seed) : seed(seed)
+
+static constexpr auto DIM = std::int32_t(Chunk::CHUNK_DIM);
+
+TerrainGenerator::TerrainGenerator(const uint64_t seed, const TerrainSettings& settings)
+    : seed(seed), settings(settings)
 {
     noise = FastNoise::New<FastNoise::Simplex>();
+    caveNoise = FastNoise::New<FastNoise::Simplex>();
 }
 
 TerrainGenerator::TerrainGenerator(
@@ -15,9 +26,10 @@ TerrainGenerator::TerrainGenerator(
     const int octaves,
     const float gain,
     const float weight,
-    const float lacunarity
+    const float lacunarity,
+    const TerrainSettings& settings
 )
-    : seed(seed)
+    : seed(seed), settings(settings)
 {
     const auto simplex = FastNoise::New<FastNoise::Simplex>();
     const auto fbm = FastNoise::New<FastNoise::FractalFBm>();
@@ -27,11 +39,541 @@ TerrainGenerator::TerrainGenerator(
     fbm->SetLacunarity(lacunarity);
     fbm->SetWeightedStrength(weight);
     noise = fbm;
+    caveNoise = FastNoise::New<FastNoise::Simplex>();
+}
+
+TerrainGenerator::~TerrainGenerator()
+{
+    // Tasks still queued on the pool reference this generator
+    tasks.wait();
+}
+
+Chunk TerrainGenerator::genChunk(const glm::i32vec3 position, const std::uint32_t lod) const
+{
+    std::int32_t heightMap[Chunk::CHUNK_DIM * Chunk::CHUNK_DIM];
+    genHeightMap({position.x, position.y}, heightMap, lod);
+    return genChunk(position, heightMap, lod);
+}
+
+/// Buffers used while filling a chunk
+struct GenScratch {
+    Voxel voxels[Chunk::CHUNK_SIZE];
+    float caves[Chunk::CHUNK_SIZE];
+    /// Feature voxels placed in other chunks by the chunk being generated
+    std::vector<FeatureSpill> outside;
+    std::vector<FeatureWrite> incoming;
+};
+
+void TerrainGenerator::generate(const std::span<const glm::i32vec3> positions, ThreadPool& pool)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::vector sorted(positions.begin(), positions.end());
+    std::ranges::sort(sorted, [](const glm::i32vec3 a, const glm::i32vec3 b) {
+        return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    });
+    requested.fetch_add(sorted.size(), std::memory_order_relaxed);
+
+    // One task per column, so the height map is only evaluated once for every chunk in it
+    for (auto begin = sorted.begin(); begin != sorted.end();) {
+        const auto end = std::find_if(begin, sorted.end(), [&](const glm::i32vec3 pos) {
+            return pos.x != begin->x || pos.y != begin->y;
+        });
+        std::vector<glm::i32vec3> column(begin, end);
+        begin = end;
+        tasks.submit(pool, [this, column = std::move(column), start] {
+            std::int32_t heightMap[Chunk::CHUNK_DIM * Chunk::CHUNK_DIM];
+            genHeightMap({column.front().x, column.front().y}, heightMap);
+            const std::span<Voxel, Chunk::CHUNK_SIZE> voxels(threadScratch<GenScratch>().voxels);
+            for (const glm::i32vec3 position : column) {
+                const std::optional<Voxel> uniform = genBase(position, heightMap, voxels);
+                if (!uniform)
+                    placeFeatures(position, heightMap, voxels);
+                finishChunk(position, uniform, voxels, start);
+            }
+        });
+    }
+}
+
+std::size_t TerrainGenerator::poll(std::vector<GeneratedChunk>& out)
+{
+    std::vector<FeatureSpill> spills;
+    return poll(out, spills);
+}
+
+std::size_t TerrainGenerator::poll(std::vector<GeneratedChunk>& out, std::vector<FeatureSpill>& spills)
+{
+    // A chunk is always completed before any spill into it, so draining spills first means the chunk of each
+    // spill is either drained below or was returned by an earlier call
+    const std::size_t firstSpill = spills.size();
+    spilled.drain(spills);
+    const std::size_t first = out.size();
+    const std::size_t count = completed.drain(out);
+    requested.fetch_sub(count, std::memory_order_relaxed);
+
+    const auto chunks = std::span(out).subspan(first);
+    const auto applied = std::remove_if(
+        spills.begin() + std::ptrdiff_t(firstSpill),
+        spills.end(),
+        [&](const FeatureSpill& spill) {
+            const auto found = std::ranges::find(chunks, spill.position, &GeneratedChunk::position);
+            if (found == chunks.end())
+                return false;
+            applyFeatures(found->chunk, spill.writes);
+            return true;
+        }
+    );
+    spills.erase(applied, spills.end());
+    return count;
+}
+
+bool TerrainGenerator::featureReplaces(const Voxel existing, const Voxel feature) const noexcept
+{
+    // Only ordering the voxels makes the result independent of the order features are applied in
+    const auto rank = [this](const Voxel voxel) {
+        return voxel.id == 0 ? 0 : voxel == settings.leaves ? 1 : 2;
+    };
+    return rank(feature) > rank(existing);
+}
+
+/// Heights are in voxels of the level of detail, coarser levels sample the noise every 2^lod voxels
+void TerrainGenerator::genHeightMap(
+    const glm::i32vec2 column,
+    const std::span<std::int32_t> out,
+    const std::uint32_t lod
+) const
+{
+    float buffer[Chunk::CHUNK_DIM * Chunk::CHUNK_DIM];
+    const glm::i32vec2 start = column * DIM;
+    const float frequency = settings.heightFrequency * float(1 << lod);
+    noise->GenUniformGrid2D(buffer, start.x, start.y, DIM, DIM, frequency, int(seed));
+    std::ranges::transform(buffer, out.begin(), [this, lod](const float value) {
+        // Arithmetic shift so negative heights round down
+        return std::int32_t(settings.baseHeight + value * settings.heightScale) >> lod;
+    });
+}
+
+/***
+ * @brief Fills a chunk from a height map of the column it is in
+ * @param heightMap height of the surface for each x, y in the column, indexed x + y * CHUNK_DIM
+ * @param lod level of detail of the chunk and the height map
+ */
+Chunk TerrainGenerator::genChunk(
+    const glm::i32vec3 position,
+    const std::span<const std::int32_t> heightMap,
+    const std::uint32_t lod
+) const
+{
+    const std::span<Voxel, Chunk::CHUNK_SIZE> voxels(threadScratch<GenScratch>().voxels);
+    if (const std::optional<Voxel> uniform = genBase(position, heightMap, voxels, lod))
+        return Chunk(*uniform);
+    return Chunk::pack(voxels);
+}
+
+std::optional<Voxel> TerrainGenerator::genBase(
+    const glm::i32vec3 position,
+    const std::span<const std::int32_t> heightMap,
+    const std::span<Voxel, Chunk::CHUNK_SIZE> out,
+    const std::uint32_t lod
+) const
+{
+    const std::int32_t minZ = position.z * DIM;
+    const std::int32_t dirtDepth = std::max(settings.dirtDepth >> lod, 1);
+    const auto [lowest, highest] = std::ranges::minmax(heightMap);
+    if (minZ > highest)
+        return Voxel{};
+    const bool caves = settings.caveThreshold < 1.0f;
+    if (minZ + DIM <= lowest - dirtDepth && !caves)
+        return settings.stone;
+
+    GenScratch& scratch = threadScratch<GenScratch>();
+    if (caves) {
+        caveNoise->GenUniformGrid3D(
+            scratch.caves,
+            position.x * DIM,
+            position.y * DIM,
+            minZ,
+            DIM,
+            DIM,
+            DIM,
+            settings.caveFrequency * float(1 << lod),
+            int(seed) + 1
+        );
+    }
+
+    // Density, solid below the surface except where caves are carved out
+    // FastNoise grids are x major while chunks are z major, so index the noise with x + y * DIM + z * DIM^2
+    for (std::int32_t x = 0; x < DIM; x++) {
+        for (std::int32_t y = 0; y < DIM; y++) {
+            const std::int32_t height = heightMap[x + y * DIM];
+            Voxel* column = out.data() + Chunk::linearIndex({x, y, 0});
+            for (std::int32_t z = 0; z < DIM; z++) {
+                const float cave = caves ? scratch.caves[x + y * DIM + z * DIM * DIM] : 0.0f;
+                column[z] = minZ + z <= height && cave <= settings.caveThreshold ? settings.stone : Voxel{};
+            }
+        }
+    }
+
+    // Surface, the solid voxels within dirtDepth of the surface become dirt with grass on top
+    for (std::int32_t x = 0; x < DIM; x++) {
+        for (std::int32_t y = 0; y < DIM; y++) {
+            const std::int32_t height = heightMap[x + y * DIM] - minZ;
+            Voxel* column = out.data() + Chunk::linearIndex({x, y, 0});
+            for (std::int32_t z = std::max(height - dirtDepth + 1, 0); z <= std::min(height, DIM - 1); z++) {
+                if (column[z].id != 0)
+                    column[z] = z == height ? settings.grass : settings.dirt;
+            }
+        }
+    }
+    return std::nullopt;
 }
 
-Chunk TerrainGenerator::genChunk(glm::i32vec3 corner)
+/// Places a tree growing from the grass voxel at base, with a trunk of the given height
+template<typename Place>
+static void placeTree(
+    const glm::i32vec3 base,
+    const std::int32_t trunk,
+    const TerrainSettings& settings,
+    Place&& place
+)
 {
-    float buffer[Chunk::CHUNK_SIZE];
-    noise->GenUniformGrid2D(buffer, corner.x, corner.y, Chunk::CHUNK_DIM, Chunk::CHUNK_DIM, 1.0, seed);
+    const std::int32_t top = base.z + trunk;
+    for (std::int32_t z = top - 1; z <= top + 2; z++) {
+        const std::int32_t radius = z <= top ? 2 : 1;
+        for (std::int32_t x = -radius; x <= radius; x++) {
+            for (std::int32_t y = -radius; y <= radius; y++) {
+                // Leave out the corners so the canopy is rounded
+                if (std::abs(x) == radius && std::abs(y) == radius && (radius == 2 || z == top + 2))
+                    continue;
+                place(glm::i32vec3(base.x + x, base.y + y, z), settings.leaves);
+            }
+        }
+    }
+    for (std::int32_t z = base.z + 1; z <= top; z++)
+        place(glm::i32vec3(base.x, base.y, z), settings.log);
+}
+
+void TerrainGenerator::placeFeatures(
+    const glm::i32vec3 position,
+    const std::span<const std::int32_t> heightMap,
+    const std::span<Voxel, Chunk::CHUNK_SIZE> voxels
+)
+{
+    if (settings.treeChance <= 0.0f)
+        return;
+    std::vector<FeatureSpill>& outside = threadScratch<GenScratch>().outside;
+    outside.clear();
+    const auto place = [&](const glm::i32vec3 world, const Voxel voxel) {
+        const auto [chunk, local] = Chunk::splitPosition(world);
+        const auto index = std::uint16_t(Chunk::linearIndex(local));
+        if (chunk == position) {
+            if (featureReplaces(voxels[index], voxel))
+                voxels[index] = voxel;
+            return;
+        }
+        auto found = std::ranges::find(outside, chunk, &FeatureSpill::position);
+        if (found == outside.end())
+            found = outside.insert(outside.end(), FeatureSpill{chunk, {}});
+        found->writes.push_back({index, voxel});
+    };
+
+    // Seeded by the chunk position so the features of a chunk don't depend on the order chunks are generated
+    RNG rng(seed ^ ChunkPositionHash{}(position));
+    const glm::i32vec3 origin = position * DIM;
+    const auto heights = std::uint64_t(std::max(settings.maxTreeHeight - settings.minTreeHeight, 0) + 1);
+    for (std::int32_t x = 0; x < DIM; x++) {
+        for (std::int32_t y = 0; y < DIM; y++) {
+            const std::int32_t height = heightMap[x + y * DIM] - origin.z;
+            if (rng.nextDouble() >= settings.treeChance || height < 0 || height >= DIM)
+                continue;
+            if (voxels[Chunk::linearIndex({x, y, height})] != settings.grass)
+                continue;
+            const auto trunk = settings.minTreeHeight + std::int32_t(rng.next() % heights);
+            placeTree(origin + glm::i32vec3(x, y, height), trunk, settings, place);
+        }
+    }
+
+    for (FeatureSpill& spill : outside) {
+        // Keep the voxel that wins at each index, so each index is written once
+        std::ranges::sort(spill.writes, {}, &FeatureWrite::index);
+        std::size_t kept = 0;
+        for (const FeatureWrite write : spill.writes) {
+            if (kept > 0 && spill.writes[kept - 1].index == write.index) {
+                if (featureReplaces(spill.writes[kept - 1].voxel, write.voxel))
+                    spill.writes[kept - 1].voxel = write.voxel;
+            }
+            else
+                spill.writes[kept++] = write;
+        }
+        spill.writes.resize(kept);
+
+        FeatureShard& shard = featureShard(spill.position);
+        std::unique_lock lock(shard.mutex);
+        FeatureTarget& target = shard.targets[spill.position];
+        target.revision = ++shard.revisions;
+        if (shard.generated.contains(spill.position))
+            spilled.push({spill.position, spill.writes});
+        // A chunk generated again places the same features, so they replace the ones from last time
+        const auto found = std::ranges::find(target.sources, position, &FeatureSource::position);
+        if (found != target.sources.end())
+            found->writes = std::move(spill.writes);
+        else
+            target.sources.push_back({position, std::move(spill.writes)});
+    }
+
+    FeatureShard& shard = featureShard(position);
+    std::unique_lock lock(shard.mutex);
+    if (outside.empty()) {
+        shard.placed.erase(position);
+        return;
+    }
+    std::vector<glm::i32vec3>& placed = shard.placed[position];
+    placed.clear();
+    for (const FeatureSpill& spill : outside)
+        placed.push_back(spill.position);
 }
+
+void TerrainGenerator::finishChunk(
+    const glm::i32vec3 position,
+    std::optional<Voxel> uniform,
+    const std::span<Voxel, Chunk::CHUNK_SIZE> voxels,
+    const std::chrono::steady_clock::time_point start
+)
+{
+    FeatureShard& shard = featureShard(position);
+    std::vector<FeatureWrite>& incoming = threadScratch<GenScratch>().incoming;
+    incoming.clear();
+    std::uint64_t revision = 0;
+    {
+        std::unique_lock lock(shard.mutex);
+        const auto found = shard.targets.find(position);
+        if (found != shard.targets.end()) {
+            revision = found->second.revision;
+            for (const FeatureSource& source : found->second.sources)
+                incoming.insert(incoming.end(), source.writes.begin(), source.writes.end());
+        }
+    }
+    if (uniform && std::ranges::any_of(incoming, [&](const FeatureWrite write) {
+            return featureReplaces(*uniform, write.voxel);
+        })) {
+        std::ranges::fill(voxels, *uniform);
+        uniform.reset();
+    }
+    if (!uniform) {
+        for (const FeatureWrite write : incoming) {
+            if (featureReplaces(voxels[write.index], write.voxel))
+                voxels[write.index] = write.voxel;
+        }
+    }
+    Chunk chunk = uniform ? Chunk(*uniform) : Chunk::pack(voxels);
+
+    std::unique_lock lock(shard.mutex);
+    // Features placed while the chunk was being packed have not been spilled, since it isn't generated yet
+    const auto found = shard.targets.find(position);
+    if (found != shard.targets.end() && found->second.revision != revision) {
+        for (const FeatureSource& source : found->second.sources)
+            applyFeatures(chunk, source.writes);
+    }
+    shard.generated.insert(position);
+    // Completed while holding the lock, so every later spill into the chunk is pushed after it
+    completed.push({position, std::move(chunk), std::chrono::steady_clock::now() - start});
+}
+
+void TerrainGenerator::applyFeatures(Chunk& chunk, const std::span<const FeatureWrite> writes) const
+{
+    for (const FeatureWrite write : writes) {
+        if (featureReplaces(chunk.get(write.index), write.voxel))
+            chunk.set(std::size_t(write.index), write.voxel);
+    }
+    // Generated chunks are meshed in full when they are loaded
+    chunk.clearDirty();
+}
+
+void TerrainGenerator::forgetChunks(const std::span<const glm::i32vec3> positions)
+{
+    std::vector<glm::i32vec3> placed;
+    for (const glm::i32vec3 position : positions) {
+        placed.clear();
+        {
+            FeatureShard& shard = featureShard(position);
+            std::unique_lock lock(shard.mutex);
+            shard.generated.erase(position);
+            const auto found = shard.placed.find(position);
+            if (found != shard.placed.end()) {
+                placed.swap(found->second);
+                shard.placed.erase(found);
+            }
+        }
+        // One shard locked at a time, the same as placeFeatures
+        for (const glm::i32vec3 target : placed) {
+            FeatureShard& shard = featureShard(target);
+            std::unique_lock lock(shard.mutex);
+            const auto found = shard.targets.find(target);
+            if (found == shard.targets.end())
+                continue;
+            std::erase_if(found->second.sources, [&](const FeatureSource& source) {
+                return source.position == position;
+            });
+            if (found->second.sources.empty())
+                shard.targets.erase(found);
+        }
+    }
+}
+
+std::size_t TerrainGenerator::featureTargetCount()
+{
+    std::size_t count = 0;
+    for (FeatureShard& shard : features) {
+        std::unique_lock lock(shard.mutex);
+        count += shard.targets.size();
+    }
+    return count;
+}
+
+TerrainGenerator::FeatureShard& TerrainGenerator::featureShard(const glm::i32vec3 position) noexcept
+{
+    return features[ChunkPositionHash{}(position) % FEATURE_SHARDS];
+}
+
+Terrain::Terrain(const uint64_t seed, ThreadPool& pool, const StreamingSettings& settings)
+    : generator(seed), streamer(chunks, generator, pool, settings)
+{
+}
+
+void Terrain::update(const std::span<const glm::vec3> observers)
+{
+    streamer.update(observers);
+    for (const FeatureSpill& spill : streamer.getSpills()) {
+        const Chunk* chunk = chunks.find(spill.position);
+        if (chunk == nullptr)
+            continue;
+        // Applied one spill at a time, since spills from different chunks may place voxels at the same index
+        features.clear();
+        for (const FeatureWrite write : spill.writes) {
+            if (generator.featureReplaces(chunk->get(write.index), write.voxel))
+                features.addVoxel(spill.position, write.index, write.voxel);
+        }
+        apply(features, RemeshPriority::BACKGROUND);
+    }
+}
+
+std::optional<Voxel> Terrain::getVoxel(const glm::i32vec3 position) const
+{
+    const auto [chunkPosition, local] = Chunk::splitPosition(position);
+    const Chunk* chunk = chunks.find(chunkPosition);
+    if (chunk == nullptr)
+        return std::nullopt;
+    return (*chunk)[local];
+}
+
+bool Terrain::setVoxel(const glm::i32vec3 position, const Voxel voxel, const RemeshPriority priority)
+{
+    const auto [chunkPosition, local] = Chunk::splitPosition(position);
+    Chunk* chunk = chunks.find(chunkPosition);
+    if (chunk == nullptr)
+        return false;
+    if ((*chunk)[local] == voxel)
+        return true;
+    chunk->set(local, voxel);
+    journal.addVoxel(chunkPosition, std::uint16_t(Chunk::linearIndex(local)), voxel);
+    recordEdit(chunkPosition, priority);
+    return true;
+}
+
+EditJournal Terrain::apply(const EditTransaction& transaction, const RemeshPriority priority)
+{
+    // Sorted by chunk, keeping the order of the operations within each chunk
+    touched.clear();
+    const auto& operations = transaction.operations;
+    for (std::uint32_t i = 0; i < operations.size(); i++) {
+        const auto& op = operations[i];
+        if (op.max.x <= op.min.x || op.max.y <= op.min.y || op.max.z <= op.min.z)
+            continue;
+        const glm::i32vec3 first = Chunk::chunkOf(op.min);
+        const glm::i32vec3 last = Chunk::chunkOf(op.max - 1);
+        for (std::int32_t x = first.x; x <= last.x; x++) {
+            for (std::int32_t y = first.y; y <= last.y; y++) {
+                for (std::int32_t z = first.z; z <= last.z; z++)
+                    touched.emplace_back(glm::i32vec3(x, y, z), i);
+            }
+        }
+    }
+    std::ranges::stable_sort(touched, [](const auto& a, const auto& b) {
+        return std::tie(a.first.x, a.first.y, a.first.z) < std::tie(b.first.x, b.first.y, b.first.z);
+    });
+
+    EditJournal changes;
+    std::vector<std::uint32_t> indices;
+    for (auto begin = touched.begin(); begin != touched.end();) {
+        const glm::i32vec3 position = begin->first;
+        const auto end = std::find_if(begin, touched.end(), [&](const auto& entry) {
+            return entry.first != position;
+        });
+        indices.clear();
+        for (auto it = begin; it != end; ++it)
+            indices.push_back(it->second);
+        begin = end;
+        Chunk* chunk = chunks.find(position);
+        if (chunk == nullptr)
+            continue;
+        const std::size_t before = changes.chunks().size();
+        transaction.applyChunk(position, indices, *chunk, changes);
+        if (changes.chunks().size() != before)
+            recordEdit(position, priority);
+    }
+    journal.append(changes);
+    return changes;
+}
+
+void Terrain::apply(const EditJournal& changes, const RemeshPriority priority)
+{
+    for (const JournalChunk& entry : changes.chunks()) {
+        Chunk* chunk = chunks.find(entry.position);
+        if (chunk == nullptr)
+            continue;
+        applyRuns(*chunk, changes.runs(entry));
+        journal.addChunk(entry.position, changes.runs(entry));
+        recordEdit(entry.position, priority);
+    }
+}
+
+void Terrain::recordEdit(const glm::i32vec3 position, const RemeshPriority priority)
+{
+    RemeshPriority& edit = edits[position];
+    edit = std::max(edit, priority);
+    streamer.markModified(position);
+}
+
+VoxelRegion Terrain::copy(const glm::i32vec3 min, const glm::i32vec3 max) const
+{
+    VoxelRegion region;
+    region.size = glm::max(max - min, 0);
+    const std::size_t columns = std::size_t(region.size.x) * std::size_t(region.size.y);
+    region.voxels.resize(columns * std::size_t(region.size.z));
+    if (region.voxels.empty())
+        return region;
+    // Copied one chunk at a time, so each chunk is only looked up once
+    const glm::i32vec3 first = Chunk::chunkOf(min);
+    const glm::i32vec3 last = Chunk::chunkOf(max - 1);
+    for (std::int32_t cx = first.x; cx <= last.x; cx++) {
+        for (std::int32_t cy = first.y; cy <= last.y; cy++) {
+            for (std::int32_t cz = first.z; cz <= last.z; cz++) {
+                const Chunk* chunk = chunks.find({cx, cy, cz});
+                if (chunk == nullptr)
+                    continue;
+                const glm::i32vec3 origin = glm::i32vec3(cx, cy, cz) * DIM;
+                const glm::i32vec3 low = glm::max(min, origin);
+                const glm::i32vec3 high = glm::min(max, origin + DIM);
+                for (std::int32_t x = low.x; x < high.x; x++) {
+                    for (std::int32_t y = low.y; y < high.y; y++) {
+                        Voxel* out = region.voxels.data() + region.index(glm::i32vec3(x, y, low.z) - min);
+                        for (std::int32_t z = low.z; z < high.z; z++)
+                            *out++ = (*chunk)[glm::ivec3(x, y, z) - origin];
+                    }
+                }
+            }
+        }
+    }
+    return region;
+}
+
 }// namespace dragonfire::voxel
@@ -4,27 +4,312 @@
 
 #pragma once
 #include "chunk.h"
+#include "chunk_map.h"
+#include "chunk_streamer.h"
+#include "core/utility/completion_queue.h"
+#include "core/utility/thread_pool.h"
+#include "edit.h"
+#include "raycast.h"
+#include "remesh_scheduler.h"
 #include "voxel.h"
 #include <FastNoise/FastNoise.h>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
 
 namespace dragonfire::voxel {
 
+struct TerrainSettings {
+    /// Frequency of the height map noise, per voxel
+    float heightFrequency = 0.004f;
+    /// World height of the surface where the height noise is 0
+    float baseHeight = 0.0f;
+    /// Maximum distance of the surface from baseHeight
+    float heightScale = 48.0f;
+    float caveFrequency = 0.02f;
+    /// Cave noise values above this are carved out, set above 1 to disable caves
+    float caveThreshold = 0.6f;
+    std::int32_t dirtDepth = 4;
+    /// Chance of a tree growing on each grass column, set to 0 to disable trees
+    float treeChance = 0.004f;
+    std::int32_t minTreeHeight = 4, maxTreeHeight = 6;
+    Voxel stone{1, 0}, dirt{2, 0}, grass{3, 0}, log{4, 0}, leaves{5, 1};
+};
+
+/// A voxel placed by a feature such as a tree, at an index of the chunk in Chunk::linearIndex order
+struct FeatureWrite {
+    std::uint16_t index;
+    Voxel voxel;
+
+    bool operator==(const FeatureWrite& other) const = default;
+};
+
+/// Voxels a feature placed in a chunk that had already been generated when the feature was placed
+struct FeatureSpill {
+    /// Position of the chunk in chunk coordinates
+    glm::i32vec3 position;
+    std::vector<FeatureWrite> writes;
+};
+
+struct GeneratedChunk {
+    /// Position of the chunk in chunk coordinates
+    glm::i32vec3 position;
+    Chunk chunk;
+    /// Time from the generate call until the chunk was finished
+    std::chrono::nanoseconds latency;
+};
+
+/***
+ * @brief Generates terrain in stages: base density, surface, then features such as trees
+ *
+ * Chunks are not lit here, GameWorld::syncTerrain passes them to its LightEngine once they are loaded.
+ * Features may reach into neighbouring chunks, those voxels are kept in a sharded queue and applied when the
+ * neighbour is generated, so chunks are generated in parallel without a global lock. A feature voxel only
+ * replaces air, or leaves with logs, so the voxels of a chunk are the same for a seed whatever order its
+ * features arrive in.
+ */
 class TerrainGenerator {
 public:
     const uint64_t seed;
+    const TerrainSettings settings;
+
+    TerrainGenerator(uint64_t seed, const TerrainSettings& settings = {});
+    TerrainGenerator(
+        uint64_t seed,
+        int octaves,
+        float gain,
+        float weight,
+        float lacunarity,
+        const TerrainSettings& settings = {}
+    );
+    /// Waits for any chunks still being generated
+    ~TerrainGenerator();
+
+    /***
+     * @brief Generates a single chunk on the calling thread, safe to call from multiple threads at once
+     *
+     * Only the density and surface stages are run, features are placed by generate.
+     * @param lod level of detail, each voxel of the chunk spans 2^lod voxels along each axis and position is
+     * in chunks of that level
+     */
+    Chunk genChunk(glm::i32vec3 position, std::uint32_t lod = 0) const;
 
-    TerrainGenerator(uint64_t seed);
-    TerrainGenerator(uint64_t seed, int octaves, float gain, float weight, float lacunarity);
+    /***
+     * @brief Generates a batch of chunks on the thread pool
+     *
+     * Chunks in the same column share one height map evaluation, so batches should contain whole columns
+     * where possible. Finished chunks are delivered through poll, in no particular order, with the features
+     * of every chunk generated before them.
+     * @param positions chunk coordinates to generate
+     */
+    void generate(std::span<const glm::i32vec3> positions, ThreadPool& pool);
 
-    Chunk genChunk(glm::i32vec3 corner);
+    /***
+     * @brief Moves every finished chunk to the end of out
+     *
+     * Features placed in chunks returned by earlier calls are discarded, use the overload taking spills to
+     * apply them to chunks that are already loaded.
+     * @return the number of chunks added to out
+     */
+    std::size_t poll(std::vector<GeneratedChunk>& out);
+
+    /***
+     * @brief Moves every finished chunk to the end of out, and the features placed in chunks returned by
+     * earlier calls to the end of spills
+     * @return the number of chunks added to out
+     */
+    std::size_t poll(std::vector<GeneratedChunk>& out, std::vector<FeatureSpill>& spills);
+
+    /***
+     * @brief Drops the feature voxels the chunks placed in other chunks, and the record that they were
+     * generated
+     *
+     * Call with the chunks unloaded, or generated and never loaded, so the feature queue only holds what the
+     * loaded chunks need. A forgotten chunk places its features again when it is generated again. Features
+     * placed in it by chunks that are still remembered are kept, so it gets them back if it is regenerated.
+     */
+    void forgetChunks(std::span<const glm::i32vec3> positions);
+
+    /// Number of chunks holding features placed in them by other chunks
+    [[nodiscard]] std::size_t featureTargetCount();
+
+    /// Whether a feature voxel replaces the voxel already in the world
+    [[nodiscard]] bool featureReplaces(Voxel existing, Voxel feature) const noexcept;
+
+    /// Number of chunks requested that have not been polled yet
+    [[nodiscard]] std::size_t pending() const noexcept { return requested.load(std::memory_order_relaxed); }
+
+    TerrainGenerator(const TerrainGenerator& other) = delete;
+    TerrainGenerator& operator=(const TerrainGenerator& other) = delete;
 
 private:
+    static constexpr std::size_t FEATURE_SHARDS = 64;
+
+    /// Feature voxels one chunk placed in another
+    struct FeatureSource {
+        glm::i32vec3 position;
+        std::vector<FeatureWrite> writes;
+    };
+
+    struct FeatureTarget {
+        std::vector<FeatureSource> sources;
+        /// Taken from the shard's revisions whenever sources changes
+        std::uint64_t revision = 0;
+    };
+
+    struct alignas(64) FeatureShard {
+        std::mutex mutex;
+        /// Only chunks with features placed in them by a chunk that hasn't been forgotten have a target
+        ankerl::unordered_dense::map<glm::i32vec3, FeatureTarget, ChunkPositionHash> targets;
+        /// Chunks handed to completed and not forgotten since, features placed in them are spilled
+        ankerl::unordered_dense::set<glm::i32vec3, ChunkPositionHash> generated;
+        /// Chunks each chunk placed features in, so its sources can be dropped when it is forgotten
+        ankerl::unordered_dense::map<glm::i32vec3, std::vector<glm::i32vec3>, ChunkPositionHash> placed;
+        std::uint64_t revisions = 0;
+    };
+
     FastNoise::SmartNode<> noise;
+    FastNoise::SmartNode<> caveNoise;
+    CompletionQueue<GeneratedChunk> completed;
+    /// Features placed in chunks that were already generated, drained before completed
+    CompletionQueue<FeatureSpill> spilled;
+    /// Feature voxels placed in each chunk by its neighbours, kept while the neighbours are remembered so
+    /// regenerated chunks get them again
+    std::array<FeatureShard, FEATURE_SHARDS> features;
+    /// Chunks requested but not yet polled
+    std::atomic_size_t requested = 0;
+    /// Generation tasks queued or running
+    TaskGroup tasks;
+
+    void genHeightMap(glm::i32vec2 column, std::span<std::int32_t> out, std::uint32_t lod = 0) const;
+    Chunk genChunk(
+        glm::i32vec3 position,
+        std::span<const std::int32_t> heightMap,
+        std::uint32_t lod = 0
+    ) const;
+    /***
+     * @brief Runs the density and surface stages
+     * @return the voxel filling the whole chunk if it is uniform, in which case out is not written
+     */
+    std::optional<Voxel> genBase(
+        glm::i32vec3 position,
+        std::span<const std::int32_t> heightMap,
+        std::span<Voxel, Chunk::CHUNK_SIZE> out,
+        std::uint32_t lod = 0
+    ) const;
+    /// Places the features starting in the chunk, queueing the voxels they place in other chunks
+    void placeFeatures(
+        glm::i32vec3 position,
+        std::span<const std::int32_t> heightMap,
+        std::span<Voxel, Chunk::CHUNK_SIZE> voxels
+    );
+    /// Applies the features other chunks placed in this one and hands it to completed
+    void finishChunk(
+        glm::i32vec3 position,
+        std::optional<Voxel> uniform,
+        std::span<Voxel, Chunk::CHUNK_SIZE> voxels,
+        std::chrono::steady_clock::time_point start
+    );
+    /// Applies feature voxels that win over the voxels already in a generated chunk
+    void applyFeatures(Chunk& chunk, std::span<const FeatureWrite> writes) const;
+    FeatureShard& featureShard(glm::i32vec3 position) noexcept;
 };
 
+/// Loaded terrain around the observers, generated on a thread pool
 class Terrain {
-    std::unordered_map<glm::i64vec3, Chunk> chunks;
+public:
+    Terrain(uint64_t seed, ThreadPool& pool, const StreamingSettings& settings = {});
+
+    /***
+     * @brief Streams chunks in and out around the observers, meant to be called once per frame
+     *
+     * Features newly generated chunks placed in chunks that were already loaded are applied as edits.
+     * @param observers world space positions, such as the camera or players
+     */
+    void update(std::span<const glm::vec3> observers);
+
+    ChunkMap& getChunks() noexcept { return chunks; }
+
+    ChunkStreamer& getStreamer() noexcept { return streamer; }
+
+    TerrainGenerator& getGenerator() noexcept { return generator; }
+
+    /// Returns the voxel at a world position, or nullopt if the chunk containing it is not loaded
+    [[nodiscard]] std::optional<Voxel> getVoxel(glm::i32vec3 position) const;
+
+    /***
+     * @brief Sets the voxel at a world position, recording the edited chunk so its mesh can be updated
+     * @param priority how soon the edit should be remeshed, a chunk uses the highest priority of its edits
+     * @return false if the chunk containing the voxel is not loaded
+     */
+    bool setVoxel(glm::i32vec3 position, Voxel voxel, RemeshPriority priority = RemeshPriority::VISIBLE);
+
+    /***
+     * @brief Applies the operations of a transaction one chunk at a time, skipping chunks that are not loaded
+     * @param priority how soon the edited chunks should be remeshed, as in setVoxel
+     * @return the voxels changed by the transaction, which are also added to getJournal
+     */
+    EditJournal apply(const EditTransaction& transaction, RemeshPriority priority = RemeshPriority::VISIBLE);
+
+    /***
+     * @brief Replays the changes of a journal, such as one received from another instance of the terrain
+     * @param priority how soon the edited chunks should be remeshed, as in setVoxel
+     */
+    void apply(const EditJournal& changes, RemeshPriority priority = RemeshPriority::VISIBLE);
+
+    /// Copies the voxels in the box from min to one before max, chunks that are not loaded are copied as air
+    [[nodiscard]] VoxelRegion copy(glm::i32vec3 min, glm::i32vec3 max) const;
+
+    /// Finds the first non air voxel along each ray, chunks that are not loaded count as air
+    void raycast(const std::span<const Ray> rays, const std::span<RayHit> out) const
+    {
+        voxel::raycast(chunks, rays, out);
+    }
+
+    [[nodiscard]] RayHit raycast(const Ray& ray) const { return voxel::raycast(chunks, ray); }
+
+    /// Moves each box along its motion until it touches a non air voxel
+    void sweep(const std::span<const BoxSweep> sweeps, const std::span<SweepHit> out) const
+    {
+        voxel::sweep(chunks, sweeps, out);
+    }
+
+    [[nodiscard]] SweepHit sweep(const Aabb& box, const glm::vec3 motion) const
+    {
+        return voxel::sweep(chunks, box, motion);
+    }
+
+    /// Chunks edited since the last call to clearEdits
+    [[nodiscard]] const auto& getEdits() const noexcept { return edits; }
+
+    /// Voxels changed since the last call to clearEdits, in the order they were changed
+    [[nodiscard]] const EditJournal& getJournal() const noexcept { return journal; }
+
+    void clearEdits() noexcept
+    {
+        edits.clear();
+        journal.clear();
+    }
+
+private:
+    ChunkMap chunks;
+    TerrainGenerator generator;
+    ChunkStreamer streamer;
+    ankerl::unordered_dense::map<glm::i32vec3, RemeshPriority, ChunkPositionHash> edits;
+    EditJournal journal;
+    /// Chunks touched by each operation of the transaction being applied
+    std::vector<std::pair<glm::i32vec3, std::uint32_t>> touched;
+    /// Feature voxels placed in loaded chunks by the last update
+    EditJournal features;
+
+    /// Records an edited chunk for remeshing and for saving when it is unloaded
+    void recordEdit(glm::i32vec3 position, RemeshPriority priority);
 };
 
 }// namespace dragonfire::voxel
@@ -0,0 +1,248 @@
+#include "core/utility/thread_pool.h"
+#include "terrain.h"
+#include <algorithm>
+#include <catch.hpp>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+
+static std::vector<glm::i32vec3> columnBatch(const int width, const int minZ, const int maxZ)
+{
+    std::vector<glm::i32vec3> positions;
+    for (int x = 0; x < width; x++) {
+        for (int y = 0; y < width; y++) {
+            for (int z = minZ; z <= maxZ; z++)
+                positions.emplace_back(x, y, z);
+        }
+    }
+    return positions;
+}
+
+static bool sameVoxels(const Chunk& a, const Chunk& b)
+{
+    for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++) {
+        if (a.get(i) != b.get(i))
+            return false;
+    }
+    return true;
+}
+
+TEST_CASE("Terrain Generation")
+{
+    const TerrainGenerator generator(1234);
+
+    SECTION("Chunks above the surface are uniform air")
+    {
+        const Chunk chunk = generator.genChunk({0, 0, 10});
+        CHECK(chunk.isUniform());
+        CHECK(chunk.get(0) == Voxel{});
+    }
+
+    SECTION("Surface chunks have a palette")
+    {
+        const Chunk chunk = generator.genChunk({0, 0, 0});
+        CHECK(!chunk.isUniform());
+        CHECK(chunk.paletteSize() > 1);
+    }
+}
+
+TEST_CASE("Batched Terrain Generation")
+{
+    ThreadPool pool(3);
+    // Without trees, so the chunks match the base terrain from genChunk
+    TerrainGenerator generator(42, TerrainSettings{.treeChance = 0.0f});
+    const auto positions = columnBatch(3, -2, 2);
+    generator.generate(positions, pool);
+    CHECK(generator.pending() == positions.size());
+    pool.waitIdle();
+
+    std::vector<GeneratedChunk> results;
+    CHECK(generator.poll(results) == positions.size());
+    CHECK(generator.pending() == 0);
+    CHECK(generator.featureTargetCount() == 0);
+    for (const glm::i32vec3 position : positions) {
+        const auto found = std::ranges::find(results, position, &GeneratedChunk::position);
+        REQUIRE(found != results.end());
+        CHECK(sameVoxels(found->chunk, generator.genChunk(position)));
+    }
+}
+
+/// Generates the chunks in batches, polling as it goes so later chunks spill features into earlier ones
+static std::vector<GeneratedChunk> generateInBatches(
+    TerrainGenerator& generator,
+    ThreadPool& pool,
+    const std::span<const glm::i32vec3> positions,
+    const std::size_t batchSize
+)
+{
+    std::vector<GeneratedChunk> results;
+    std::vector<FeatureSpill> spills;
+    for (std::size_t i = 0; i < positions.size(); i += batchSize) {
+        generator.generate(positions.subspan(i, std::min(batchSize, positions.size() - i)), pool);
+        generator.poll(results, spills);
+    }
+    pool.waitIdle();
+    generator.poll(results, spills);
+    for (const FeatureSpill& spill : spills) {
+        const auto found = std::ranges::find(results, spill.position, &GeneratedChunk::position);
+        REQUIRE(found != results.end());
+        for (const FeatureWrite write : spill.writes) {
+            if (generator.featureReplaces(found->chunk.get(write.index), write.voxel))
+                found->chunk.set(std::size_t(write.index), write.voxel);
+        }
+    }
+    return results;
+}
+
+TEST_CASE("Terrain Features", "[voxel]")
+{
+    ThreadPool pool(3);
+    const TerrainSettings settings{.treeChance = 0.02f};
+    const auto positions = columnBatch(4, -2, 1);
+    TerrainGenerator generator(42, settings);
+    const auto expected = generateInBatches(generator, pool, positions, positions.size());
+    REQUIRE(expected.size() == positions.size());
+    const auto find = [&](const glm::i32vec3 position) -> const Chunk& {
+        return std::ranges::find(expected, position, &GeneratedChunk::position)->chunk;
+    };
+
+    SECTION("Trees grow across chunk borders")
+    {
+        std::size_t logs = 0, crossings = 0;
+        for (const GeneratedChunk& result : expected) {
+            for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++)
+                logs += result.chunk.get(i) == settings.log;
+            const glm::i32vec3 next = result.position + glm::i32vec3(1, 0, 0);
+            if (next.x >= 4)
+                continue;
+            for (std::int32_t y = 0; y < 32; y++) {
+                for (std::int32_t z = 0; z < 32; z++) {
+                    crossings += result.chunk[{31, y, z}] == settings.leaves
+                                 && find(next)[{0, y, z}] == settings.leaves;
+                }
+            }
+        }
+        CHECK(logs > 0);
+        CHECK(crossings > 0);
+        for (const glm::i32vec3 position : positions) {
+            const Chunk base = generator.genChunk(position);
+            for (std::size_t i = 0; i < Chunk::CHUNK_SIZE; i++)
+                REQUIRE(base.get(i) != settings.log);
+        }
+    }
+
+    SECTION("The order chunks are generated in doesn't change them")
+    {
+        TerrainGenerator reversed(42, settings);
+        const std::vector backwards(positions.rbegin(), positions.rend());
+        const auto results = generateInBatches(reversed, pool, backwards, 4);
+        REQUIRE(results.size() == expected.size());
+        for (const GeneratedChunk& result : results)
+            CHECK(sameVoxels(result.chunk, find(result.position)));
+    }
+
+    SECTION("Regenerated chunks get the features of their neighbours again")
+    {
+        // Unloaded first, their neighbours still hold the features they placed in them
+        const glm::i32vec3 again[] = {{1, 1, -2}, {1, 1, -1}, {1, 1, 0}, {1, 1, 1}};
+        generator.forgetChunks(again);
+        generator.generate(again, pool);
+        pool.waitIdle();
+        std::vector<GeneratedChunk> results;
+        std::vector<FeatureSpill> spills;
+        generator.poll(results, spills);
+        REQUIRE(results.size() == 4);
+        for (const GeneratedChunk& result : results)
+            CHECK(sameVoxels(result.chunk, find(result.position)));
+        // Its own features are placed again in the neighbours, which already have them
+        for (const FeatureSpill& spill : spills) {
+            for (const FeatureWrite write : spill.writes)
+                CHECK_FALSE(generator.featureReplaces(find(spill.position).get(write.index), write.voxel));
+        }
+    }
+
+    SECTION("Forgotten chunks drop the features they placed")
+    {
+        CHECK(generator.featureTargetCount() > 0);
+        generator.forgetChunks(positions);
+        CHECK(generator.featureTargetCount() == 0);
+    }
+}
+
+TEST_CASE("Terrain Generation Benchmark", "[.][benchmark]")
+{
+    const auto positions = columnBatch(8, -2, 1);
+    for (const std::uint32_t threadCount : {1u, 2u, 4u, std::max(std::thread::hardware_concurrency(), 1u)}) {
+        ThreadPool pool(threadCount);
+        TerrainGenerator generator(42);
+        std::vector<GeneratedChunk> results;
+        results.reserve(positions.size());
+
+        const auto start = std::chrono::steady_clock::now();
+        generator.generate(positions, pool);
+        pool.waitIdle();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        generator.poll(results);
+        REQUIRE(results.size() == positions.size());
+
+        std::vector<double> latencies;
+        for (const GeneratedChunk& result : results)
+            latencies.push_back(std::chrono::duration<double, std::milli>(result.latency).count());
+        std::ranges::sort(latencies);
+        spdlog::info(
+            "{} threads: {:.0f} chunks/s, latency median {:.2f} ms, p95 {:.2f} ms, max {:.2f} ms",
+            threadCount,
+            double(results.size()) / elapsed.count(),
+            latencies[latencies.size() / 2],
+            latencies[latencies.size() * 95 / 100],
+            latencies.back()
+        );
+    }
+
+    const TerrainGenerator generator(42);
+    BENCHMARK("Single surface chunk") { return generator.genChunk({0, 0, 0}); };
+}
+
+TEST_CASE("Chunk Streaming")
+{
+    ThreadPool pool(2);
+    StreamingSettings settings;
+    settings.radius = 2;
+    settings.verticalRadius = 1;
+    settings.unloadMargin = 1;
+    settings.maxLoadsPerFrame = 8;
+    Terrain terrain(7, pool, settings);
+    ChunkStreamer& streamer = terrain.getStreamer();
+
+    const auto streamAll = [&](const glm::vec3 observer) {
+        std::size_t loaded = 0, unloaded = 0;
+        for (int frame = 0; frame < 1000; frame++) {
+            terrain.update(std::span(&observer, 1));
+            CHECK(streamer.getLoaded().size() <= settings.maxLoadsPerFrame);
+            loaded += streamer.getLoaded().size();
+            unloaded += streamer.getUnloaded().size();
+            if (streamer.queuedWork() == 0 && streamer.pendingLoads() == 0)
+                break;
+            pool.waitIdle();
+        }
+        return std::pair(loaded, unloaded);
+    };
+
+    // 13 columns within a radius of 2, 3 chunks high
+    const auto [loaded, unloaded] = streamAll({10.0f, 10.0f, 10.0f});
+    CHECK(loaded == 39);
+    CHECK(unloaded == 0);
+    CHECK(terrain.getChunks().size() == 39);
+    CHECK(terrain.getChunks().contains({2, 0, 0}));
+    CHECK_FALSE(terrain.getChunks().contains({3, 0, 0}));
+
+    // Moving one chunk stays within the unload margin, moving far away unloads everything
+    CHECK(streamAll({42.0f, 10.0f, 10.0f}).second == 0);
+    const std::size_t before = terrain.getChunks().size();
+    CHECK(before > 39);
+    const auto [farLoaded, farUnloaded] = streamAll({10000.0f, 10.0f, 10.0f});
+    CHECK(farLoaded == 39);
+    CHECK(farUnloaded == before);
+    CHECK(terrain.getChunks().size() == 39);
+}
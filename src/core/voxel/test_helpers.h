@@ -0,0 +1,68 @@
+#pragma once
+#include "chunk_map.h"
+#include "chunk_streamer.h"
+#include "terrain.h"
+#include "voxel.h"
+#include <fmt/format.h>
+#include <glm/glm.hpp>
+
+/// Fixtures shared by the voxel tests
+namespace dragonfire::voxel::test {
+
+/// Sets a voxel at a world position, loading its chunk as air if needed
+inline void setVoxel(ChunkMap& chunks, const glm::i32vec3 position, const Voxel voxel)
+{
+    const glm::i32vec3 chunkPos = ChunkStreamer::chunkPosition(glm::vec3(position));
+    Chunk* chunk = chunks.find(chunkPos);
+    if (chunk == nullptr)
+        chunk = &chunks.insert(chunkPos, Chunk());
+    chunk->set(position - chunkPos * std::int32_t(Chunk::CHUNK_DIM), voxel);
+}
+
+/// The voxel at a world position, air if its chunk isn't loaded
+inline Voxel getVoxel(const ChunkMap& chunks, const glm::i32vec3 position)
+{
+    const glm::i32vec3 chunkPos = ChunkStreamer::chunkPosition(glm::vec3(position));
+    const Chunk* chunk = chunks.find(chunkPos);
+    return chunk ? (*chunk)[position - chunkPos * std::int32_t(Chunk::CHUNK_DIM)] : Voxel{};
+}
+
+/// Voxel types with the ids used by the tests: air, the voxels of the default GenerationSettings, then water
+/// and lava followed by their flowing levels
+inline VoxelRegistry voxelTypes()
+{
+    std::string json = R"([{"name": "air", "solid": false, "transparent": true}, {"name": "stone"},
+        {"name": "dirt"}, {"name": "grass"}, {"name": "log"}, {"name": "leaves", "transparent": true})";
+    for (const std::string_view fluid : {"water", "lava"}) {
+        const bool transparent = fluid == "water";
+        json += fmt::format(R"(, {{"name": "{}", "solid": false, "transparent": {}}})", fluid, transparent);
+        for (int level = 7; level > 0; level--)
+            json += fmt::format(R"(, {{"name": "{}_{}", "solid": false}})", fluid, level);
+    }
+    json += "]";
+    VoxelRegistry registry;
+    registry.loadJsonString(json);
+    return registry;
+}
+
+/// Loads air chunks from min to max into the terrain, with a floor at z = 0
+inline void loadFlatChunks(
+    Terrain& terrain,
+    const glm::i32vec3 min,
+    const glm::i32vec3 max,
+    const Voxel floor
+)
+{
+    for (int x = min.x; x <= max.x; x++) {
+        for (int y = min.y; y <= max.y; y++) {
+            for (int z = min.z; z <= max.z; z++)
+                terrain.getChunks().insert({x, y, z}, Chunk());
+        }
+    }
+    EditTransaction fill;
+    fill.fill(glm::i32vec3(min.x, min.y, 0) * 32, glm::i32vec3((max.x + 1) * 32, (max.y + 1) * 32, 1), floor);
+    terrain.apply(fill);
+    terrain.clearEdits();
+}
+
+}// namespace dragonfire::voxel::test
@@ -0,0 +1,139 @@
+#include "chunk_streamer.h"
+#include "core/utility/thread_scratch.h"
+#include "visibility.h"
+#include <bit>
+
+namespace dragonfire::voxel {
+
+static constexpr auto DIM = std::int32_t(Chunk::CHUNK_DIM);
+static constexpr std::uint8_t CAMERA_CHUNK = 6;
+
+/// Buffers used while flood filling a chunk
+struct VisibilityScratch {
+    Voxel voxels[Chunk::CHUNK_SIZE];
+    /// Voxels that are not opaque and voxels already filled, indexed x * DIM + y with bit z for each voxel
+    std::uint32_t open[DIM * DIM];
+    std::uint32_t filled[DIM * DIM];
+    /// Columns with newly filled voxels that still have to spread to their neighbours
+    std::vector<std::pair<std::int32_t, std::uint32_t>> pending;
+};
+
+/// Grows seed to cover every run of bits in mask it touches
+static std::uint32_t fillRuns(std::uint32_t seed, const std::uint32_t mask) noexcept
+{
+    for (std::uint32_t last = 0; seed != last;) {
+        last = seed;
+        seed |= (seed << 1 | seed >> 1) & mask;
+    }
+    return seed;
+}
+
+/// Faces of the chunk touched by the bits of a column, as bits in FACE_DIRECTIONS order
+static std::uint8_t touchedFaces(const std::int32_t column, const std::uint32_t bits) noexcept
+{
+    const std::int32_t x = column / DIM, y = column % DIM;
+    std::uint8_t faces = 0;
+    faces |= std::uint8_t(x == 0) | std::uint8_t(x == DIM - 1) << 1;
+    faces |= std::uint8_t(y == 0) << 2 | std::uint8_t(y == DIM - 1) << 3;
+    faces |= std::uint8_t(bits & 1) << 4 | std::uint8_t(bits >> (DIM - 1)) << 5;
+    return faces;
+}
+
+ChunkVisibility computeVisibility(const Chunk& chunk)
+{
+    if (chunk.isUniform()) {
+        const Voxel voxel = chunk.get(0);
+        return voxel.id != 0 && !voxel.transparent ? ChunkVisibility() : ChunkVisibility::open();
+    }
+    if (chunk.isEmpty())
+        return ChunkVisibility::open();
+
+    VisibilityScratch& scratch = threadScratch<VisibilityScratch>();
+    chunk.unpack(std::span<Voxel, Chunk::CHUNK_SIZE>(scratch.voxels, Chunk::CHUNK_SIZE));
+    for (std::int32_t column = 0; column < DIM * DIM; column++) {
+        const Voxel* voxels = scratch.voxels + column * DIM;
+        std::uint32_t open = 0;
+        for (std::int32_t z = 0; z < DIM; z++)
+            open |= std::uint32_t(voxels[z].id == 0 || voxels[z].transparent) << z;
+        scratch.open[column] = open;
+        scratch.filled[column] = 0;
+    }
+
+    ChunkVisibility visibility;
+    for (std::int32_t start = 0; start < DIM * DIM; start++) {
+        // Each unfilled open voxel starts a new connected region
+        while (const std::uint32_t unfilled = scratch.open[start] & ~scratch.filled[start]) {
+            const std::uint32_t seed = fillRuns(1u << std::countr_zero(unfilled), scratch.open[start]);
+            scratch.filled[start] |= seed;
+            scratch.pending.assign(1, {start, seed});
+            std::uint8_t faces = 0;
+            while (!scratch.pending.empty()) {
+                const auto [column, bits] = scratch.pending.back();
+                scratch.pending.pop_back();
+                faces |= touchedFaces(column, bits);
+                const std::int32_t x = column / DIM, y = column % DIM;
+                const auto spread = [&](const std::int32_t neighbour) {
+                    const std::uint32_t free = scratch.open[neighbour] & ~scratch.filled[neighbour];
+                    if ((bits & free) == 0)
+                        return;
+                    const std::uint32_t grown = fillRuns(bits & free, free);
+                    scratch.filled[neighbour] |= grown;
+                    scratch.pending.emplace_back(neighbour, grown);
+                };
+                if (x > 0)
+                    spread(column - DIM);
+                if (x < DIM - 1)
+                    spread(column + DIM);
+                if (y > 0)
+                    spread(column - 1);
+                if (y < DIM - 1)
+                    spread(column + 1);
+            }
+            for (std::uint8_t face = 0; face < 6; face++) {
+                if (faces >> face & 1)
+                    visibility.faces[face] |= faces;
+            }
+        }
+    }
+    return visibility;
+}
+
+void OcclusionCuller::setVisibility(const glm::i32vec3 position, const ChunkVisibility& visibility)
+{
+    chunks[position] = visibility;
+}
+
+void OcclusionCuller::remove(const glm::i32vec3 position)
+{
+    chunks.erase(position);
+}
+
+void OcclusionCuller::cull(const glm::vec3 camera)
+{
+    visible.clear();
+    const glm::i32vec3 start = ChunkStreamer::chunkPosition(camera);
+    everything = !chunks.contains(start);
+    if (everything)
+        return;
+
+    visible.insert(start);
+    queue.assign(1, {start, CAMERA_CHUNK, 0});
+    // Breadth first, so each chunk is entered along the shortest path from the camera
+    for (std::size_t next = 0; next < queue.size(); next++) {
+        const Step step = queue[next];
+        const ChunkVisibility& visibility = chunks.find(step.position)->second;
+        for (std::uint8_t face = 0; face < 6; face++) {
+            // Turning back towards the camera can't see anything a more direct path doesn't
+            if (step.directions >> (face ^ 1) & 1)
+                continue;
+            if (step.from != CAMERA_CHUNK && !visibility.connects(step.from, face))
+                continue;
+            const glm::i32vec3 neighbour = step.position + FACE_DIRECTIONS[face];
+            if (!chunks.contains(neighbour) || !visible.insert(neighbour).second)
+                continue;
+            queue.push_back({neighbour, std::uint8_t(face ^ 1), std::uint8_t(step.directions | 1 << face)});
+        }
+    }
+}
+
+}// namespace dragonfire::voxel
@@ -0,0 +1,86 @@
+#pragma once
+#include "chunk.h"
+#include "chunk_map.h"
+#include <array>
+#include <glm/vec3.hpp>
+#include <vector>
+
+namespace dragonfire::voxel {
+
+/// Which faces of a chunk can see each other through the voxels of the chunk that are not opaque
+struct ChunkVisibility {
+    /// Faces reachable from each face, as bits in FACE_DIRECTIONS order
+    std::array<std::uint8_t, 6> faces{};
+
+    [[nodiscard]] bool connects(const std::uint8_t from, const std::uint8_t to) const noexcept
+    {
+        return (faces[from] >> to & 1) != 0;
+    }
+
+    /// Every face sees every other face, as in a chunk of air
+    static constexpr ChunkVisibility open() noexcept
+    {
+        return {{0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F}};
+    }
+
+    bool operator==(const ChunkVisibility& other) const = default;
+};
+
+/***
+ * @brief Flood fills the voxels of a chunk that are not opaque to find which faces they connect
+ *
+ * Each column is filled a 32 bit mask at a time, spreading along z within the column and to the neighbouring
+ * columns, so a chunk of open caves is only a few thousand mask operations.
+ */
+ChunkVisibility computeVisibility(const Chunk& chunk);
+
+/***
+ * @brief Culls chunks hidden behind opaque terrain, using the visibility of each chunk
+ *
+ * Walks from the chunk containing the camera to its neighbours, only leaving a chunk through a face
+ * connected to the face it was entered through, and never turning back towards the camera. Chunks the walk
+ * never reaches can't be seen through open space. Chunks without a known visibility stop the walk.
+ */
+class OcclusionCuller {
+public:
+    void setVisibility(glm::i32vec3 position, const ChunkVisibility& visibility);
+    void remove(glm::i32vec3 position);
+
+    /***
+     * @brief Finds the chunks visible from the camera
+     *
+     * If the camera is in a chunk without a known visibility, such as above the loaded area, every chunk is
+     * visible.
+     */
+    void cull(glm::vec3 camera);
+
+    /// Whether the chunk was reached by the last call to cull
+    [[nodiscard]] bool isVisible(const glm::i32vec3 position) const noexcept
+    {
+        return everything || visible.contains(position);
+    }
+
+    /// Number of chunks reached by the last call to cull, or every chunk if nothing was culled
+    [[nodiscard]] std::size_t visibleCount() const noexcept
+    {
+        return everything ? chunks.size() : visible.size();
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return chunks.size(); }
+
+private:
+    struct Step {
+        glm::i32vec3 position;
+        /// Face the chunk was entered through, or 6 for the chunk containing the camera
+        std::uint8_t from;
+        /// Directions taken to reach the chunk, as bits in FACE_DIRECTIONS order
+        std::uint8_t directions;
+    };
+
+    ankerl::unordered_dense::map<glm::i32vec3, ChunkVisibility, ChunkPositionHash> chunks;
+    ankerl::unordered_dense::set<glm::i32vec3, ChunkPositionHash> visible;
+    std::vector<Step> queue;
+    bool everything = true;
+};
+
+}// namespace dragonfire::voxel
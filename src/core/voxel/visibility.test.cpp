@@ -0,0 +1,198 @@
+#include "terrain.h"
+#include "visibility.h"
+#include <catch.hpp>
+#include <random>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+using namespace dragonfire::voxel;
+
+static constexpr Voxel STONE{1, 0};
+static constexpr Voxel GLASS{4, 1};
+static constexpr std::int32_t DIM = Chunk::CHUNK_DIM;
+
+/// Fills the box from min to one before max of the chunk with voxel
+static void fillBox(Chunk& chunk, const glm::ivec3 min, const glm::ivec3 max, const Voxel voxel)
+{
+    for (std::int32_t x = min.x; x < max.x; x++) {
+        for (std::int32_t y = min.y; y < max.y; y++) {
+            for (std::int32_t z = min.z; z < max.z; z++)
+                chunk.set({x, y, z}, voxel);
+        }
+    }
+}
+
+/// Flood fills one voxel at a time, as a reference for computeVisibility
+static ChunkVisibility slowVisibility(const Chunk& chunk)
+{
+    std::vector<std::uint8_t> filled(Chunk::CHUNK_SIZE);
+    std::vector<glm::ivec3> stack;
+    ChunkVisibility visibility;
+    const auto isOpen = [&](const glm::ivec3 index) {
+        const Voxel voxel = chunk[index];
+        return voxel.id == 0 || voxel.transparent;
+    };
+    for (std::size_t start = 0; start < Chunk::CHUNK_SIZE; start++) {
+        if (filled[start] || !isOpen(Chunk::position(start)))
+            continue;
+        filled[start] = 1;
+        stack.assign(1, Chunk::position(start));
+        std::uint8_t faces = 0;
+        while (!stack.empty()) {
+            const glm::ivec3 index = stack.back();
+            stack.pop_back();
+            for (std::uint8_t face = 0; face < 6; face++) {
+                const glm::ivec3 next = index + FACE_DIRECTIONS[face];
+                const glm::ivec3 wrapped = (next + DIM) % DIM;
+                if (wrapped != next) {
+                    faces |= 1 << face;
+                    continue;
+                }
+                const std::size_t i = Chunk::linearIndex(next);
+                if (!filled[i] && isOpen(next)) {
+                    filled[i] = 1;
+                    stack.push_back(next);
+                }
+            }
+        }
+        for (std::uint8_t face = 0; face < 6; face++) {
+            if (faces >> face & 1)
+                visibility.faces[face] |= faces;
+        }
+    }
+    return visibility;
+}
+
+TEST_CASE("Chunk Visibility", "[voxel]")
+{
+    SECTION("Uniform chunks")
+    {
+        CHECK(computeVisibility(Chunk()) == ChunkVisibility::open());
+        CHECK(computeVisibility(Chunk(GLASS)) == ChunkVisibility::open());
+        CHECK(computeVisibility(Chunk(STONE)) == ChunkVisibility());
+    }
+
+    SECTION("A tunnel only connects its ends")
+    {
+        Chunk chunk(STONE);
+        fillBox(chunk, {0, 15, 15}, {DIM, 17, 17}, Voxel{});
+        const ChunkVisibility visibility = computeVisibility(chunk);
+        CHECK(visibility.connects(0, 1));
+        CHECK(visibility.connects(1, 0));
+        for (std::uint8_t face = 2; face < 6; face++) {
+            CHECK_FALSE(visibility.connects(0, face));
+            CHECK_FALSE(visibility.connects(face, face));
+        }
+
+        SECTION("Turning the tunnel upwards")
+        {
+            fillBox(chunk, {16, 15, 15}, {DIM, 17, 17}, STONE);
+            fillBox(chunk, {15, 15, 15}, {17, 17, DIM}, Voxel{});
+            const ChunkVisibility bent = computeVisibility(chunk);
+            CHECK(bent.connects(0, 5));
+            CHECK(bent.connects(5, 0));
+            CHECK_FALSE(bent.connects(0, 1));
+            CHECK_FALSE(bent.connects(0, 4));
+        }
+    }
+
+    SECTION("A wall separates its sides until it has a hole")
+    {
+        Chunk chunk;
+        fillBox(chunk, {16, 0, 0}, {17, DIM, DIM}, STONE);
+        ChunkVisibility visibility = computeVisibility(chunk);
+        CHECK_FALSE(visibility.connects(0, 1));
+        for (std::uint8_t face = 2; face < 6; face++) {
+            CHECK(visibility.connects(0, face));
+            CHECK(visibility.connects(1, face));
+        }
+        chunk.set({16, 3, 30}, GLASS);
+        visibility = computeVisibility(chunk);
+        CHECK(visibility.connects(0, 1));
+    }
+
+    SECTION("Matches filling one voxel at a time")
+    {
+        std::mt19937 rng(17);
+        for (const int percent : {45, 60, 70}) {
+            std::bernoulli_distribution solid(percent / 100.0);
+            std::vector<Voxel> voxels(Chunk::CHUNK_SIZE);
+            for (Voxel& voxel : voxels)
+                voxel = solid(rng) ? STONE : Voxel{};
+            const Chunk chunk = Chunk::pack(std::span<const Voxel, Chunk::CHUNK_SIZE>(voxels));
+            CHECK(computeVisibility(chunk) == slowVisibility(chunk));
+        }
+    }
+}
+
+TEST_CASE("Occlusion Culling", "[voxel]")
+{
+    OcclusionCuller culler;
+    const glm::vec3 camera(16.0f, 16.0f, 16.0f);
+    // A row of chunks along x from the camera, with solid rock in the middle
+    culler.setVisibility({0, 0, 0}, ChunkVisibility::open());
+    culler.setVisibility({1, 0, 0}, computeVisibility(Chunk(STONE)));
+    culler.setVisibility({2, 0, 0}, ChunkVisibility::open());
+    culler.setVisibility({0, 1, 0}, ChunkVisibility::open());
+
+    SECTION("Chunks behind rock are culled")
+    {
+        culler.cull(camera);
+        CHECK(culler.isVisible({0, 0, 0}));
+        CHECK(culler.isVisible({1, 0, 0}));
+        CHECK(culler.isVisible({0, 1, 0}));
+        CHECK_FALSE(culler.isVisible({2, 0, 0}));
+        CHECK(culler.visibleCount() == 3);
+    }
+
+    SECTION("Tunnels through the rock are seen through")
+    {
+        Chunk tunnel(STONE);
+        fillBox(tunnel, {0, 15, 15}, {DIM, 17, 17}, Voxel{});
+        culler.setVisibility({1, 0, 0}, computeVisibility(tunnel));
+        culler.cull(camera);
+        CHECK(culler.isVisible({2, 0, 0}));
+        CHECK(culler.visibleCount() == 4);
+    }
+
+    SECTION("Removed chunks stop the walk")
+    {
+        culler.setVisibility({1, 0, 0}, ChunkVisibility::open());
+        culler.remove({1, 0, 0});
+        culler.cull(camera);
+        CHECK_FALSE(culler.isVisible({1, 0, 0}));
+        CHECK_FALSE(culler.isVisible({2, 0, 0}));
+        CHECK(culler.size() == 3);
+    }
+
+    SECTION("Everything is visible from outside the known chunks")
+    {
+        culler.cull({-100.0f, 16.0f, 16.0f});
+        CHECK(culler.isVisible({2, 0, 0}));
+        CHECK(culler.visibleCount() == culler.size());
+    }
+}
+
+TEST_CASE("Chunk Visibility Benchmark", "[.][benchmark]")
+{
+    TerrainGenerator generator(3);
+    std::vector<Chunk> chunks;
+    for (int x = -2; x < 2; x++) {
+        for (int z = -3; z < 1; z++)
+            chunks.push_back(generator.genChunk({x, 0, z}));
+    }
+    std::size_t sealed = 0;
+    for (const Chunk& chunk : chunks) {
+        const ChunkVisibility visibility = computeVisibility(chunk);
+        sealed += !visibility.connects(4, 5) && !visibility.connects(0, 1) && !visibility.connects(2, 3);
+    }
+    spdlog::info("{} of {} generated chunks can't be seen through along any axis", sealed, chunks.size());
+
+    BENCHMARK("Compute visibility of 16 generated chunks")
+    {
+        std::uint32_t faces = 0;
+        for (const Chunk& chunk : chunks)
+            faces += computeVisibility(chunk).faces[0];
+        return faces;
+    };
+}
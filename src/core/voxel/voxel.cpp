@@ -4,6 +4,10 @@
 
 #include "voxel.h"
 #include "core/file.h"
+#include "core/utility/formatted_error.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <simdjson.h>
 
 using namespace simdjson;
@@ -32,6 +36,22 @@ simdjson_inline simdjson_result<dragonfire::voxel::VoxelType> ondemand::value::g
             error = field.value().get_double().get(d);
             voxel.hardness = float(d);
         }
+        else if (key == "solid")
+            error = field.value().get_bool().get(voxel.solid);
+        else if (key == "transparent")
+            error = field.value().get_bool().get(voxel.transparent);
+        else if (key == "textureLayer") {
+            uint64_t layer;
+            error = field.value().get_uint64().get(layer);
+            voxel.textureLayer = uint16_t(layer);
+        }
+        else if (key == "light") {
+            uint64_t level;
+            error = field.value().get_uint64().get(level);
+            voxel.light = uint8_t(std::min<uint64_t>(level, 15));
+        }
+        else if (key == "tickable")
+            error = field.value().get_bool().get(voxel.tickable);
         if (error)
             return error;
     }
@@ -42,6 +62,26 @@ simdjson_inline simdjson_result<dragonfire::voxel::VoxelType> ondemand::value::g
 
 namespace dragonfire::voxel {
 
+/// Parses a json object or array of objects, calling add with each voxel type
+template<typename Func>
+static void parseTypes(ondemand::parser& parser, std::string& json, Func&& add)
+{
+    const size_t length = json.size();
+    json.reserve(length + SIMDJSON_PADDING);
+    auto doc = parser.iterate(padded_string_view(json.data(), length, json.capacity())).value();
+    if (doc.type() == ondemand::json_type::array) {
+        auto array = doc.get_array().value();
+        for (auto element : array) {
+            auto val = element.value();
+            add(VoxelType(val));
+        }
+    }
+    else {
+        auto val = doc.get_value().value();
+        add(VoxelType(val));
+    }
+}
+
 void VoxelRegistry::loadJsonFiles(const std::span<const char*> paths)
 {
     ondemand::parser parser;
@@ -49,43 +89,164 @@ void VoxelRegistry::loadJsonFiles(const std::span<const char*> paths)
         File file(path);
         std::string jsonString = file.readString();
         file.close();
-        jsonString.resize(jsonString.size() + SIMDJSON_PADDING);
-        const auto view = padded_string_view(jsonString);
-        auto doc = parser.iterate(view).value();
-        if (doc.type() == ondemand::json_type::array) {
-            auto array = doc.get_array().value();
-            for (auto element : array) {
-                auto val = element.value();
-                const uint32_t index = voxelTypes.size();
-                const auto& voxel = voxelTypes.emplace_back(val);
-                voxelIdMap[voxel.name] = index;
-            }
-        }
-        else {
-            auto val = doc.get_value().value();
-            const uint32_t index = voxelTypes.size();
-            const auto& voxel = voxelTypes.emplace_back(val);
-            voxelIdMap[voxel.name] = index;
-        }
+        parseTypes(parser, jsonString, [&](VoxelType&& type) { add(std::move(type)); });
     }
 }
 
 void VoxelRegistry::loadJsonString(const std::string_view string)
 {
     ondemand::parser parser;
-    const padded_string json = string;
-    auto doc = parser.iterate(json).value();
-    if (doc.type() == ondemand::json_type::array) {
-        auto array = doc.get_array().value();
-        for (auto element : array) {
-            auto val = element.value();
-            voxelTypes.emplace_back(val);
-        }
+    std::string json(string);
+    parseTypes(parser, json, [&](VoxelType&& type) { add(std::move(type)); });
+}
+
+bool VoxelRegistry::loadJsonFilesCached(
+    const std::span<const char*> paths,
+    const std::filesystem::path& cachePath
+)
+{
+    // The files still have to be read to tell if they changed, but parsing them is skipped
+    std::vector<std::string> contents;
+    uint64_t key = paths.size();
+    for (const char* path : paths) {
+        File file(path);
+        const std::string& json = contents.emplace_back(file.readString());
+        file.close();
+        key = key * 0x9E3779B97F4A7C15ull ^ ankerl::unordered_dense::hash<std::string_view>{}(json);
     }
-    else {
-        auto val = doc.get_value().value();
-        voxelTypes.emplace_back(val);
+    if (loadCache(cachePath, key))
+        return true;
+
+    *this = VoxelRegistry();
+    ondemand::parser parser;
+    for (std::string& json : contents)
+        parseTypes(parser, json, [&](VoxelType&& type) { add(std::move(type)); });
+    saveCache(cachePath, key);
+    return false;
+}
+
+/// Layout of the start of a registry cache, followed by each property table in the order of the fields of
+/// VoxelType, then the length of every name and display name and finally the characters of the names
+struct CacheHeader {
+    static constexpr char MAGIC[4] = {'D', 'F', 'V', 'R'};
+    static constexpr uint32_t VERSION = 2;
+
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t count;
+    uint32_t nameBytes;
+};
+
+void VoxelRegistry::saveCache(const std::filesystem::path& path, const uint64_t key) const
+{
+    std::vector<uint32_t> lengths;
+    std::string names;
+    for (const VoxelType& type : voxelTypes) {
+        lengths.push_back(uint32_t(type.name.size()));
+        lengths.push_back(uint32_t(type.displayName.size()));
+        names += type.name;
+        names += type.displayName;
     }
+    CacheHeader header{};
+    std::memcpy(header.magic, CacheHeader::MAGIC, sizeof(header.magic));
+    header.version = CacheHeader::VERSION;
+    header.key = key;
+    header.count = uint32_t(voxelTypes.size());
+    header.nameBytes = uint32_t(names.size());
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    const auto write = [&]<typename T>(const std::span<T> data) {
+        out.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size_bytes()));
+    };
+    write(std::span(&header, 1));
+    write(std::span(hardnessTable));
+    write(std::span(solidTable));
+    write(std::span(transparentTable));
+    write(std::span(textureTable));
+    write(std::span(lightTable));
+    write(std::span(tickableTable));
+    write(std::span(lengths));
+    write(std::span(names));
+    if (!out)
+        throw FormattedError("Failed to write voxel registry cache {}", path.string());
+}
+
+bool VoxelRegistry::loadCache(const std::filesystem::path& path, const uint64_t key)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    const std::vector<char> data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    size_t offset = 0;
+    // Copies the next count values into out, false if the file is too short
+    const auto read = [&]<typename T>(T* out, const size_t count) {
+        const size_t size = sizeof(T) * count;
+        if (data.size() - offset < size)
+            return false;
+        std::memcpy(out, data.data() + offset, size);
+        offset += size;
+        return true;
+    };
+
+    CacheHeader header{};
+    if (!read(&header, 1) || std::memcmp(header.magic, CacheHeader::MAGIC, sizeof(header.magic)) != 0
+        || header.version != CacheHeader::VERSION || header.key != key)
+        return false;
+    // Checked before allocating so a corrupt count can't ask for more memory than the file could describe
+    const size_t count = header.count;
+    constexpr size_t typeBytes = sizeof(float) + 4 + sizeof(uint16_t) + 2 * sizeof(uint32_t);
+    if ((data.size() - offset) / typeBytes < count)
+        return false;
+
+    VoxelRegistry loaded;
+    loaded.hardnessTable.resize(count);
+    loaded.solidTable.resize(count);
+    loaded.transparentTable.resize(count);
+    loaded.textureTable.resize(count);
+    loaded.lightTable.resize(count);
+    loaded.tickableTable.resize(count);
+    std::vector<uint32_t> lengths(count * 2);
+    std::string names(header.nameBytes, '\0');
+    const bool complete = read(loaded.hardnessTable.data(), count) && read(loaded.solidTable.data(), count)
+                          && read(loaded.transparentTable.data(), count)
+                          && read(loaded.textureTable.data(), count) && read(loaded.lightTable.data(), count)
+                          && read(loaded.tickableTable.data(), count) && read(lengths.data(), lengths.size())
+                          && read(names.data(), names.size());
+    if (!complete || offset != data.size())
+        return false;
+
+    size_t position = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (names.size() - position < size_t(lengths[i * 2]) + lengths[i * 2 + 1])
+            return false;
+        VoxelType& type = loaded.voxelTypes.emplace_back();
+        type.name = names.substr(position, lengths[i * 2]);
+        type.displayName = names.substr(position + lengths[i * 2], lengths[i * 2 + 1]);
+        position += type.name.size() + type.displayName.size();
+        type.hardness = loaded.hardnessTable[i];
+        type.solid = loaded.solidTable[i];
+        type.transparent = loaded.transparentTable[i];
+        type.textureLayer = loaded.textureTable[i];
+        type.light = loaded.lightTable[i];
+        type.tickable = loaded.tickableTable[i];
+        loaded.voxelIdMap[type.name] = uint32_t(i);
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+void VoxelRegistry::add(VoxelType&& type)
+{
+    const auto index = uint32_t(voxelTypes.size());
+    hardnessTable.push_back(type.hardness);
+    solidTable.push_back(type.solid);
+    transparentTable.push_back(type.transparent);
+    textureTable.push_back(type.textureLayer);
+    lightTable.push_back(type.light);
+    tickableTable.push_back(type.tickable);
+    voxelIdMap[type.name] = index;
+    voxelTypes.push_back(std::move(type));
 }
 
 }// namespace dragonfire::voxel
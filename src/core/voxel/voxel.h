@@ -4,7 +4,10 @@
 
 #pragma once
 #include "core/utility/string_hash.h"
+#include <array>
 #include <cstdint>
+#include <filesystem>
+#include <optional>
 #include <span>
 #include <string>
 #include <vector>
@@ -16,13 +19,27 @@ struct Voxel {
     static constexpr size_t MAX_VOXEL_COUNT = 1 << ID_BIT_COUNT;
     uint16_t id : ID_BIT_COUNT;
     uint16_t transparent : 1;
+
+    bool operator==(const Voxel& other) const = default;
 };
 
 struct VoxelType {
     std::string name, displayName;
     float hardness = 1.0;
+    /// Whether the voxel blocks movement, false for voxels such as plants that can be walked through
+    bool solid = true;
+    /// Whether voxels behind this one can be seen through it
+    bool transparent = false;
+    /// Layer of the voxel texture array drawn on its faces
+    uint16_t textureLayer = 0;
+    /// Block light emitted, from 0 to 15
+    uint8_t light = 0;
+    /// Whether the voxel receives random ticks, for gameplay such as crops growing or grass spreading
+    bool tickable = false;
 };
 
+/// Voxel types loaded from json, with the properties read while meshing, lighting and simulating copied into
+/// dense tables indexed by Voxel::id so lookups don't touch the names of each type
 class VoxelRegistry {
 public:
     const VoxelType& operator[](const Voxel voxel) const { return voxelTypes[voxel.id]; }
@@ -33,6 +50,42 @@ public:
         return voxelTypes[index];
     }
 
+    /// Returns the id of the voxel type with the given name
+    [[nodiscard]] uint32_t getId(const std::string_view name) const { return voxelIdMap.at(name); }
+
+    /// Returns the id of the voxel type with the given name, or nothing if it isn't registered
+    [[nodiscard]] std::optional<uint32_t> find(const std::string_view name) const
+    {
+        const auto found = voxelIdMap.find(name);
+        return found == voxelIdMap.end() ? std::nullopt : std::optional(found->second);
+    }
+
+    [[nodiscard]] bool isSolid(const Voxel voxel) const noexcept { return solidTable[voxel.id]; }
+
+    [[nodiscard]] bool isTransparent(const Voxel voxel) const noexcept { return transparentTable[voxel.id]; }
+
+    [[nodiscard]] float getHardness(const Voxel voxel) const noexcept { return hardnessTable[voxel.id]; }
+
+    [[nodiscard]] uint16_t getTextureLayer(const Voxel voxel) const noexcept
+    {
+        return textureTable[voxel.id];
+    }
+
+    [[nodiscard]] uint8_t getLight(const Voxel voxel) const noexcept { return lightTable[voxel.id]; }
+
+    [[nodiscard]] bool isTickable(const Voxel voxel) const noexcept { return tickableTable[voxel.id]; }
+
+    /// Block light emitted by each voxel id, in the form taken by LightEngine
+    [[nodiscard]] std::span<const uint8_t> lightEmission() const noexcept { return lightTable; }
+
+    /// Whether each voxel id blocks movement, in the form taken by buildCollisionBoxes
+    [[nodiscard]] std::span<const uint8_t> solidity() const noexcept { return solidTable; }
+
+    /// Whether each voxel id receives random ticks, in the form taken by RandomTicker
+    [[nodiscard]] std::span<const uint8_t> tickability() const noexcept { return tickableTable; }
+
+    [[nodiscard]] size_t size() const noexcept { return voxelTypes.size(); }
+
     template<typename... Args>
     void loadJsonFiles(Args... args)
     {
@@ -43,9 +96,35 @@ public:
     void loadJsonFiles(std::span<const char*> paths);
     void loadJsonString(std::string_view string);
 
+    /***
+     * @brief Loads voxel types from json files, reading the binary cache instead of parsing them if the cache
+     * was written from files with the same contents
+     *
+     * Replaces any voxel types already loaded. The cache is rewritten if it is missing or out of date.
+     * @param cachePath native path of the cache
+     * @return true if the types were read from the cache
+     * @throws FormattedError if the cache needed writing and could not be
+     */
+    bool loadJsonFilesCached(std::span<const char*> paths, const std::filesystem::path& cachePath);
+
+    /***
+     * @brief Writes every voxel type to a binary cache at a native path
+     * @param key identifies the inputs the types were loaded from, loadCache only accepts a matching key
+     * @throws FormattedError if the file could not be written
+     */
+    void saveCache(const std::filesystem::path& path, uint64_t key) const;
+    /// Replaces the voxel types with those in the cache at a native path, returns false and leaves the
+    /// registry unchanged if the cache is missing, corrupt or was saved with a different key
+    bool loadCache(const std::filesystem::path& path, uint64_t key);
+
 private:
     std::vector<VoxelType> voxelTypes;
     StringFlatMap<uint32_t> voxelIdMap;
+    std::vector<uint8_t> solidTable, transparentTable, lightTable, tickableTable;
+    std::vector<float> hardnessTable;
+    std::vector<uint16_t> textureTable;
+
+    void add(VoxelType&& type);
 };
 
 }// namespace dragonfire::voxel
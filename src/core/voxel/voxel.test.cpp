@@ -3,6 +3,8 @@
 //
 #include "voxel.h"
 #include <catch.hpp>
+#include <fmt/format.h>
+#include <random>
 
 using namespace dragonfire::voxel;
 
@@ -14,4 +16,63 @@ TEST_CASE("loadJsonString")
     {"name":"test", "hardness": 2.0}
 )";
     REQUIRE_NOTHROW(registry.loadJsonString(json));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Voxel property tables")
+{
+    VoxelRegistry registry;
+    registry.loadJsonString(R"([
+        {"name":"air", "solid": false, "transparent": true},
+        {"name":"torch", "displayName": "Torch", "light": 14, "solid": false, "textureLayer": 3},
+        {"name":"sun", "light": 40, "hardness": 0.5, "tickable": true}
+    ])");
+    REQUIRE(registry.size() == 3);
+    CHECK(registry.getId("torch") == 1);
+    CHECK(registry["torch"].displayName == "Torch");
+    CHECK(registry["sun"].displayName == "sun");
+
+    const Voxel air{0, 1}, torch{1, 0}, sun{2, 0};
+    CHECK_FALSE(registry.isSolid(air));
+    CHECK(registry.isTransparent(air));
+    CHECK_FALSE(registry.isSolid(torch));
+    CHECK(registry.getTextureLayer(torch) == 3);
+    CHECK(registry.getLight(torch) == 14);
+    CHECK(registry.isSolid(sun));
+    CHECK_FALSE(registry.isTransparent(sun));
+    CHECK(registry.getHardness(sun) == 0.5f);
+    CHECK(std::ranges::equal(registry.lightEmission(), std::vector<uint8_t>{0, 14, 15}));
+    CHECK(registry.isTickable(sun));
+    CHECK(std::ranges::equal(registry.tickability(), std::vector<uint8_t>{0, 0, 1}));
+}
+
+TEST_CASE("Voxel registry cache")
+{
+    const std::string name = fmt::format("dragonfire-registry-{}.bin", std::random_device()());
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    VoxelRegistry registry;
+    registry.loadJsonString(R"([
+        {"name":"stone", "hardness": 3.0},
+        {"name":"glass", "transparent": true},
+        {"name":"grass", "tickable": true}
+    ])");
+    registry.saveCache(path, 42);
+
+    VoxelRegistry cached;
+    CHECK_FALSE(cached.loadCache(path, 43));
+    CHECK(cached.size() == 0);
+    REQUIRE(cached.loadCache(path, 42));
+    REQUIRE(cached.size() == 3);
+    CHECK(cached.getId("glass") == 1);
+    CHECK(cached["stone"].hardness == 3.0f);
+    CHECK(cached.getHardness(Voxel{0, 0}) == 3.0f);
+    CHECK(cached.isTransparent(Voxel{1, 1}));
+    CHECK(cached["grass"].tickable);
+    CHECK_FALSE(cached.isTickable(Voxel{1, 1}));
+
+    // A truncated cache is rejected rather than partially loaded
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    VoxelRegistry truncated;
+    CHECK_FALSE(truncated.loadCache(path, 42));
+    std::filesystem::remove(path);
+    CHECK_FALSE(truncated.loadCache(path, 42));
+}
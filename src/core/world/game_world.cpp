@@ -3,10 +3,143 @@
 //
 
 #include "game_world.h"
+#include "core/config.h"
+#include "core/utility/slab_allocator.h"
+#include <algorithm>
+#include <cmath>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
 
 namespace dragonfire {
-GameWorld::GameWorld(uint32_t maxBodies)
+
+GameWorld::GameWorld(ThreadPool& threadPool, uint32_t maxBodies) : threadPool(threadPool)
+{
+    const auto& cfg = Config::get();
+    voxel::StreamingSettings streaming;
+    streaming.radius = int32_t(cfg.getInt("world.viewDistance").value_or(streaming.radius));
+    streaming.verticalRadius = int32_t(
+        cfg.getInt("world.verticalViewDistance").value_or(streaming.verticalRadius)
+    );
+    streaming.maxLoadsPerFrame = uint32_t(
+        cfg.getInt("world.chunkLoadsPerFrame").value_or(streaming.maxLoadsPerFrame)
+    );
+    const auto seed = uint64_t(cfg.getInt("world.seed").value_or(0));
+    slabAllocator::setHugePages(cfg.getBool("memory.hugePages").value_or(false));
+    trimAfterUnloads = size_t(cfg.getInt("memory.trimAfterUnloads").value_or(1024));
+    voxelTypes.loadJsonFiles("assets/voxels/voxels.json");
+    terrain = std::make_unique<voxel::Terrain>(seed, threadPool, streaming);
+    if (cfg.getBool("world.saveChunks").value_or(true)) {
+        chunkStorage = std::make_unique<voxel::ChunkStorage>(
+            voxel::ChunkStorage::inWriteDir(fmt::format("regions/{}", seed))
+        );
+        terrain->getStreamer().setStorage(chunkStorage.get());
+    }
+    voxel::FluidSettings fluidSettings;
+    fluidSettings.tickRate = cfg.getFloat("world.fluidTickRate").value_or(fluidSettings.tickRate);
+    fluids = std::make_unique<voxel::FluidSimulation>(*terrain, voxelTypes, fluidSettings);
+    const auto emission = voxelTypes.lightEmission();
+    light = std::make_unique<voxel::LightEngine>(
+        terrain->getChunks(),
+        std::vector<uint8_t>(emission.begin(), emission.end())
+    );
+    const auto tickable = voxelTypes.tickability();
+    randomTicker = std::make_unique<voxel::RandomTicker>(
+        terrain->getChunks(),
+        std::vector<uint8_t>(tickable.begin(), tickable.end()),
+        seed,
+        uint32_t(cfg.getInt("world.randomTickSamples").value_or(3))
+    );
+    randomTickRate = cfg.getFloat("world.randomTickRate").value_or(20.0);
+    pathfinder = std::make_unique<voxel::Pathfinder>(*terrain, threadPool, voxelTypes.solidity());
+
+    initJolt();
+    // Scratch memory for a physics step, which fails the step if it runs out
+    const auto tempMegabytes = cfg.getInt("physics.tempAllocatorSize").value_or(16);
+    tempAllocator = std::make_unique<JPH::TempAllocatorImpl>(JPH::uint(tempMegabytes) * 1024 * 1024);
+    physicsJobs = std::make_unique<PhysicsJobSystem>(threadPool);
+    physicsSystem = std::make_unique<JPH::PhysicsSystem>();
+    physicsSystem->Init(
+        maxBodies,
+        0,
+        JPH::uint(cfg.getInt("physics.maxBodyPairs").value_or(65536)),
+        JPH::uint(cfg.getInt("physics.maxContactConstraints").value_or(20480)),
+        broadPhaseLayers,
+        objectVsBroadPhaseFilter,
+        objectLayerPairs
+    );
+    // The world is z up
+    physicsSystem->SetGravity(JPH::Vec3(0.0f, 0.0f, -9.81f));
+    terrainPhysics = std::make_unique<TerrainPhysics>(
+        *physicsSystem,
+        *terrain,
+        threadPool,
+        voxelTypes.solidity()
+    );
+
+    // Entities with a transform remember where they were at the start of the tick, to be drawn between ticks
+    world.component<Transform>().add(flecs::With, world.component<PreviousTransform>());
+    world.system<const Transform, PreviousTransform>("CapturePreviousTransforms")
+        .kind(flecs::OnLoad)
+        .each([](const Transform& transform, PreviousTransform& previous) {
+            previous.transform = transform;
+            previous.captured = true;
+        });
+}
+
+GameWorld::~GameWorld()
+{
+    // Chunks still loaded are not unloaded by the streamer, so their changes are saved here
+    terrain->getStreamer().saveModified();
+    // Terrain bodies are removed from the physics system before it is destroyed
+    terrainPhysics.reset();
+    physicsSystem.reset();
+}
+
+void GameWorld::syncTerrain()
 {
-    //physicsSystem->Init(maxBodies, 0, 65536, 20480,)
+    // The journal also holds the fluids' own changes from this frame's ticks, waking them again is harmless
+    fluids->voxelsChanged(terrain->getJournal());
+    for (const glm::i32vec3 position : terrain->getStreamer().getLoaded()) {
+        randomTicker->addChunk(position);
+        light->addChunk(position);
+    }
+    for (const glm::i32vec3 position : terrain->getStreamer().getUnloaded()) {
+        randomTicker->removeChunk(position);
+        light->removeChunk(position);
+    }
+    // Unloading a large area leaves its blocks pooled, their memory is returned once enough have piled up
+    unloadedSinceTrim += terrain->getStreamer().getUnloaded().size();
+    if (trimAfterUnloads > 0 && unloadedSinceTrim >= trimAfterUnloads) {
+        slabAllocator::trim();
+        unloadedSinceTrim = 0;
+    }
+    randomTicker->voxelsChanged(terrain->getJournal());
+    light->voxelsChanged(terrain->getJournal());
+    light->update(threadPool);
+    // After the ticks, so the graphs and collision see the voxels the fluids changed this frame
+    pathfinder->update();
+    terrainPhysics->update();
+}
+
+void GameWorld::update(const double deltaTime)
+{
+    fluids->update(deltaTime, threadPool);
+
+    randomTicks.clear();
+    // At most a few ticks per update, so a long update doesn't make the next one longer
+    randomTickTime = std::min(randomTickTime + deltaTime * randomTickRate, 4.0);
+    for (; randomTickTime >= 1.0; randomTickTime -= 1.0)
+        randomTicker->tick(threadPool, randomTicks);
+
+    // Jolt expects a collision step per 1/60s, long updates take more so fast bodies don't tunnel
+    const int collisionSteps = std::clamp(int(std::ceil(deltaTime * 60.0)), 1, 4);
+    const JPH::EPhysicsUpdateError error = physicsSystem->Update(
+        float(deltaTime),
+        collisionSteps,
+        tempAllocator.get(),
+        physicsJobs.get()
+    );
+    if (error != JPH::EPhysicsUpdateError::None)
+        spdlog::warn("Physics step ran out of space, error flags {}", uint32_t(error));
 }
-} // dragonfire
\ No newline at end of file
+} // dragonfire
@@ -3,19 +3,87 @@
 //
 
 #pragma once
+#include "physics_job_system.h"
+#include "physics_layers.h"
+#include "terrain_physics.h"
+#include "transform.h"
 #include <Jolt/Jolt.h>
+#include <Jolt/Core/TempAllocator.h>
 #include <Jolt/Physics/PhysicsSystem.h>
+#include <core/voxel/fluid.h>
+#include <core/voxel/light.h>
+#include <core/voxel/pathfinding.h>
+#include <core/voxel/random_tick.h>
+#include <core/voxel/region_file.h>
+#include <core/voxel/terrain.h>
+#include <core/voxel/voxel.h>
 #include <flecs.h>
 
 namespace dragonfire {
+class ThreadPool;
 
 class GameWorld {
+    ThreadPool& threadPool;
     flecs::world world;
+    BroadPhaseLayerMap broadPhaseLayers;
+    ObjectVsBroadPhaseFilter objectVsBroadPhaseFilter;
+    ObjectLayerPairs objectLayerPairs;
+    std::unique_ptr<JPH::TempAllocatorImpl> tempAllocator;
+    std::unique_ptr<PhysicsJobSystem> physicsJobs;
     std::unique_ptr<JPH::PhysicsSystem> physicsSystem;
+    /// Loaded before anything built from it, the collision and path graphs keep views of its tables
+    voxel::VoxelRegistry voxelTypes;
+    /// Modified chunks of the world's seed, saved when they are unloaded, null if saving is turned off
+    std::unique_ptr<voxel::ChunkStorage> chunkStorage;
+    std::unique_ptr<voxel::Terrain> terrain;
+    std::unique_ptr<voxel::LightEngine> light;
+    std::unique_ptr<TerrainPhysics> terrainPhysics;
+    std::unique_ptr<voxel::FluidSimulation> fluids;
+    std::unique_ptr<voxel::RandomTicker> randomTicker;
+    std::vector<voxel::RandomTick> randomTicks;
+    double randomTickRate;
+    /// Random ticks due but not yet run, in ticks
+    double randomTickTime = 0.0;
+    std::unique_ptr<voxel::Pathfinder> pathfinder;
+    /// Chunks unloaded before the memory of the pooled chunk blocks is given back, 0 to never give it back
+    size_t trimAfterUnloads;
+    size_t unloadedSinceTrim = 0;
 
 public:
-    explicit GameWorld(uint32_t maxBodies = 10240);
+    explicit GameWorld(ThreadPool& threadPool, uint32_t maxBodies = 10240);
+    ~GameWorld();
     flecs::world& getECSWorld() { return world; }
+
+    voxel::Terrain& getTerrain() { return *terrain; }
+
+    const voxel::VoxelRegistry& getVoxelTypes() const { return voxelTypes; }
+
+    JPH::PhysicsSystem& getPhysicsSystem() { return *physicsSystem; }
+
+    TerrainPhysics& getTerrainPhysics() { return *terrainPhysics; }
+
+    voxel::FluidSimulation& getFluids() { return *fluids; }
+
+    voxel::LightEngine& getLight() { return *light; }
+
+    voxel::RandomTicker& getRandomTicker() { return *randomTicker; }
+
+    /// Voxels picked by the random ticks run in the last update, for gameplay systems to act on
+    [[nodiscard]] std::span<const voxel::RandomTick> getRandomTicks() const noexcept { return randomTicks; }
+
+    voxel::Pathfinder& getPathfinder() { return *pathfinder; }
+
+    /***
+     * @brief Passes the chunks loaded and unloaded and the voxels changed since the last call to the
+     * simulations, relights them, rebuilds the path graphs of changed chunks and updates the terrain
+     * collision around active bodies. Meant to be called once per frame, after the ticks and Terrain::update
+     * and before RemeshScheduler::update clears the edits and meshes the changed light, see
+     * TerrainPhysics::update.
+     */
+    void syncTerrain();
+
+    /// Steps the fluids, runs the random ticks due and steps the physics, meant to be called once per tick
+    void update(double deltaTime);
 };
 
 }// namespace dragonfire
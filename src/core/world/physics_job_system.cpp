@@ -0,0 +1,82 @@
+#include "physics_job_system.h"
+#include <Jolt/Core/Factory.h>
+#include <Jolt/RegisterTypes.h>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+namespace dragonfire {
+
+void initJolt()
+{
+    static std::once_flag once;
+    std::call_once(once, [] {
+        JPH::RegisterDefaultAllocator();
+        JPH::Factory::sInstance = new JPH::Factory();
+        JPH::RegisterTypes();
+    });
+}
+
+PhysicsJobSystem::PhysicsJobSystem(ThreadPool& pool, const JPH::uint maxJobs, const JPH::uint maxBarriers)
+    : JobSystemWithBarrier(maxBarriers), pool(pool)
+{
+    jobs.Init(maxJobs, maxJobs);
+}
+
+PhysicsJobSystem::~PhysicsJobSystem()
+{
+    // Tasks still queued on the pool free their jobs through this
+    tasks.wait();
+}
+
+int PhysicsJobSystem::GetMaxConcurrency() const
+{
+    return int(pool.threadCount()) + 1;
+}
+
+PhysicsJobSystem::JobHandle PhysicsJobSystem::CreateJob(
+    const char* name,
+    const JPH::ColorArg color,
+    const JobFunction& function,
+    const JPH::uint32 dependencies
+)
+{
+    JPH::uint32 index = jobs.ConstructObject(name, color, this, function, dependencies);
+    if (index == decltype(jobs)::cInvalidObjectIndex) {
+        spdlog::warn("Out of physics jobs, waiting for the workers to finish some");
+        // Jobs are freed as the workers finish them
+        while (index == decltype(jobs)::cInvalidObjectIndex) {
+            std::this_thread::yield();
+            index = jobs.ConstructObject(name, color, this, function, dependencies);
+        }
+    }
+    Job* job = &jobs.Get(index);
+    // The handle holds a reference, so the job outlives its task if it is queued and finishes right away
+    JobHandle handle(job);
+    if (dependencies == 0)
+        QueueJob(job);
+    return handle;
+}
+
+void PhysicsJobSystem::QueueJob(Job* job)
+{
+    // Released by the task, which may run after a barrier already ran the job on the waiting thread
+    job->AddRef();
+    tasks.submit(pool, [job] {
+        job->Execute();
+        job->Release();
+    });
+}
+
+void PhysicsJobSystem::QueueJobs(Job** queued, const JPH::uint count)
+{
+    for (JPH::uint i = 0; i < count; i++)
+        QueueJob(queued[i]);
+}
+
+void PhysicsJobSystem::FreeJob(Job* job)
+{
+    jobs.DestructObject(job);
+}
+
+}// namespace dragonfire
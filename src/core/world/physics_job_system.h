@@ -0,0 +1,54 @@
+#pragma once
+#include "core/utility/thread_pool.h"
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/FixedSizeFreeList.h>
+#include <Jolt/Core/JobSystemWithBarrier.h>
+#include <Jolt/Physics/PhysicsSettings.h>
+
+namespace dragonfire {
+
+/// Sets up Jolt's allocator, factory and type registry, which are global, the first time it is called
+void initJolt();
+
+/***
+ * @brief Runs Jolt's jobs on the engine's thread pool, so physics doesn't start a second set of workers
+ * competing with terrain generation, meshing and the voxel simulations for cores
+ *
+ * The thread calling PhysicsSystem::Update runs jobs of the step itself while it waits for them, so a step
+ * still finishes when every worker is busy with other tasks. Must not be waited on from a worker of the pool.
+ */
+class PhysicsJobSystem final : public JPH::JobSystemWithBarrier {
+public:
+    explicit PhysicsJobSystem(
+        ThreadPool& pool,
+        JPH::uint maxJobs = JPH::cMaxPhysicsJobs,
+        JPH::uint maxBarriers = JPH::cMaxPhysicsBarriers
+    );
+    /// Waits for the pool to let go of every job queued on it
+    ~PhysicsJobSystem() override;
+
+    /// The workers of the pool and the thread waiting for the step
+    [[nodiscard]] int GetMaxConcurrency() const override;
+
+    JobHandle CreateJob(
+        const char* name,
+        JPH::ColorArg color,
+        const JobFunction& function,
+        JPH::uint32 dependencies = 0
+    ) override;
+
+    PhysicsJobSystem(const PhysicsJobSystem& other) = delete;
+    PhysicsJobSystem& operator=(const PhysicsJobSystem& other) = delete;
+
+protected:
+    void QueueJob(Job* job) override;
+    void QueueJobs(Job** queued, JPH::uint count) override;
+    void FreeJob(Job* job) override;
+
+private:
+    ThreadPool& pool;
+    JPH::FixedSizeFreeList<Job> jobs;
+    TaskGroup tasks;
+};
+
+}// namespace dragonfire
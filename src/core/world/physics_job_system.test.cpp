@@ -0,0 +1,166 @@
+#include "core/utility/thread_pool.h"
+#include "physics_job_system.h"
+#include "physics_layers.h"
+#include <Jolt/Core/TempAllocator.h>
+#include <Jolt/Physics/Body/BodyCreationSettings.h>
+#include <Jolt/Physics/Collision/Shape/BoxShape.h>
+#include <Jolt/Physics/Collision/Shape/SphereShape.h>
+#include <Jolt/Physics/PhysicsSystem.h>
+#include <catch.hpp>
+#include <chrono>
+#include <spdlog/spdlog.h>
+
+using namespace dragonfire;
+
+/// A physics system with a static floor whose top is at z = 0
+struct PhysicsScene {
+    BroadPhaseLayerMap broadPhaseLayers;
+    ObjectVsBroadPhaseFilter objectVsBroadPhaseFilter;
+    ObjectLayerPairs objectLayerPairs;
+    JPH::TempAllocatorImpl tempAllocator{16 * 1024 * 1024};
+    JPH::PhysicsSystem physics;
+
+    explicit PhysicsScene(const JPH::uint maxBodies)
+    {
+        physics.Init(
+            maxBodies,
+            0,
+            65536,
+            20480,
+            broadPhaseLayers,
+            objectVsBroadPhaseFilter,
+            objectLayerPairs
+        );
+        physics.SetGravity(JPH::Vec3(0.0f, 0.0f, -9.81f));
+        const JPH::BodyCreationSettings floor(
+            new JPH::BoxShape(JPH::Vec3(500.0f, 500.0f, 1.0f)),
+            JPH::RVec3(0.0f, 0.0f, -1.0f),
+            JPH::Quat::sIdentity(),
+            JPH::EMotionType::Static,
+            objectLayers::NON_MOVING
+        );
+        physics.GetBodyInterface().CreateAndAddBody(floor, JPH::EActivation::DontActivate);
+    }
+
+    JPH::BodyID addBody(const JPH::RefConst<JPH::Shape>& shape, const JPH::RVec3 position)
+    {
+        const JPH::BodyCreationSettings settings(
+            shape.GetPtr(),
+            position,
+            JPH::Quat::sIdentity(),
+            JPH::EMotionType::Dynamic,
+            objectLayers::MOVING
+        );
+        return physics.GetBodyInterface().CreateAndAddBody(settings, JPH::EActivation::Activate);
+    }
+
+    /// Steps a 60Hz tick
+    JPH::EPhysicsUpdateError step(JPH::JobSystem& jobs)
+    {
+        return physics.Update(1.0f / 60.0f, 1, &tempAllocator, &jobs);
+    }
+};
+
+TEST_CASE("Physics Job System", "[world]")
+{
+    initJolt();
+    ThreadPool pool(2);
+    PhysicsJobSystem jobs(pool);
+    CHECK(jobs.GetMaxConcurrency() == 3);
+
+    SECTION("Jobs run on the pool and barriers wait for them")
+    {
+        std::atomic_int count = 0;
+        JPH::JobSystem::Barrier* barrier = jobs.CreateBarrier();
+        for (int i = 0; i < 500; i++)
+            barrier->AddJob(jobs.CreateJob("Count", JPH::Color::sGreen, [&] { count++; }));
+        jobs.WaitForJobs(barrier);
+        jobs.DestroyBarrier(barrier);
+        CHECK(count == 500);
+    }
+
+    SECTION("Jobs wait for their dependencies")
+    {
+        std::atomic_int order = 0;
+        // Jobs finished before they are added to the barrier are not synchronized by it
+        std::atomic_int first = -1, second = -1;
+        JPH::JobSystem::Barrier* barrier = jobs.CreateBarrier();
+        const auto run = [&] { second = order++; };
+        JPH::JobSystem::JobHandle after = jobs.CreateJob("After", JPH::Color::sGreen, run, 1);
+        JPH::JobSystem::JobHandle before = jobs.CreateJob("Before", JPH::Color::sGreen, [&] {
+            first = order++;
+            after.RemoveDependency();
+        });
+        barrier->AddJob(before);
+        barrier->AddJob(after);
+        jobs.WaitForJobs(barrier);
+        jobs.DestroyBarrier(barrier);
+        CHECK(first == 0);
+        CHECK(second == 1);
+    }
+
+    SECTION("Bodies fall and come to rest on the floor")
+    {
+        PhysicsScene scene(16);
+        const JPH::BodyID sphere = scene.addBody(new JPH::SphereShape(0.5f), JPH::RVec3(0.0f, 0.0f, 5.0f));
+        for (int i = 0; i < 180; i++)
+            CHECK(scene.step(jobs) == JPH::EPhysicsUpdateError::None);
+        const JPH::RVec3 position = scene.physics.GetBodyInterface().GetCenterOfMassPosition(sphere);
+        CHECK(position.GetZ() == Approx(0.5f).margin(0.02f));
+    }
+}
+
+TEST_CASE("Physics Job System Teardown", "[world]")
+{
+    initJolt();
+    ThreadPool pool(3);
+    for (int round = 0; round < 200; round++) {
+        // Destroyed right after its jobs finish, while the pool tasks running them may still be returning
+        std::atomic_int count = 0;
+        PhysicsJobSystem jobs(pool);
+        JPH::JobSystem::Barrier* barrier = jobs.CreateBarrier();
+        for (int i = 0; i < 64; i++)
+            barrier->AddJob(jobs.CreateJob("Count", JPH::Color::sGreen, [&] { count++; }));
+        jobs.WaitForJobs(barrier);
+        jobs.DestroyBarrier(barrier);
+        REQUIRE(count == 64);
+    }
+}
+
+TEST_CASE("Physics Benchmark", "[.][benchmark]")
+{
+    initJolt();
+    ThreadPool pool;
+    PhysicsJobSystem jobs(pool);
+    constexpr int side = 16, layers = 4;
+    PhysicsScene scene(side * side * layers + 1);
+    const JPH::RefConst<JPH::Shape> box = new JPH::BoxShape(JPH::Vec3::sReplicate(0.5f));
+    for (int x = 0; x < side; x++) {
+        for (int y = 0; y < side; y++) {
+            for (int z = 0; z < layers; z++) {
+                const JPH::RVec3 position(float(x) * 1.5f, float(y) * 1.5f, 2.0f + float(z) * 1.5f);
+                scene.addBody(box, position);
+            }
+        }
+    }
+    scene.physics.OptimizeBroadPhase();
+
+    // Most of the bodies land and start colliding in the first few seconds
+    constexpr int ticks = 300;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ticks; i++)
+        scene.step(jobs);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    spdlog::info(
+        "{} falling bodies on {} threads, {:.3f}ms per tick, {} still active",
+        side * side * layers,
+        jobs.GetMaxConcurrency(),
+        std::chrono::duration<double, std::milli>(elapsed).count() / ticks,
+        scene.physics.GetNumActiveBodies(JPH::EBodyType::RigidBody)
+    );
+
+    BENCHMARK("Tick")
+    {
+        return scene.step(jobs);
+    };
+}
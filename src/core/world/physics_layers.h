@@ -0,0 +1,56 @@
+#pragma once
+#include <Jolt/Jolt.h>
+#include <Jolt/Physics/Collision/BroadPhase/BroadPhaseLayer.h>
+#include <Jolt/Physics/Collision/ObjectLayer.h>
+
+namespace dragonfire {
+
+/// Object layers of physics bodies, static bodies such as terrain never collide with each other
+namespace objectLayers {
+    constexpr JPH::ObjectLayer NON_MOVING = 0;
+    constexpr JPH::ObjectLayer MOVING = 1;
+    constexpr JPH::ObjectLayer COUNT = 2;
+}// namespace objectLayers
+
+/// Broad phase layers, one tree for static bodies and one for everything that moves
+namespace broadPhaseLayers {
+    constexpr JPH::BroadPhaseLayer NON_MOVING(0);
+    constexpr JPH::BroadPhaseLayer MOVING(1);
+    constexpr JPH::uint COUNT = 2;
+}// namespace broadPhaseLayers
+
+class BroadPhaseLayerMap final : public JPH::BroadPhaseLayerInterface {
+public:
+    [[nodiscard]] JPH::uint GetNumBroadPhaseLayers() const override { return broadPhaseLayers::COUNT; }
+
+    [[nodiscard]] JPH::BroadPhaseLayer GetBroadPhaseLayer(const JPH::ObjectLayer layer) const override
+    {
+        return layer == objectLayers::NON_MOVING ? broadPhaseLayers::NON_MOVING : broadPhaseLayers::MOVING;
+    }
+
+#if defined(JPH_EXTERNAL_PROFILE) || defined(JPH_PROFILE_ENABLED)
+    [[nodiscard]] const char* GetBroadPhaseLayerName(const JPH::BroadPhaseLayer layer) const override
+    {
+        return layer == broadPhaseLayers::NON_MOVING ? "NON_MOVING" : "MOVING";
+    }
+#endif
+};
+
+class ObjectVsBroadPhaseFilter final : public JPH::ObjectVsBroadPhaseLayerFilter {
+public:
+    [[nodiscard]] bool ShouldCollide(const JPH::ObjectLayer layer, const JPH::BroadPhaseLayer broadPhase)
+        const override
+    {
+        return layer != objectLayers::NON_MOVING || broadPhase == broadPhaseLayers::MOVING;
+    }
+};
+
+class ObjectLayerPairs final : public JPH::ObjectLayerPairFilter {
+public:
+    [[nodiscard]] bool ShouldCollide(const JPH::ObjectLayer a, const JPH::ObjectLayer b) const override
+    {
+        return a != objectLayers::NON_MOVING || b != objectLayers::NON_MOVING;
+    }
+};
+
+}// namespace dragonfire
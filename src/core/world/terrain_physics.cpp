@@ -0,0 +1,255 @@
+#include "terrain_physics.h"
+#include "core/utility/thread_pool.h"
+#include "core/voxel/collision.h"
+#include "core/voxel/terrain.h"
+#include "physics_layers.h"
+#include <Jolt/Physics/Body/BodyCreationSettings.h>
+#include <Jolt/Physics/Body/BodyLock.h>
+#include <Jolt/Physics/Collision/Shape/BoxShape.h>
+#include <Jolt/Physics/Collision/Shape/RotatedTranslatedShape.h>
+#include <Jolt/Physics/Collision/Shape/StaticCompoundShape.h>
+#include <Jolt/Physics/PhysicsSystem.h>
+#include <memory>
+#include <spdlog/spdlog.h>
+
+namespace dragonfire {
+
+static constexpr auto DIM = float(voxel::Chunk::CHUNK_DIM);
+
+/// Builds a shape in chunk local coordinates covering the boxes, null if there are none
+static JPH::RefConst<JPH::Shape> createShape(const std::span<const voxel::CollisionBox> boxes)
+{
+    if (boxes.empty())
+        return nullptr;
+    const auto halfExtent = [](const voxel::CollisionBox& box) {
+        return JPH::Vec3(box.size.x, box.size.y, box.size.z) * 0.5f;
+    };
+    const auto center = [&](const voxel::CollisionBox& box) {
+        return JPH::Vec3(box.min.x, box.min.y, box.min.z) + halfExtent(box);
+    };
+
+    JPH::ShapeSettings::ShapeResult result;
+    if (boxes.size() == 1) {
+        // Compounds need at least two shapes
+        const JPH::RefConst<JPH::Shape> box = new JPH::BoxShape(halfExtent(boxes[0]));
+        result = JPH::RotatedTranslatedShapeSettings(center(boxes[0]), JPH::Quat::sIdentity(), box).Create();
+    }
+    else {
+        JPH::StaticCompoundShapeSettings settings;
+        for (const voxel::CollisionBox& box : boxes)
+            settings.AddShape(center(box), JPH::Quat::sIdentity(), new JPH::BoxShape(halfExtent(box)));
+        result = settings.Create();
+    }
+    if (result.HasError()) {
+        spdlog::error("Failed to build chunk collision: {}", result.GetError().c_str());
+        return nullptr;
+    }
+    return result.Get();
+}
+
+static JPH::AABox chunkBounds(const glm::i32vec3 position)
+{
+    const glm::vec3 min = glm::vec3(position) * DIM;
+    return {JPH::Vec3(min.x, min.y, min.z), JPH::Vec3(min.x + DIM, min.y + DIM, min.z + DIM)};
+}
+
+TerrainPhysics::TerrainPhysics(
+    JPH::PhysicsSystem& physics,
+    voxel::Terrain& terrain,
+    ThreadPool& pool,
+    const std::span<const std::uint8_t> solid,
+    const TerrainPhysicsSettings& settings
+)
+    : settings(settings), physics(physics), terrain(terrain), pool(pool), solid(solid)
+{
+}
+
+TerrainPhysics::~TerrainPhysics()
+{
+    // Tasks still queued on the pool reference this
+    tasks.wait();
+    for (auto& [position, collision] : chunks) {
+        if (!collision.body.IsInvalid())
+            removeBody(collision);
+    }
+}
+
+void TerrainPhysics::update()
+{
+    updateCount++;
+    for (const glm::i32vec3 position : terrain.getStreamer().getUnloaded()) {
+        const auto found = chunks.find(position);
+        if (found == chunks.end())
+            continue;
+        ChunkCollision& collision = found->second;
+        if (!collision.body.IsInvalid())
+            removeBody(collision);
+        cached -= collision.built;
+        building -= collision.building;
+        chunks.erase(found);
+    }
+    for (const voxel::JournalChunk& edited : terrain.getJournal().chunks())
+        invalidate(edited.position);
+    applyResults();
+
+    findNeeded();
+    JPH::BodyInterface& bodyInterface = physics.GetBodyInterface();
+    added.clear();
+    for (const glm::i32vec3 position : needed) {
+        ChunkCollision& collision = chunks.find(position)->second;
+        if (!collision.built) {
+            if (!collision.building && building < settings.maxPendingBuilds)
+                submit(position, collision);
+            continue;
+        }
+        if (collision.shape == nullptr || !collision.body.IsInvalid())
+            continue;
+        const glm::vec3 origin = glm::vec3(position) * DIM;
+        const JPH::BodyCreationSettings creation(
+            collision.shape.GetPtr(),
+            JPH::RVec3(origin.x, origin.y, origin.z),
+            JPH::Quat::sIdentity(),
+            JPH::EMotionType::Static,
+            objectLayers::NON_MOVING
+        );
+        const JPH::Body* body = bodyInterface.CreateBody(creation);
+        if (body == nullptr) {
+            spdlog::warn("Out of physics bodies for terrain collision");
+            break;
+        }
+        collision.body = body->GetID();
+        added.push_back(collision.body);
+        bodies++;
+    }
+    // Adding in one batch builds the broad phase nodes for all of them at once
+    if (!added.empty()) {
+        const auto count = int(added.size());
+        const JPH::BodyInterface::AddState state = bodyInterface.AddBodiesPrepare(added.data(), count);
+        bodyInterface.AddBodiesFinalize(added.data(), count, state, JPH::EActivation::DontActivate);
+    }
+
+    // Remove the bodies of chunks nothing has been near for a while, and forget chunks with nothing cached
+    needed.clear();
+    for (auto& [position, collision] : chunks) {
+        const bool stale = updateCount - collision.lastNeeded > settings.keepUpdates;
+        if (stale && !collision.body.IsInvalid())
+            removeBody(collision);
+        if (!collision.built && !collision.building && collision.body.IsInvalid())
+            needed.push_back(position);
+    }
+    for (const glm::i32vec3 position : needed)
+        chunks.erase(position);
+}
+
+void TerrainPhysics::invalidate(const glm::i32vec3 position)
+{
+    const auto found = chunks.find(position);
+    if (found == chunks.end())
+        return;
+    // The body keeps its reference to the old shape until the new one replaces it
+    ChunkCollision& collision = found->second;
+    collision.version = ++versions;
+    // The build in flight is discarded when it finishes, so it no longer counts against maxPendingBuilds
+    building -= collision.building;
+    collision.building = false;
+    cached -= collision.built;
+    collision.built = false;
+    collision.shape = nullptr;
+}
+
+void TerrainPhysics::findNeeded()
+{
+    needed.clear();
+    JPH::BodyIDVector active;
+    physics.GetActiveBodies(JPH::EBodyType::RigidBody, active);
+    const JPH::BodyLockInterface& locks = physics.GetBodyLockInterface();
+    const voxel::ChunkMap& loaded = terrain.getChunks();
+    for (const JPH::BodyID id : active) {
+        glm::vec3 min, max;
+        {
+            const JPH::BodyLockRead lock(locks, id);
+            if (!lock.Succeeded() || !lock.GetBody().IsDynamic())
+                continue;
+            const JPH::Body& body = lock.GetBody();
+            const JPH::AABox bounds = body.GetWorldSpaceBounds();
+            const JPH::Vec3 motion = body.GetLinearVelocity() * settings.lookahead;
+            const JPH::Vec3 low = JPH::Vec3::sMin(bounds.mMin, bounds.mMin + motion);
+            const JPH::Vec3 high = JPH::Vec3::sMax(bounds.mMax, bounds.mMax + motion);
+            min = glm::vec3(low.GetX(), low.GetY(), low.GetZ()) - settings.margin;
+            max = glm::vec3(high.GetX(), high.GetY(), high.GetZ()) + settings.margin;
+        }
+        const glm::i32vec3 first = voxel::ChunkStreamer::chunkPosition(min);
+        const glm::i32vec3 last = voxel::ChunkStreamer::chunkPosition(max);
+        for (std::int32_t x = first.x; x <= last.x; x++) {
+            for (std::int32_t y = first.y; y <= last.y; y++) {
+                for (std::int32_t z = first.z; z <= last.z; z++) {
+                    if (loaded.find({x, y, z}) == nullptr)
+                        continue;
+                    const auto [found, inserted] = chunks.try_emplace({x, y, z});
+                    ChunkCollision& collision = found->second;
+                    if (inserted)
+                        collision.version = ++versions;
+                    if (collision.lastNeeded == updateCount)
+                        continue;
+                    collision.lastNeeded = updateCount;
+                    needed.emplace_back(x, y, z);
+                }
+            }
+        }
+    }
+}
+
+void TerrainPhysics::submit(const glm::i32vec3 position, ChunkCollision& collision)
+{
+    const voxel::Chunk* chunk = terrain.getChunks().find(position);
+    if (chunk == nullptr)
+        return;
+    // Copied so the chunk can be edited while the shape is built
+    const auto copy = std::make_shared<voxel::Chunk>(*chunk);
+    collision.building = true;
+    building++;
+    tasks.submit(pool, [this, copy, position, version = collision.version] {
+        thread_local std::vector<voxel::CollisionBox> boxes;
+        voxel::buildCollisionBoxes(*copy, boxes, solid);
+        completed.push({position, version, createShape(boxes)});
+    });
+}
+
+void TerrainPhysics::applyResults()
+{
+    results.clear();
+    completed.drain(results);
+    JPH::BodyInterface& bodyInterface = physics.GetBodyInterface();
+    for (BuiltShape& result : results) {
+        // Versions are unique across entries, so builds started before an edit, or for an entry erased on
+        // unload and created again since, never match
+        const auto found = chunks.find(result.position);
+        if (found == chunks.end() || found->second.version != result.version)
+            continue;
+        ChunkCollision& collision = found->second;
+        collision.building = false;
+        building--;
+        collision.shape = std::move(result.shape);
+        collision.built = true;
+        cached++;
+        if (collision.body.IsInvalid())
+            continue;
+        if (collision.shape == nullptr)
+            removeBody(collision);
+        else
+            bodyInterface.SetShape(collision.body, collision.shape, false, JPH::EActivation::DontActivate);
+        // Bodies asleep on the old shape would otherwise float or sink into the new one
+        bodyInterface.ActivateBodiesInAABox(chunkBounds(result.position), {}, {});
+    }
+}
+
+void TerrainPhysics::removeBody(ChunkCollision& collision)
+{
+    JPH::BodyInterface& bodyInterface = physics.GetBodyInterface();
+    bodyInterface.RemoveBody(collision.body);
+    bodyInterface.DestroyBody(collision.body);
+    collision.body = JPH::BodyID();
+    bodies--;
+}
+
+}// namespace dragonfire
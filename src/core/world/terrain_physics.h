@@ -0,0 +1,122 @@
+#pragma once
+#include "core/utility/completion_queue.h"
+#include "core/utility/thread_pool.h"
+#include "core/voxel/chunk_map.h"
+#include <Jolt/Jolt.h>
+#include <Jolt/Physics/Body/BodyID.h>
+#include <Jolt/Physics/Collision/Shape/Shape.h>
+#include <ankerl/unordered_dense.h>
+#include <span>
+#include <vector>
+
+namespace JPH {
+class PhysicsSystem;
+}
+
+namespace dragonfire {
+namespace voxel {
+    class Terrain;
+}
+
+struct TerrainPhysicsSettings {
+    /// Distance in voxels around the bounds of each active body that needs collision
+    float margin = 2.0f;
+    /// Seconds of motion added to the bounds of each active body, so fast bodies have collision ahead of them
+    float lookahead = 0.25f;
+    /// Updates a chunk stays in the physics system after no active body is near it, so bodies moving back
+    /// and forth over a border don't add and remove it every update
+    std::uint32_t keepUpdates = 120;
+    /// Maximum number of shape builds in flight at once
+    std::uint32_t maxPendingBuilds = 64;
+};
+
+/***
+ * @brief Static collision for the chunks of a terrain, built only around active dynamic bodies
+ *
+ * Each chunk near an active body gets a static body made of a compound of boxes merged from its solid
+ * voxels, see buildCollisionBoxes. Shapes are built on the thread pool from a copy of the chunk and stay
+ * cached until the chunk is edited or unloaded, bodies are removed once nothing active is near them. An
+ * edited chunk keeps its previous shape until the new one is ready.
+ */
+class TerrainPhysics {
+public:
+    TerrainPhysicsSettings settings;
+
+    /***
+     * @param solid whether each voxel id blocks movement, see VoxelRegistry::solidity. Must outlive this.
+     */
+    TerrainPhysics(
+        JPH::PhysicsSystem& physics,
+        voxel::Terrain& terrain,
+        ThreadPool& pool,
+        std::span<const std::uint8_t> solid = {},
+        const TerrainPhysicsSettings& settings = {}
+    );
+    /// Waits for any shape builds still on the pool and removes every terrain body
+    ~TerrainPhysics();
+
+    /***
+     * @brief Submits shape builds for chunks near active bodies, adds finished shapes to the physics system
+     * and removes bodies no longer needed. Meant to be called once per frame, outside of physics updates.
+     *
+     * Reads the terrain's edit journal and the chunks it unloaded, so it must be called after Terrain::update
+     * and before RemeshScheduler::update clears the edits.
+     */
+    void update();
+
+    /// Drops the cached shape of a chunk so it is rebuilt, call after changing the chunk without recording it
+    /// in the terrain's edit journal
+    void invalidate(glm::i32vec3 position);
+
+    /// Number of chunks with a body in the physics system
+    [[nodiscard]] std::size_t bodyCount() const noexcept { return bodies; }
+
+    /// Number of chunks with a cached shape, including empty chunks that need no shape
+    [[nodiscard]] std::size_t cachedShapes() const noexcept { return cached; }
+
+    /// Number of shape builds in flight
+    [[nodiscard]] std::size_t pendingBuilds() const noexcept { return building; }
+
+    TerrainPhysics(const TerrainPhysics& other) = delete;
+    TerrainPhysics& operator=(const TerrainPhysics& other) = delete;
+
+private:
+    struct ChunkCollision {
+        /// Null if the chunk has no solid voxels or the shape has not been built
+        JPH::RefConst<JPH::Shape> shape;
+        JPH::BodyID body;
+        /// Taken from versions when the entry is created and by each edit, so a build started before the
+        /// edit, or before the entry was erased and created again, is discarded
+        std::uint64_t version = 0;
+        /// Update the chunk was last near an active body
+        std::uint64_t lastNeeded = 0;
+        bool built = false;
+        bool building = false;
+    };
+
+    struct BuiltShape {
+        glm::i32vec3 position;
+        std::uint64_t version;
+        JPH::RefConst<JPH::Shape> shape;
+    };
+
+    JPH::PhysicsSystem& physics;
+    voxel::Terrain& terrain;
+    ThreadPool& pool;
+    std::span<const std::uint8_t> solid;
+    ankerl::unordered_dense::map<glm::i32vec3, ChunkCollision, voxel::ChunkPositionHash> chunks;
+    CompletionQueue<BuiltShape> completed;
+    std::vector<BuiltShape> results;
+    std::vector<glm::i32vec3> needed;
+    std::vector<JPH::BodyID> added;
+    std::uint64_t updateCount = 0, versions = 0;
+    std::size_t bodies = 0, cached = 0, building = 0;
+    TaskGroup tasks;
+
+    void findNeeded();
+    void submit(glm::i32vec3 position, ChunkCollision& collision);
+    void applyResults();
+    void removeBody(ChunkCollision& collision);
+};
+
+}// namespace dragonfire
@@ -35,4 +35,21 @@ struct Transform {
     Transform& operator=(Transform&& other) noexcept = default;
 };
 
+/// Transform of an entity at the start of the last tick, rendering interpolates from it to the Transform
+struct PreviousTransform {
+    Transform transform;
+    /// False until a tick has run since the entity got its Transform, until then it is drawn at its Transform
+    bool captured = false;
+};
+
+/// Blends two transforms, alpha 0 gives from and 1 gives to
+[[nodiscard]] inline Transform interpolate(const Transform& from, const Transform& to, const float alpha)
+{
+    return {
+        glm::mix(from.position, to.position, alpha),
+        glm::mix(from.scale, to.scale, alpha),
+        glm::slerp(from.rotation, to.rotation, alpha),
+    };
+}
+
 }// namespace dragonfire
\ No newline at end of file
@@ -6,6 +6,7 @@ layout (location=0) in vec3 normal;
 layout (location=1) in vec2 uv;
 layout (location=2) in vec3 fragPos;
 layout (location=3) in flat uint instanceIndex;
+layout (location=4) in vec2 light;
 
 layout (set=0, binding=0) uniform Ubo {
     mat4 perspective;
@@ -41,5 +42,9 @@ void main() {
     if (textureIndices.base != 0) {
         objectColor = vec3(texture(bindless_textures[textureIndices.base], uv));
     }
-    outColor = vec4((ambient + diffuse + specular) * objectColor, 1.0);
+    // Each level of voxel light is 80% as bright as the one above it, sky light dims the sun and block light
+    // adds its own
+    vec3 sky = (ambient + diffuse + specular) * pow(0.8, 15.0 * (1.0 - light.x));
+    float block = pow(0.8, 15.0 * (1.0 - light.y));
+    outColor = vec4((sky + block * lightColor) * objectColor, 1.0);
 }
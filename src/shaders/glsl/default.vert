@@ -3,6 +3,7 @@
 layout (location=0) in vec3 position;
 layout (location=1) in vec3 normal;
 layout (location=2) in vec2 uv;
+layout (location=3) in vec2 light;
 
 layout (set=0, binding=0) uniform Ubo {
     mat4 perspective;
@@ -21,6 +22,7 @@ layout (location=0) out vec3 normalOut;
 layout (location=1) out vec2 uvOut;
 layout (location=2) out vec3 fragPos;
 layout (location=3) out uint instanceIndex;
+layout (location=4) out vec2 lightOut;
 
 void main()
 {
@@ -31,5 +33,6 @@ void main()
     // forward normals and uvs to fragment shader
     normalOut = normal;
     uvOut = uv;
+    lightOut = light;
     instanceIndex = gl_InstanceIndex;
 }